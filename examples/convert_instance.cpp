@@ -0,0 +1,29 @@
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+#include "models/EAModel3DHelpers.hpp"
+
+// Converts the text neighbor and bond tables of an L x L x L instance into
+// the binary instance format read by run_3D_EA (see EAModel3DHelpers.hpp).
+int main(int argc, char* argv[]) {
+    if (argc != 5) {
+        std::cerr << "Usage: " << argv[0]
+                  << " <L> <neighbor_table_path> <bond_table_path> <instance_path>"
+                  << std::endl;
+        return 1;
+    }
+
+    int L = std::atoi(argv[1]);
+    int num_spins = L * L * L;
+    int num_neighbors = 6;
+
+    try {
+        convertTextInstance(argv[2], argv[3], argv[4], L, num_spins, num_neighbors);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -4,18 +4,88 @@
 #include <string>
 #include <gsl/gsl_rng.h>
 #include <iomanip>
+#include <memory>
 #include <omp.h>
+#include <type_traits>
 
+#include "DataWriter.hpp"
 #include "Population.hpp"
+#include "StepRecorder.hpp"
 #include "models/IsingModel.hpp"
+#include "models/BatchedEAModel.hpp"
+#include "models/MultiSpinEAModel.hpp"
 #include "SharedModelData.hpp"
 #include "models/EAModel3DHelpers.hpp"
 #include "Genealogy.hpp"
 
+template <typename ModelType>
+void runAnnealing(const SharedModelData<ModelType>& shared_data, int pop_size,
+                  double culling_frac, double beta_max, unsigned long int seed,
+                  const std::string& engine, const std::string& output_dir) {
+    Population<ModelType> population(pop_size, gsl_rng_mt19937, shared_data, seed);
+
+    // With an output directory every step goes to binary columns (see
+    // DataWriter.hpp) written in the background, instead of a text line
+    std::unique_ptr<DataWriter> writer;
+    std::unique_ptr<StepRecorder<ModelType>> recorder;
+    if (!output_dir.empty()) {
+        writer = std::make_unique<DataWriter>(output_dir);
+        recorder = std::make_unique<StepRecorder<ModelType>>(*writer);
+    }
+
+    double beta = 0.0;
+    int step = 0;
+    while (beta <= beta_max) {
+        if constexpr (std::is_same_v<ModelType, IsingModel>) {
+            if (engine == "houdayer") {
+                // Same 30 sweeps, with a round of Houdayer moves after each
+                // block of 10.
+                for (int block = 0; block < 3; ++block) {
+                    population.equilibrate(10, beta, ModelType::UpdateMethod::metropolis, true);
+                    population.houdayerMoves();
+                }
+            } else if (engine == "nfold" && beta >= 1.0) {
+                // Low temperature tail: most Metropolis proposals would be
+                // rejected, so skip them.
+                population.equilibrate(30, beta, ModelType::UpdateMethod::n_fold_way, false);
+            } else {
+                population.equilibrate(30, beta, ModelType::UpdateMethod::metropolis, true);
+            }
+        } else {
+            population.equilibrate(30, beta, ModelType::UpdateMethod::metropolis, true);
+        }
+        if (recorder) {
+            recorder->record(step, population);
+        } else {
+            double E = population.measureEnergy();
+            double E_min = population.getMinEnergy();
+            GenealogyStatistics stats = population.computeGenealogyStatistics();
+
+            std::cout << std::fixed << std::setprecision(15)
+              << step << " " << beta << " "
+              << E << " "
+              << E_min << " "
+              << stats.rho_t << " "
+              << stats.num_gs_families << std::endl;
+        }
+
+        if (beta == beta_max) break;
+        beta = population.suggestNextBeta(beta, culling_frac);
+        if (beta > beta_max) beta = beta_max;
+        population.resample(beta);
+        step++;
+    }
+    if (writer) {
+        writer->close();
+    }
+}
+
 int main(int argc, char* argv[]) {
-    if (argc < 8 || argc > 9) {
+    if (argc < 8 || argc > 12) {
         std::cerr << "Usage: " << argv[0] 
-                << " <L> <pop_size> <culling_frac> <beta_max> <seed> <neighbor_table_path> <bond_table_path> [num_threads]" 
+                << " <L> <pop_size> <culling_frac> <beta_max> <seed> <neighbor_table_path> <bond_table_path> [num_threads] [ising|houdayer|nfold|msc|batched] [original|morton|tiled|rcm] [output_dir]" 
+                << std::endl;
+        std::cerr << "       (or a binary instance from convert_instance in place of <neighbor_table_path>, with - as <bond_table_path>)"
                 << std::endl;
         return 1;
     }
@@ -30,7 +100,7 @@ int main(int argc, char* argv[]) {
     std::string bond_path = argv[7];
 
     // Parse optional num_threads
-    if (argc == 9) {
+    if (argc >= 9) {
         int num_threads = std::atoi(argv[8]);
         if (num_threads > 0) {
             omp_set_num_threads(num_threads);
@@ -39,39 +109,99 @@ int main(int argc, char* argv[]) {
         }
     }
 
-std::cout << "Using " << omp_get_max_threads() << " OpenMP threads\n";
+    // Optional engine: "msc" selects the 64-replica multi-spin-coded model,
+    // which only accepts +/-J bonds; "batched" runs 8 replicas in lock-step
+    // with real-valued (e.g. Gaussian) bonds; "houdayer" adds Houdayer cluster moves
+    // between the IsingModel sweeps; "nfold" switches to the rejection-free
+    // n-fold way for beta >= 1, which needs discrete (e.g. +/-J) bonds.
+    std::string engine = (argc >= 10) ? argv[9] : "ising";
+    if (engine != "ising" && engine != "houdayer" && engine != "nfold" && engine != "msc" &&
+        engine != "batched") {
+        std::cerr << "Unknown engine '" << engine << "', expected ising, houdayer, nfold, msc or batched." << std::endl;
+        return 1;
+    }
 
-    int num_spins = L * L * L;
-    int num_neighbors = 6;
+    // Optional order in which the ising, houdayer and nfold engines store the
+    // spins: Z-order (morton), 4^3 blocks (tiled) or reverse Cuthill-McKee
+    // (rcm) keep the neighbors of a spin in fewer cache lines than the
+    // row-major order of the tables. Energies and states are unaffected.
+    const std::string order_name = (argc >= 11) ? argv[10] : "original";
+    SpinOrder spin_order = SpinOrder::original;
+    if (order_name == "morton") {
+        spin_order = SpinOrder::morton;
+    } else if (order_name == "tiled") {
+        spin_order = SpinOrder::tiled;
+    } else if (order_name == "rcm") {
+        spin_order = SpinOrder::rcm;
+    } else if (order_name != "original") {
+        std::cerr << "Unknown spin order '" << order_name << "', expected original, morton, tiled or rcm." << std::endl;
+        return 1;
+    }
+    // Optional output directory for the per-step columns
+    const std::string output_dir = (argc == 12) ? argv[11] : "";
 
-    std::vector<int> neighbor_table = loadNeighborTable(neighbor_path, num_spins, num_neighbors);
-    std::vector<double> bond_table = loadBondTable(bond_path, num_spins, num_neighbors);
+    if (spin_order != SpinOrder::original && (engine == "msc" || engine == "batched")) {
+        std::cerr << "The " << engine << " engine keeps the original spin order." << std::endl;
+        return 1;
+    }
 
-    SharedModelData<IsingModel> shared_data(L, num_spins, num_neighbors,
-                                            neighbor_table.data(), bond_table.data());
+std::cout << "Using " << omp_get_max_threads() << " OpenMP threads\n";
 
-    Population<IsingModel> population(pop_size, gsl_rng_mt19937, shared_data, seed);
+    int num_spins = L * L * L;
+    int num_neighbors = 6;
 
-    double beta = 0.0;
-    int step = 0;
-    while (beta <= beta_max) {
-        population.equilibrate(30, beta, IsingModel::UpdateMethod::metropolis, true);
-        double E = population.measureEnergy();
-        double E_min = population.getMinEnergy();
-        GenealogyStatistics stats = population.computeGenealogyStatistics();
-
-        std::cout << std::fixed << std::setprecision(15)
-          << step << " " << beta << " "
-          << E << " "
-          << E_min << " "
-          << stats.rho_t << " "
-          << stats.num_gs_families << std::endl;
+    // A binary instance is mapped rather than read, and its tables are used
+    // in place.
+    std::unique_ptr<InstanceFile> instance;
+    std::vector<int> neighbor_storage;
+    std::vector<double> bond_storage;
+    const int* neighbor_table;
+    const double* bond_table;
+    if (isInstanceFile(neighbor_path)) {
+        if (bond_path != "-") {
+            std::cerr << "Pass - as the bond table path with a binary instance." << std::endl;
+            return 1;
+        }
+        instance = std::make_unique<InstanceFile>(neighbor_path);
+        if (instance->systemSize() != L || instance->numSpins() != num_spins ||
+            instance->numNeighbors() != num_neighbors) {
+            std::cerr << "Instance " << neighbor_path << " has L = " << instance->systemSize()
+                      << ", " << instance->numSpins() << " spins and " << instance->numNeighbors()
+                      << " neighbors, expected L = " << L << "." << std::endl;
+            return 1;
+        }
+        neighbor_table = instance->neighborTable();
+        bond_table = instance->bondTable();
+    } else {
+        neighbor_storage = loadNeighborTable(neighbor_path, num_spins, num_neighbors);
+        bond_storage = loadBondTable(bond_path, num_spins, num_neighbors);
+        neighbor_table = neighbor_storage.data();
+        bond_table = bond_storage.data();
+    }
 
-        if (beta == beta_max) break;
-        beta = population.suggestNextBeta(beta, culling_frac);
-        if (beta > beta_max) beta = beta_max;
-        population.resample(beta);
-        step++;
+    if (engine == "msc") {
+        SharedModelData<MultiSpinEAModel> shared_data(L, num_spins, num_neighbors,
+                                                      neighbor_table, bond_table);
+        runAnnealing(shared_data, pop_size, culling_frac, beta_max, seed, engine, output_dir);
+    } else if (engine == "batched") {
+        SharedModelData<BatchedEAModel> shared_data(L, num_spins, num_neighbors,
+                                                    neighbor_table, bond_table);
+        runAnnealing(shared_data, pop_size, culling_frac, beta_max, seed, engine, output_dir);
+    } else {
+        // Without relabeling the tables are used in place, as for the other
+        // engines.
+        SharedModelData<IsingModel> shared_data =
+            spin_order == SpinOrder::original
+                ? SharedModelData<IsingModel>(L, num_spins, num_neighbors,
+                                              neighbor_table, bond_table)
+                : SharedModelData<IsingModel>::relabeled(L, num_spins, num_neighbors,
+                                                         neighbor_table, bond_table,
+                                                         spin_order);
+        if (engine == "nfold" && !shared_data.discrete_bonds) {
+            std::cerr << "The nfold engine requires discrete bonds." << std::endl;
+            return 1;
+        }
+        runAnnealing(shared_data, pop_size, culling_frac, beta_max, seed, engine, output_dir);
     }
 
     return 0;
@@ -1,19 +1,25 @@
 #include <iostream>
+#include <cmath>
 #include <cstdlib>
+#include <memory>
+#include <string>
 #include <vector>
 #include <gsl/gsl_rng.h>
 #include <omp.h>
 
+#include "DataWriter.hpp"
+#include "ObservableSet.hpp"
 #include "Population.hpp"
+#include "StepRecorder.hpp"
 #include "models/IsingModel.hpp"
 #include "SharedModelData.hpp"
 #include "models/Ising3DHelpers.hpp"
 #include "Genealogy.hpp"
 
 int main(int argc, char* argv[]) {
-    if (argc < 6 || argc > 7) {
+    if (argc < 6 || argc > 8) {
         std::cerr << "Usage: " << argv[0]
-                << " <L> <pop_size> <culling_frac> <beta_max> <seed> [num_threads]" << std::endl;
+                << " <L> <pop_size> <culling_frac> <beta_max> <seed> [num_threads] [output_dir]" << std::endl;
         return 1;
     }
 
@@ -26,7 +32,7 @@ int main(int argc, char* argv[]) {
     unsigned long int seed = static_cast<unsigned long int>(std::stoul(argv[5]));
 
     // Optional num_threads argument
-    if (argc == 7) {
+    if (argc >= 7) {
         int num_threads = std::atoi(argv[6]);
         if (num_threads > 0) {
             omp_set_num_threads(num_threads);
@@ -46,44 +52,69 @@ int main(int argc, char* argv[]) {
     // Create population
     Population<IsingModel> population(pop_size, gsl_rng_mt19937, shared_data, seed);
 
+    // Checkerboard sweeps are vectorized but need a bipartite (even L) lattice
+    const bool checkerboard = (L % 2 == 0);
+    const IsingModel::UpdateMethod method =
+        checkerboard ? IsingModel::UpdateMethod::metropolis_checkerboard
+                     : IsingModel::UpdateMethod::metropolis;
+
+    // Magnetization moments for the Binder cumulant, measured together with
+    // the energy at the end of every equilibrate
+    ObservableSet<IsingModel> observables;
+    const int m1 = observables.add(IsingModel::Observable::magnetization);
+    const int m2 = observables.add(IsingModel::Observable::magnetization, 2);
+    const int m4 = observables.add(IsingModel::Observable::magnetization, 4);
+    population.setObservables(observables);
+
+    // With an output directory every step goes to binary columns (see
+    // DataWriter.hpp) written in the background, instead of a text line
+    std::unique_ptr<DataWriter> writer;
+    std::unique_ptr<StepRecorder<IsingModel>> recorder;
+    int binder_column = -1;
+    if (argc == 8) {
+        writer = std::make_unique<DataWriter>(argv[7]);
+        recorder = std::make_unique<StepRecorder<IsingModel>>(
+            *writer, std::vector<std::string>{"m", "m2", "m4"});
+        binder_column = writer->addScalar("binder");
+    }
+
     // Annealing loop
     double beta = beta_min;
     int step = 0;
     while (beta <= beta_max) {
-        population.equilibrate(10, beta, IsingModel::UpdateMethod::metropolis, true);
+        population.equilibrate(10, beta, method, true);
         double E = population.measureEnergy(); 
 
-        double M_sum = 0.0;
-        double M2_sum = 0.0;
-        double M4_sum = 0.0;
-        for (const auto& model : population.getModels()) {
-            double m = model.measureMagnetization() / num_spins;  
-            M_sum += m;
-            M2_sum += m * m;
-            M4_sum += m * m * m * m;
-        }
-        int current_pop_size = population.getPopSize();
-        double M_avg = M_sum / current_pop_size;
-        double M2_avg = M2_sum / current_pop_size;
-        double M4_avg = M4_sum / current_pop_size;
+        const std::vector<double>& moments = population.measureObservables();
+        double M_avg = moments[m1] / num_spins;
+        double M2_avg = moments[m2] / (static_cast<double>(num_spins) * num_spins);
+        double M4_avg = moments[m4] / std::pow(static_cast<double>(num_spins), 4);
 
         double binder = 1.0 - M4_avg / (3.0 * M2_avg * M2_avg);
 
-        GenealogyStatistics stats = population.computeGenealogyStatistics();
+        if (recorder) {
+            writer->set(binder_column, binder);
+            recorder->record(step, population);
+        } else {
+            GenealogyStatistics stats = population.computeGenealogyStatistics();
 
-        std::cout << step << " "
-        << beta << " " 
-        << E / num_spins << " "
-        << M_avg << " "
-        << binder << " "
-        << stats.rho_t << " "
-        << stats.rho_s << std::endl;
+            std::cout << step << " "
+            << beta << " "
+            << E / num_spins << " "
+            << M_avg << " "
+            << binder << " "
+            << stats.rho_t << " "
+            << stats.rho_s << std::endl;
+        }
         if (beta == beta_max) break;
         beta = population.suggestNextBeta(beta, culling_frac);
         if (beta > beta_max) beta = beta_max;
         population.resample(beta);
         step++;
     }
+    if (writer) {
+        writer->close();
+    }
 
     return 0;
 }
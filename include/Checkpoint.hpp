@@ -0,0 +1,102 @@
+#ifndef CHECKPOINT_HPP
+#define CHECKPOINT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// On-disk checkpoint of a Population (see Population::saveCheckpoint). The
+// file is the fixed header below followed by these sections, each starting
+// on a CHECKPOINT_ALIGNMENT boundary at the offset recorded in the header:
+//
+//   population gsl_rng state           rng_state_bytes
+//   running energy of every lane       num_models * lanes doubles
+//   measured energy of every replica   pop_size doubles
+//   family of every lane               num_models * lanes int32
+//   parent of every lane               num_models * lanes int32
+//   replica states                     num_models * state_bytes
+//
+// The replica states are the raw stateData() bytes of each model object in
+// order, so a checkpoint is written in one sequential pass and a restart maps
+// the file and copies them back without parsing. Everything is in native
+// byte order: a checkpoint restarts a run on the same kind of machine, it is
+// not an exchange format.
+
+constexpr char CHECKPOINT_MAGIC[8] = {'P', 'A', 'M', 'C', 'C', 'K', 'P', 'T'};
+constexpr std::uint32_t CHECKPOINT_VERSION = 3;
+constexpr std::size_t CHECKPOINT_ALIGNMENT = 64;
+
+struct CheckpointHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t header_bytes;
+  // ModelType::stateBytes, the size of one model object's state, and
+  // ModelType::stateLayout (0 if the model has none).
+  std::uint64_t state_bytes;
+  std::uint64_t state_layout;
+  std::int32_t lanes;
+  std::int32_t num_models;
+  std::int32_t pop_size;
+  std::int32_t initial_pop_size;
+  std::int32_t nom_pop_size;
+  std::int32_t max_pop_size;
+  std::int32_t rng_backend;
+  std::int32_t energies_current;
+  std::int64_t step;
+  std::int64_t num_resamples;
+  std::int64_t num_houdayer_rounds;
+  std::uint64_t seed;
+  std::uint64_t resample_seed;
+  double beta;
+  double delta_beta_f;
+  // Energy moments as of the last measurement.
+  double avg_energy;
+  double var_energy;
+  double min_energy;
+  char rng_name[32];
+  std::uint64_t rng_state_bytes;
+
+  // Filled in by layoutCheckpoint.
+  std::uint64_t rng_state_offset;
+  std::uint64_t lane_energies_offset;
+  std::uint64_t energies_offset;
+  std::uint64_t families_offset;
+  std::uint64_t parents_offset;
+  std::uint64_t states_offset;
+  std::uint64_t file_bytes;
+};
+
+// Sets the section offsets and file_bytes of header from its sizes.
+void layoutCheckpoint(CheckpointHeader& header);
+
+// Writes bytes to path + ".tmp", flushes it to disk and renames it over path,
+// so a process killed while writing leaves the previous checkpoint intact.
+void writeCheckpointFile(const std::string& path, const void* data,
+                         std::size_t bytes);
+
+// Read-only memory map of a checkpoint file. The constructor checks the magic,
+// version and layout against the file size and throws std::runtime_error on a
+// mismatch, so a truncated or foreign file is rejected before it is read.
+class CheckpointFile {
+ public:
+  explicit CheckpointFile(const std::string& path);
+  ~CheckpointFile();
+  CheckpointFile(const CheckpointFile&) = delete;
+  CheckpointFile& operator=(const CheckpointFile&) = delete;
+
+  const CheckpointHeader& header() const {
+    return *static_cast<const CheckpointHeader*>(data_);
+  }
+  // Start of the section at offset, one of the header's *_offset fields.
+  template <typename T>
+  const T* section(std::uint64_t offset) const {
+    return reinterpret_cast<const T*>(static_cast<const unsigned char*>(data_) +
+                                      offset);
+  }
+
+ private:
+  void* data_ = nullptr;
+  std::size_t size_ = 0;
+};
+
+#endif  // CHECKPOINT_HPP
@@ -0,0 +1,169 @@
+#ifndef DATA_WRITER_HPP
+#define DATA_WRITER_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Columnar output of an annealing run, one row per step, written from a
+// background thread so the annealing loop only copies values. A run is a
+// directory holding
+//
+//   schema.json     {"format": "pamc-columnar", "version": 1,
+//                    "byte_order": "little", "columns": [...]}
+//   <name>.bin      values of column <name>, step after step
+//   <name>.offsets.bin  (array columns only) int64 start of each step's
+//                       values in <name>.bin, plus the total at the end
+//
+// Each entry of "columns" is {"name", "kind": "scalar" | "array", "type":
+// "float64" | "int64" | "int32" | "int8", "file"[, "offsets"]}. Scalar
+// columns hold one value per step, array columns (e.g. per-replica energies)
+// any number. Values are raw native-endian arrays, so numpy.fromfile reads a
+// column without parsing; the number of steps is the size of any scalar file
+// over its element size. validation/pamc_data.py loads a run.
+class DataWriter {
+ public:
+  enum class ColumnType { float64, int64, int32, int8 };
+
+  // Creates the directory if needed; existing columns are overwritten.
+  explicit DataWriter(const std::string& directory);
+  // Writes the steps ended so far and stops the writer thread. Errors are
+  // lost here; call close() first to see them.
+  ~DataWriter();
+  DataWriter(const DataWriter&) = delete;
+  DataWriter& operator=(const DataWriter&) = delete;
+
+  // Declare the columns before the first endStep and return their index.
+  int addScalar(const std::string& name, ColumnType type = ColumnType::float64);
+  int addArray(const std::string& name, ColumnType type = ColumnType::float64);
+
+  // Values of the current step, converted to the column's type. Scalars not
+  // set in a step are written as NaN (float64) or 0, arrays as empty.
+  template <typename T>
+  void set(int column, T value);
+  // Array types must match the column's exactly.
+  template <typename T>
+  void setArray(int column, const T* values, std::size_t count);
+  template <typename T>
+  void setArray(int column, const std::vector<T>& values) {
+    setArray(column, values.data(), values.size());
+  }
+
+  // Hands the current step to the writer thread and starts the next one.
+  // Rethrows an error of an earlier write.
+  void endStep();
+  // Blocks until every ended step is handed to the OS (no fsync); rethrows
+  // write errors, including those of the flush itself.
+  void flush();
+  // flush(), then closes the files. The writer cannot be used afterwards.
+  void close();
+
+  long numSteps() const { return num_steps_; }
+
+ private:
+  struct Column {
+    std::string name;
+    bool array;
+    ColumnType type;
+    std::size_t element_bytes;
+    std::FILE* values = nullptr;
+    std::FILE* offsets = nullptr;
+    std::int64_t total = 0;  // array values written so far
+  };
+  // One step's bytes for every column.
+  using Step = std::vector<std::vector<unsigned char>>;
+
+  std::string directory_;
+  std::vector<Column> columns_;
+  Step current_;
+  std::vector<bool> scalar_set_;
+  long num_steps_ = 0;
+  bool started_ = false;
+  bool closed_ = false;
+
+  // Steps handed over and not yet written, guarded by mutex_.
+  std::mutex mutex_;
+  std::condition_variable ready_;
+  std::condition_variable drained_;
+  std::vector<Step> queue_;
+  bool writing_ = false;
+  bool stopping_ = false;
+  std::exception_ptr error_;
+  std::thread thread_;
+
+  int addColumn(const std::string& name, bool array, ColumnType type);
+  void start();
+  void run();
+  void writeStep(const Step& step);
+  void rethrowError();
+  void storeScalar(int column, const void* value);
+  template <typename T>
+  static constexpr bool isType(ColumnType type);
+};
+
+template <typename T>
+constexpr bool DataWriter::isType(ColumnType type) {
+  switch (type) {
+    case ColumnType::float64:
+      return std::is_same_v<T, double>;
+    case ColumnType::int64:
+      return std::is_same_v<T, std::int64_t>;
+    case ColumnType::int32:
+      return std::is_same_v<T, std::int32_t>;
+    case ColumnType::int8:
+      return std::is_same_v<T, std::int8_t>;
+  }
+  return false;
+}
+
+template <typename T>
+void DataWriter::set(int column, T value) {
+  static_assert(std::is_arithmetic_v<T>, "DataWriter::set takes numbers");
+  if (columns_.at(column).array) {
+    throw std::invalid_argument("Column " + columns_[column].name +
+                                " holds arrays");
+  }
+  switch (columns_[column].type) {
+    case ColumnType::float64: {
+      const double x = static_cast<double>(value);
+      storeScalar(column, &x);
+      break;
+    }
+    case ColumnType::int64: {
+      const std::int64_t x = static_cast<std::int64_t>(value);
+      storeScalar(column, &x);
+      break;
+    }
+    case ColumnType::int32: {
+      const std::int32_t x = static_cast<std::int32_t>(value);
+      storeScalar(column, &x);
+      break;
+    }
+    case ColumnType::int8: {
+      const std::int8_t x = static_cast<std::int8_t>(value);
+      storeScalar(column, &x);
+      break;
+    }
+  }
+}
+
+template <typename T>
+void DataWriter::setArray(int column, const T* values, std::size_t count) {
+  const Column& c = columns_.at(column);
+  if (!c.array || !isType<T>(c.type)) {
+    throw std::invalid_argument("Column " + c.name +
+                                " is not an array of this type");
+  }
+  const auto* bytes = reinterpret_cast<const unsigned char*>(values);
+  current_[column].assign(bytes, bytes + count * sizeof(T));
+}
+
+#endif  // DATA_WRITER_HPP
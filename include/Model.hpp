@@ -3,43 +3,203 @@
 
 #include <gsl/gsl_rng.h>
 
-// Abstract base class for all Monte Carlo models used in PAMC.
-// Model is a polymorphic base for all models used in Population.
-// SharedModelData<ModelType> is templated and not linked to Model directly;
-// each derived model defines how it uses its own SharedModelData<ModelType>.
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
 
-// Population<ModelType> assumes that ModelType defines the following methods:
+#include "Rng.hpp"
+
+// Population<ModelType> is templated on the concrete model and calls it
+// directly: nothing here is virtual, so every call can be inlined and replicas
+// carry no vtable pointer. SharedModelData<ModelType> is specialized per model.
+// A single-lane ModelType defines
+//
+//   enum class UpdateMethod { ... };
+//   void initializeState(gsl_rng*);
+//   void copyStateFrom(const ModelType&);   // genealogy included
+//   double measureEnergy() const;
+//   void updateSweep(int num_sweeps, double beta, RandomStream&,
+//                    UpdateMethod, bool sequential);  // and with gsl_rng*
+//   auto getState() const;                 // return type may vary
+//   void setFamily(int);  int getFamily() const;
+//   void setParent(int);  int getParent() const;
+//
+// Deriving from Model (below) provides the genealogy methods. Population
+// checks the interface at compile time (see checkModelInterface), so a
+// missing method is reported by name rather than deep inside Population.
+//
+// Multi-spin-coded models pack several replicas into one object and declare
 //
-//   void initializeState(gsl_rng*, const SharedModelData<ModelType>&);
-//   void updateSweep(int, UpdateMethod, double, gsl_rng*, bool [, ...]);
-//   auto getState() const;         // return type may vary
+//   static constexpr int NUM_LANES;
 //
-// These methods are duck-typed: they are not enforced via Model.hpp,
-// but are required for Population to compile and function correctly.
+// Population then addresses replica i as lane i % NUM_LANES of object
+// i / NUM_LANES, and expects lane-indexed versions of the per-replica methods:
+//
+//   void copyLaneFrom(int lane, const ModelType& other, int other_lane);
+//   void measureEnergies(double* energies) const;   // one value per lane
+//   auto getState(int lane) const;
+//   void setFamily(int lane, int family);  int getFamily(int lane) const;
+//   void setParent(int lane, int parent);  int getParent(int lane) const;
+//
+// Models may also define an enum class Observable and
+//   double measureObservable(Observable) const;
+// (multi-lane models: void measureObservables(Observable, double*) const, one
+// value per lane), which Population averages through an
+// ObservableSet<ModelType> (see ObservableSet.hpp).
 
-class Model {
- public:
-  virtual ~Model() = default;
+// Number of replicas stored in one ModelType object (1 unless the model
+// declares NUM_LANES).
+template <typename ModelType, typename = void>
+struct ModelLanes : std::integral_constant<int, 1> {};
 
-  // Randomizes internal state using the provided RNG.
-  // This base method must be overloaded in each derived class.
-  // Models must also define a duck-typed overload that takes
-  // SharedModelData<ModelType>&.
-  virtual void initializeState(gsl_rng* r) = 0;
+template <typename ModelType>
+struct ModelLanes<ModelType, std::void_t<decltype(ModelType::NUM_LANES)>>
+    : std::integral_constant<int, ModelType::NUM_LANES> {};
 
-  // Copies the full model state from another instance.
-  virtual void copyStateFrom(const Model& other) = 0;
+// Models whose state can live in a ReplicaArena slot (see ReplicaArena.hpp)
+// additionally provide
+//
+//   static std::size_t stateBytes(const SharedModelData<ModelType>&);
+//   ModelType(const SharedModelData<ModelType>&, void* state);  // view
+//   const void* stateData() const;
+//
+// and Population then allocates all replicas from one arena. Such models can
+// be checkpointed (see Population::saveCheckpoint) if they also provide
+//
+//   void restoreState(const void* state, double energy);   // single-lane
+//   void restoreState(const void* state, const double* energies);  // lanes
+//
+// which copies back stateBytes() bytes saved from stateData() together with
+// the running energies. When the meaning of those bytes depends on more than
+// their size, the model also declares
+//
+//   static std::uint64_t stateLayout(const SharedModelData<ModelType>&);
+//
+// a fingerprint of the layout (0 for the default one), which the checkpoint
+// records and a restart must match.
+template <typename ModelType, typename = void>
+struct ModelUsesArena : std::false_type {};
 
-  // Calculates and returns the current energy of the model.
-  virtual double measureEnergy() const = 0;
+template <typename ModelType>
+struct ModelUsesArena<ModelType,
+                      std::void_t<decltype(&ModelType::stateBytes)>>
+    : std::true_type {};
 
-  // Applies update sweeps with given beta and RNG.
-  // Derived models may overload this to accept additional arguments.
-  virtual void updateSweep(int num_sweeps, double beta, gsl_rng* r) = 0;
+template <typename ModelType, typename = void>
+struct ModelHasStateLayout : std::false_type {};
 
-  // Optional tag for method-specific updates (e.g., Metropolis, Heat Bath).
-  enum class UpdateMethod {};
+template <typename ModelType>
+struct ModelHasStateLayout<ModelType,
+                           std::void_t<decltype(&ModelType::stateLayout)>>
+    : std::true_type {};
 
+// Models whose sweeps can themselves use all threads for some update methods
+// declare
+//
+//   static bool sweepsInParallel(UpdateMethod);
+//
+// and Population then sweeps a population with fewer model objects than
+// threads one object at a time, letting each sweep use every thread.
+template <typename ModelType, typename = void>
+struct ModelSweepsInParallel : std::false_type {};
+
+template <typename ModelType>
+struct ModelSweepsInParallel<
+    ModelType, std::void_t<decltype(&ModelType::sweepsInParallel)>>
+    : std::true_type {};
+
+namespace model_interface {
+
+template <typename ModelType, template <typename> class Op, typename = void>
+struct Detect : std::false_type {};
+
+template <typename ModelType, template <typename> class Op>
+struct Detect<ModelType, Op, std::void_t<Op<ModelType>>> : std::true_type {};
+
+template <typename M>
+using InitializeState =
+    decltype(std::declval<M&>().initializeState(std::declval<gsl_rng*>()));
+template <typename M>
+using UpdateSweep = decltype(std::declval<M&>().updateSweep(
+    0, 0.0, std::declval<RandomStream&>(),
+    std::declval<typename M::UpdateMethod>(), false));
+template <typename M>
+using CopyStateFrom =
+    decltype(std::declval<M&>().copyStateFrom(std::declval<const M&>()));
+template <typename M>
+using MeasureEnergy = std::enable_if_t<std::is_convertible_v<
+    decltype(std::declval<const M&>().measureEnergy()), double>>;
+template <typename M>
+using GetState = decltype(std::declval<const M&>().getState());
+template <typename M>
+using Genealogy = decltype(std::declval<M&>().setFamily(0),
+                           std::declval<M&>().setParent(0),
+                           int{std::declval<const M&>().getFamily()},
+                           int{std::declval<const M&>().getParent()});
+template <typename M>
+using CopyLaneFrom = decltype(std::declval<M&>().copyLaneFrom(
+    0, std::declval<const M&>(), 0));
+template <typename M>
+using MeasureEnergies = decltype(std::declval<const M&>().measureEnergies(
+    std::declval<double*>()));
+template <typename M>
+using GetLaneState = decltype(std::declval<const M&>().getState(0));
+template <typename M>
+using LaneGenealogy = decltype(std::declval<M&>().setFamily(0, 0),
+                               std::declval<M&>().setParent(0, 0),
+                               int{std::declval<const M&>().getFamily(0)},
+                               int{std::declval<const M&>().getParent(0)});
+
+template <typename M>
+using RestoreState = decltype(std::declval<M&>().restoreState(
+    std::declval<const void*>(), std::declval<double>()));
+template <typename M>
+using RestoreLaneStates = decltype(std::declval<M&>().restoreState(
+    std::declval<const void*>(), std::declval<const double*>()));
+
+}  // namespace model_interface
+
+// Compile-time check of the interface above, used by Population.
+template <typename ModelType>
+constexpr bool checkModelInterface() {
+  using namespace model_interface;
+  static_assert(Detect<ModelType, InitializeState>::value,
+                "ModelType needs void initializeState(gsl_rng*)");
+  static_assert(Detect<ModelType, UpdateSweep>::value,
+                "ModelType needs updateSweep(int, double, RandomStream&, "
+                "UpdateMethod, bool)");
+  if constexpr (ModelLanes<ModelType>::value == 1) {
+    static_assert(Detect<ModelType, CopyStateFrom>::value,
+                  "ModelType needs copyStateFrom(const ModelType&)");
+    static_assert(Detect<ModelType, MeasureEnergy>::value,
+                  "ModelType needs double measureEnergy() const");
+    static_assert(Detect<ModelType, GetState>::value,
+                  "ModelType needs getState() const");
+    static_assert(Detect<ModelType, Genealogy>::value,
+                  "ModelType needs setFamily/getFamily/setParent/getParent "
+                  "(derive from Model)");
+  } else {
+    static_assert(Detect<ModelType, CopyLaneFrom>::value,
+                  "Multi-lane ModelType needs copyLaneFrom(int, const "
+                  "ModelType&, int)");
+    static_assert(Detect<ModelType, MeasureEnergies>::value,
+                  "Multi-lane ModelType needs measureEnergies(double*) const");
+    static_assert(Detect<ModelType, GetLaneState>::value,
+                  "Multi-lane ModelType needs getState(int) const");
+    static_assert(Detect<ModelType, LaneGenealogy>::value,
+                  "Multi-lane ModelType needs lane-indexed "
+                  "setFamily/getFamily/setParent/getParent");
+  }
+  return true;
+}
+
+// Genealogy of a single-lane replica: the family it descends from (the index
+// of its ancestor in the initial population) and the replica it was copied
+// from at the last resampling. Models derive from Model and call
+// copyGenealogyFrom in copyStateFrom. The base is empty of virtual functions
+// and only ever used through the derived type.
+class Model {
+ public:
   // Families can only be set once and is inherited via copyStateFrom
   void setFamily(int family) {
     if (family_ != -1) {
@@ -52,22 +212,20 @@ class Model {
   int getFamily() const { return family_; }
   int getParent() const { return parent_; }
 
-  // Duck-typed method: must be implemented in each model class and must take no
-  // arguments.
-  //   auto getState() const;
-  // Used by Population to extract the state of a model instance.
-  // The return type may vary across models.
-
-  // Optional tag for model-specific observables (e.g., Energy, Magnetization).
-  // enum class Observable {};
-
-  // Generic observable measurement interface.
-  // Still under design—will likely use duck typing:
-  // Population expects a method measureObservable(...) where the argument
-  // is ModelType::Observable (defined only in derived classes).
-  private:
-    int family_ = -1;
-    int parent_ = -1;
+ protected:
+  Model() = default;
+  Model(const Model&) = default;
+  Model& operator=(const Model&) = default;
+  ~Model() = default;
+
+  void copyGenealogyFrom(const Model& other) {
+    family_ = other.family_;
+    parent_ = other.parent_;
+  }
+
+ private:
+  int family_ = -1;
+  int parent_ = -1;
 };
 
-#endif  // MODEL_HPP
\ No newline at end of file
+#endif  // MODEL_HPP
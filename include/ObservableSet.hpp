@@ -0,0 +1,124 @@
+#ifndef OBSERVABLE_SET_HPP
+#define OBSERVABLE_SET_HPP
+
+#include <cmath>
+#include <functional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Model.hpp"
+
+// Set of per-replica quantities that Population averages in one pass (see
+// Population::setObservables). Each entry is a power of either a model
+// observable, measured through the duck-typed
+//
+//   double measureObservable(Observable) const;                  // 1 lane
+//   void measureObservables(Observable, double* values) const;   // per lane
+//
+// or a user-defined function of the replica. Every distinct observable or
+// function is evaluated once per replica however many powers of it are
+// requested, so e.g. |m|, m^2 and m^4 cost a single magnetization pass.
+template <typename ModelType>
+class ObservableSet {
+ public:
+  using Observable = typename ModelType::Observable;
+  static constexpr int LANES = ModelLanes<ModelType>::value;
+  // User-defined quantity; multi-lane models also receive the lane.
+  using Function = std::conditional_t<
+      LANES == 1, std::function<double(const ModelType&)>,
+      std::function<double(const ModelType&, int)>>;
+
+  // Adds the average of x^power (|x|^power if absolute) of observable x and
+  // returns its index among the measured averages.
+  int add(Observable observable, int power = 1, bool absolute = false) {
+    for (auto& source : sources_) {
+      if (!source.function && source.observable == observable) {
+        return addMoment(source, power, absolute);
+      }
+    }
+    sources_.push_back({observable, Function(), {}});
+    return addMoment(sources_.back(), power, absolute);
+  }
+
+  // As above for a user-defined function; each call adds a new source.
+  int add(Function function, int power = 1, bool absolute = false) {
+    sources_.push_back({Observable(), std::move(function), {}});
+    return addMoment(sources_.back(), power, absolute);
+  }
+
+  int size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  // Writes the value of every entry for one replica to values[0..size()).
+  void evaluate(const ModelType& model, double* values) const {
+    static_assert(LANES == 1, "use evaluateLanes for multi-lane models");
+    for (const auto& source : sources_) {
+      const double x = source.function
+                           ? source.function(model)
+                           : model.measureObservable(source.observable);
+      for (const auto& moment : source.moments) {
+        values[moment.index] = moment.apply(x);
+      }
+    }
+  }
+
+  // Writes the entries of lanes 0..num_lanes-1 of one multi-lane object to
+  // values[lane * size() + index].
+  void evaluateLanes(const ModelType& model, int num_lanes,
+                     double* values) const {
+    static_assert(LANES > 1, "use evaluate for single-lane models");
+    double lane_values[LANES];
+    for (const auto& source : sources_) {
+      if (source.function) {
+        for (int lane = 0; lane < num_lanes; ++lane) {
+          lane_values[lane] = source.function(model, lane);
+        }
+      } else {
+        model.measureObservables(source.observable, lane_values);
+      }
+      for (const auto& moment : source.moments) {
+        for (int lane = 0; lane < num_lanes; ++lane) {
+          values[lane * size_ + moment.index] = moment.apply(lane_values[lane]);
+        }
+      }
+    }
+  }
+
+ private:
+  struct Moment {
+    int index;
+    int power;
+    bool absolute;
+
+    double apply(double x) const {
+      if (absolute) {
+        x = std::abs(x);
+      }
+      double result = 1.0;
+      for (int p = 0; p < power; ++p) {
+        result *= x;
+      }
+      return result;
+    }
+  };
+  struct Source {
+    Observable observable;
+    Function function;
+    std::vector<Moment> moments;
+  };
+
+  std::vector<Source> sources_;
+  int size_ = 0;
+
+  int addMoment(Source& source, int power, bool absolute) {
+    if (power < 1) {
+      throw std::invalid_argument("Observable power must be positive");
+    }
+    source.moments.push_back({size_, power, absolute});
+    return size_++;
+  }
+};
+
+#endif  // OBSERVABLE_SET_HPP
@@ -1,136 +1,318 @@
 #ifndef POPULATION_HPP
 #define POPULATION_HPP
 
-// Population<ModelType> assumes that ModelType defines the following methods:
-//
-//   void initializeState(gsl_rng*, const SharedModelData<ModelType>&);
-//   void updateSweep(int, UpdateMethod, double, gsl_rng*, bool [, ...]);
-//   auto getState() const;         // return type may vary
-//
-// These methods are duck-typed: they are not enforced via Model.hpp,
-// but are required for Population to compile and function correctly.
+// Population<ModelType> calls ModelType directly, without virtual dispatch.
+// The methods it needs are listed in Model.hpp and checked at compile time
+// by checkModelInterface.
 
 #include <gsl/gsl_rng.h>
 
 #include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <future>
 #include <numeric>
+#include <string>
 #include <vector>
 #include <iostream>
 #include <cassert>
 #include <algorithm>
 #include <limits>
+#include <memory>
 #include <unordered_set>
 #include <omp.h>
 
+#include "Checkpoint.hpp"
 #include "Model.hpp"
+#include "ObservableSet.hpp"
+#include "ReplicaArena.hpp"
+#include "Rng.hpp"
 #include "SharedModelData.hpp"
 #include "Genealogy.hpp"
 
+// How the parallel equilibrate distributes model objects over threads.
+// static_blocks splits them into equal contiguous blocks; dynamic hands them
+// out one at a time; longest_first does the same in decreasing order of each
+// object's previous sweep time, so that expensive sweeps (e.g. Wolff near
+// T_c) start early and cheap ones fill the gaps at the end. The results do
+// not depend on the schedule (see seedReplicaStream).
+enum class EquilibrateSchedule { static_blocks, dynamic, longest_first };
+
 template <typename ModelType>
 class Population {
+  static_assert(checkModelInterface<ModelType>());
+
  public:
+  // T and seed drive initialization and resampling. The sweeps in
+  // equilibrate draw from per-replica RandomStreams of rng_backend (see
+  // seedReplicaStream), so results do not depend on the number of threads.
   Population(int pop_size, const gsl_rng_type* T,
-             const SharedModelData<ModelType>& shared_data, unsigned long int seed = 42);
+             const SharedModelData<ModelType>& shared_data, unsigned long int seed = 42,
+             RngBackend rng_backend = RngBackend::philox);
   ~Population();
   void equilibrate(int num_sweeps, double beta, typename ModelType::UpdateMethod method, bool sequential);
   void equilibrate(int num_sweeps, double beta, typename ModelType::UpdateMethod method, bool sequential, gsl_rng* r_override);
-  void resample(double new_beta, gsl_rng* r_override = nullptr);
+  void equilibrate(int num_sweeps, double beta, typename ModelType::UpdateMethod method, bool sequential, RandomStream& r_override);
+  // Resamples to new_beta. Without a generator every stage runs in parallel
+  // and the copy counts come from per-replica counter-based draws (see
+  // computeCopyCountsParallel), so the result does not depend on the number
+  // of threads. The overloads taking a generator (nullptr means the
+  // population's own) draw the counts from it serially.
+  void resample(double new_beta);
+  void resample(double new_beta, gsl_rng* r_override);
+  void resample(double new_beta, RandomStream& r_override);
+  // Houdayer cluster moves (ModelType::houdayerMove) between randomly paired
+  // replicas, which all share beta_ and the couplings. Each round pairs the
+  // population afresh and moves every pair once; pairs run in parallel, each
+  // on its own counter-based stream, so results do not depend on the number
+  // of threads. Interleave with equilibrate, which keeps the moves ergodic.
+  void houdayerMoves(int num_rounds = 1);
   // Keep beta schedule simple for now.
   double suggestNextBeta(double beta, double epsilon);
+  // Energies and registered observables are measured at the end of every
+  // equilibrate, in the same parallel loop as the sweeps. After changing
+  // replicas through getModels(), pass force = true to measure them again.
   double measureEnergy(bool force = false);
+  // Registers the observables averaged by measureObservables().
+  void setObservables(ObservableSet<ModelType> observables);
+  // Population averages of the registered observables, indexed as returned
+  // by ObservableSet::add.
+  const std::vector<double>& measureObservables(bool force = false);
   // Compute rho_t and rho_s for error estimation.
   GenealogyStatistics computeGenealogyStatistics();
 
-  // Not enforced to be in derived models via Model.hpp, but required for
-  // Population. void measureObservable(typename ModelType::Observable);
+  // Checkpoint/restart for models whose replicas live in a ReplicaArena (see
+  // Checkpoint.hpp for the format). A checkpoint holds the replica states,
+  // running and measured energies, genealogy, beta, delta beta F, the step
+  // and resample counters, the resample seed and the state of the
+  // population's gsl_rng. The per-thread RandomStreams are reseeded from
+  // (seed, family, step) before every use, so their backend is all that is
+  // stored. saveCheckpoint writes
+  // the file before returning; saveCheckpointAsync copies the state (about
+  // the size of the arena) and writes it on a background thread, so the next
+  // equilibrate runs while it goes to disk. waitForCheckpoint blocks until
+  // the last write is done and rethrows its error, if any; the next save,
+  // loadCheckpoint and the destructor wait for it too.
+  void saveCheckpoint(const std::string& path);
+  void saveCheckpointAsync(const std::string& path);
+  void waitForCheckpoint();
+  // Restores a checkpoint into a population constructed with the same
+  // SharedModelData (state layout included, see Model.hpp), gsl_rng type,
+  // population size and RNG backend. The run
+  // then continues bitwise identically to the one that saved it; registered
+  // observables are measured afresh.
+  void loadCheckpoint(const std::string& path);
 
-  // population_[i].getState() is duck typed and not enforced by Model.hpp.
-  auto getState(int i) const { return population_[i].getState(); }
-  int getBeta() const { return beta_; }
+  auto getState(int i) const {
+    if constexpr (LANES == 1) {
+      return population_[i].getState();
+    } else {
+      return population_[i / LANES].getState(i % LANES);
+    }
+  }
+  double getBeta() const { return beta_; }
   double getDeltaBetaF() const { return delta_betaF_; }
   int getPopSize() const { return pop_size_; }
+  // Number of parallel equilibrate calls so far.
+  long getStep() const { return step_; }
+  // Busiest thread's time over the mean over threads in the last parallel
+  // equilibrate (1 is perfect balance).
+  double getLoadImbalance() const { return load_imbalance_; }
   double getMinEnergy();
   auto getMinEnergyState();
+  // Per-replica energies as of the last measurement (see measureEnergy).
+  const std::vector<double>& getEnergies() {
+    measureEnergy();
+    return energies_;
+  }
+  int getFamily(int i) const { return getReplicaFamily(i); }
 
 
-  void setRngSeed(unsigned long int s) { gsl_rng_set(r_, s); }
+  // Reseeds the population's gsl_rng and the key of the parallel
+  // resample(beta), whose draws restart as after construction with seed s.
+  // The equilibrate and Houdayer streams keep the constructor's seed.
+  void setRngSeed(unsigned long int s) {
+    gsl_rng_set(r_, s);
+    resample_seed_ = s;
+    num_resamples_ = 0;
+  }
   void setNomPopSize(int i) { nom_pop_size_ = i; }
+  void setSchedule(EquilibrateSchedule schedule) { schedule_ = schedule; }
 
   // Returns a const reference to the population of models for direct
   // interaction when needed. Not intended to be used in normal circumstances;
-  // for unit testing and debugging.
+  // for unit testing and debugging. For multi-lane models each element holds
+  // LANES replicas.
   std::vector<ModelType>& getModels() { return population_; }
 
 
  private:
+  // Replicas per model object; replica i lives in lane i % LANES of
+  // population_[i / LANES]. See ModelLanes in Model.hpp.
+  static constexpr int LANES = ModelLanes<ModelType>::value;
+  static int numModels(int num_replicas) {
+    return (num_replicas + LANES - 1) / LANES;
+  }
+
   double beta_ = 0.0;
   double delta_betaF_ = 0.0;
   int pop_size_ = 0;
   const int initial_pop_size_;
   int nom_pop_size_ = 0;
   int max_pop_size_ = 0;
+  // Backing storage for all replicas when ModelType supports it (see
+  // ModelUsesArena in Model.hpp); population_ then only holds views.
+  std::unique_ptr<ReplicaArena> arena_;
   std::vector<ModelType> population_;
   std::vector<double> energies_;
   std::vector<double> weights_;
   std::vector<int> copy_counts_;
+  // Work arrays of scatterCopies.
+  std::vector<int> extra_offsets_;
+  std::vector<int> hole_offsets_;
+  std::vector<int> keeper_offsets_;
+  std::vector<int> hole_slots_;
+  std::vector<int> copy_sources_;
   double avg_energy_ = 0.0;
   double var_energy_ = 0.0;
   double min_energy_ = std::numeric_limits<double>::max();
   bool energies_current_ = false;
+  ObservableSet<ModelType> observables_;
+  // Entry k of replica i at [i * observables_.size() + k].
+  std::vector<double> observable_values_;
+  std::vector<double> observable_averages_;
+  bool observables_current_ = false;
   const SharedModelData<ModelType>& shared_data_;
 
   gsl_rng* r_ = nullptr;
-  std::vector<gsl_rng*> thread_rngs_;
+  // One stream object per thread, reseeded for every replica it sweeps.
+  // Grown by growThreadStreams when the thread count rises after
+  // construction.
+  std::vector<RandomStream> thread_rngs_;
   unsigned long int seed_ = 42;
+  long step_ = 0;
+  EquilibrateSchedule schedule_ = EquilibrateSchedule::static_blocks;
+  // Wall time of the last sweep of each model object (carried through
+  // resampling for single-lane models) and the visiting order built from it.
+  std::vector<double> sweep_costs_;
+  std::vector<int> sweep_order_;
+  std::vector<double> thread_busy_;
+  double load_imbalance_ = 1.0;
+  // Key of computeCopyCountsParallel and the resamples drawn under it.
+  unsigned long int resample_seed_ = 42;
+  long num_resamples_ = 0;
+  // Random pairing of houdayerMoves and its number of rounds so far.
+  std::vector<int> pair_order_;
+  long num_houdayer_rounds_ = 0;
+  // Write started by saveCheckpointAsync, if any.
+  std::future<void> pending_checkpoint_;
+
+  // Replicas per chunk of the parallel sums and scans in measurement and
+  // resampling. Chunk results are combined in chunk order, so they do not
+  // depend on the number of threads (and match a plain serial sum for
+  // populations of one chunk).
+  static constexpr int REDUCTION_CHUNK = 4096;
+  static int numChunks(int n) {
+    return (n + REDUCTION_CHUNK - 1) / REDUCTION_CHUNK;
+  }
 
   // Helper functions
   void resizePopulationStorage(int new_size);
-  inline int stochastic_round(double tau, gsl_rng* r) {
+  void measureModel(int m);
+  void measureReplicas();
+  void reduceMeasurements();
+  void copyReplica(int to, int from);
+  int getReplicaFamily(int i) const;
+  int getReplicaParent(int i) const;
+  void setReplicaFamily(int i, int family);
+  void setReplicaParent(int i, int parent);
+  void seedReplicaStream(RandomStream& rng, int m) const;
+  void growThreadStreams();
+  double sweepModel(int m, int num_sweeps, double beta,
+                    typename ModelType::UpdateMethod method, bool sequential,
+                    RandomStream& rng);
+  // Rng is gsl_rng* or RandomStream (see Rng.hpp)
+  template <typename Rng>
+  inline int stochastic_round(double tau, Rng& r) {
+    return stochastic_round(tau, rngUniform(r));
+  }
+  static int stochastic_round(double tau, double u) {
     int floor = static_cast<int>(std::floor(tau));
     double prob = tau - floor;
-    double rng = gsl_rng_uniform(r);
-    return (rng < prob) ? floor + 1 : floor;
+    return (u < prob) ? floor + 1 : floor;
   }
+  template <typename F>
+  static int exclusiveScan(int n, std::vector<int>& out, F value);
+  template <typename Rng>
+  void equilibrateSerial(int num_sweeps, double beta, typename ModelType::UpdateMethod method, bool sequential, Rng& r);
+  template <typename Rng>
+  void resampleImpl(double new_beta, Rng& r_local);
+  void prepareResample(double new_beta);
   void computeWeights(double new_beta, double avg_energy, double& QR);
-  void computeCopyCounts(int& total_new, gsl_rng* r_local);
+  template <typename Rng>
+  void computeCopyCounts(int& total_new, Rng& r_local);
+  int computeCopyCountsParallel();
   void forwardCopy(int old_pop_size, int new_pop_size);
   void backfillHoles(int old_pop_size);
+  void scatterCopies(int old_pop_size, int new_pop_size);
+  std::vector<unsigned char> serializeCheckpoint() const;
+  // ModelType::stateLayout of shared_data_, 0 if the model has none.
+  std::uint64_t stateLayout() const;
 };
 
 template <typename ModelType>
 Population<ModelType>::Population(int pop_size, const gsl_rng_type* T,
-                                  const SharedModelData<ModelType>& shared_data, unsigned long int seed)
+                                  const SharedModelData<ModelType>& shared_data, unsigned long int seed,
+                                  RngBackend rng_backend)
     : beta_(0.0),
       pop_size_(0),
       initial_pop_size_(pop_size),
       nom_pop_size_(pop_size),
       shared_data_(shared_data),
       r_(gsl_rng_alloc(T)),
-      seed_(seed) {
+      seed_(seed),
+      resample_seed_(seed) {
   max_pop_size_ =
       static_cast<int>(nom_pop_size_ + 10 * std::sqrt(nom_pop_size_));
-  // population_.reserve(pop_size);
+  // Reserve everything for the largest population resample() may produce so
+  // that later resizes never reallocate (and never move replicas).
+  population_.reserve(numModels(max_pop_size_));
+  energies_.reserve(max_pop_size_);
+  weights_.reserve(max_pop_size_);
+  copy_counts_.reserve(max_pop_size_);
+  for (auto* work : {&extra_offsets_, &hole_offsets_, &keeper_offsets_,
+                     &hole_slots_, &copy_sources_}) {
+    work->reserve(max_pop_size_ + 1);
+  }
+  if constexpr (ModelUsesArena<ModelType>::value) {
+    arena_ = std::make_unique<ReplicaArena>(ModelType::stateBytes(shared_data),
+                                            numModels(max_pop_size_));
+  }
   resizePopulationStorage(nom_pop_size_);
   gsl_rng_set(r_, seed);
   int num_threads = omp_get_max_threads();
-  thread_rngs_.resize(num_threads);
+  thread_rngs_.reserve(num_threads);
   for (int t = 0; t < num_threads; ++t) {
-      thread_rngs_[t] = gsl_rng_alloc(gsl_rng_mt19937);
-      gsl_rng_set(thread_rngs_[t], seed_ + t *1000);
+    thread_rngs_.emplace_back(rng_backend, seed_);
+  }
+  thread_busy_.resize(num_threads);
+  sweep_costs_.assign(numModels(max_pop_size_), 0.0);
+  sweep_order_.reserve(numModels(max_pop_size_));
+  for (auto& model : population_) {
+    model.initializeState(r_);
   }
   for (int i = 0; i < pop_size_; ++i) {
-    population_[i].initializeState(r_);
-    population_[i].setFamily(i);
-    population_[i].setParent(i);
+    setReplicaFamily(i, i);
+    setReplicaParent(i, i);
   }
 }
 
 template <typename ModelType>
 Population<ModelType>::~Population() {
-  gsl_rng_free(r_);
-  for (auto* rng : thread_rngs_) {
-    gsl_rng_free(rng);
+  if (pending_checkpoint_.valid()) {
+    pending_checkpoint_.wait();
   }
+  gsl_rng_free(r_);
 }
 
 // Use a variadic template in order to pass additional arguments to the default
@@ -140,50 +322,196 @@ void Population<ModelType>::equilibrate(int num_sweeps, double beta,
                                         typename ModelType::UpdateMethod method,
                                         bool sequential) {
   beta_ = beta;
-  #pragma omp parallel for schedule(static)
-  for (int i = 0; i < pop_size_; ++i) {
-    int tid = omp_get_thread_num();
-    gsl_rng* rng = thread_rngs_[tid];
-    population_[i].updateSweep(num_sweeps, beta, rng, method, sequential);
+  const int num_models = numModels(pop_size_);
+  ++step_;
+  growThreadStreams();
+  if constexpr (ModelSweepsInParallel<ModelType>::value) {
+    // Too few objects to occupy the threads: run them one after the other
+    // and parallelize inside each sweep instead.
+    if (ModelType::sweepsInParallel(method) &&
+        num_models < omp_get_max_threads()) {
+      for (int i = 0; i < num_models; ++i) {
+        sweepModel(i, num_sweeps, beta, method, sequential, thread_rngs_[0]);
+      }
+      load_imbalance_ = 1.0;
+      reduceMeasurements();
+      return;
+    }
+  }
+  if (schedule_ != EquilibrateSchedule::static_blocks) {
+    sweep_order_.resize(num_models);
+    std::iota(sweep_order_.begin(), sweep_order_.end(), 0);
+    if (schedule_ == EquilibrateSchedule::longest_first) {
+      std::stable_sort(sweep_order_.begin(), sweep_order_.end(),
+                       [&](int a, int b) {
+                         return sweep_costs_[a] > sweep_costs_[b];
+                       });
+    }
   }
-  energies_current_ = false;
+
+  int num_threads = 1;
+  #pragma omp parallel
+  {
+    const int tid = omp_get_thread_num();
+    RandomStream& rng = thread_rngs_[tid];
+    double busy = 0.0;
+    if (schedule_ == EquilibrateSchedule::static_blocks) {
+      #pragma omp for schedule(static) nowait
+      for (int i = 0; i < num_models; ++i) {
+        busy += sweepModel(i, num_sweeps, beta, method, sequential, rng);
+      }
+    } else {
+      #pragma omp for schedule(dynamic, 1) nowait
+      for (int k = 0; k < num_models; ++k) {
+        busy += sweepModel(sweep_order_[k], num_sweeps, beta, method,
+                           sequential, rng);
+      }
+    }
+    thread_busy_[tid] = busy;
+    #pragma omp single nowait
+    num_threads = omp_get_num_threads();
+  }
+
+  const auto busy_end = thread_busy_.begin() + num_threads;
+  const double mean_busy =
+      std::accumulate(thread_busy_.begin(), busy_end, 0.0) / num_threads;
+  load_imbalance_ =
+      mean_busy > 0.0 ? *std::max_element(thread_busy_.begin(), busy_end) /
+                            mean_busy
+                      : 1.0;
+  reduceMeasurements();
+}
+
+template <typename ModelType>
+void Population<ModelType>::houdayerMoves(int num_rounds) {
+  static_assert(LANES == 1, "Houdayer moves need single-lane replicas");
+  const int num_pairs = pop_size_ / 2;
+  if (num_pairs == 0) {
+    return;
+  }
+  // Family streams use key seed_ ^ splitMix64(family) with family >= 0.
+  std::uint64_t tag = ~std::uint64_t{0};
+  const std::uint64_t key = seed_ ^ splitMix64(tag);
+  pair_order_.resize(pop_size_);
+  growThreadStreams();
+  for (int round = 0; round < num_rounds; ++round) {
+    const std::uint64_t stage =
+        static_cast<std::uint64_t>(num_houdayer_rounds_++) << 32;
+    // Fisher-Yates shuffle on the stream past the last pair's.
+    RandomStream& shuffle_rng = thread_rngs_[0];
+    shuffle_rng.seed(key, stage | 0xffffffffULL);
+    std::iota(pair_order_.begin(), pair_order_.end(), 0);
+    for (int i = pop_size_ - 1; i > 0; --i) {
+      std::swap(pair_order_[i], pair_order_[shuffle_rng.uniformInt(i + 1)]);
+    }
+
+    #pragma omp parallel for schedule(dynamic, 16)
+    for (int p = 0; p < num_pairs; ++p) {
+      RandomStream& rng = thread_rngs_[omp_get_thread_num()];
+      rng.seed(key, stage | static_cast<std::uint32_t>(p));
+      population_[pair_order_[2 * p]].houdayerMove(
+          population_[pair_order_[2 * p + 1]], rng);
+    }
+  }
+  measureReplicas();
+}
+
+// Makes room for one stream and busy time per thread of the next parallel
+// region, in case omp_set_num_threads raised the count since the last call.
+// The streams are reseeded before every use, so new ones need no state.
+template <typename ModelType>
+void Population<ModelType>::growThreadStreams() {
+  const int num_threads = omp_get_max_threads();
+  const RngBackend backend = thread_rngs_[0].backend();
+  while (static_cast<int>(thread_rngs_.size()) < num_threads) {
+    thread_rngs_.emplace_back(backend, seed_);
+  }
+  if (static_cast<int>(thread_busy_.size()) < num_threads) {
+    thread_busy_.resize(num_threads);
+  }
+}
+
+// Sweeps model object m, measures it while it is still in this core's cache,
+// and returns the time taken.
+template <typename ModelType>
+double Population<ModelType>::sweepModel(
+    int m, int num_sweeps, double beta,
+    typename ModelType::UpdateMethod method, bool sequential,
+    RandomStream& rng) {
+  const double start = omp_get_wtime();
+  seedReplicaStream(rng, m);
+  population_[m].updateSweep(num_sweeps, beta, rng, method, sequential);
+  const double swept = omp_get_wtime();
+  measureModel(m);
+  sweep_costs_[m] = swept - start;
+  return omp_get_wtime() - start;
 }
 
 template <typename ModelType>
 void Population<ModelType>::equilibrate(int num_sweeps, double beta, typename ModelType::UpdateMethod method, bool sequential, gsl_rng* r_override) {
+  equilibrateSerial(num_sweeps, beta, method, sequential, r_override);
+}
+
+template <typename ModelType>
+void Population<ModelType>::equilibrate(int num_sweeps, double beta, typename ModelType::UpdateMethod method, bool sequential, RandomStream& r_override) {
+  equilibrateSerial(num_sweeps, beta, method, sequential, r_override);
+}
+
+template <typename ModelType>
+template <typename Rng>
+void Population<ModelType>::equilibrateSerial(int num_sweeps, double beta, typename ModelType::UpdateMethod method, bool sequential, Rng& r_override) {
   beta_ = beta;
-  for (int i = 0; i < pop_size_; ++i) {
+  const int num_models = numModels(pop_size_);
+  for (int i = 0; i < num_models; ++i) {
     population_[i].updateSweep(num_sweeps, beta, r_override, method, sequential);
+    measureModel(i);
   }
-  energies_current_ = false;
+  reduceMeasurements();
 }
 
 // Resample to new_beta. Internally uses local copies of old_pop_size and new_pop_size
 // to make logic clearer, since pop_size_ is updated indirectly by helpers.
+template <typename ModelType>
+void Population<ModelType>::resample(double new_beta) {
+  const int old_pop_size = pop_size_;
+  prepareResample(new_beta);
+  const int new_pop_size = computeCopyCountsParallel();
+  observables_current_ = false;
+
+  if (new_pop_size >= old_pop_size) {
+    resizePopulationStorage(new_pop_size);
+    scatterCopies(old_pop_size, new_pop_size);
+  }
+  else {
+    scatterCopies(old_pop_size, new_pop_size);
+    resizePopulationStorage(new_pop_size);
+  }
+  pop_size_ = new_pop_size;
+
+  assert(std::accumulate(copy_counts_.begin(), copy_counts_.end(), 0) == new_pop_size);
+}
+
 template <typename ModelType>
 void Population<ModelType>::resample(double new_beta, gsl_rng* r_override) {
   gsl_rng* r_local = r_override ? r_override : r_;
-  double delta_beta = new_beta - beta_;
-  double avg_energy = measureEnergy();
-  double QR = 0.0;
-  int old_pop_size = pop_size_;
+  resampleImpl(new_beta, r_local);
+}
 
-  // First reset the parents_ variable to the replica's index.
-  // This ensures that the replicated models inherit the parents' index.
-  for (int i = 0; i < pop_size_; ++i) {
-    population_[i].setParent(i);
-  }
+template <typename ModelType>
+void Population<ModelType>::resample(double new_beta, RandomStream& r_override) {
+  resampleImpl(new_beta, r_override);
+}
 
-  // This function calculates normalized weights (held in weights_) 
-  // using a shifted energy for numerical stability. It also updates QR,
-  // which is the normalization factor used in calculating delta (beta *F),
-  // where the delta_beta *avg_energy term compensates for the energy shift
-  computeWeights(new_beta, avg_energy, QR);
-  delta_betaF_ -= std::log(QR / pop_size_) + delta_beta *avg_energy;
+template <typename ModelType>
+template <typename Rng>
+void Population<ModelType>::resampleImpl(double new_beta, Rng& r_local) {
+  int old_pop_size = pop_size_;
+  prepareResample(new_beta);
 
   // computeCopyCounts() updates both copy_counts_ and new_pop_size
   int new_pop_size = 0;
   computeCopyCounts(new_pop_size, r_local);
+  observables_current_ = false;
 
   if (new_pop_size >= old_pop_size) {
     resizePopulationStorage(new_pop_size);
@@ -199,6 +527,28 @@ void Population<ModelType>::resample(double new_beta, gsl_rng* r_override) {
   assert(std::accumulate(copy_counts_.begin(), copy_counts_.end(), 0) == new_pop_size);
 }
 
+// Steps shared by both resampling paths, up to the copy counts.
+template <typename ModelType>
+void Population<ModelType>::prepareResample(double new_beta) {
+  double delta_beta = new_beta - beta_;
+  double avg_energy = measureEnergy();
+  double QR = 0.0;
+
+  // First reset the parents_ variable to the replica's index.
+  // This ensures that the replicated models inherit the parents' index.
+  #pragma omp parallel for schedule(static)
+  for (int i = 0; i < pop_size_; ++i) {
+    setReplicaParent(i, i);
+  }
+
+  // This function calculates normalized weights (held in weights_) 
+  // using a shifted energy for numerical stability. It also updates QR,
+  // which is the normalization factor used in calculating delta (beta *F),
+  // where the delta_beta *avg_energy term compensates for the energy shift
+  computeWeights(new_beta, avg_energy, QR);
+  delta_betaF_ -= std::log(QR / pop_size_) + delta_beta *avg_energy;
+}
+
 template <typename ModelType>
 double Population<ModelType>::suggestNextBeta(double beta, double epsilon) {
   measureEnergy();
@@ -210,29 +560,29 @@ double Population<ModelType>::suggestNextBeta(double beta, double epsilon) {
 template <typename ModelType>
 double Population<ModelType>::measureEnergy(bool force) {
   if (!energies_current_ || force) {
-    double total_energy = 0.0;
-    double total_energy_sq = 0.0;
-    double min_energy = std::numeric_limits<double>::max();
-    for (int i = 0; i < pop_size_; ++i) {
-      energies_[i] = population_[i].measureEnergy();
-      total_energy += energies_[i];
-      total_energy_sq += energies_[i] * energies_[i];
-      min_energy = std::min(min_energy, energies_[i]);
-    }
-
-    double mean_energy = total_energy /pop_size_;
-    double mean_energy_sq = total_energy_sq /pop_size_;
-    var_energy_ = mean_energy_sq - mean_energy *mean_energy;
-    avg_energy_ = mean_energy;
-    min_energy_ = min_energy;
+    measureReplicas();
+  }
+  return avg_energy_;
+}
 
-    energies_current_ = true;
+template <typename ModelType>
+void Population<ModelType>::setObservables(
+    ObservableSet<ModelType> observables) {
+  observables_ = std::move(observables);
+  observable_values_.assign(static_cast<std::size_t>(numModels(max_pop_size_)) *
+                                LANES * observables_.size(),
+                            0.0);
+  observable_averages_.assign(observables_.size(), 0.0);
+  observables_current_ = false;
+}
 
-    return mean_energy;
+template <typename ModelType>
+const std::vector<double>& Population<ModelType>::measureObservables(
+    bool force) {
+  if (!observables_current_ || force) {
+    measureReplicas();
   }
-
-  // double total_energy = std::accumulate(energies_.begin(), energies_.end(), 0.0);
-  return avg_energy_;
+  return observable_averages_;
 }
 
 template <typename ModelType>
@@ -244,7 +594,7 @@ GenealogyStatistics Population<ModelType>::computeGenealogyStatistics() {
     std::unordered_set<int> gs_family_ids;
 
     for (int i = 0; i < pop_size_; ++i) {
-      int family_id = population_[i].getFamily();
+      int family_id = getReplicaFamily(i);
       family_sizes[family_id]++;
       if (std::abs(energies_[i] - gs_energy) < std::numeric_limits<double>::epsilon()){
         gs_family_ids.insert(family_id);
@@ -272,6 +622,191 @@ GenealogyStatistics Population<ModelType>::computeGenealogyStatistics() {
     return stats;
 }
 
+template <typename ModelType>
+void Population<ModelType>::saveCheckpoint(const std::string& path) {
+  waitForCheckpoint();
+  const std::vector<unsigned char> image = serializeCheckpoint();
+  writeCheckpointFile(path, image.data(), image.size());
+}
+
+template <typename ModelType>
+void Population<ModelType>::saveCheckpointAsync(const std::string& path) {
+  waitForCheckpoint();
+  pending_checkpoint_ =
+      std::async(std::launch::async, [path, image = serializeCheckpoint()] {
+        writeCheckpointFile(path, image.data(), image.size());
+      });
+}
+
+template <typename ModelType>
+void Population<ModelType>::waitForCheckpoint() {
+  if (pending_checkpoint_.valid()) {
+    pending_checkpoint_.get();
+  }
+}
+
+// The whole file image, built in memory so that the asynchronous write works
+// on a snapshot. Model objects are copied in parallel.
+template <typename ModelType>
+std::vector<unsigned char> Population<ModelType>::serializeCheckpoint() const {
+  static_assert(ModelUsesArena<ModelType>::value,
+                "Checkpoints need a ModelType whose state lives in a "
+                "ReplicaArena (see ModelUsesArena in Model.hpp)");
+  const int num_models = numModels(pop_size_);
+  CheckpointHeader header{};
+  std::memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+  header.version = CHECKPOINT_VERSION;
+  header.header_bytes = sizeof(CheckpointHeader);
+  header.state_bytes = ModelType::stateBytes(shared_data_);
+  header.state_layout = stateLayout();
+  header.lanes = LANES;
+  header.num_models = num_models;
+  header.pop_size = pop_size_;
+  header.initial_pop_size = initial_pop_size_;
+  header.nom_pop_size = nom_pop_size_;
+  header.max_pop_size = max_pop_size_;
+  header.rng_backend = static_cast<std::int32_t>(thread_rngs_[0].backend());
+  header.energies_current = energies_current_;
+  header.step = step_;
+  header.num_resamples = num_resamples_;
+  header.num_houdayer_rounds = num_houdayer_rounds_;
+  header.seed = seed_;
+  header.resample_seed = resample_seed_;
+  header.beta = beta_;
+  header.delta_beta_f = delta_betaF_;
+  header.avg_energy = avg_energy_;
+  header.var_energy = var_energy_;
+  header.min_energy = min_energy_;
+  std::strncpy(header.rng_name, gsl_rng_name(r_), sizeof(header.rng_name) - 1);
+  header.rng_state_bytes = gsl_rng_size(r_);
+  layoutCheckpoint(header);
+
+  std::vector<unsigned char> image(header.file_bytes);
+  unsigned char* out = image.data();
+  std::memcpy(out, &header, sizeof(header));
+  std::memcpy(out + header.rng_state_offset, gsl_rng_state(r_),
+              header.rng_state_bytes);
+  std::memcpy(out + header.energies_offset, energies_.data(),
+              pop_size_ * sizeof(double));
+  auto* lane_energies =
+      reinterpret_cast<double*>(out + header.lane_energies_offset);
+  auto* families = reinterpret_cast<std::int32_t*>(out + header.families_offset);
+  auto* parents = reinterpret_cast<std::int32_t*>(out + header.parents_offset);
+  unsigned char* states = out + header.states_offset;
+  #pragma omp parallel for schedule(static)
+  for (int m = 0; m < num_models; ++m) {
+    if constexpr (LANES == 1) {
+      lane_energies[m] = population_[m].measureEnergy();
+    } else {
+      population_[m].measureEnergies(lane_energies + m * LANES);
+    }
+    for (int i = m * LANES; i < (m + 1) * LANES; ++i) {
+      families[i] = getReplicaFamily(i);
+      parents[i] = getReplicaParent(i);
+    }
+    std::memcpy(states + m * header.state_bytes, population_[m].stateData(),
+                header.state_bytes);
+  }
+  return image;
+}
+
+template <typename ModelType>
+std::uint64_t Population<ModelType>::stateLayout() const {
+  if constexpr (ModelHasStateLayout<ModelType>::value) {
+    return ModelType::stateLayout(shared_data_);
+  } else {
+    return 0;
+  }
+}
+
+template <typename ModelType>
+void Population<ModelType>::loadCheckpoint(const std::string& path) {
+  if constexpr (LANES == 1) {
+    static_assert(model_interface::Detect<ModelType,
+                                          model_interface::RestoreState>::value,
+                  "ModelType needs restoreState(const void*, double)");
+  } else {
+    static_assert(
+        model_interface::Detect<ModelType,
+                                model_interface::RestoreLaneStates>::value,
+        "Multi-lane ModelType needs restoreState(const void*, const double*)");
+  }
+  waitForCheckpoint();
+  const CheckpointFile file(path);
+  const CheckpointHeader& header = file.header();
+  if (header.lanes != LANES ||
+      header.state_bytes != ModelType::stateBytes(shared_data_) ||
+      header.state_layout != stateLayout()) {
+    throw std::runtime_error("Checkpoint " + path +
+                             " was written for a different model or system");
+  }
+  if (header.initial_pop_size != initial_pop_size_ ||
+      header.max_pop_size != max_pop_size_) {
+    throw std::runtime_error("Checkpoint " + path +
+                             " was written for a different population size");
+  }
+  if (header.rng_backend != static_cast<std::int32_t>(thread_rngs_[0].backend()) ||
+      std::strncmp(header.rng_name, gsl_rng_name(r_), sizeof(header.rng_name)) != 0 ||
+      header.rng_state_bytes != gsl_rng_size(r_)) {
+    throw std::runtime_error("Checkpoint " + path +
+                             " was written with different generators");
+  }
+  // The layout check of CheckpointFile trusts these counts, so a file whose
+  // replicas would not fit this population is rejected here.
+  if (header.pop_size < 0 || header.pop_size > max_pop_size_ ||
+      header.num_models != numModels(header.pop_size)) {
+    throw std::runtime_error("Checkpoint " + path +
+                             " has an inconsistent population size");
+  }
+
+  // Fresh model objects, so that the genealogy can be set again.
+  resizePopulationStorage(0);
+  resizePopulationStorage(header.pop_size);
+  const int num_models = header.num_models;
+  const double* lane_energies =
+      file.section<double>(header.lane_energies_offset);
+  const std::int32_t* families =
+      file.section<std::int32_t>(header.families_offset);
+  const std::int32_t* parents =
+      file.section<std::int32_t>(header.parents_offset);
+  const unsigned char* states =
+      file.section<unsigned char>(header.states_offset);
+  #pragma omp parallel for schedule(static)
+  for (int m = 0; m < num_models; ++m) {
+    if constexpr (LANES == 1) {
+      population_[m].restoreState(states + m * header.state_bytes,
+                                  lane_energies[m]);
+    } else {
+      population_[m].restoreState(states + m * header.state_bytes,
+                                  lane_energies + m * LANES);
+    }
+    for (int i = m * LANES; i < (m + 1) * LANES; ++i) {
+      setReplicaFamily(i, families[i]);
+      setReplicaParent(i, parents[i]);
+    }
+  }
+  const double* energies = file.section<double>(header.energies_offset);
+  std::copy(energies, energies + pop_size_, energies_.begin());
+  std::memcpy(gsl_rng_state(r_),
+              file.section<unsigned char>(header.rng_state_offset),
+              header.rng_state_bytes);
+
+  nom_pop_size_ = header.nom_pop_size;
+  step_ = header.step;
+  num_resamples_ = header.num_resamples;
+  num_houdayer_rounds_ = header.num_houdayer_rounds;
+  seed_ = header.seed;
+  resample_seed_ = header.resample_seed;
+  beta_ = header.beta;
+  delta_betaF_ = header.delta_beta_f;
+  avg_energy_ = header.avg_energy;
+  var_energy_ = header.var_energy;
+  min_energy_ = header.min_energy;
+  energies_current_ = header.energies_current != 0;
+  observables_current_ = false;
+  std::fill(sweep_costs_.begin(), sweep_costs_.end(), 0.0);
+}
+
 template <typename ModelType>
 double Population<ModelType>::getMinEnergy() {
     if (!energies_current_) {
@@ -296,30 +831,26 @@ void Population<ModelType>::resizePopulationStorage(int new_size) {
     throw std::runtime_error("Exceeded maximum allowed population size.");
   } 
 
-  int reserve_size = new_size;
-  if (new_size > static_cast<int>(population_.capacity())) {
-    reserve_size = static_cast<int>(new_size + 5 * std::sqrt(static_cast<double>(new_size)));
-  }
-
-  population_.reserve(reserve_size);
-  energies_.reserve(reserve_size);
-  weights_.reserve(reserve_size);
-  copy_counts_.reserve(reserve_size);
-
+  // Storage was reserved for max_pop_size_ replicas in the constructor, so
+  // growing or shrinking here never goes to the heap.
   energies_.resize(new_size, 0.0);
   weights_.resize(new_size, 0.0);
   copy_counts_.resize(new_size, 0);
 
-  // This loop is not optimal but is just here to make a working version of pamc.
-  // This whole section will be replaced once manual memory management is set up.
-  if (new_size > pop_size_) {
-    for (int i = pop_size_; i < new_size; ++i) {
+  const int old_models = numModels(pop_size_);
+  const int new_models = numModels(new_size);
+  for (int i = old_models; i < new_models; ++i) {
+    if constexpr (ModelUsesArena<ModelType>::value) {
+      population_.emplace_back(shared_data_, arena_->acquire());
+    } else {
       population_.emplace_back(shared_data_);
     }
-  } else if (new_size < pop_size_) {
-    for (int i = 0; i < pop_size_ - new_size; ++i) {
-      population_.pop_back();
+  }
+  for (int i = new_models; i < old_models; ++i) {
+    if constexpr (ModelUsesArena<ModelType>::value) {
+      arena_->release(population_.back().stateData());
     }
+    population_.pop_back();
   }
 
   pop_size_ = new_size;
@@ -333,20 +864,32 @@ void Population<ModelType>::computeWeights(double new_beta, double avg_energy, d
   // Apply energy shift to stabilize exponentials:
   // We compute weights ∝ exp(-Δβ (E_i - ⟨E⟩)) to avoid underflow,
   // and account for the shift in the delta betaF update.
-  for (int i = 0; i < pop_size_; ++i) {
-    weights_[i] = std::exp(-delta_beta * (energies_[i] - avg_energy));
+  // QR is summed per chunk in parallel, then over chunks in order.
+  const int num_chunks = numChunks(pop_size_);
+  std::vector<double> chunk_sums(num_chunks);
+  #pragma omp parallel for schedule(static)
+  for (int c = 0; c < num_chunks; ++c) {
+    const int end = std::min(pop_size_, (c + 1) * REDUCTION_CHUNK);
+    double sum = 0.0;
+    for (int i = c * REDUCTION_CHUNK; i < end; ++i) {
+      weights_[i] = std::exp(-delta_beta * (energies_[i] - avg_energy));
+      sum += weights_[i];
+    }
+    chunk_sums[c] = sum;
   }
-  QR = std::accumulate(weights_.begin(), weights_.end(), 0.0);
+  QR = std::accumulate(chunk_sums.begin(), chunk_sums.end(), 0.0);
 
   // Now normalize weights (equal to tau_i).
   // The shifted energy in Q and in weights cancel each other.
+  #pragma omp parallel for schedule(static)
   for (int i = 0; i < pop_size_; ++i) {
     weights_[i] = nom_pop_size_ * weights_[i] / QR;
   }
 }
 
 template <typename ModelType>
-void Population<ModelType>::computeCopyCounts(int& new_pop_size, gsl_rng* r_local) {
+template <typename Rng>
+void Population<ModelType>::computeCopyCounts(int& new_pop_size, Rng& r_local) {
   new_pop_size = 0;
   for (int i = 0; i < pop_size_; ++i) {
     int n = stochastic_round(weights_[i], r_local);
@@ -355,6 +898,26 @@ void Population<ModelType>::computeCopyCounts(int& new_pop_size, gsl_rng* r_loca
   }
 }
 
+// Replica i is rounded with the first word of Philox block i of a stream
+// numbered by the resample count, under a key derived from the seed (and
+// disjoint from the equilibrate keys in practice). Each draw is a pure
+// function of (resample_seed_, num_resamples_, i), so the loop parallelizes
+// freely.
+template <typename ModelType>
+int Population<ModelType>::computeCopyCountsParallel() {
+  const std::uint64_t key = ~static_cast<std::uint64_t>(resample_seed_);
+  const std::uint64_t stream = static_cast<std::uint64_t>(num_resamples_++);
+  int new_pop_size = 0;
+  #pragma omp parallel for schedule(static) reduction(+ : new_pop_size)
+  for (int i = 0; i < pop_size_; ++i) {
+    std::uint32_t bits[4];
+    Philox4x32::block(key, stream, static_cast<std::uint64_t>(i), bits);
+    copy_counts_[i] = stochastic_round(weights_[i], bits[0] * 0x1p-32);
+    new_pop_size += copy_counts_[i];
+  }
+  return new_pop_size;
+}
+
 template <typename ModelType>
 void Population<ModelType>::forwardCopy(int old_pop_size, int new_pop_size) {
   int copy_from = 0;
@@ -365,7 +928,7 @@ void Population<ModelType>::forwardCopy(int old_pop_size, int new_pop_size) {
   while (copy_from < old_pop_size && copy_counts_[copy_from] <= 1) ++copy_from;
 
   while (copy_from < old_pop_size && copy_to < new_pop_size) {
-    population_[copy_to].copyStateFrom(population_[copy_from]);
+    copyReplica(copy_to, copy_from);
     energies_[copy_to] = energies_[copy_from];
 
     --copy_counts_[copy_from];
@@ -390,7 +953,7 @@ void Population<ModelType>::backfillHoles(int old_pop_size) {
     while (copy_to < copy_from && copy_counts_[copy_from] == 0) --copy_from;
 
     if (copy_to < copy_from) {
-      population_[copy_to].copyStateFrom(population_[copy_from]);
+      copyReplica(copy_to, copy_from);
       energies_[copy_to] = energies_[copy_from];
       copy_counts_[copy_to] = 1;
       --copy_counts_[copy_from];
@@ -400,4 +963,233 @@ void Population<ModelType>::backfillHoles(int old_pop_size) {
   }
 }
 
+// Parallel equivalent of forwardCopy followed by backfillHoles; the final
+// layout, families and parents are identical. The holes (slots in
+// [0, new_pop_size) without copies) are filled in ascending order, first with
+// the surplus copies of each replica with more than one copy, in replica
+// order, then with the surviving replicas in [new_pop_size, old_pop_size),
+// from the back. Prefix sums over copy_counts_ give each hole its source.
+// Since a hole is never a source, all copies are independent.
+template <typename ModelType>
+void Population<ModelType>::scatterCopies(int old_pop_size, int new_pop_size) {
+  const int num_extras =
+      exclusiveScan(old_pop_size, extra_offsets_,
+                    [&](int i) { return std::max(copy_counts_[i] - 1, 0); });
+  const int num_holes =
+      exclusiveScan(new_pop_size, hole_offsets_,
+                    [&](int i) { return copy_counts_[i] == 0 ? 1 : 0; });
+  const int num_keepers = exclusiveScan(
+      std::max(old_pop_size - new_pop_size, 0), keeper_offsets_,
+      [&](int k) { return copy_counts_[new_pop_size + k] > 0 ? 1 : 0; });
+  assert(num_holes == num_extras + num_keepers);
+  (void)num_extras;
+  (void)num_keepers;
+
+  hole_slots_.resize(num_holes);
+  copy_sources_.resize(num_holes);
+  #pragma omp parallel for schedule(static)
+  for (int i = 0; i < new_pop_size; ++i) {
+    if (copy_counts_[i] == 0) {
+      hole_slots_[hole_offsets_[i]] = i;
+    }
+  }
+  #pragma omp parallel for schedule(static)
+  for (int i = 0; i < old_pop_size; ++i) {
+    for (int h = extra_offsets_[i]; h < extra_offsets_[i + 1]; ++h) {
+      copy_sources_[h] = i;
+    }
+    if (i >= new_pop_size && copy_counts_[i] > 0) {
+      copy_sources_[num_holes - 1 - keeper_offsets_[i - new_pop_size]] = i;
+    }
+  }
+
+  // Lanes of one multi-lane object share words, so those copies stay serial.
+  #pragma omp parallel for schedule(static) if (LANES == 1)
+  for (int h = 0; h < num_holes; ++h) {
+    copyReplica(hole_slots_[h], copy_sources_[h]);
+    energies_[hole_slots_[h]] = energies_[copy_sources_[h]];
+  }
+  std::fill(copy_counts_.begin(), copy_counts_.begin() + new_pop_size, 1);
+}
+
+// Writes the exclusive prefix sums of value(0), ..., value(n - 1) to
+// out[0..n] and returns the total. Chunks are scanned in parallel, then
+// offset by the totals of the chunks before them.
+template <typename ModelType>
+template <typename F>
+int Population<ModelType>::exclusiveScan(int n, std::vector<int>& out,
+                                         F value) {
+  out.resize(n + 1);
+  out[0] = 0;
+  const int num_chunks = numChunks(n);
+  #pragma omp parallel for schedule(static)
+  for (int c = 0; c < num_chunks; ++c) {
+    const int end = std::min(n, (c + 1) * REDUCTION_CHUNK);
+    int sum = 0;
+    for (int i = c * REDUCTION_CHUNK; i < end; ++i) {
+      sum += value(i);
+      out[i + 1] = sum;
+    }
+  }
+  for (int c = 1; c < num_chunks; ++c) {
+    out[std::min(n, (c + 1) * REDUCTION_CHUNK)] += out[c * REDUCTION_CHUNK];
+  }
+  #pragma omp parallel for schedule(static)
+  for (int c = 1; c < num_chunks; ++c) {
+    const int end = std::min(n, (c + 1) * REDUCTION_CHUNK);
+    for (int i = c * REDUCTION_CHUNK + 1; i < end; ++i) {
+      out[i] += out[c * REDUCTION_CHUNK];
+    }
+  }
+  return out[n];
+}
+
+// Energies and observables of the replicas of model object m.
+template <typename ModelType>
+void Population<ModelType>::measureModel(int m) {
+  const int num_observables = observables_.size();
+  if constexpr (LANES == 1) {
+    energies_[m] = population_[m].measureEnergy();
+    if (num_observables > 0) {
+      observables_.evaluate(population_[m],
+                            &observable_values_[m * num_observables]);
+    }
+  } else {
+    // Lanes past pop_size_ in the last object are discarded.
+    double lane_energies[LANES];
+    population_[m].measureEnergies(lane_energies);
+    const int num_lanes = std::min(LANES, pop_size_ - m * LANES);
+    std::copy(lane_energies, lane_energies + num_lanes,
+              energies_.begin() + m * LANES);
+    if (num_observables > 0) {
+      observables_.evaluateLanes(
+          population_[m], num_lanes,
+          &observable_values_[m * LANES * num_observables]);
+    }
+  }
+}
+
+template <typename ModelType>
+void Population<ModelType>::measureReplicas() {
+  const int num_models = numModels(pop_size_);
+  #pragma omp parallel for schedule(static)
+  for (int m = 0; m < num_models; ++m) {
+    measureModel(m);
+  }
+  reduceMeasurements();
+}
+
+// Energy moments, minimum and observable averages from the per-replica
+// values, reduced per chunk in parallel and then over chunks in order.
+template <typename ModelType>
+void Population<ModelType>::reduceMeasurements() {
+  const int num_observables = observables_.size();
+  // Per chunk: sum of E, sum of E^2, min E, then the observable sums.
+  const int stride = 3 + num_observables;
+  const int num_chunks = numChunks(pop_size_);
+  std::vector<double> partials(static_cast<std::size_t>(num_chunks) * stride);
+  #pragma omp parallel for schedule(static)
+  for (int c = 0; c < num_chunks; ++c) {
+    double* partial = &partials[static_cast<std::size_t>(c) * stride];
+    std::fill(partial, partial + stride, 0.0);
+    partial[2] = std::numeric_limits<double>::max();
+    const int end = std::min(pop_size_, (c + 1) * REDUCTION_CHUNK);
+    for (int i = c * REDUCTION_CHUNK; i < end; ++i) {
+      partial[0] += energies_[i];
+      partial[1] += energies_[i] * energies_[i];
+      partial[2] = std::min(partial[2], energies_[i]);
+      const double* values = observable_values_.data() + i * num_observables;
+      for (int k = 0; k < num_observables; ++k) {
+        partial[3 + k] += values[k];
+      }
+    }
+  }
+
+  double total_energy = 0.0;
+  double total_energy_sq = 0.0;
+  double min_energy = std::numeric_limits<double>::max();
+  std::fill(observable_averages_.begin(), observable_averages_.end(), 0.0);
+  for (int c = 0; c < num_chunks; ++c) {
+    const double* partial = &partials[static_cast<std::size_t>(c) * stride];
+    total_energy += partial[0];
+    total_energy_sq += partial[1];
+    min_energy = std::min(min_energy, partial[2]);
+    for (int k = 0; k < num_observables; ++k) {
+      observable_averages_[k] += partial[3 + k];
+    }
+  }
+
+  double mean_energy = total_energy /pop_size_;
+  double mean_energy_sq = total_energy_sq /pop_size_;
+  var_energy_ = mean_energy_sq - mean_energy *mean_energy;
+  avg_energy_ = mean_energy;
+  min_energy_ = min_energy;
+  for (double& average : observable_averages_) {
+    average /= pop_size_;
+  }
+
+  energies_current_ = true;
+  observables_current_ = true;
+}
+
+template <typename ModelType>
+void Population<ModelType>::copyReplica(int to, int from) {
+  if constexpr (LANES == 1) {
+    population_[to].copyStateFrom(population_[from]);
+    sweep_costs_[to] = sweep_costs_[from];
+  } else {
+    population_[to / LANES].copyLaneFrom(to % LANES, population_[from / LANES],
+                                         from % LANES);
+  }
+}
+
+// The stream of model object m in the current step is a function of
+// (seed_, family, step_, m) only: the family selects the key, and step_ and m
+// the Philox stream (or xoshiro/mt19937 seed), which are distinct for every
+// sweep of every object in a run. Streams therefore follow the genealogy
+// through resampling and do not depend on which thread runs the object.
+template <typename ModelType>
+void Population<ModelType>::seedReplicaStream(RandomStream& rng, int m) const {
+  std::uint64_t family = static_cast<std::uint64_t>(getReplicaFamily(m * LANES));
+  const std::uint64_t key = seed_ ^ splitMix64(family);
+  rng.seed(key, (static_cast<std::uint64_t>(step_) << 32) |
+                    static_cast<std::uint32_t>(m));
+}
+
+template <typename ModelType>
+int Population<ModelType>::getReplicaFamily(int i) const {
+  if constexpr (LANES == 1) {
+    return population_[i].getFamily();
+  } else {
+    return population_[i / LANES].getFamily(i % LANES);
+  }
+}
+
+template <typename ModelType>
+int Population<ModelType>::getReplicaParent(int i) const {
+  if constexpr (LANES == 1) {
+    return population_[i].getParent();
+  } else {
+    return population_[i / LANES].getParent(i % LANES);
+  }
+}
+
+template <typename ModelType>
+void Population<ModelType>::setReplicaFamily(int i, int family) {
+  if constexpr (LANES == 1) {
+    population_[i].setFamily(family);
+  } else {
+    population_[i / LANES].setFamily(i % LANES, family);
+  }
+}
+
+template <typename ModelType>
+void Population<ModelType>::setReplicaParent(int i, int parent) {
+  if constexpr (LANES == 1) {
+    population_[i].setParent(parent);
+  } else {
+    population_[i / LANES].setParent(i % LANES, parent);
+  }
+}
+
 #endif  // POPULATION_HPP
\ No newline at end of file
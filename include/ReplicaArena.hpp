@@ -0,0 +1,94 @@
+#ifndef REPLICA_ARENA_HPP
+#define REPLICA_ARENA_HPP
+
+#include <cstddef>
+#include <new>
+#include <stdexcept>
+#include <vector>
+
+// Population-wide slab for replica state.
+// One aligned allocation holds `capacity` slots of `slot_bytes` each (rounded
+// up to ALIGNMENT so every slot starts on its own cache line). Slots are handed
+// out and returned through a free list, so a population can grow and shrink
+// across resampling steps without touching the heap. Models constructed on a
+// slot are non-owning views into the arena; the arena must outlive them.
+class ReplicaArena {
+ public:
+  static constexpr std::size_t ALIGNMENT = 64;
+
+  ReplicaArena() = default;
+  ReplicaArena(std::size_t slot_bytes, int capacity)
+      : slot_bytes_(roundUp(slot_bytes)), capacity_(capacity) {
+    buffer_ = static_cast<unsigned char*>(::operator new(
+        slot_bytes_ * static_cast<std::size_t>(capacity_),
+        std::align_val_t{ALIGNMENT}));
+    // Hand out low slots first so a freshly built population is contiguous.
+    free_slots_.reserve(capacity_);
+    for (int s = capacity_ - 1; s >= 0; --s) {
+      free_slots_.push_back(s);
+    }
+  }
+  ~ReplicaArena() {
+    if (buffer_) {
+      ::operator delete(buffer_, std::align_val_t{ALIGNMENT});
+    }
+  }
+  ReplicaArena(const ReplicaArena&) = delete;
+  ReplicaArena& operator=(const ReplicaArena&) = delete;
+
+  void* acquire() {
+    if (free_slots_.empty()) {
+      throw std::runtime_error("ReplicaArena is out of slots.");
+    }
+    int s = free_slots_.back();
+    free_slots_.pop_back();
+    return slot(s);
+  }
+  void release(const void* p) { free_slots_.push_back(slotIndex(p)); }
+
+  void* slot(int s) { return buffer_ + static_cast<std::size_t>(s) * slot_bytes_; }
+  int slotIndex(const void* p) const {
+    return static_cast<int>((static_cast<const unsigned char*>(p) - buffer_) /
+                            slot_bytes_);
+  }
+
+  std::size_t slotBytes() const { return slot_bytes_; }
+  int capacity() const { return capacity_; }
+  int numFree() const { return static_cast<int>(free_slots_.size()); }
+
+ private:
+  static std::size_t roundUp(std::size_t bytes) {
+    return (bytes + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+  }
+
+  unsigned char* buffer_ = nullptr;
+  std::size_t slot_bytes_ = 0;
+  int capacity_ = 0;
+  std::vector<int> free_slots_;
+};
+
+// std::vector allocator handing out ReplicaArena::ALIGNMENT-aligned storage,
+// for shared tables that vector kernels stream row by row.
+template <typename T>
+struct AlignedAllocator {
+  using value_type = T;
+
+  AlignedAllocator() = default;
+  template <typename U>
+  AlignedAllocator(const AlignedAllocator<U>&) {}
+
+  T* allocate(std::size_t n) {
+    return static_cast<T*>(::operator new(
+        n * sizeof(T), std::align_val_t{ReplicaArena::ALIGNMENT}));
+  }
+  void deallocate(T* p, std::size_t) {
+    ::operator delete(p, std::align_val_t{ReplicaArena::ALIGNMENT});
+  }
+
+  template <typename U>
+  bool operator==(const AlignedAllocator<U>&) const { return true; }
+  template <typename U>
+  bool operator!=(const AlignedAllocator<U>&) const { return false; }
+};
+
+#endif  // REPLICA_ARENA_HPP
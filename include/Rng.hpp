@@ -0,0 +1,274 @@
+#ifndef RNG_HPP
+#define RNG_HPP
+
+#include <gsl/gsl_rng.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+
+// Random number generators for the Monte Carlo hot loops. gsl_rng draws go
+// through a function pointer on a large state (about 2.5 KB for mt19937);
+// the engines here are a few words, inline, and fill whole batches at once.
+// RandomStream wraps one of them (or a gsl_rng, so that validation against
+// the GSL generators still runs) behind a small buffer, and the rng*()
+// helpers at the bottom let the model kernels be written once for both
+// gsl_rng* and RandomStream.
+
+// philox and xoshiro take the full 64-bit seed and stream id. gsl is for
+// validation only: mt19937 is seeded through gsl_rng_set, which keeps 32 bits,
+// so at most 2^32 distinct streams exist and two (seed, stream) pairs can
+// collide into identical streams (see RandomStream::gslSeed).
+enum class RngBackend { philox, xoshiro, gsl };
+
+inline std::uint64_t splitMix64(std::uint64_t& x) {
+  std::uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+// Philox4x32-10 (Salmon et al., SC'11). Counter-based: block n of stream s
+// under a given key is a pure function of (key, s, n), so independent streams
+// need no seeding state and any block can be generated directly.
+class Philox4x32 {
+ public:
+  Philox4x32(std::uint64_t key, std::uint64_t stream)
+      : key_(key), stream_(stream) {}
+
+  // The four words of block `counter`.
+  static void block(std::uint64_t key, std::uint64_t stream,
+                    std::uint64_t counter, std::uint32_t* out) {
+    std::uint32_t c0 = static_cast<std::uint32_t>(counter);
+    std::uint32_t c1 = static_cast<std::uint32_t>(counter >> 32);
+    std::uint32_t c2 = static_cast<std::uint32_t>(stream);
+    std::uint32_t c3 = static_cast<std::uint32_t>(stream >> 32);
+    std::uint32_t k0 = static_cast<std::uint32_t>(key);
+    std::uint32_t k1 = static_cast<std::uint32_t>(key >> 32);
+    for (int round = 0; round < 10; ++round) {
+      const std::uint64_t p0 = std::uint64_t{0xD2511F53} * c0;
+      const std::uint64_t p1 = std::uint64_t{0xCD9E8D57} * c2;
+      const std::uint32_t hi0 = static_cast<std::uint32_t>(p0 >> 32);
+      const std::uint32_t hi1 = static_cast<std::uint32_t>(p1 >> 32);
+      c0 = hi1 ^ c1 ^ k0;
+      c1 = static_cast<std::uint32_t>(p1);
+      c2 = hi0 ^ c3 ^ k1;
+      c3 = static_cast<std::uint32_t>(p0);
+      k0 += 0x9E3779B9;
+      k1 += 0xBB67AE85;
+    }
+    out[0] = c0;
+    out[1] = c1;
+    out[2] = c2;
+    out[3] = c3;
+  }
+
+  // Fills n words (a multiple of 4) from consecutive blocks.
+  void fill(std::uint32_t* out, std::size_t n) {
+    for (std::size_t b = 0; b < n / 4; ++b) {
+      block(key_, stream_, counter_ + b, out + 4 * b);
+    }
+    counter_ += n / 4;
+  }
+
+  std::uint64_t counter() const { return counter_; }
+
+ private:
+  std::uint64_t key_;
+  std::uint64_t stream_;
+  std::uint64_t counter_ = 0;
+};
+
+// xoshiro256** (Blackman and Vigna), seeded by splitmix64.
+class Xoshiro256 {
+ public:
+  explicit Xoshiro256(std::uint64_t seed, std::uint64_t stream = 0) {
+    seed ^= splitMix64(stream);
+    for (auto& word : s_) {
+      word = splitMix64(seed);
+    }
+  }
+
+  std::uint64_t bits64() {
+    const std::uint64_t result = rotl(s_[1] * 5, 7) * 9;
+    const std::uint64_t t = s_[1] << 17;
+    s_[2] ^= s_[0];
+    s_[3] ^= s_[1];
+    s_[1] ^= s_[2];
+    s_[0] ^= s_[3];
+    s_[2] ^= t;
+    s_[3] = rotl(s_[3], 45);
+    return result;
+  }
+
+  // Uniform integer in [0, n) for n < 2^32 (multiply-shift, bias < n / 2^32).
+  int uniformInt(int n) {
+    const std::uint64_t high = bits64() >> 32;
+    return static_cast<int>((high * static_cast<std::uint64_t>(n)) >> 32);
+  }
+
+  // Fills n words (a multiple of 2).
+  void fill(std::uint32_t* out, std::size_t n) {
+    for (std::size_t i = 0; i + 1 < n; i += 2) {
+      const std::uint64_t bits = bits64();
+      out[i] = static_cast<std::uint32_t>(bits);
+      out[i + 1] = static_cast<std::uint32_t>(bits >> 32);
+    }
+  }
+
+ private:
+  std::uint64_t s_[4];
+
+  static std::uint64_t rotl(std::uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+  }
+};
+
+// 64 random bits from any gsl_rng type, independent of its output range.
+inline std::uint64_t gslRandomWord(gsl_rng* r) {
+  std::uint64_t word = 0;
+  for (int k = 0; k < 4; ++k) {
+    word = (word << 16) | gsl_rng_uniform_int(r, 1UL << 16);
+  }
+  return word;
+}
+
+// Buffered stream of random numbers from one backend. The philox and xoshiro
+// backends refill BUFFER_WORDS words at a time; the gsl backend (mt19937)
+// forwards every call so that it reproduces plain gsl_rng draws exactly.
+class RandomStream {
+ public:
+  static constexpr int BUFFER_WORDS = 256;
+
+  explicit RandomStream(RngBackend backend = RngBackend::philox,
+                        std::uint64_t seed = 0, std::uint64_t stream = 0)
+      : backend_(backend), philox_(seed, stream), xoshiro_(seed, stream) {
+    if (backend_ == RngBackend::gsl) {
+      gsl_ = gsl_rng_alloc(gsl_rng_mt19937);
+      gsl_rng_set(gsl_, gslSeed(seed, stream));
+    }
+  }
+  RandomStream(RandomStream&& other) noexcept
+      : backend_(other.backend_),
+        gsl_(std::exchange(other.gsl_, nullptr)),
+        philox_(other.philox_),
+        xoshiro_(other.xoshiro_),
+        next_(other.next_) {
+    std::copy(other.buffer_, other.buffer_ + BUFFER_WORDS, buffer_);
+  }
+  RandomStream(const RandomStream&) = delete;
+  RandomStream& operator=(const RandomStream&) = delete;
+  RandomStream& operator=(RandomStream&&) = delete;
+  ~RandomStream() {
+    if (gsl_ != nullptr) {
+      gsl_rng_free(gsl_);
+    }
+  }
+
+  RngBackend backend() const { return backend_; }
+
+  void seed(std::uint64_t seed, std::uint64_t stream = 0) {
+    philox_ = Philox4x32(seed, stream);
+    xoshiro_ = Xoshiro256(seed, stream);
+    if (gsl_ != nullptr) {
+      gsl_rng_set(gsl_, gslSeed(seed, stream));
+    }
+    next_ = BUFFER_WORDS;
+  }
+
+  std::uint32_t bits32() {
+    if (gsl_ != nullptr) {
+      return static_cast<std::uint32_t>(gslRandomWord(gsl_));
+    }
+    if (next_ == BUFFER_WORDS) {
+      refill();
+    }
+    return buffer_[next_++];
+  }
+
+  std::uint64_t bits64() {
+    if (gsl_ != nullptr) {
+      return gslRandomWord(gsl_);
+    }
+    const std::uint64_t low = bits32();
+    return (static_cast<std::uint64_t>(bits32()) << 32) | low;
+  }
+
+  // Uniform double in [0, 1) with 32-bit resolution, like gsl_rng_uniform on
+  // mt19937.
+  double uniform() {
+    if (gsl_ != nullptr) {
+      return gsl_rng_uniform(gsl_);
+    }
+    return bits32() * 0x1p-32;
+  }
+
+  // Unbiased uniform integer in [0, n) for 0 < n < 2^32 (Lemire's method).
+  unsigned long uniformInt(unsigned long n) {
+    if (gsl_ != nullptr) {
+      return gsl_rng_uniform_int(gsl_, n);
+    }
+    const std::uint32_t range = static_cast<std::uint32_t>(n);
+    std::uint64_t m = static_cast<std::uint64_t>(bits32()) * range;
+    if (static_cast<std::uint32_t>(m) < range) {
+      const std::uint32_t limit = -range % range;
+      while (static_cast<std::uint32_t>(m) < limit) {
+        m = static_cast<std::uint64_t>(bits32()) * range;
+      }
+    }
+    return static_cast<unsigned long>(m >> 32);
+  }
+
+  // Batch of n uniforms in [0, 1).
+  void fillUniform(double* out, std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i) {
+      out[i] = uniform();
+    }
+  }
+
+ private:
+  RngBackend backend_;
+  gsl_rng* gsl_ = nullptr;
+  Philox4x32 philox_;
+  Xoshiro256 xoshiro_;
+  alignas(64) std::uint32_t buffer_[BUFFER_WORDS];
+  int next_ = BUFFER_WORDS;
+
+  // Stream 0 uses seed as is, matching a gsl_rng set to the same seed. Other
+  // streams mix the id into the seed and fold the 64-bit result to the 32
+  // bits mt19937 keeps, so every bit of seed and stream counts; distinct
+  // pairs still collide with probability 2^-32.
+  static unsigned long gslSeed(std::uint64_t seed, std::uint64_t stream) {
+    if (stream == 0) {
+      return static_cast<unsigned long>(seed);
+    }
+    const std::uint64_t mixed = seed ^ splitMix64(stream);
+    return static_cast<unsigned long>((mixed ^ (mixed >> 32)) & 0xffffffffULL);
+  }
+
+  void refill() {
+    if (backend_ == RngBackend::philox) {
+      philox_.fill(buffer_, BUFFER_WORDS);
+    } else {
+      xoshiro_.fill(buffer_, BUFFER_WORDS);
+    }
+    next_ = 0;
+  }
+};
+
+// Generator-agnostic access used by the model kernels, which are templated on
+// the generator type (gsl_rng* or RandomStream).
+inline double rngUniform(gsl_rng* r) { return gsl_rng_uniform(r); }
+inline double rngUniform(RandomStream& r) { return r.uniform(); }
+inline unsigned long rngUniformInt(gsl_rng* r, unsigned long n) {
+  return gsl_rng_uniform_int(r, n);
+}
+inline unsigned long rngUniformInt(RandomStream& r, unsigned long n) {
+  return r.uniformInt(n);
+}
+inline std::uint64_t rngBits64(gsl_rng* r) { return gslRandomWord(r); }
+inline std::uint64_t rngBits64(RandomStream& r) { return r.bits64(); }
+
+#endif  // RNG_HPP
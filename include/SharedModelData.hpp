@@ -1,6 +1,16 @@
 #ifndef SHARED_MODEL_DATA_HPP
 #define SHARED_MODEL_DATA_HPP
 
+#include <algorithm>
+#include <cmath>
+#include <climits>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "ReplicaArena.hpp"
+
 // Primary template (unspecialized)
 template <typename ModelT>
 struct SharedModelData;
@@ -10,25 +20,466 @@ struct SharedModelData<class TestModel> {
 
 };
 
+// Storage used for the spins of each IsingModel replica. int32 is the
+// original layout; int8 cuts memory 4x at no extra cost per access, and bit
+// packs 64 spins per word so that magnetization, overlap and (for uniform
+// bonds) energy reduce to XOR/popcount.
+enum class SpinStorage { int32, int8, bit };
+
+// Order in which IsingModel stores the spins of a lattice given by a neighbor
+// table (see SharedModelData<IsingModel>::relabeled).
+enum class SpinOrder { original, morton, tiled, rcm };
+
 // Specialization for IsingModel
 // The bond and neighbor tables are specified externally. The only constraint is
 // that all spins must have the same number of neighbors.
 // Consider changing neighbor_table and bond_table to std::span for bounds
 // checking.
+//
+// Periodic hypercubic lattices in 2 to 5 dimensions can instead be built with
+// hypercubic(), which keeps no neighbor table (neighbor_table is nullptr):
+// IsingModel computes the neighbors from the site index, and reads the bonds
+// from lattice_bonds, one table per lattice direction.
+//
+// relabeled() stores the spins of a table-driven lattice in a cache-friendly
+// order instead, with its own copy of the tables in the internal labelling.
 template <>
 struct SharedModelData<class IsingModel> {
+  static constexpr int MIN_LATTICE_DIMENSION = 2;
+  static constexpr int MAX_LATTICE_DIMENSION = 5;
+
   const int system_size;
   const int num_spins;
   const int num_neighbors;
   const int* neighbor_table;
   const double* bond_table;
+  const SpinStorage spin_storage;
+  // True when every entry of bond_table has the same value, uniform_bond.
+  bool uniform_bonds = true;
+  double uniform_bond = 0.0;
+  // True when every bond is an integer multiple of bond_unit (ferromagnet,
+  // +/-J, small integer couplings). Local fields then take at most
+  // 2 * num_neighbors * max_bond_multiple + 1 values, and IsingModel looks
+  // up Boltzmann factors instead of calling exp(). Gaussian bonds leave this
+  // false.
+  bool discrete_bonds = false;
+  double bond_unit = 0.0;
+  int max_bond_multiple = 0;
+  // True when neighbor_table is the periodic L x L x L cubic lattice of
+  // initializeNeighborTable3D (L = system_size), or for an implicit lattice
+  // in 3 dimensions. With even L the lattice is bipartite and IsingModel can
+  // use the vectorized checkerboard kernels.
+  bool cubic_lattice = false;
+  // Bond multiples (bond / bond_unit) of a cubic lattice with discrete,
+  // non-uniform bonds, regrouped as [n * num_spins + i] so that a row of
+  // sites reads the bonds of one direction contiguously. Empty otherwise,
+  // including for implicit lattices, which keep each bond once.
+  std::vector<std::int32_t> direction_bonds;
+  // Dimension D of an implicit lattice built by hypercubic(), 0 when the
+  // neighbors come from neighbor_table.
+  int lattice_dimension = 0;
+  // Bonds of an implicit lattice: the bond between site i and its +1
+  // neighbor along dimension d at [d * num_spins + i]. Each bond is stored
+  // once, and the -1 neighbor j of i along d holds it at [d * num_spins + j].
+  std::vector<double> lattice_bonds;
+  // Internal labelling of a relabeled() lattice: order[k] is the original
+  // label of internal spin k and label its inverse. Both are empty when the
+  // spins keep the labels of the neighbor table.
+  std::vector<int> order;
+  std::vector<int> label;
+  // Tables in the internal labelling, which neighbor_table and bond_table
+  // point into after relabeled(). Empty otherwise.
+  std::vector<int> relabeled_neighbors;
+  std::vector<double> relabeled_bonds;
+
+  SharedModelData(int system_size, int num_spins, int num_neighbors,
+                  const int* neighbor_table, const double* bond_table,
+                  SpinStorage spin_storage = SpinStorage::int32)
+      : system_size(system_size),
+        num_spins(num_spins),
+        num_neighbors(num_neighbors),
+        neighbor_table(neighbor_table),
+        bond_table(bond_table),
+        spin_storage(spin_storage) {
+    detectCubicLattice();
+    analyzeBonds();
+  }
+
+  // Periodic hypercubic lattice of side system_size in dimension D (2 to 5)
+  // without a neighbor table. bond_table has the layout of the neighbor
+  // table of initializeNeighborTableND(system_size, D), must be symmetric and
+  // is read here only (bond_table is nullptr afterwards); lattice_bonds keeps
+  // the couplings.
+  static SharedModelData hypercubic(
+      int system_size, int dimension, const double* bond_table,
+      SpinStorage spin_storage = SpinStorage::int32) {
+    return SharedModelData(system_size, dimension, bond_table, spin_storage);
+  }
+
+  // Same lattice as the constructor above, with the spins stored in
+  // spin_order so that neighbors share cache lines: Z-order (morton) or 4^3
+  // blocks (tiled) of the periodic cubic lattice (the neighbors of each site
+  // those of initializeNeighborTable3D, in any order), or reverse
+  // Cuthill-McKee (rcm, see SparseGraphHelpers.hpp) for any table.
+  // The tables are read here only and copied in the internal labelling.
+  // IsingModel translates in getState, setSpin and getSpin, so populations
+  // and their output keep the original labels. A relabeled cubic lattice no
+  // longer counts as cubic_lattice, so the checkerboard methods are not
+  // available on it. Defined in IsingModel.cpp.
+  static SharedModelData relabeled(
+      int system_size, int num_spins, int num_neighbors,
+      const int* neighbor_table, const double* bond_table,
+      SpinOrder spin_order, SpinStorage spin_storage = SpinStorage::int32);
+
+  // neighbor_table and bond_table may point into this object, so it can be
+  // moved but not copied.
+  SharedModelData(SharedModelData&&) = default;
+  SharedModelData(const SharedModelData&) = delete;
+
+ private:
+  // order[k] is the spin of neighbor_table stored at position k.
+  SharedModelData(int system_size, int num_spins, int num_neighbors,
+                  const int* neighbor_table, const double* bond_table,
+                  std::vector<int> spin_order, SpinStorage spin_storage)
+      : system_size(system_size),
+        num_spins(num_spins),
+        num_neighbors(num_neighbors),
+        neighbor_table(nullptr),
+        bond_table(nullptr),
+        spin_storage(spin_storage),
+        order(std::move(spin_order)),
+        label(num_spins, -1) {
+    if (order.size() != static_cast<std::size_t>(num_spins)) {
+      throw std::invalid_argument("Spin order is not a permutation");
+    }
+    for (int k = 0; k < num_spins; ++k) {
+      if (order[k] < 0 || order[k] >= num_spins || label[order[k]] >= 0) {
+        throw std::invalid_argument("Spin order is not a permutation");
+      }
+      label[order[k]] = k;
+    }
+    const long num_entries = static_cast<long>(num_spins) * num_neighbors;
+    relabeled_neighbors.resize(num_entries);
+    relabeled_bonds.resize(num_entries);
+    for (int k = 0; k < num_spins; ++k) {
+      const long row = static_cast<long>(order[k]) * num_neighbors;
+      for (int n = 0; n < num_neighbors; ++n) {
+        const int j = neighbor_table[row + n];
+        if (j < 0 || j >= num_spins) {
+          throw std::invalid_argument("Neighbor index out of range");
+        }
+        relabeled_neighbors[static_cast<long>(k) * num_neighbors + n] =
+            label[j];
+        relabeled_bonds[static_cast<long>(k) * num_neighbors + n] =
+            bond_table[row + n];
+      }
+    }
+    this->neighbor_table = relabeled_neighbors.data();
+    this->bond_table = relabeled_bonds.data();
+    detectCubicLattice();
+    analyzeBonds();
+  }
+
+  SharedModelData(int system_size, int dimension, const double* bond_table,
+                  SpinStorage spin_storage)
+      : system_size(system_size),
+        num_spins(latticeSites(system_size, dimension)),
+        num_neighbors(2 * dimension),
+        neighbor_table(nullptr),
+        bond_table(bond_table),
+        spin_storage(spin_storage),
+        cubic_lattice(dimension == 3),
+        lattice_dimension(dimension) {
+    const int z = num_neighbors;
+    lattice_bonds.resize(static_cast<std::size_t>(num_spins) * dimension);
+    for (int i = 0; i < num_spins; ++i) {
+      int stride = 1;
+      for (int d = dimension - 1; d >= 0; --d) {
+        const int x = (i / stride) % system_size;
+        const int j = x == system_size - 1 ? i - (system_size - 1) * stride
+                                           : i + stride;
+        const double J = bond_table[static_cast<long>(i) * z + 2 * d + 1];
+        if (bond_table[static_cast<long>(j) * z + 2 * d] != J) {
+          throw std::invalid_argument(
+              "Hypercubic lattice bonds must be symmetric");
+        }
+        lattice_bonds[static_cast<std::size_t>(d) * num_spins + i] = J;
+        stride *= system_size;
+      }
+    }
+    analyzeBonds();
+    this->bond_table = nullptr;
+  }
+
+  static int latticeSites(int system_size, int dimension) {
+    if (dimension < MIN_LATTICE_DIMENSION ||
+        dimension > MAX_LATTICE_DIMENSION) {
+      throw std::invalid_argument(
+          "Hypercubic lattices need 2 to 5 dimensions");
+    }
+    if (system_size < 2) {
+      throw std::invalid_argument("Hypercubic lattices need L >= 2");
+    }
+    long sites = 1;
+    for (int d = 0; d < dimension; ++d) {
+      sites *= system_size;
+      if (sites > INT_MAX) {
+        throw std::invalid_argument("Hypercubic lattice is too large");
+      }
+    }
+    return static_cast<int>(sites);
+  }
+
+  void analyzeBonds() {
+    const long num_entries = static_cast<long>(num_spins) * num_neighbors;
+    for (long b = 1; b < num_entries && uniform_bonds; ++b) {
+      uniform_bonds = (bond_table[b] == bond_table[0]);
+    }
+    if (uniform_bonds && num_entries > 0) {
+      uniform_bond = bond_table[0];
+    }
+    detectDiscreteBonds(num_entries);
+    if (cubic_lattice && lattice_dimension == 0 && discrete_bonds &&
+        !uniform_bonds) {
+      direction_bonds.resize(num_entries);
+      for (int i = 0; i < num_spins; ++i) {
+        for (int n = 0; n < 6; ++n) {
+          direction_bonds[static_cast<long>(n) * num_spins + i] =
+              static_cast<std::int32_t>(
+                  std::nearbyint(bond_table[i * 6 + n] / bond_unit));
+        }
+      }
+    }
+  }
+
+  // Largest local field (in units of bond_unit) worth tabulating.
+  static constexpr int MAX_TABULATED_FIELD = 1024;
+
+  void detectDiscreteBonds(long num_entries) {
+    for (long b = 0; b < num_entries; ++b) {
+      double magnitude = std::abs(bond_table[b]);
+      if (magnitude > 0.0 && (bond_unit == 0.0 || magnitude < bond_unit)) {
+        bond_unit = magnitude;
+      }
+    }
+    if (bond_unit == 0.0) {
+      return;
+    }
+    for (long b = 0; b < num_entries; ++b) {
+      double multiple = bond_table[b] / bond_unit;
+      if (multiple != std::nearbyint(multiple) ||
+          std::abs(multiple) * num_neighbors > MAX_TABULATED_FIELD) {
+        max_bond_multiple = 0;
+        return;
+      }
+      max_bond_multiple =
+          std::max(max_bond_multiple, static_cast<int>(std::abs(multiple)));
+    }
+    discrete_bonds = true;
+  }
+
+  void detectCubicLattice() {
+    const int L = system_size;
+    if (num_neighbors != 6 || L <= 0 ||
+        static_cast<long>(L) * L * L != num_spins) {
+      return;
+    }
+    auto index = [L](int x, int y, int z) {
+      return (((x + L) % L) * L + (y + L) % L) * L + (z + L) % L;
+    };
+    for (int x = 0; x < L; ++x) {
+      for (int y = 0; y < L; ++y) {
+        for (int z = 0; z < L; ++z) {
+          const int* nb = neighbor_table + index(x, y, z) * 6;
+          if (nb[0] != index(x - 1, y, z) || nb[1] != index(x + 1, y, z) ||
+              nb[2] != index(x, y - 1, z) || nb[3] != index(x, y + 1, z) ||
+              nb[4] != index(x, y, z - 1) || nb[5] != index(x, y, z + 1)) {
+            return;
+          }
+        }
+      }
+    }
+    cubic_lattice = true;
+  }
+};
+
+// Specialization for MultiSpinEAModel
+// Same table layout as IsingModel, but the couplings must all have the same
+// magnitude (+/-J, including the ferromagnet). The sign of every bond is
+// expanded once into a 64-bit mask so that a whole word of replicas can be
+// tested against it with a single XOR.
+template <>
+struct SharedModelData<class MultiSpinEAModel> {
+  const int system_size;
+  const int num_spins;
+  const int num_neighbors;
+  const int* neighbor_table;
+  const double* bond_table;
+  double bond_magnitude = 0.0;
+  // ~0 where the bond is antiferromagnetic (J < 0), 0 otherwise.
+  std::vector<std::uint64_t> bond_masks;
+
+  SharedModelData(int system_size, int num_spins, int num_neighbors,
+                  const int* neighbor_table, const double* bond_table)
+      : system_size(system_size),
+        num_spins(num_spins),
+        num_neighbors(num_neighbors),
+        neighbor_table(neighbor_table),
+        bond_table(bond_table),
+        bond_masks(static_cast<std::size_t>(num_spins) * num_neighbors) {
+    if (num_neighbors <= 0 || num_neighbors > 14 || num_neighbors % 2 != 0) {
+      throw std::invalid_argument(
+          "MultiSpinEAModel requires an even number of neighbors <= 14");
+    }
+    bond_magnitude = std::abs(bond_table[0]);
+    if (bond_magnitude == 0.0) {
+      throw std::invalid_argument("MultiSpinEAModel requires nonzero bonds");
+    }
+    for (std::size_t b = 0; b < bond_masks.size(); ++b) {
+      if (std::abs(bond_table[b]) != bond_magnitude) {
+        throw std::invalid_argument(
+            "MultiSpinEAModel requires +/-J bonds of equal magnitude");
+      }
+      bond_masks[b] = bond_table[b] < 0 ? ~std::uint64_t{0} : 0;
+    }
+  }
+};
+
+// Specialization for BatchedEAModel
+// Same table layout as IsingModel, with any real couplings (typically
+// Gaussian). The tables are shared by every lane and are not copied.
+template <>
+struct SharedModelData<class BatchedEAModel> {
+  const int system_size;
+  const int num_spins;
+  const int num_neighbors;
+  const int* neighbor_table;
+  const double* bond_table;
+
   SharedModelData(int system_size, int num_spins, int num_neighbors,
                   const int* neighbor_table, const double* bond_table)
       : system_size(system_size),
         num_spins(num_spins),
         num_neighbors(num_neighbors),
         neighbor_table(neighbor_table),
-        bond_table(bond_table) {}
+        bond_table(bond_table) {
+    if (num_spins <= 0 || num_neighbors <= 0 || num_neighbors % 2 != 0) {
+      throw std::invalid_argument(
+          "BatchedEAModel requires spins and an even number of neighbors");
+    }
+  }
+};
+
+// Precision of the dense SKModel coupling matrix and local fields. float32
+// halves the memory traffic of every flip and doubles the SIMD width.
+enum class CouplingPrecision { float64, float32 };
+
+// Specialization for SKModel (fully connected, e.g. Sherrington-Kirkpatrick)
+// couplings is a dense row-major num_spins x num_spins matrix, symmetric with
+// a zero diagonal; the energy is -sum_{i<j} J_ij s_i s_j. It is copied into
+// rows padded to row_stride entries, each starting on its own cache line, in
+// the requested precision (only the matching matrix is filled). The padding
+// is zero, so kernels may run over whole rows.
+template <>
+struct SharedModelData<class SKModel> {
+  const int num_spins;
+  const CouplingPrecision precision;
+  const int row_stride;
+  std::vector<double, AlignedAllocator<double>> couplings;
+  std::vector<float, AlignedAllocator<float>> couplings_f32;
+
+  SharedModelData(int num_spins, const double* couplings,
+                  CouplingPrecision precision = CouplingPrecision::float64)
+      : num_spins(num_spins),
+        precision(precision),
+        row_stride(paddedStride(num_spins, precision)) {
+    if (num_spins <= 0) {
+      throw std::invalid_argument("SKModel requires at least one spin");
+    }
+    const std::size_t entries =
+        static_cast<std::size_t>(num_spins) * row_stride;
+    if (precision == CouplingPrecision::float64) {
+      this->couplings.assign(entries, 0.0);
+    } else {
+      couplings_f32.assign(entries, 0.0f);
+    }
+    for (int i = 0; i < num_spins; ++i) {
+      if (couplings[static_cast<long>(i) * num_spins + i] != 0.0) {
+        throw std::invalid_argument("SKModel couplings need a zero diagonal");
+      }
+      for (int j = 0; j < num_spins; ++j) {
+        const double J = couplings[static_cast<long>(i) * num_spins + j];
+        if (J != couplings[static_cast<long>(j) * num_spins + i]) {
+          throw std::invalid_argument("SKModel couplings must be symmetric");
+        }
+        const std::size_t k = static_cast<std::size_t>(i) * row_stride + j;
+        if (precision == CouplingPrecision::float64) {
+          this->couplings[k] = J;
+        } else {
+          couplings_f32[k] = static_cast<float>(J);
+        }
+      }
+    }
+  }
+
+ private:
+  static int paddedStride(int num_spins, CouplingPrecision precision) {
+    const int per_line = static_cast<int>(
+        ReplicaArena::ALIGNMENT / (precision == CouplingPrecision::float64
+                                       ? sizeof(double)
+                                       : sizeof(float)));
+    return (num_spins + per_line - 1) / per_line * per_line;
+  }
+};
+
+// One term of a sparse instance: the coupling J_ij between spins i != j, or
+// for SharedModelData<SparseIsingModel>::fromQubo the QUBO coefficient Q_ij
+// (i == j for the linear terms).
+struct SparseTerm {
+  int i;
+  int j;
+  double weight;
+};
+
+// Specialization for SparseIsingModel (arbitrary sparse graphs)
+// E = -sum_{i<j} J_ij s_i s_j - sum_i h_i s_i + energy_offset, with J in CSR
+// form: the neighbors of spin i are column_indices[row_offsets[i] ..
+// row_offsets[i + 1]) with couplings weights[...], every edge listed in both
+// rows with the same weight. Degrees may vary freely. fields (h) may be left
+// empty. The tables are validated and owned here, and unless reorder is false
+// the spins are relabeled in reverse Cuthill-McKee order (see
+// SparseGraphHelpers.hpp) so that neighboring spins sit close in memory. All
+// tables below use the internal labels; order and label translate, and
+// SparseIsingModel only exposes the original labels.
+template <>
+struct SharedModelData<class SparseIsingModel> {
+  const int num_spins;
+  std::vector<long> row_offsets;
+  std::vector<int> column_indices;
+  std::vector<double> weights;
+  std::vector<double> fields;
+  double energy_offset = 0.0;
+  int max_degree = 0;
+  // order[k] is the original label of internal spin k; label is its inverse.
+  std::vector<int> order;
+  std::vector<int> label;
+
+  SharedModelData(int num_spins, std::vector<long> row_offsets,
+                  std::vector<int> column_indices, std::vector<double> weights,
+                  std::vector<double> fields = {}, bool reorder = true);
+
+  // Builds the CSR tables from a list of couplings, each edge given once
+  // (either orientation); repeated edges are summed.
+  static SharedModelData fromEdges(int num_spins,
+                                   const std::vector<SparseTerm>& edges,
+                                   std::vector<double> fields = {},
+                                   bool reorder = true);
+  // Ising form of the QUBO problem min sum_{i,j} Q_ij x_i x_j over x_i in
+  // {0, 1}, with x_i = (1 + s_i) / 2. energy_offset makes every energy equal
+  // to the QUBO objective of the corresponding x.
+  static SharedModelData fromQubo(int num_variables,
+                                  const std::vector<SparseTerm>& terms,
+                                  bool reorder = true);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,119 @@
+#ifndef STEP_RECORDER_HPP
+#define STEP_RECORDER_HPP
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "DataWriter.hpp"
+#include "Genealogy.hpp"
+#include "Population.hpp"
+
+// Standard per-step columns of an annealing run, written through a
+// DataWriter:
+//
+//   step, pop_size                                   int64
+//   beta, mean_energy, min_energy, delta_beta_f,
+//   rho_t, rho_s, load_imbalance                     float64
+//   num_unique_families, max_family_size,
+//   num_gs_families                                  int64
+//
+// where load_imbalance is Population::getLoadImbalance() of the last
+// equilibrate. Then come one float64 column per entry of observable_names,
+// holding the matching entry of Population::measureObservables(), and with
+// replica_arrays the per-replica arrays energies (float64) and families
+// (int32). Further columns added to the writer before the first record()
+// can be set by the caller before each record().
+template <typename ModelType>
+class StepRecorder {
+ public:
+  StepRecorder(DataWriter& writer,
+               std::vector<std::string> observable_names = {},
+               bool replica_arrays = false)
+      : writer_(writer),
+        step_(writer.addScalar("step", DataWriter::ColumnType::int64)),
+        beta_(writer.addScalar("beta")),
+        pop_size_(writer.addScalar("pop_size", DataWriter::ColumnType::int64)),
+        mean_energy_(writer.addScalar("mean_energy")),
+        min_energy_(writer.addScalar("min_energy")),
+        delta_beta_f_(writer.addScalar("delta_beta_f")),
+        rho_t_(writer.addScalar("rho_t")),
+        rho_s_(writer.addScalar("rho_s")),
+        load_imbalance_(writer.addScalar("load_imbalance")),
+        num_unique_families_(writer.addScalar(
+            "num_unique_families", DataWriter::ColumnType::int64)),
+        max_family_size_(
+            writer.addScalar("max_family_size", DataWriter::ColumnType::int64)),
+        num_gs_families_(
+            writer.addScalar("num_gs_families", DataWriter::ColumnType::int64)),
+        replica_arrays_(replica_arrays) {
+    for (const std::string& name : observable_names) {
+      observables_.push_back(writer.addScalar(name));
+    }
+    if (replica_arrays_) {
+      energies_ = writer.addArray("energies");
+      families_ =
+          writer.addArray("families", DataWriter::ColumnType::int32);
+    }
+  }
+
+  // Measures the population if needed and ends the writer's step.
+  void record(long step, Population<ModelType>& population) {
+    const double mean_energy = population.measureEnergy();
+    const GenealogyStatistics stats = population.computeGenealogyStatistics();
+    writer_.set(step_, step);
+    writer_.set(beta_, population.getBeta());
+    writer_.set(pop_size_, population.getPopSize());
+    writer_.set(mean_energy_, mean_energy);
+    writer_.set(min_energy_, population.getMinEnergy());
+    writer_.set(delta_beta_f_, population.getDeltaBetaF());
+    writer_.set(rho_t_, stats.rho_t);
+    writer_.set(rho_s_, stats.rho_s);
+    writer_.set(load_imbalance_, population.getLoadImbalance());
+    writer_.set(num_unique_families_, stats.num_unique_families);
+    writer_.set(max_family_size_, stats.max_family_size);
+    writer_.set(num_gs_families_, stats.num_gs_families);
+    if (!observables_.empty()) {
+      const std::vector<double>& averages = population.measureObservables();
+      if (averages.size() != observables_.size()) {
+        throw std::invalid_argument(
+            "StepRecorder needs one name per registered observable");
+      }
+      for (std::size_t k = 0; k < observables_.size(); ++k) {
+        writer_.set(observables_[k], averages[k]);
+      }
+    }
+    if (replica_arrays_) {
+      writer_.setArray(energies_, population.getEnergies());
+      family_buffer_.resize(population.getPopSize());
+      for (int i = 0; i < population.getPopSize(); ++i) {
+        family_buffer_[i] = population.getFamily(i);
+      }
+      writer_.setArray(families_, family_buffer_);
+    }
+    writer_.endStep();
+  }
+
+ private:
+  DataWriter& writer_;
+  const int step_;
+  const int beta_;
+  const int pop_size_;
+  const int mean_energy_;
+  const int min_energy_;
+  const int delta_beta_f_;
+  const int rho_t_;
+  const int rho_s_;
+  const int load_imbalance_;
+  const int num_unique_families_;
+  const int max_family_size_;
+  const int num_gs_families_;
+  const bool replica_arrays_;
+  std::vector<int> observables_;
+  int energies_ = -1;
+  int families_ = -1;
+  std::vector<std::int32_t> family_buffer_;
+};
+
+#endif  // STEP_RECORDER_HPP
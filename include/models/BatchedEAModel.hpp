@@ -0,0 +1,112 @@
+#ifndef BATCHED_EA_MODEL_HPP
+#define BATCHED_EA_MODEL_HPP
+
+#include <gsl/gsl_rng.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "Model.hpp"
+#include "Rng.hpp"
+#include "SharedModelData.hpp"
+#include "models/IsingCheckerboard.hpp"
+
+// Edwards-Anderson model with arbitrary real (e.g. Gaussian) couplings, run
+// as NUM_LANES = 8 replicas of the same disorder realization in lock-step.
+// Spins are interleaved, spins_[i * NUM_LANES + lane], so the neighbor spins
+// of all lanes sit in one 8-byte word and each bond is loaded once for the
+// whole batch; the local fields of the 8 lanes are then one AVX-512 (or two
+// AVX2) vector of doubles. The site order is shared, but every lane draws its
+// own acceptance numbers, so replicas stay statistically independent. Where
+// the bonds are +/-J, MultiSpinEAModel packs 64 replicas instead.
+class BatchedEAModel {
+ public:
+  static constexpr int NUM_LANES = 8;
+
+  explicit BatchedEAModel(const SharedModelData<BatchedEAModel>& shared_data);
+  // Non-owning view onto stateBytes(shared_data) bytes of external storage,
+  // normally a ReplicaArena slot. All lanes are reset to +1.
+  BatchedEAModel(const SharedModelData<BatchedEAModel>& shared_data,
+                 void* state);
+  BatchedEAModel(BatchedEAModel&& other) noexcept;
+  BatchedEAModel(const BatchedEAModel&) = delete;
+  BatchedEAModel& operator=(const BatchedEAModel&) = delete;
+  ~BatchedEAModel();
+
+  // State footprint of one object (all lanes), used to size ReplicaArena slots.
+  static std::size_t stateBytes(
+      const SharedModelData<BatchedEAModel>& shared_data);
+  const void* stateData() const { return spins_; }
+  // Overwrites the state with stateBytes() bytes saved from stateData() and
+  // sets the running lane energies, when restoring a checkpoint.
+  void restoreState(const void* state, const double* energies);
+
+  void initializeState(gsl_rng* r);
+  // Copies spins, energy and genealogy of one replica into lane `lane` of
+  // this object.
+  void copyLaneFrom(int lane, const BatchedEAModel& other, int other_lane);
+
+  enum class UpdateMethod { metropolis, heat_bath };
+  enum class Observable { energy, magnetization };
+
+  // Running lane energies, updated by every accepted flip and carried by
+  // copyLaneFrom, so these are O(1) per lane.
+  double measureEnergy(int lane) const;
+  void measureEnergies(double* energies) const;
+  // Full recomputation for one lane, or for all lanes in one pass over the
+  // bonds.
+  double computeEnergy(int lane) const;
+  void computeEnergies(double* energies) const;
+  double measureMagnetization(int lane) const;
+  void measureMagnetizations(double* magnetizations) const;
+  // One value per lane of the given observable.
+  void measureObservables(Observable observable, double* values) const;
+
+  void updateSweep(int num_sweeps, double beta, gsl_rng* r, UpdateMethod method,
+                   bool sequential = false);
+  void updateSweep(int num_sweeps, double beta, RandomStream& r,
+                   UpdateMethod method, bool sequential = false);
+
+  std::vector<int> getState(int lane) const;
+
+  // Families can only be set once and are inherited via copyLaneFrom
+  void setFamily(int lane, int family) {
+    if (families_[lane] != -1) {
+      throw std::logic_error("family_ already set");
+    }
+    families_[lane] = family;
+  }
+  void setParent(int lane, int parent) { parents_[lane] = parent; }
+
+  int getFamily(int lane) const { return families_[lane]; }
+  int getParent(int lane) const { return parents_[lane]; }
+
+  // Helper methods for unit testing
+  void setSpin(int i, int lane, int val);
+  int getSpin(int i, int lane) const;
+
+ private:
+  // Shared model data, immutable
+  int num_spins_;
+  int num_neighbors_;
+  const int* neighbor_table_;
+  const double* bond_table_;
+  SimdLevel simd_level_;
+
+  // Interleaved spins, either owned or a view into a ReplicaArena slot
+  std::int8_t* spins_;
+  bool owns_state_;
+  std::array<int, NUM_LANES> families_;
+  std::array<int, NUM_LANES> parents_;
+  std::array<double, NUM_LANES> energies_;
+
+  // Rng is gsl_rng* or RandomStream (see Rng.hpp)
+  template <typename Rng>
+  void updateSweepImpl(int num_sweeps, double beta, Rng& r,
+                       UpdateMethod method, bool sequential);
+};
+
+#endif  // BATCHED_EA_MODEL_HPP
@@ -1,13 +1,98 @@
 #ifndef EA_3D_HELPERS_HPP
 #define EA_3D_HELPERS_HPP
 
+#include <cstddef>
+#include <cstdint>
 #include <vector>
 #include <string>
 
-// Load a 3D lattice neighbor table from file (same format as Ising3DHelpers)
+// Load a 3D lattice neighbor table from file (same format as Ising3DHelpers).
+// Throws std::runtime_error unless the file holds exactly num_spins *
+// num_neighbors entries, each a spin index in [0, num_spins).
 std::vector<int> loadNeighborTable(const std::string& filename, int num_spins, int num_neighbors);
 
-// Load bond values from file (each line = site, columns = bonds)
+// Load bond values from file (each line = site, columns = bonds). Throws
+// std::runtime_error unless the file holds exactly num_spins * num_neighbors
+// numbers.
 std::vector<double> loadBondTable(const std::string& filename, int num_spins, int num_neighbors);
 
-#endif  // EA_MODEL_3D_HELPERS_HPP
\ No newline at end of file
+// Binary instance file: the fixed header below, then the neighbor table
+// (num_spins * num_neighbors int32) and the bond table (as many float64),
+// each starting on an INSTANCE_ALIGNMENT boundary at the offset recorded in
+// the header. The tables have the layout of the text files, so InstanceFile
+// maps them straight into SharedModelData without parsing or copying.
+// Values are native-endian, like checkpoints.
+
+constexpr char INSTANCE_MAGIC[8] = {'P', 'A', 'M', 'C', 'I', 'N', 'S', 'T'};
+constexpr std::uint32_t INSTANCE_VERSION = 1;
+constexpr std::size_t INSTANCE_ALIGNMENT = 64;
+
+// Element types of the tables, recorded so that a reader can tell what it is
+// mapping. Only int32 neighbors and float64 bonds are written.
+enum class InstanceDtype : std::uint32_t { int32 = 1, float64 = 2 };
+
+struct InstanceHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t header_bytes;
+  std::int32_t system_size;
+  std::int32_t num_spins;
+  std::int32_t num_neighbors;
+  std::uint32_t neighbor_dtype;
+  std::uint32_t bond_dtype;
+  std::uint32_t reserved;
+  std::uint64_t neighbor_offset;
+  std::uint64_t bond_offset;
+  std::uint64_t file_bytes;
+};
+
+// Validates the tables (neighbor indices in range) and writes them as a
+// binary instance to path.
+void writeInstanceFile(const std::string& path, int system_size, int num_spins,
+                       int num_neighbors, const int* neighbor_table,
+                       const double* bond_table);
+
+// Converts the text tables read by loadNeighborTable/loadBondTable into a
+// binary instance.
+void convertTextInstance(const std::string& neighbor_path,
+                         const std::string& bond_path,
+                         const std::string& instance_path, int system_size,
+                         int num_spins, int num_neighbors);
+
+// True when path starts with INSTANCE_MAGIC.
+bool isInstanceFile(const std::string& path);
+
+// Read-only memory map of a binary instance. The constructor checks the
+// magic, version, table types and layout against the file size, and that
+// every neighbor index lies in [0, num_spins), and throws std::runtime_error
+// on a mismatch. The tables stay valid for the lifetime of the object and are
+// read from the page cache, so repeated loads of the same instance cost
+// neither parsing nor copying.
+class InstanceFile {
+ public:
+  explicit InstanceFile(const std::string& path);
+  ~InstanceFile();
+  InstanceFile(const InstanceFile&) = delete;
+  InstanceFile& operator=(const InstanceFile&) = delete;
+
+  const InstanceHeader& header() const {
+    return *static_cast<const InstanceHeader*>(data_);
+  }
+  int systemSize() const { return header().system_size; }
+  int numSpins() const { return header().num_spins; }
+  int numNeighbors() const { return header().num_neighbors; }
+  const int* neighborTable() const {
+    return reinterpret_cast<const int*>(static_cast<const unsigned char*>(data_) +
+                                        header().neighbor_offset);
+  }
+  const double* bondTable() const {
+    return reinterpret_cast<const double*>(
+        static_cast<const unsigned char*>(data_) + header().bond_offset);
+  }
+
+ private:
+  void* data_ = nullptr;
+  std::size_t size_ = 0;
+};
+
+#endif  // EA_MODEL_3D_HELPERS_HPP
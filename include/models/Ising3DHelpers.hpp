@@ -19,4 +19,20 @@ inline int index3D(int i, int j, int k, int system_size) {
 // spin has 6 neighbors.
 std::vector<int> initializeNeighborTable3D(int system_size);
 
+// Neighbor table of the periodic hypercubic lattice of side system_size in
+// the given dimension, with sites numbered like index3D (first coordinate
+// slowest). Neighbors 2d and 2d + 1 of a site are its -1 and +1 neighbors
+// along dimension d, so for dimension 3 this is initializeNeighborTable3D.
+std::vector<int> initializeNeighborTableND(int system_size, int dimension);
+
+// Orders of the sites of initializeNeighborTable3D(system_size) that keep
+// lattice neighbors close in memory, as order[k] = site placed at position k
+// (see SharedModelData<IsingModel>::relabeled). mortonOrder3D sorts the sites
+// by the interleaved bits of their coordinates (Z-order), for any L.
+// tiledOrder3D numbers tile^3 blocks in row-major order and the sites of each
+// block row-major within it; blocks at the far edges are cut short when tile
+// does not divide L.
+std::vector<int> mortonOrder3D(int system_size);
+std::vector<int> tiledOrder3D(int system_size, int tile);
+
 #endif  // ISING_3D_HELPERS_HPP
\ No newline at end of file
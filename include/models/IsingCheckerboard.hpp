@@ -0,0 +1,49 @@
+#ifndef ISING_CHECKERBOARD_HPP
+#define ISING_CHECKERBOARD_HPP
+
+#include <cstdint>
+
+// Checkerboard (two-sublattice) sweep kernels for IsingModel on the periodic
+// L x L x L cubic lattice built by initializeNeighborTable3D, with L even.
+// All sites of one color are independent given the other color, so each row
+// is updated in vector chunks with neighbor rows found from the lattice
+// strides instead of the neighbor table. Only int32 spins and discrete bonds
+// (see SharedModelData<IsingModel>::discrete_bonds) take this path.
+
+// Instruction set used by the kernels. Every level gives bit-identical
+// results: rows are processed in chunks of CHECKERBOARD_LANES sites and lane j
+// of a chunk always draws from random stream j.
+enum class SimdLevel { scalar, avx2, avx512 };
+
+// Best level supported by the running CPU.
+SimdLevel detectSimdLevel();
+
+constexpr int CHECKERBOARD_LANES = 16;
+
+// One xoshiro128++ stream per lane, stored lane-contiguous so the vector
+// kernels can step all of them at once.
+struct CheckerboardRng {
+  alignas(64) std::uint32_t state[4][CHECKERBOARD_LANES];
+  explicit CheckerboardRng(std::uint64_t seed);
+};
+
+struct CheckerboardLattice {
+  int system_size;
+  // Bond multiples (bond / bond_unit) stored per direction as [n * N + i],
+  // with n in the neighbor order of initializeNeighborTable3D. nullptr when
+  // all bonds are equal to uniform_bond * bond_unit.
+  const std::int32_t* direction_bonds;
+  int uniform_bond;
+  double bond_unit;
+  // Largest |local field| in units of bond_unit.
+  int max_field;
+};
+
+// Applies num_sweeps checkerboard sweeps of Metropolis or heat-bath updates.
+// Returns the sum of s_i * k_i (k_i the local field in units of bond_unit)
+// over all flipped spins, so the energy changed by 2 * bond_unit times that.
+long checkerboardSweep(std::int32_t* spins, const CheckerboardLattice& lattice,
+                       double beta, bool heat_bath, int num_sweeps,
+                       CheckerboardRng& rng, SimdLevel level);
+
+#endif  // ISING_CHECKERBOARD_HPP
@@ -3,52 +3,107 @@
 
 #include <gsl/gsl_rng.h>
 
+#include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <stdexcept>
 #include <vector>
 
 #include "Model.hpp"
+#include "Rng.hpp"
 #include "SharedModelData.hpp"
 
 class IsingModel : public Model {
  public:
   // IsingModel state related methods
   explicit IsingModel(const SharedModelData<IsingModel>& shared_data);
+  // Non-owning view onto stateBytes(shared_data) bytes of external storage,
+  // normally a ReplicaArena slot. The spins are reset to +1.
+  IsingModel(const SharedModelData<IsingModel>& shared_data, void* state);
+  IsingModel(IsingModel&& other) noexcept;
+  IsingModel(const IsingModel&) = delete;
+  IsingModel& operator=(const IsingModel&) = delete;
   ~IsingModel();
-  void initializeState(gsl_rng* r) override;
-  void copyStateFrom(const Model& other) override;
+  void initializeState(gsl_rng* r);
+  void copyStateFrom(const IsingModel& other);
 
   // IsingModel specific enumerated classes
-  enum class UpdateMethod { metropolis, heat_bath, wolff };
+  // The checkerboard methods sweep the two sublattices of an even cubic or
+  // implicit hypercubic lattice in turn (vectorized on the cubic lattice for
+  // int32 spins and discrete bonds, uniform ones if the lattice is implicit)
+  // and
+  // ignore the sequential flag. swendsen_wang does one multi-cluster update
+  // per sweep, itself parallelized over the OpenMP threads, and also ignores
+  // the sequential flag. n_fold_way is rejection-free random-site Metropolis
+  // (Bortz-Kalos-Lebowitz) for discrete bonds: it only draws the accepted
+  // flips, skipping the rejected attempts in between, and counts every
+  // attempt towards num_sweeps, so it samples the same dynamics as
+  // metropolis and is much cheaper when most proposals are rejected.
+  enum class UpdateMethod {
+    metropolis,
+    heat_bath,
+    wolff,
+    metropolis_checkerboard,
+    heat_bath_checkerboard,
+    swendsen_wang,
+    n_fold_way
+  };
+  // Methods whose sweeps run in parallel within one replica (see
+  // ModelSweepsInParallel in Model.hpp).
+  static bool sweepsInParallel(UpdateMethod method) {
+    return method == UpdateMethod::swendsen_wang;
+  }
   enum class Observable { energy, magnetization };
 
   // IsingModel observable methods
-  double measureEnergy() const override;
+  // Running energy, updated by every accepted move and carried by
+  // copyStateFrom, so this is O(1).
+  double measureEnergy() const;
+  // Full O(N z) recomputation from the spins.
+  double computeEnergy() const;
   double measureMagnetization() const;
+  // Value of the given observable, as measured by the methods above.
+  double measureObservable(Observable observable) const;
+  // Spin overlap q = sum_i s_i t_i with another replica of the same system.
+  double measureOverlap(const IsingModel& other) const;
 
   // Monte Carlo sweep methods.
   // By default uses metropolis updates on randomly selected spins
-  void updateSweep(int num_sweeps, double beta, gsl_rng* r) override {
+  void updateSweep(int num_sweeps, double beta, gsl_rng* r) {
     updateSweep(num_sweeps, beta, r, UpdateMethod::metropolis, false);
   }
   void updateSweep(int num_sweeps, double beta, gsl_rng* r, UpdateMethod method,
                    bool sequential = false);
-
-  const std::vector<int> getState() const { return std::vector<int>(spins_, spins_ + num_spins_); }
-
-  // Families can only be set once and is inherited via copyStateFrom
-  void setFamily(int family) {
-    if (family_ != -1) {
-      throw std::logic_error("family_ already set");
-    }
-    family_ = family;
-  }
-  void setParent(int parent) { parent_ = parent; }
-
-  int getFamily() const { return family_; }
-  int getParent() const { return parent_; }
-
-  // Helper methods for unit testing IsingModel class
+  void updateSweep(int num_sweeps, double beta, RandomStream& r,
+                   UpdateMethod method, bool sequential = false);
+
+  // Houdayer cluster move with another replica of the same system: grows the
+  // cluster of connected sites where the two replicas disagree from a random
+  // such site and swaps it between them (flips it in both). The sum of the
+  // two energies is unchanged, so the move is always accepted. Returns the
+  // cluster size, 0 when the replicas are identical.
+  int houdayerMove(IsingModel& other, gsl_rng* r);
+  int houdayerMove(IsingModel& other, RandomStream& r);
+
+  // Spins in the labelling of the neighbor table, also for a relabeled()
+  // lattice.
+  const std::vector<int> getState() const;
+  SpinStorage getSpinStorage() const { return spin_storage_; }
+
+  // Replica state footprint, used to size ReplicaArena slots.
+  static std::size_t stateBytes(const SharedModelData<IsingModel>& shared_data);
+  // Raw spins in the internal order of a relabeled() lattice; stateLayout
+  // fingerprints that order (0 when the spins keep the labels of the neighbor
+  // table), so that a checkpoint only restores into the same order.
+  const void* stateData() const { return spins_; }
+  static std::uint64_t stateLayout(
+      const SharedModelData<IsingModel>& shared_data);
+  // Overwrites the state with stateBytes() bytes saved from stateData() and
+  // sets the running energy, when restoring a checkpoint.
+  void restoreState(const void* state, double energy);
+
+  // Helper methods for unit testing IsingModel class, in the labelling of
+  // getState
   void setSpin(int i, int val);
   int getSpin(int i) const;
 
@@ -59,16 +114,72 @@ class IsingModel : public Model {
   const int system_size_;
   const int* neighbor_table_;
   const double* bond_table_;
-  int family_ = -1;
-  int parent_ = -1;
-
-  // Owned data
-  int* spins_;
-
-  // Monte Carlo update methods
-  void metropolis(gsl_rng* r, double beta, int i);
-  void heatBath(gsl_rng* r, double beta, int i);
-  int wolff(gsl_rng* r, double beta);
+  const SpinStorage spin_storage_;
+  const bool uniform_bonds_;
+  const double uniform_bond_;
+  // Integer-multiple couplings: local fields are k * bond_unit_ with
+  // |k| <= max_field_, and flip probabilities come from a lookup table.
+  const bool discrete_bonds_;
+  const double bond_unit_;
+  const double inv_bond_unit_;
+  const int max_field_;
+  const bool cubic_lattice_;
+  const std::int32_t* direction_bonds_;
+  // Implicit hypercubic lattice (see SharedModelData<IsingModel>::
+  // hypercubic()): its dimension, 0 with a neighbor table, and bonds.
+  const int lattice_dimension_;
+  const double* lattice_bonds_;
+  // Internal labelling of a relabeled() lattice, nullptr when the spins keep
+  // the labels of the neighbor table.
+  const int* order_;
+  const int* label_;
+
+  // Replica state, either owned or a view into a ReplicaArena slot. Layout
+  // depends on spin_storage_: int32_t[num_spins_], int8_t[num_spins_] or
+  // uint64_t words with bit i set when spin i is -1.
+  void* spins_;
+  std::size_t state_bytes_;
+  bool owns_state_;
+  double energy_ = 0.0;
+
+  // Order in which singleSpinSweeps visits the sites.
+  enum class SiteOrder { random, sequential, checkerboard };
+
+  // Monte Carlo update methods, instantiated for each spin storage type and
+  // for each generator (gsl_rng* or RandomStream, see Rng.hpp)
+  template <typename Spins, typename Rng>
+  void updateSweepImpl(int num_sweeps, double beta, Rng& r,
+                       UpdateMethod method, bool sequential);
+  // Metropolis or heat bath sweeps. Picks the kernel below matching the
+  // topology, bond type and coordination number once per call.
+  template <typename Spins, typename Rng>
+  void singleSpinSweeps(int num_sweeps, double beta, Rng& r, bool heat_bath,
+                        SiteOrder order);
+  // Topology is a neighbor policy (neighbor table or implicit lattice of
+  // compile-time dimension), Bonds a bond policy (uniform, discrete or
+  // continuous) and Z the number of neighbors, or 0 for num_neighbors_ read
+  // at run time.
+  template <typename Spins, typename Topology, typename Bonds, int Z,
+            bool HeatBath, typename Rng>
+  void singleSpinKernel(const Topology& topology, int num_sweeps, double beta,
+                        Rng& r, SiteOrder order);
+  // Calls f with the neighbor policy of the other updates and measurements.
+  template <typename F>
+  decltype(auto) withTopology(F&& f) const;
+  template <typename Spins, typename Rng>
+  void checkerboardSweep(int num_sweeps, double beta, Rng& r, bool heat_bath);
+  // add_probabilities is indexed by bond magnitude in units of bond_unit_
+  // for discrete bonds, and nullptr otherwise.
+  template <typename Spins, typename Rng>
+  int wolff(Rng& r, double beta, const double* add_probabilities);
+  template <typename Spins, typename Rng>
+  void swendsenWang(Rng& r, double beta, const double* add_probabilities);
+  template <typename Spins, typename Rng>
+  void nFoldWay(int num_sweeps, double beta, Rng& r);
+  template <typename Spins, typename Rng>
+  int houdayerMoveImpl(IsingModel& other, Rng& r);
+  template <typename Spins>
+  double computeEnergyImpl() const;
 
   // Helper functions
 };
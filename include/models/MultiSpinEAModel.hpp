@@ -0,0 +1,116 @@
+#ifndef MULTI_SPIN_EA_MODEL_HPP
+#define MULTI_SPIN_EA_MODEL_HPP
+
+#include <gsl/gsl_rng.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "Model.hpp"
+#include "Rng.hpp"
+#include "SharedModelData.hpp"
+
+// Multi-spin-coded +/-J Ising / Edwards-Anderson model.
+// One object holds NUM_LANES = 64 independent replicas of the same disorder
+// realization: bit k of spins_[i] is spin i of replica (lane) k, with a set bit
+// meaning s = -1. A single sweep updates all 64 replicas with bitwise logic:
+// the number of unsatisfied bonds around a site is accumulated in bit-sliced
+// counters, and the acceptance test compares a per-lane random number against
+// the per-lane Boltzmann threshold bit by bit, stopping as soon as every lane
+// is decided. Each lane draws its own random bits, so replicas stay
+// statistically independent; only the order of visited sites is shared.
+class MultiSpinEAModel {
+ public:
+  static constexpr int NUM_LANES = 64;
+
+  explicit MultiSpinEAModel(const SharedModelData<MultiSpinEAModel>& shared_data);
+  // Non-owning view onto stateBytes(shared_data) bytes of external storage,
+  // normally a ReplicaArena slot. All lanes are reset to +1.
+  MultiSpinEAModel(const SharedModelData<MultiSpinEAModel>& shared_data,
+                   void* state);
+  MultiSpinEAModel(MultiSpinEAModel&& other) noexcept;
+  MultiSpinEAModel(const MultiSpinEAModel&) = delete;
+  MultiSpinEAModel& operator=(const MultiSpinEAModel&) = delete;
+  ~MultiSpinEAModel();
+
+  // State footprint of one object (all lanes), used to size ReplicaArena slots.
+  static std::size_t stateBytes(
+      const SharedModelData<MultiSpinEAModel>& shared_data);
+  const void* stateData() const { return spins_; }
+  // Overwrites the state with stateBytes() bytes saved from stateData() and
+  // sets the running lane energies, when restoring a checkpoint.
+  void restoreState(const void* state, const double* energies);
+
+  void initializeState(gsl_rng* r);
+  // Copies spins and genealogy of one replica into lane `lane` of this object.
+  void copyLaneFrom(int lane, const MultiSpinEAModel& other, int other_lane);
+
+  enum class UpdateMethod { metropolis, heat_bath };
+  enum class Observable { energy, magnetization };
+
+  // Lane energies are cached at the end of every sweep and carried by
+  // copyLaneFrom, so these are O(1) per lane.
+  double measureEnergy(int lane) const;
+  void measureEnergies(double* energies) const;
+  // Full recomputation for one lane, or for all lanes in one bit-sliced pass
+  // over the bonds.
+  double computeEnergy(int lane) const;
+  void computeEnergies(double* energies) const;
+  double measureMagnetization(int lane) const;
+  // Magnetizations of all lanes in one bit-sliced pass over the spins.
+  void measureMagnetizations(double* magnetizations) const;
+  // One value per lane of the given observable.
+  void measureObservables(Observable observable, double* values) const;
+
+  void updateSweep(int num_sweeps, double beta, gsl_rng* r, UpdateMethod method,
+                   bool sequential = false);
+  void updateSweep(int num_sweeps, double beta, RandomStream& r,
+                   UpdateMethod method, bool sequential = false);
+
+  std::vector<int> getState(int lane) const;
+
+  // Families can only be set once and are inherited via copyLaneFrom
+  void setFamily(int lane, int family) {
+    if (families_[lane] != -1) {
+      throw std::logic_error("family_ already set");
+    }
+    families_[lane] = family;
+  }
+  void setParent(int lane, int parent) { parents_[lane] = parent; }
+
+  int getFamily(int lane) const { return families_[lane]; }
+  int getParent(int lane) const { return parents_[lane]; }
+
+  // Helper methods for unit testing
+  void setSpin(int i, int lane, int val);
+  int getSpin(int i, int lane) const;
+
+ private:
+  // Shared model data, immutable
+  int num_spins_;
+  int num_neighbors_;
+  int num_planes_;  // bit-sliced counter width, enough to hold num_neighbors_
+  const int* neighbor_table_;
+  const std::uint64_t* bond_masks_;
+  double bond_magnitude_;
+
+  // Spin words, either owned or a view into a ReplicaArena slot
+  std::uint64_t* spins_;
+  bool owns_state_;
+  std::array<int, NUM_LANES> families_;
+  std::array<int, NUM_LANES> parents_;
+  std::array<double, NUM_LANES> energies_;
+
+  // Engine is Xoshiro256 or RandomStream (bits64() and uniformInt(n)).
+  template <typename Engine>
+  void updateSweepImpl(int num_sweeps, double beta, Engine& rng,
+                       UpdateMethod method, bool sequential);
+  // Flip probability for each count of unsatisfied bonds, 0..num_neighbors_.
+  void computeFlipProbabilities(double beta, UpdateMethod method,
+                                double* probabilities) const;
+};
+
+#endif  // MULTI_SPIN_EA_MODEL_HPP
@@ -0,0 +1,100 @@
+#ifndef SK_MODEL_HPP
+#define SK_MODEL_HPP
+
+#include <gsl/gsl_rng.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "Model.hpp"
+#include "Rng.hpp"
+#include "SharedModelData.hpp"
+#include "models/IsingCheckerboard.hpp"
+
+// Fully connected Ising spin glass (Sherrington-Kirkpatrick and any other
+// dense coupling matrix, see SharedModelData<SKModel>). Each replica keeps
+// its local fields h_i = sum_j J_ij s_j next to the spins, so a proposal costs
+// O(1) and only an accepted flip of spin k touches the matrix: h += -2 s_k J_k,
+// one AXPY over row k, vectorized with AVX2/AVX-512 when the CPU has them.
+// Since the scale is +/-2 every instruction set gives the same fields.
+class SKModel : public Model {
+ public:
+  explicit SKModel(const SharedModelData<SKModel>& shared_data);
+  // Non-owning view onto stateBytes(shared_data) bytes of external storage,
+  // normally a ReplicaArena slot. The spins are reset to +1.
+  SKModel(const SharedModelData<SKModel>& shared_data, void* state);
+  SKModel(SKModel&& other) noexcept;
+  SKModel(const SKModel&) = delete;
+  SKModel& operator=(const SKModel&) = delete;
+  ~SKModel();
+
+  // Local fields (one padded row) followed by the int8 spins, used to size
+  // ReplicaArena slots.
+  static std::size_t stateBytes(const SharedModelData<SKModel>& shared_data);
+  const void* stateData() const { return state_; }
+  // Overwrites the state with stateBytes() bytes saved from stateData() and
+  // sets the running energy, when restoring a checkpoint.
+  void restoreState(const void* state, double energy);
+
+  void initializeState(gsl_rng* r);
+  void copyStateFrom(const SKModel& other);
+
+  enum class UpdateMethod { metropolis, heat_bath };
+  enum class Observable { energy, magnetization };
+
+  // Running energy, updated by every accepted flip and carried by
+  // copyStateFrom, so this is O(1).
+  double measureEnergy() const;
+  // Recomputation from the local fields, O(N).
+  double computeEnergy() const;
+  double measureMagnetization() const;
+  double measureObservable(Observable observable) const;
+  // Spin overlap q = sum_i s_i t_i with another replica of the same system.
+  double measureOverlap(const SKModel& other) const;
+
+  // With float32 couplings the fields are rebuilt from the spins at the end
+  // of every call, so rounding does not accumulate across a run.
+  void updateSweep(int num_sweeps, double beta, gsl_rng* r, UpdateMethod method,
+                   bool sequential = false);
+  void updateSweep(int num_sweeps, double beta, RandomStream& r,
+                   UpdateMethod method, bool sequential = false);
+
+  std::vector<int> getState() const;
+
+  // Helper methods for unit testing
+  void setSpin(int i, int val);
+  int getSpin(int i) const;
+  double getLocalField(int i) const;
+
+ private:
+  // Shared model data, immutable
+  const int num_spins_;
+  const int row_stride_;
+  const CouplingPrecision precision_;
+  const double* couplings_;
+  const float* couplings_f32_;
+  const SimdLevel simd_level_;
+
+  // Replica state, either owned or a view into a ReplicaArena slot:
+  // fields_ (row_stride_ doubles or floats) then spins_ (int8).
+  void* state_;
+  std::size_t state_bytes_;
+  bool owns_state_;
+  void* fields_;
+  std::int8_t* spins_;
+  double energy_ = 0.0;
+
+  // T is the coupling precision, Rng gsl_rng* or RandomStream (see Rng.hpp)
+  template <typename T, typename Rng>
+  void updateSweepImpl(int num_sweeps, double beta, Rng& r,
+                       UpdateMethod method, bool sequential);
+  template <typename T>
+  void flipSpin(int k);
+  // Rebuilds the local fields and the energy from the spins.
+  template <typename T>
+  void refreshFields();
+};
+
+#endif  // SK_MODEL_HPP
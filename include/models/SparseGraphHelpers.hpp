@@ -0,0 +1,15 @@
+#ifndef SPARSE_GRAPH_HELPERS_HPP
+#define SPARSE_GRAPH_HELPERS_HPP
+
+#include <vector>
+
+// Reverse Cuthill-McKee ordering of an undirected graph in CSR form (every
+// edge listed in both rows). Returns order with order[k] the vertex placed at
+// position k. Each connected component is numbered by a breadth-first search
+// from a vertex of minimum degree, visiting neighbors in increasing degree,
+// which keeps the neighbors of consecutive vertices close together.
+std::vector<int> reverseCuthillMcKee(int num_vertices,
+                                     const std::vector<long>& row_offsets,
+                                     const std::vector<int>& column_indices);
+
+#endif  // SPARSE_GRAPH_HELPERS_HPP
@@ -0,0 +1,95 @@
+#ifndef SPARSE_ISING_MODEL_HPP
+#define SPARSE_ISING_MODEL_HPP
+
+#include <gsl/gsl_rng.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "Model.hpp"
+#include "Rng.hpp"
+#include "SharedModelData.hpp"
+
+// Ising model on an arbitrary sparse graph with variable degree and optional
+// local fields, e.g. QUBO, Max-Cut or Chimera/Pegasus-like instances (see
+// SharedModelData<SparseIsingModel>). The kernels walk the CSR rows of the
+// internal (reordered) labelling; sequential sweeps visit spins in that order,
+// so consecutive updates touch nearby spins. Spin indices in getState,
+// setSpin and getSpin are the original labels.
+class SparseIsingModel : public Model {
+ public:
+  explicit SparseIsingModel(
+      const SharedModelData<SparseIsingModel>& shared_data);
+  // Non-owning view onto stateBytes(shared_data) bytes of external storage,
+  // normally a ReplicaArena slot. The spins are reset to +1.
+  SparseIsingModel(const SharedModelData<SparseIsingModel>& shared_data,
+                   void* state);
+  SparseIsingModel(SparseIsingModel&& other) noexcept;
+  SparseIsingModel(const SparseIsingModel&) = delete;
+  SparseIsingModel& operator=(const SparseIsingModel&) = delete;
+  ~SparseIsingModel();
+
+  // int8 spins, used to size ReplicaArena slots.
+  static std::size_t stateBytes(
+      const SharedModelData<SparseIsingModel>& shared_data);
+  const void* stateData() const { return spins_; }
+  // Overwrites the state with stateBytes() bytes saved from stateData() and
+  // sets the running energy, when restoring a checkpoint.
+  void restoreState(const void* state, double energy);
+
+  void initializeState(gsl_rng* r);
+  void copyStateFrom(const SparseIsingModel& other);
+
+  enum class UpdateMethod { metropolis, heat_bath };
+  enum class Observable { energy, magnetization };
+
+  // Running energy, updated by every accepted flip and carried by
+  // copyStateFrom, so this is O(1).
+  double measureEnergy() const;
+  // Full recomputation from the spins, one pass over every row.
+  double computeEnergy() const;
+  double measureMagnetization() const;
+  double measureObservable(Observable observable) const;
+  // Spin overlap q = sum_i s_i t_i with another replica of the same system.
+  double measureOverlap(const SparseIsingModel& other) const;
+
+  void updateSweep(int num_sweeps, double beta, gsl_rng* r, UpdateMethod method,
+                   bool sequential = false);
+  void updateSweep(int num_sweeps, double beta, RandomStream& r,
+                   UpdateMethod method, bool sequential = false);
+
+  // Spins in the original labelling.
+  std::vector<int> getState() const;
+
+  // Helper methods for unit testing, in the original labelling
+  void setSpin(int i, int val);
+  int getSpin(int i) const;
+
+ private:
+  // Shared model data, immutable
+  const int num_spins_;
+  const long* row_offsets_;
+  const int* column_indices_;
+  const double* weights_;
+  const double* fields_;  // nullptr without local fields
+  const double energy_offset_;
+  const int* order_;
+  const int* label_;
+
+  // Replica state, either owned or a view into a ReplicaArena slot, indexed
+  // by internal label.
+  std::int8_t* spins_;
+  bool owns_state_;
+  double energy_ = 0.0;
+
+  // Rng is gsl_rng* or RandomStream (see Rng.hpp)
+  template <typename Rng>
+  void updateSweepImpl(int num_sweeps, double beta, Rng& r,
+                       UpdateMethod method, bool sequential);
+  // Field acting on internal spin i: h_i + sum_j J_ij s_j.
+  double localField(int i) const;
+};
+
+#endif  // SPARSE_ISING_MODEL_HPP
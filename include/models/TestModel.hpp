@@ -5,12 +5,14 @@
 
 #include <stdexcept>
 #include "Model.hpp"
+#include "Rng.hpp"
 #include "SharedModelData.hpp"
 
-class TestModel {
+class TestModel : public Model {
  public:
   TestModel(const SharedModelData<TestModel>&) {}
   enum class UpdateMethod { FAKE_LOW, FAKE_MID, FAKE_HIGH };
+  enum class Observable { energy };
 
   void initializeState(gsl_rng* r) {
     state_initialized = true;
@@ -18,7 +20,9 @@ class TestModel {
   }
 
   // void updateSweep(int num_sweeps, UpdateMethod method, double /*beta*/, gsl_rng* r) {
-  void updateSweep(int num_sweeps, double /*beta*/, gsl_rng* r,
+  // Rng is gsl_rng* or RandomStream (see Rng.hpp)
+  template <typename Rng>
+  void updateSweep(int num_sweeps, double /*beta*/, Rng&& r,
                              UpdateMethod method, bool /*sequential*/) {
     for (int i = 0; i < num_sweeps; ++i) {
       updates_called_ += 1;
@@ -26,13 +30,13 @@ class TestModel {
 
     switch (method) {
       case UpdateMethod::FAKE_LOW:
-        energy_ = gsl_rng_uniform(r);             // [0,1)
+        energy_ = rngUniform(r);                  // [0,1)
         break;
       case UpdateMethod::FAKE_MID:
-        energy_ = 1.0 + gsl_rng_uniform(r);       // [1,2)
+        energy_ = 1.0 + rngUniform(r);            // [1,2)
         break;
       case UpdateMethod::FAKE_HIGH:
-        energy_ = 2.0 + gsl_rng_uniform(r);       // [2,3)
+        energy_ = 2.0 + rngUniform(r);            // [2,3)
         break;
       default:
         throw std::invalid_argument("Unknown update method in TestModel");
@@ -43,6 +47,10 @@ class TestModel {
     return energy_;
   }
 
+  double measureObservable(Observable) const {
+    return energy_;
+  }
+
   double getState() const {
     return energy_;
   }
@@ -51,29 +59,16 @@ class TestModel {
     energy_ = other.energy_;
     updates_called_ = other.updates_called_;
     state_initialized = other.state_initialized;
-    family_ = other.family_;
-    parent_ = other.parent_;
+    copyGenealogyFrom(other);
   }
 
   void setState(double energy) { energy_ = energy; }
-  void setFamily(int family) {
-    if (family_ != -1) {
-      throw std::logic_error("family_ already set");
-    }
-    family_ = family;
-  }
-  void setParent(int parent) { parent_ = parent; }
-
-  int getFamily() const { return family_; }
-  int getParent() const { return parent_; }
 
   bool state_initialized = false;
   int updates_called_ = 0;
 
  private:
   double energy_ = 0.0;
-  int family_ = -1;
-  int parent_ = -1;
 };
 
 #endif  // TEST_MODEL_HPP
\ No newline at end of file
@@ -0,0 +1,131 @@
+#include "Checkpoint.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+std::uint64_t alignUp(std::uint64_t bytes) {
+  return (bytes + CHECKPOINT_ALIGNMENT - 1) / CHECKPOINT_ALIGNMENT *
+         CHECKPOINT_ALIGNMENT;
+}
+
+std::runtime_error ioError(const std::string& what, const std::string& path) {
+  return std::runtime_error(what + " " + path + ": " + std::strerror(errno));
+}
+
+}  // namespace
+
+void layoutCheckpoint(CheckpointHeader& header) {
+  const std::uint64_t num_lanes =
+      static_cast<std::uint64_t>(header.num_models) * header.lanes;
+  std::uint64_t offset = alignUp(sizeof(CheckpointHeader));
+  auto place = [&](std::uint64_t bytes) {
+    const std::uint64_t start = offset;
+    offset = alignUp(offset + bytes);
+    return start;
+  };
+  header.rng_state_offset = place(header.rng_state_bytes);
+  header.lane_energies_offset = place(num_lanes * sizeof(double));
+  header.energies_offset =
+      place(static_cast<std::uint64_t>(header.pop_size) * sizeof(double));
+  header.families_offset = place(num_lanes * sizeof(std::int32_t));
+  header.parents_offset = place(num_lanes * sizeof(std::int32_t));
+  header.states_offset = place(0);
+  header.file_bytes =
+      header.states_offset +
+      static_cast<std::uint64_t>(header.num_models) * header.state_bytes;
+}
+
+void writeCheckpointFile(const std::string& path, const void* data,
+                         std::size_t bytes) {
+  const std::string tmp_path = path + ".tmp";
+  const int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    throw ioError("Cannot create checkpoint", tmp_path);
+  }
+  const char* p = static_cast<const char*>(data);
+  while (bytes > 0) {
+    const ssize_t written = ::write(fd, p, bytes);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      ::close(fd);
+      throw ioError("Cannot write checkpoint", tmp_path);
+    }
+    p += written;
+    bytes -= static_cast<std::size_t>(written);
+  }
+  if (::fsync(fd) != 0) {
+    ::close(fd);
+    throw ioError("Cannot flush checkpoint", tmp_path);
+  }
+  if (::close(fd) != 0) {
+    throw ioError("Cannot close checkpoint", tmp_path);
+  }
+  if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+    throw ioError("Cannot rename checkpoint to", path);
+  }
+}
+
+CheckpointFile::CheckpointFile(const std::string& path) {
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw ioError("Cannot open checkpoint", path);
+  }
+  struct stat st;
+  if (::fstat(fd, &st) != 0) {
+    ::close(fd);
+    throw ioError("Cannot stat checkpoint", path);
+  }
+  size_ = static_cast<std::size_t>(st.st_size);
+  if (size_ < sizeof(CheckpointHeader)) {
+    ::close(fd);
+    throw std::runtime_error("Checkpoint " + path + " is truncated");
+  }
+  data_ = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (data_ == MAP_FAILED) {
+    data_ = nullptr;
+    throw ioError("Cannot map checkpoint", path);
+  }
+  ::madvise(data_, size_, MADV_SEQUENTIAL);
+
+  const CheckpointHeader& stored = header();
+  std::string problem;
+  if (std::memcmp(stored.magic, CHECKPOINT_MAGIC, sizeof(stored.magic)) != 0) {
+    problem = "is not a checkpoint";
+  } else if (stored.version != CHECKPOINT_VERSION) {
+    problem = "has version " + std::to_string(stored.version) + ", expected " +
+              std::to_string(CHECKPOINT_VERSION);
+  } else if (stored.header_bytes != sizeof(CheckpointHeader)) {
+    problem = "has an unexpected header size";
+  } else {
+    CheckpointHeader expected = stored;
+    layoutCheckpoint(expected);
+    if (std::memcmp(&expected, &stored, sizeof(CheckpointHeader)) != 0) {
+      problem = "has an inconsistent layout";
+    } else if (stored.file_bytes != size_) {
+      problem = "is truncated";
+    }
+  }
+  if (!problem.empty()) {
+    ::munmap(data_, size_);
+    data_ = nullptr;
+    throw std::runtime_error("Checkpoint " + path + " " + problem);
+  }
+}
+
+CheckpointFile::~CheckpointFile() {
+  if (data_ != nullptr) {
+    ::munmap(data_, size_);
+  }
+}
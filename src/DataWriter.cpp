@@ -0,0 +1,278 @@
+#include "DataWriter.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <utility>
+
+namespace {
+
+const char* typeName(DataWriter::ColumnType type) {
+  switch (type) {
+    case DataWriter::ColumnType::float64:
+      return "float64";
+    case DataWriter::ColumnType::int64:
+      return "int64";
+    case DataWriter::ColumnType::int32:
+      return "int32";
+    case DataWriter::ColumnType::int8:
+      return "int8";
+  }
+  return "";
+}
+
+std::size_t typeBytes(DataWriter::ColumnType type) {
+  switch (type) {
+    case DataWriter::ColumnType::float64:
+    case DataWriter::ColumnType::int64:
+      return 8;
+    case DataWriter::ColumnType::int32:
+      return 4;
+    case DataWriter::ColumnType::int8:
+      return 1;
+  }
+  return 0;
+}
+
+std::FILE* openFile(const std::string& path) {
+  std::FILE* file = std::fopen(path.c_str(), "wb");
+  if (file == nullptr) {
+    throw std::runtime_error("Cannot open " + path + ": " +
+                             std::strerror(errno));
+  }
+  return file;
+}
+
+void writeBytes(std::FILE* file, const void* data, std::size_t bytes,
+                const std::string& name) {
+  if (bytes > 0 && std::fwrite(data, 1, bytes, file) != bytes) {
+    throw std::runtime_error("Cannot write column " + name);
+  }
+}
+
+}  // namespace
+
+DataWriter::DataWriter(const std::string& directory) : directory_(directory) {
+  std::filesystem::create_directories(directory_);
+}
+
+DataWriter::~DataWriter() {
+  try {
+    close();
+  } catch (...) {
+  }
+}
+
+int DataWriter::addScalar(const std::string& name, ColumnType type) {
+  return addColumn(name, false, type);
+}
+
+int DataWriter::addArray(const std::string& name, ColumnType type) {
+  return addColumn(name, true, type);
+}
+
+int DataWriter::addColumn(const std::string& name, bool array,
+                          ColumnType type) {
+  if (started_ || closed_) {
+    throw std::logic_error("Columns must be added before the first step");
+  }
+  if (name.empty() || name.find_first_of("/\\\"") != std::string::npos) {
+    throw std::invalid_argument("Invalid column name '" + name + "'");
+  }
+  for (const Column& column : columns_) {
+    if (column.name == name) {
+      throw std::invalid_argument("Duplicate column " + name);
+    }
+  }
+  columns_.push_back({name, array, type, typeBytes(type)});
+  current_.emplace_back();
+  scalar_set_.push_back(false);
+  return static_cast<int>(columns_.size()) - 1;
+}
+
+void DataWriter::storeScalar(int column, const void* value) {
+  const auto* bytes = static_cast<const unsigned char*>(value);
+  current_[column].assign(bytes, bytes + columns_[column].element_bytes);
+  scalar_set_[column] = true;
+}
+
+// Opens every column file and writes the schema, which is fixed from here on.
+void DataWriter::start() {
+  const std::filesystem::path dir(directory_);
+  std::string columns_json;
+  for (Column& column : columns_) {
+    const std::string file = column.name + ".bin";
+    column.values = openFile((dir / file).string());
+    if (!columns_json.empty()) {
+      columns_json += ",\n";
+    }
+    columns_json += "    {\"name\": \"" + column.name + "\", \"kind\": \"" +
+                    (column.array ? "array" : "scalar") + "\", \"type\": \"" +
+                    typeName(column.type) + "\", \"file\": \"" + file + "\"";
+    if (column.array) {
+      const std::string offsets = column.name + ".offsets.bin";
+      column.offsets = openFile((dir / offsets).string());
+      writeBytes(column.offsets, &column.total, sizeof(column.total),
+                 column.name);
+      columns_json += ", \"offsets\": \"" + offsets + "\"";
+    }
+    columns_json += "}";
+  }
+
+  const std::uint16_t probe = 1;
+  const bool little = *reinterpret_cast<const unsigned char*>(&probe) == 1;
+  const std::string schema =
+      std::string("{\n  \"format\": \"pamc-columnar\",\n  \"version\": 1,\n") +
+      "  \"byte_order\": \"" + (little ? "little" : "big") + "\",\n" +
+      "  \"columns\": [\n" + columns_json + "\n  ]\n}\n";
+  std::FILE* schema_file = openFile((dir / "schema.json").string());
+  const bool ok = std::fwrite(schema.data(), 1, schema.size(), schema_file) ==
+                  schema.size();
+  if (std::fclose(schema_file) != 0 || !ok) {
+    throw std::runtime_error("Cannot write " + (dir / "schema.json").string());
+  }
+
+  started_ = true;
+  thread_ = std::thread(&DataWriter::run, this);
+}
+
+void DataWriter::endStep() {
+  if (closed_) {
+    throw std::logic_error("DataWriter is closed");
+  }
+  if (!started_) {
+    start();
+  }
+  rethrowError();
+  for (std::size_t c = 0; c < columns_.size(); ++c) {
+    if (!columns_[c].array && !scalar_set_[c]) {
+      if (columns_[c].type == ColumnType::float64) {
+        const double nan = std::numeric_limits<double>::quiet_NaN();
+        storeScalar(static_cast<int>(c), &nan);
+      } else {
+        current_[c].assign(columns_[c].element_bytes, 0);
+      }
+    }
+    scalar_set_[c] = false;
+  }
+  Step step(columns_.size());
+  std::swap(step, current_);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue_.push_back(std::move(step));
+  }
+  ready_.notify_one();
+  ++num_steps_;
+}
+
+void DataWriter::flush() {
+  if (!started_) {
+    return;
+  }
+  std::unique_lock<std::mutex> lock(mutex_);
+  drained_.wait(lock, [&] { return queue_.empty() && !writing_; });
+  // The writer thread is idle while the lock is held. Buffered writes can
+  // first fail here, e.g. on a full disk, so a failed flush counts as a
+  // write error of its column.
+  for (Column& column : columns_) {
+    bool ok = std::fflush(column.values) == 0;
+    if (column.offsets != nullptr) {
+      ok &= std::fflush(column.offsets) == 0;
+    }
+    if (!ok && error_ == nullptr) {
+      error_ = std::make_exception_ptr(
+          std::runtime_error("Cannot write column " + column.name));
+    }
+  }
+  lock.unlock();
+  rethrowError();
+}
+
+// The writer thread drains the queue before it stops, and errors are only
+// rethrown once it has been joined and the files closed.
+void DataWriter::close() {
+  if (closed_) {
+    return;
+  }
+  if (!started_) {
+    start();
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  ready_.notify_one();
+  thread_.join();
+  closed_ = true;
+  bool ok = true;
+  for (Column& column : columns_) {
+    ok &= std::fclose(column.values) == 0;
+    if (column.offsets != nullptr) {
+      ok &= std::fclose(column.offsets) == 0;
+    }
+  }
+  rethrowError();
+  if (!ok) {
+    throw std::runtime_error("Cannot close the columns in " + directory_);
+  }
+}
+
+// Writer thread: takes all queued steps at once and writes them with the
+// lock released. After an error it keeps draining the queue without writing,
+// so flush() and close() still return.
+void DataWriter::run() {
+  std::vector<Step> batch;
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    ready_.wait(lock, [&] { return !queue_.empty() || stopping_; });
+    if (queue_.empty()) {
+      return;
+    }
+    std::swap(batch, queue_);
+    writing_ = true;
+    const bool failed = error_ != nullptr;
+    lock.unlock();
+    std::exception_ptr error;
+    if (!failed) {
+      try {
+        for (const Step& step : batch) {
+          writeStep(step);
+        }
+      } catch (...) {
+        error = std::current_exception();
+      }
+    }
+    batch.clear();
+    lock.lock();
+    if (error != nullptr) {
+      error_ = error;
+    }
+    writing_ = false;
+    drained_.notify_all();
+  }
+}
+
+void DataWriter::writeStep(const Step& step) {
+  for (std::size_t c = 0; c < columns_.size(); ++c) {
+    Column& column = columns_[c];
+    writeBytes(column.values, step[c].data(), step[c].size(), column.name);
+    if (column.array) {
+      column.total +=
+          static_cast<std::int64_t>(step[c].size() / column.element_bytes);
+      writeBytes(column.offsets, &column.total, sizeof(column.total),
+                 column.name);
+    }
+  }
+}
+
+void DataWriter::rethrowError() {
+  std::exception_ptr error;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    error = error_;
+  }
+  if (error != nullptr) {
+    std::rethrow_exception(error);
+  }
+}
@@ -0,0 +1,349 @@
+#include "models/BatchedEAModel.hpp"
+
+#include <gsl/gsl_rng.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+#include "ReplicaArena.hpp"
+
+namespace {
+
+constexpr int LANES = BatchedEAModel::NUM_LANES;
+
+// Read-only view of one object for the sweep kernels.
+struct BatchedLattice {
+  int num_spins;
+  int num_neighbors;
+  const int* neighbor_table;
+  const double* bond_table;
+};
+
+// Local fields h[lane] = sum_n J_in s_jn[lane] of site i in every lane: one
+// bond load and one vector multiply-add per neighbor for the whole batch.
+__attribute__((always_inline)) inline void laneFields(
+    const BatchedLattice& lattice, const std::int8_t* spins, int i,
+    double* __restrict h) {
+  const int z = lattice.num_neighbors;
+  const int* neighbors = lattice.neighbor_table + i * z;
+  const double* bonds = lattice.bond_table + i * z;
+  #pragma omp simd
+  for (int lane = 0; lane < LANES; ++lane) {
+    h[lane] = 0.0;
+  }
+  for (int n = 0; n < z; ++n) {
+    const double J = bonds[n];
+    const std::int8_t* s = spins + neighbors[n] * LANES;
+    #pragma omp simd
+    for (int lane = 0; lane < LANES; ++lane) {
+      h[lane] += J * s[lane];
+    }
+  }
+}
+
+// Sweeps of every lane with a shared site order. The local fields of all
+// lanes come from one vector pass; each lane then draws its own uniform and
+// decides its flip. The bounds 1 - x <= exp(-x) <= 1 / (1 + x) settle most
+// Metropolis proposals without calling exp.
+template <bool HeatBath, typename Rng>
+__attribute__((always_inline)) inline void sweepBody(
+    const BatchedLattice& lattice, std::int8_t* spins, double* energies,
+    int num_sweeps, double beta, Rng& r, bool sequential) {
+  alignas(64) double h[LANES];
+  double energy[LANES];
+  std::copy(energies, energies + LANES, energy);
+
+  auto update_site = [&](int i) {
+    laneFields(lattice, spins, i, h);
+    std::int8_t* s = spins + i * LANES;
+    for (int lane = 0; lane < LANES; ++lane) {
+      const double delta_E = 2.0 * s[lane] * h[lane];
+      bool flip;
+      if constexpr (HeatBath) {
+        const double prob_up = 1 / (1 + std::exp(-2 * beta * h[lane]));
+        flip = (rngUniform(r) < prob_up) != (s[lane] > 0);
+      } else if (delta_E <= 0.0) {
+        flip = true;
+      } else {
+        const double x = beta * delta_E;
+        const double u = rngUniform(r);
+        flip = u < 1 - x || (u * (1 + x) < 1 && u < std::exp(-x));
+      }
+      if (flip) {
+        s[lane] = static_cast<std::int8_t>(-s[lane]);
+        energy[lane] += delta_E;
+      }
+    }
+  };
+
+  for (int sweep = 0; sweep < num_sweeps; ++sweep) {
+    for (int n = 0; n < lattice.num_spins; ++n) {
+      update_site(sequential
+                      ? n
+                      : static_cast<int>(rngUniformInt(r, lattice.num_spins)));
+    }
+  }
+  std::copy(energy, energy + LANES, energies);
+}
+
+template <bool HeatBath, typename Rng>
+void sweepScalar(const BatchedLattice& lattice, std::int8_t* spins,
+                 double* energies, int num_sweeps, double beta, Rng& r,
+                 bool sequential) {
+  sweepBody<HeatBath>(lattice, spins, energies, num_sweeps, beta, r,
+                      sequential);
+}
+
+template <bool HeatBath, typename Rng>
+__attribute__((target("avx2"))) void sweepAvx2(
+    const BatchedLattice& lattice, std::int8_t* spins, double* energies,
+    int num_sweeps, double beta, Rng& r, bool sequential) {
+  sweepBody<HeatBath>(lattice, spins, energies, num_sweeps, beta, r,
+                      sequential);
+}
+
+template <bool HeatBath, typename Rng>
+__attribute__((target("avx512f"))) void sweepAvx512(
+    const BatchedLattice& lattice, std::int8_t* spins, double* energies,
+    int num_sweeps, double beta, Rng& r, bool sequential) {
+  sweepBody<HeatBath>(lattice, spins, energies, num_sweeps, beta, r,
+                      sequential);
+}
+
+template <bool HeatBath, typename Rng>
+void sweep(SimdLevel level, const BatchedLattice& lattice, std::int8_t* spins,
+           double* energies, int num_sweeps, double beta, Rng& r,
+           bool sequential) {
+  switch (level) {
+    case SimdLevel::avx512:
+      sweepAvx512<HeatBath>(lattice, spins, energies, num_sweeps, beta, r,
+                            sequential);
+      return;
+    case SimdLevel::avx2:
+      sweepAvx2<HeatBath>(lattice, spins, energies, num_sweeps, beta, r,
+                          sequential);
+      return;
+    case SimdLevel::scalar:
+      sweepScalar<HeatBath>(lattice, spins, energies, num_sweeps, beta, r,
+                            sequential);
+      return;
+  }
+}
+
+}  // namespace
+
+std::size_t BatchedEAModel::stateBytes(
+    const SharedModelData<BatchedEAModel>& shared_data) {
+  return static_cast<std::size_t>(shared_data.num_spins) * NUM_LANES *
+         sizeof(std::int8_t);
+}
+
+// A null state allocates storage owned by this model.
+BatchedEAModel::BatchedEAModel(
+    const SharedModelData<BatchedEAModel>& shared_data)
+    : BatchedEAModel(shared_data, nullptr) {}
+
+BatchedEAModel::BatchedEAModel(
+    const SharedModelData<BatchedEAModel>& shared_data, void* state)
+    : num_spins_(shared_data.num_spins),
+      num_neighbors_(shared_data.num_neighbors),
+      neighbor_table_(shared_data.neighbor_table),
+      bond_table_(shared_data.bond_table),
+      simd_level_(detectSimdLevel()),
+      spins_(static_cast<std::int8_t*>(state)),
+      owns_state_(state == nullptr) {
+  if (owns_state_) {
+    spins_ = static_cast<std::int8_t*>(::operator new(
+        stateBytes(shared_data), std::align_val_t{ReplicaArena::ALIGNMENT}));
+  }
+  std::fill(spins_, spins_ + static_cast<std::size_t>(num_spins_) * NUM_LANES,
+            std::int8_t{1});
+  families_.fill(-1);
+  parents_.fill(-1);
+  computeEnergies(energies_.data());
+}
+
+BatchedEAModel::BatchedEAModel(BatchedEAModel&& other) noexcept
+    : num_spins_(other.num_spins_),
+      num_neighbors_(other.num_neighbors_),
+      neighbor_table_(other.neighbor_table_),
+      bond_table_(other.bond_table_),
+      simd_level_(other.simd_level_),
+      spins_(other.spins_),
+      owns_state_(other.owns_state_),
+      families_(other.families_),
+      parents_(other.parents_),
+      energies_(other.energies_) {
+  other.spins_ = nullptr;
+  other.owns_state_ = false;
+}
+
+BatchedEAModel::~BatchedEAModel() {
+  if (owns_state_) {
+    ::operator delete(spins_, std::align_val_t{ReplicaArena::ALIGNMENT});
+  }
+}
+
+void BatchedEAModel::initializeState(gsl_rng* r) {
+  const std::size_t num_entries =
+      static_cast<std::size_t>(num_spins_) * NUM_LANES;
+  for (std::size_t k = 0; k < num_entries; ++k) {
+    spins_[k] = static_cast<std::int8_t>(gsl_rng_uniform_int(r, 2) * 2 - 1);
+  }
+  computeEnergies(energies_.data());
+}
+
+void BatchedEAModel::copyLaneFrom(int lane, const BatchedEAModel& other,
+                                  int other_lane) {
+  assert(num_spins_ == other.num_spins_ && "Number of spins must match!");
+  for (int i = 0; i < num_spins_; ++i) {
+    spins_[i * NUM_LANES + lane] = other.spins_[i * NUM_LANES + other_lane];
+  }
+  families_[lane] = other.families_[other_lane];
+  parents_[lane] = other.parents_[other_lane];
+  energies_[lane] = other.energies_[other_lane];
+}
+
+void BatchedEAModel::restoreState(const void* state, const double* energies) {
+  std::memcpy(spins_, state, static_cast<std::size_t>(num_spins_) * NUM_LANES);
+  std::copy(energies, energies + NUM_LANES, energies_.begin());
+}
+
+double BatchedEAModel::measureEnergy(int lane) const {
+#ifndef NDEBUG
+  const double full_energy = computeEnergy(lane);
+  assert(std::abs(energies_[lane] - full_energy) <=
+             1e-6 * (1 + std::abs(full_energy)) &&
+         "Running energy out of sync with the spins");
+#endif
+  return energies_[lane];
+}
+
+void BatchedEAModel::measureEnergies(double* energies) const {
+  std::copy(energies_.begin(), energies_.end(), energies);
+}
+
+double BatchedEAModel::computeEnergy(int lane) const {
+  double energies[NUM_LANES];
+  computeEnergies(energies);
+  return energies[lane];
+}
+
+// Every bond is counted once, from the site that holds it as an even
+// neighbor, as in IsingModel::computeEnergy.
+void BatchedEAModel::computeEnergies(double* energies) const {
+  double sum[NUM_LANES] = {};
+  for (int i = 0; i < num_spins_; ++i) {
+    const std::int8_t* s = spins_ + i * NUM_LANES;
+    for (int n = 0; n < num_neighbors_; n += 2) {
+      const int b = i * num_neighbors_ + n;
+      const double J = bond_table_[b];
+      const std::int8_t* t = spins_ + neighbor_table_[b] * NUM_LANES;
+      #pragma omp simd
+      for (int lane = 0; lane < NUM_LANES; ++lane) {
+        sum[lane] += J * (s[lane] * t[lane]);
+      }
+    }
+  }
+  for (int lane = 0; lane < NUM_LANES; ++lane) {
+    energies[lane] = -sum[lane];
+  }
+}
+
+double BatchedEAModel::measureMagnetization(int lane) const {
+  int mag = 0;
+  for (int i = 0; i < num_spins_; ++i) {
+    mag += spins_[i * NUM_LANES + lane];
+  }
+  return static_cast<double>(mag);
+}
+
+void BatchedEAModel::measureMagnetizations(double* magnetizations) const {
+  int mag[NUM_LANES] = {};
+  for (int i = 0; i < num_spins_; ++i) {
+    for (int lane = 0; lane < NUM_LANES; ++lane) {
+      mag[lane] += spins_[i * NUM_LANES + lane];
+    }
+  }
+  for (int lane = 0; lane < NUM_LANES; ++lane) {
+    magnetizations[lane] = static_cast<double>(mag[lane]);
+  }
+}
+
+void BatchedEAModel::measureObservables(Observable observable,
+                                        double* values) const {
+  switch (observable) {
+    case Observable::energy:
+      measureEnergies(values);
+      break;
+    case Observable::magnetization:
+      measureMagnetizations(values);
+      break;
+    default:
+      throw std::invalid_argument("Unknown observable!");
+  }
+}
+
+void BatchedEAModel::updateSweep(int num_sweeps, double beta, gsl_rng* r,
+                                 UpdateMethod method, bool sequential) {
+  updateSweepImpl(num_sweeps, beta, r, method, sequential);
+}
+
+void BatchedEAModel::updateSweep(int num_sweeps, double beta, RandomStream& r,
+                                 UpdateMethod method, bool sequential) {
+  updateSweepImpl(num_sweeps, beta, r, method, sequential);
+}
+
+template <typename Rng>
+void BatchedEAModel::updateSweepImpl(int num_sweeps, double beta, Rng& r,
+                                     UpdateMethod method, bool sequential) {
+  const BatchedLattice lattice{num_spins_, num_neighbors_, neighbor_table_,
+                               bond_table_};
+  switch (method) {
+    case UpdateMethod::metropolis:
+      sweep<false>(simd_level_, lattice, spins_, energies_.data(), num_sweeps,
+                   beta, r, sequential);
+      return;
+    case UpdateMethod::heat_bath:
+      sweep<true>(simd_level_, lattice, spins_, energies_.data(), num_sweeps,
+                  beta, r, sequential);
+      return;
+    default:
+      throw std::invalid_argument("Unknown update method!");
+  }
+}
+
+std::vector<int> BatchedEAModel::getState(int lane) const {
+  std::vector<int> state(num_spins_);
+  for (int i = 0; i < num_spins_; ++i) {
+    state[i] = spins_[i * NUM_LANES + lane];
+  }
+  return state;
+}
+
+void BatchedEAModel::setSpin(int i, int lane, int val) {
+  if (val != 1 && val != -1) {
+    throw std::invalid_argument("Spin value must be +1 or -1");
+  }
+  std::int8_t& s = spins_[i * NUM_LANES + lane];
+  if (s != val) {
+    double local_h = 0.0;
+    for (int n = 0; n < num_neighbors_; ++n) {
+      const int b = i * num_neighbors_ + n;
+      local_h += bond_table_[b] * spins_[neighbor_table_[b] * NUM_LANES + lane];
+    }
+    energies_[lane] += 2.0 * s * local_h;
+    s = static_cast<std::int8_t>(val);
+  }
+}
+
+int BatchedEAModel::getSpin(int i, int lane) const {
+  if (i < 0 || i >= num_spins_ || lane < 0 || lane >= NUM_LANES) {
+    throw std::out_of_range("Index out of range");
+  }
+  return spins_[i * NUM_LANES + lane];
+}
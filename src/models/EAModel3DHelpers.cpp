@@ -1,3 +1,10 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
 #include <fstream>
 #include <stdexcept>
 #include <vector>
@@ -5,28 +12,190 @@
 
 #include "models/EAModel3DHelpers.hpp"
 
-std::vector<int> loadNeighborTable(const std::string& filename, int num_spins, int num_neighbors) {
+namespace {
+
+// Reads exactly count values of type T and checks that nothing but
+// whitespace follows them.
+template <typename T>
+std::vector<T> loadTable(const std::string& filename, const char* what,
+                         int num_spins, int num_neighbors) {
     std::ifstream infile(filename);
-    if (!infile) throw std::runtime_error("Failed to open neighbor table file.");
+    if (!infile) throw std::runtime_error(std::string("Failed to open ") + what + " file " + filename);
+    if (num_spins <= 0 || num_neighbors <= 0) {
+        throw std::invalid_argument(std::string("Invalid size of ") + what);
+    }
 
-    std::vector<int> neighbors(num_spins * num_neighbors);
-    for (int i = 0; i < num_spins; ++i) {
-        for (int n = 0; n < num_neighbors; ++n) {
-            infile >> neighbors[i * num_neighbors + n];
+    const long count = static_cast<long>(num_spins) * num_neighbors;
+    std::vector<T> values(count);
+    for (long k = 0; k < count; ++k) {
+        if (!(infile >> values[k])) {
+            throw std::runtime_error(filename + " holds fewer than " + std::to_string(count) +
+                                     " entries (" + std::to_string(num_spins) + " spins x " +
+                                     std::to_string(num_neighbors) + " neighbors)");
         }
     }
+    infile >> std::ws;
+    if (!infile.eof()) {
+        throw std::runtime_error(filename + " holds more than " + std::to_string(count) +
+                                 " entries (" + std::to_string(num_spins) + " spins x " +
+                                 std::to_string(num_neighbors) + " neighbors)");
+    }
+    return values;
+}
+
+// Position of the first neighbor index outside [0, num_spins), or -1.
+long findBadNeighbor(const int* neighbor_table, int num_spins, int num_neighbors) {
+    const long count = static_cast<long>(num_spins) * num_neighbors;
+    for (long k = 0; k < count; ++k) {
+        if (neighbor_table[k] < 0 || neighbor_table[k] >= num_spins) {
+            return k;
+        }
+    }
+    return -1;
+}
+
+void checkNeighbors(const int* neighbor_table, int num_spins, int num_neighbors) {
+    const long k = findBadNeighbor(neighbor_table, num_spins, num_neighbors);
+    if (k >= 0) {
+        throw std::runtime_error("Neighbor " + std::to_string(neighbor_table[k]) + " of spin " +
+                                 std::to_string(k / num_neighbors) + " is out of range");
+    }
+}
+
+std::uint64_t alignUp(std::uint64_t bytes) {
+    return (bytes + INSTANCE_ALIGNMENT - 1) / INSTANCE_ALIGNMENT * INSTANCE_ALIGNMENT;
+}
+
+// Sets the table offsets and file_bytes of header from its sizes.
+void layoutInstance(InstanceHeader& header) {
+    const std::uint64_t count =
+        static_cast<std::uint64_t>(header.num_spins) * header.num_neighbors;
+    header.neighbor_offset = alignUp(sizeof(InstanceHeader));
+    header.bond_offset = alignUp(header.neighbor_offset + count * sizeof(std::int32_t));
+    header.file_bytes = header.bond_offset + count * sizeof(double);
+}
+
+std::runtime_error ioError(const std::string& what, const std::string& path) {
+    return std::runtime_error(what + " " + path + ": " + std::strerror(errno));
+}
+
+}  // namespace
+
+std::vector<int> loadNeighborTable(const std::string& filename, int num_spins, int num_neighbors) {
+    std::vector<int> neighbors = loadTable<int>(filename, "neighbor table", num_spins, num_neighbors);
+    checkNeighbors(neighbors.data(), num_spins, num_neighbors);
     return neighbors;
 }
 
 std::vector<double> loadBondTable(const std::string& filename, int num_spins, int num_neighbors) {
-    std::ifstream infile(filename);
-    if (!infile) throw std::runtime_error("Failed to open bond table file.");
+    return loadTable<double>(filename, "bond table", num_spins, num_neighbors);
+}
+
+void writeInstanceFile(const std::string& path, int system_size, int num_spins,
+                       int num_neighbors, const int* neighbor_table,
+                       const double* bond_table) {
+    static_assert(sizeof(int) == sizeof(std::int32_t), "neighbor tables are int32");
+    if (num_spins <= 0 || num_neighbors <= 0) {
+        throw std::invalid_argument("Invalid instance size");
+    }
+    checkNeighbors(neighbor_table, num_spins, num_neighbors);
+
+    InstanceHeader header{};
+    std::memcpy(header.magic, INSTANCE_MAGIC, sizeof(header.magic));
+    header.version = INSTANCE_VERSION;
+    header.header_bytes = sizeof(InstanceHeader);
+    header.system_size = system_size;
+    header.num_spins = num_spins;
+    header.num_neighbors = num_neighbors;
+    header.neighbor_dtype = static_cast<std::uint32_t>(InstanceDtype::int32);
+    header.bond_dtype = static_cast<std::uint32_t>(InstanceDtype::float64);
+    layoutInstance(header);
 
-    std::vector<double> bonds(num_spins * num_neighbors);
-    for (int i = 0; i < num_spins; ++i) {
-        for (int n = 0; n < num_neighbors; ++n) {
-            infile >> bonds[i * num_neighbors + n];
+    const std::uint64_t count = static_cast<std::uint64_t>(num_spins) * num_neighbors;
+    const std::vector<char> padding(INSTANCE_ALIGNMENT, 0);
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) throw ioError("Cannot create instance", path);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(padding.data(), header.neighbor_offset - sizeof(header));
+    out.write(reinterpret_cast<const char*>(neighbor_table), count * sizeof(std::int32_t));
+    out.write(padding.data(),
+              header.bond_offset - header.neighbor_offset - count * sizeof(std::int32_t));
+    out.write(reinterpret_cast<const char*>(bond_table), count * sizeof(double));
+    out.close();
+    if (!out) throw ioError("Cannot write instance", path);
+}
+
+void convertTextInstance(const std::string& neighbor_path,
+                         const std::string& bond_path,
+                         const std::string& instance_path, int system_size,
+                         int num_spins, int num_neighbors) {
+    const std::vector<int> neighbors = loadNeighborTable(neighbor_path, num_spins, num_neighbors);
+    const std::vector<double> bonds = loadBondTable(bond_path, num_spins, num_neighbors);
+    writeInstanceFile(instance_path, system_size, num_spins, num_neighbors,
+                      neighbors.data(), bonds.data());
+}
+
+bool isInstanceFile(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    char magic[sizeof(INSTANCE_MAGIC)];
+    return in.read(magic, sizeof(magic)) &&
+           std::memcmp(magic, INSTANCE_MAGIC, sizeof(magic)) == 0;
+}
+
+InstanceFile::InstanceFile(const std::string& path) {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw ioError("Cannot open instance", path);
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw ioError("Cannot stat instance", path);
+    }
+    size_ = static_cast<std::size_t>(st.st_size);
+    if (size_ < sizeof(InstanceHeader)) {
+        ::close(fd);
+        throw std::runtime_error("Instance " + path + " is truncated");
+    }
+    data_ = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data_ == MAP_FAILED) {
+        data_ = nullptr;
+        throw ioError("Cannot map instance", path);
+    }
+
+    const InstanceHeader& stored = header();
+    std::string problem;
+    if (std::memcmp(stored.magic, INSTANCE_MAGIC, sizeof(stored.magic)) != 0) {
+        problem = "is not a binary instance";
+    } else if (stored.version != INSTANCE_VERSION) {
+        problem = "has version " + std::to_string(stored.version) + ", expected " +
+                  std::to_string(INSTANCE_VERSION);
+    } else if (stored.header_bytes != sizeof(InstanceHeader)) {
+        problem = "has an unexpected header size";
+    } else if (stored.neighbor_dtype != static_cast<std::uint32_t>(InstanceDtype::int32) ||
+               stored.bond_dtype != static_cast<std::uint32_t>(InstanceDtype::float64)) {
+        problem = "has unsupported table types";
+    } else if (stored.num_spins <= 0 || stored.num_neighbors <= 0) {
+        problem = "has an invalid size";
+    } else {
+        InstanceHeader expected = stored;
+        layoutInstance(expected);
+        if (std::memcmp(&expected, &stored, sizeof(InstanceHeader)) != 0) {
+            problem = "has an inconsistent layout";
+        } else if (stored.file_bytes != size_) {
+            problem = "is truncated";
+        } else if (findBadNeighbor(neighborTable(), numSpins(), numNeighbors()) >= 0) {
+            problem = "has a neighbor index out of range";
         }
     }
-    return bonds;
-}
\ No newline at end of file
+    if (!problem.empty()) {
+        ::munmap(data_, size_);
+        data_ = nullptr;
+        throw std::runtime_error("Instance " + path + " " + problem);
+    }
+}
+
+InstanceFile::~InstanceFile() {
+    if (data_ != nullptr) {
+        ::munmap(data_, size_);
+    }
+}
@@ -1,5 +1,10 @@
 #include "models/Ising3DHelpers.hpp"
 
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+
 std::vector<int> initializeNeighborTable3D(int system_size) {
   int L = system_size;
   int num_spins = L * L * L;
@@ -21,46 +26,88 @@ std::vector<int> initializeNeighborTable3D(int system_size) {
 
   return neighbor_table;
 }
-// Future arbitrary dimension support
-// // Compute flattened index from D-dimensional coordinates
-// int indexND(const std::vector<int>& coords, int L) {
-//     int index = 0;
-//     int stride = 1;
-//     for (int d = coords.size() - 1; d >= 0; --d) {
-//         int coord = (coords[d] % L + L) % L;  // periodic
-//         index += coord * stride;
-//         stride *= L;
-//     }
-//     return index;
-// }
 
-// // Compute D-dimensional neighbor table
-// std::vector<int> makeNeighborTable(int L, int D) {
-//     const int num_sites = std::pow(L, D);
-//     const int num_neighbors = 2 * D;
-//     std::vector<int> neighbor_table(num_sites * num_neighbors);
+std::vector<int> initializeNeighborTableND(int system_size, int dimension) {
+  int L = system_size;
+  int num_spins = 1;
+  for (int d = 0; d < dimension; ++d) {
+    num_spins *= L;
+  }
+  const int num_neighbors = 2 * dimension;
+  std::vector<int> neighbor_table(num_spins * num_neighbors);
 
-//     for (int flat = 0; flat < num_sites; ++flat) {
-//         // Convert flat index to coordinates
-//         std::vector<int> coords(D);
-//         int temp = flat;
-//         for (int d = D - 1; d >= 0; --d) {
-//             coords[d] = temp % L;
-//             temp /= L;
-//         }
+  for (int i = 0; i < num_spins; ++i) {
+    // Stride of dimension d is L^(dimension - 1 - d).
+    int stride = 1;
+    for (int d = dimension - 1; d >= 0; --d) {
+      const int x = (i / stride) % L;
+      neighbor_table[i * num_neighbors + 2 * d] =
+          i + (mod(x - 1, L) - x) * stride;
+      neighbor_table[i * num_neighbors + 2 * d + 1] =
+          i + (mod(x + 1, L) - x) * stride;
+      stride *= L;
+    }
+  }
 
-//         // Add ±1 neighbors in each dimension
-//         for (int d = 0; d < D; ++d) {
-//             std::vector<int> plus = coords;
-//             std::vector<int> minus = coords;
-//             plus[d] = (coords[d] + 1) % L;
-//             minus[d] = (coords[d] - 1 + L) % L;
+  return neighbor_table;
+}
 
-//             neighbor_table[flat * num_neighbors + 2 * d]     = indexND(minus,
-//             L); neighbor_table[flat * num_neighbors + 2 * d + 1] =
-//             indexND(plus, L);
-//         }
-//     }
+namespace {
 
-//     return neighbor_table;
-// }
+// Spreads the low 21 bits of v so that two zero bits follow each of them.
+std::uint64_t spreadBits(std::uint64_t v) {
+  v &= 0x1fffff;
+  v = (v | v << 32) & 0x1f00000000ffffULL;
+  v = (v | v << 16) & 0x1f0000ff0000ffULL;
+  v = (v | v << 8) & 0x100f00f00f00f00fULL;
+  v = (v | v << 4) & 0x10c30c30c30c30c3ULL;
+  v = (v | v << 2) & 0x1249249249249249ULL;
+  return v;
+}
+
+}  // namespace
+
+std::vector<int> mortonOrder3D(int system_size) {
+  const int L = system_size;
+  std::vector<std::pair<std::uint64_t, int>> codes;
+  codes.reserve(static_cast<std::size_t>(L) * L * L);
+  for (int i = 0; i < L; ++i) {
+    for (int j = 0; j < L; ++j) {
+      for (int k = 0; k < L; ++k) {
+        codes.emplace_back(
+            spreadBits(i) << 2 | spreadBits(j) << 1 | spreadBits(k),
+            index3D(i, j, k, L));
+      }
+    }
+  }
+  std::sort(codes.begin(), codes.end());
+
+  std::vector<int> order(codes.size());
+  for (std::size_t n = 0; n < codes.size(); ++n) {
+    order[n] = codes[n].second;
+  }
+  return order;
+}
+
+std::vector<int> tiledOrder3D(int system_size, int tile) {
+  if (tile <= 0) {
+    throw std::invalid_argument("Tile size must be positive");
+  }
+  const int L = system_size;
+  std::vector<int> order;
+  order.reserve(static_cast<std::size_t>(L) * L * L);
+  for (int bi = 0; bi < L; bi += tile) {
+    for (int bj = 0; bj < L; bj += tile) {
+      for (int bk = 0; bk < L; bk += tile) {
+        for (int i = bi; i < std::min(bi + tile, L); ++i) {
+          for (int j = bj; j < std::min(bj + tile, L); ++j) {
+            for (int k = bk; k < std::min(bk + tile, L); ++k) {
+              order.push_back(index3D(i, j, k, L));
+            }
+          }
+        }
+      }
+    }
+  }
+  return order;
+}
@@ -0,0 +1,439 @@
+#include "models/IsingCheckerboard.hpp"
+
+#include <immintrin.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include "Rng.hpp"
+
+namespace {
+
+constexpr int LANES = CHECKERBOARD_LANES;
+
+inline std::uint32_t rotl(std::uint32_t x, int k) {
+  return (x << k) | (x >> (32 - k));
+}
+
+// One xoshiro128++ step of stream j.
+inline std::uint32_t nextLane(CheckerboardRng& rng, int j) {
+  std::uint32_t* s0 = rng.state[0];
+  std::uint32_t* s1 = rng.state[1];
+  std::uint32_t* s2 = rng.state[2];
+  std::uint32_t* s3 = rng.state[3];
+  const std::uint32_t result = rotl(s0[j] + s3[j], 7) + s0[j];
+  const std::uint32_t t = s1[j] << 9;
+  s2[j] ^= s0[j];
+  s3[j] ^= s1[j];
+  s1[j] ^= s2[j];
+  s0[j] ^= s3[j];
+  s2[j] ^= t;
+  s3[j] = rotl(s3[j], 11);
+  return result;
+}
+
+// Acceptance thresholds for 31-bit uniforms r: a move is accepted when
+// r < threshold[k], i.e. with probability threshold[k] / 2^31. Indexed like
+// FlipTable in IsingModel.cpp: Metropolis by s_i times the local field (k <= 0
+// always flips), heat bath by the local field itself (probability of up).
+struct ThresholdTable {
+  double beta = std::numeric_limits<double>::quiet_NaN();
+  bool heat_bath = false;
+  double bond_unit = 0.0;
+  int max_field = -1;
+  std::vector<std::int32_t> values;
+
+  static std::int32_t threshold(double p) {
+    if (p >= 1.0) {
+      return std::numeric_limits<std::int32_t>::max();
+    }
+    return static_cast<std::int32_t>(p * 2147483648.0);
+  }
+
+  const std::int32_t* center(double new_beta, bool new_heat_bath,
+                             double new_bond_unit, int new_max_field) {
+    if (new_beta != beta || new_heat_bath != heat_bath ||
+        new_bond_unit != bond_unit || new_max_field != max_field) {
+      beta = new_beta;
+      heat_bath = new_heat_bath;
+      bond_unit = new_bond_unit;
+      max_field = new_max_field;
+      values.resize(2 * max_field + 1);
+      for (int k = -max_field; k <= max_field; ++k) {
+        double h = bond_unit * k;
+        values[k + max_field] = threshold(
+            heat_bath ? 1 / (1 + exp(-2 * beta * h))
+                      : (k <= 0 ? 1.0 : exp(-beta * (2 * h))));
+      }
+    }
+    return values.data() + max_field;
+  }
+};
+
+thread_local ThresholdTable threshold_table;
+thread_local std::vector<std::int32_t> padded_row;
+
+// One row of L sites along z with fixed (x, y). The z -/+ 1 neighbors of
+// site z are padded[z] and padded[z + 2]; the other four neighbor rows are
+// read in place, which is safe because they hold the other color only.
+struct Row {
+  std::int32_t* self;
+  const std::int32_t* padded;
+  const std::int32_t* xm;
+  const std::int32_t* xp;
+  const std::int32_t* ym;
+  const std::int32_t* yp;
+  // Per-direction bond multiples for this row, or null for uniform bonds.
+  const std::int32_t* bonds[6];
+  int uniform_bond;
+  int length;
+  // z parity of the sites being updated.
+  int parity;
+  bool heat_bath;
+  const std::int32_t* thresholds;
+};
+
+// Returns s_old * k if the spin flipped, 0 otherwise.
+inline int updateSite(const Row& row, int z, std::uint32_t r) {
+  int k;
+  if (row.bonds[0] != nullptr) {
+    k = row.bonds[0][z] * row.xm[z] + row.bonds[1][z] * row.xp[z] +
+        row.bonds[2][z] * row.ym[z] + row.bonds[3][z] * row.yp[z] +
+        row.bonds[4][z] * row.padded[z] + row.bonds[5][z] * row.padded[z + 2];
+  } else {
+    k = row.uniform_bond * (row.xm[z] + row.xp[z] + row.ym[z] + row.yp[z] +
+                            row.padded[z] + row.padded[z + 2]);
+  }
+  const std::int32_t r31 = static_cast<std::int32_t>(r >> 1);
+  const int m = row.self[z] * k;
+  const int updated = row.heat_bath ? (r31 < row.thresholds[k] ? 1 : -1)
+                                    : (m <= 0 || r31 < row.thresholds[m]
+                                           ? -row.self[z]
+                                           : row.self[z]);
+  if (updated == row.self[z]) {
+    return 0;
+  }
+  row.self[z] = updated;
+  return m;
+}
+
+// Chunk starting at z0 with one draw per lane, whether or not the lane holds
+// a site of the current color; lanes past the row end draw and discard.
+inline long chunkScalar(const Row& row, int z0, CheckerboardRng& rng) {
+  long delta = 0;
+  for (int j = 0; j < LANES; ++j) {
+    const std::uint32_t r = nextLane(rng, j);
+    const int z = z0 + j;
+    if (z < row.length && (z & 1) == row.parity) {
+      delta += updateSite(row, z, r);
+    }
+  }
+  return delta;
+}
+
+// Row kernels return the sum of s_old * k over the flipped sites.
+long rowScalar(const Row& row, CheckerboardRng& rng) {
+  long delta = 0;
+  for (int z0 = 0; z0 < row.length; z0 += LANES) {
+    delta += chunkScalar(row, z0, rng);
+  }
+  return delta;
+}
+
+__attribute__((target("avx2"))) inline __m256i rotlAvx2(__m256i x, int k) {
+  return _mm256_or_si256(_mm256_slli_epi32(x, k),
+                         _mm256_srli_epi32(x, 32 - k));
+}
+
+__attribute__((target("avx2"))) inline __m256i loadAvx2(const std::int32_t* p,
+                                                       int z) {
+  return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + z));
+}
+
+__attribute__((target("avx2"))) long rowAvx2(const Row& row,
+                                             CheckerboardRng& rng) {
+  __m256i delta = _mm256_setzero_si256();
+  const __m256i one = _mm256_set1_epi32(1);
+  const __m256i minus_one = _mm256_set1_epi32(-1);
+  const __m256i minus_two = _mm256_set1_epi32(-2);
+  const __m256i uniform = _mm256_set1_epi32(row.uniform_bond);
+  // Chunks start at even z, so lane j holds the current color iff
+  // (j & 1) == parity.
+  const __m256i color = row.parity == 0
+                            ? _mm256_setr_epi32(-1, 0, -1, 0, -1, 0, -1, 0)
+                            : _mm256_setr_epi32(0, -1, 0, -1, 0, -1, 0, -1);
+  int z0 = 0;
+  for (; z0 + LANES <= row.length; z0 += LANES) {
+    for (int h = 0; h < LANES; h += 8) {
+      auto state = [&](int w) {
+        return reinterpret_cast<__m256i*>(rng.state[w] + h);
+      };
+      __m256i s0 = _mm256_load_si256(state(0));
+      __m256i s1 = _mm256_load_si256(state(1));
+      __m256i s2 = _mm256_load_si256(state(2));
+      __m256i s3 = _mm256_load_si256(state(3));
+      const __m256i r = _mm256_add_epi32(
+          rotlAvx2(_mm256_add_epi32(s0, s3), 7), s0);
+      const __m256i t = _mm256_slli_epi32(s1, 9);
+      s2 = _mm256_xor_si256(s2, s0);
+      s3 = _mm256_xor_si256(s3, s1);
+      s1 = _mm256_xor_si256(s1, s2);
+      s0 = _mm256_xor_si256(s0, s3);
+      s2 = _mm256_xor_si256(s2, t);
+      s3 = rotlAvx2(s3, 11);
+      _mm256_store_si256(state(0), s0);
+      _mm256_store_si256(state(1), s1);
+      _mm256_store_si256(state(2), s2);
+      _mm256_store_si256(state(3), s3);
+      const __m256i r31 = _mm256_srli_epi32(r, 1);
+
+      const int z = z0 + h;
+      const __m256i n0 = loadAvx2(row.xm, z);
+      const __m256i n1 = loadAvx2(row.xp, z);
+      const __m256i n2 = loadAvx2(row.ym, z);
+      const __m256i n3 = loadAvx2(row.yp, z);
+      const __m256i n4 = loadAvx2(row.padded, z);
+      const __m256i n5 = loadAvx2(row.padded + 2, z);
+      __m256i k;
+      if (row.bonds[0] != nullptr) {
+        const __m256i b01 = _mm256_add_epi32(
+            _mm256_mullo_epi32(n0, loadAvx2(row.bonds[0], z)),
+            _mm256_mullo_epi32(n1, loadAvx2(row.bonds[1], z)));
+        const __m256i b23 = _mm256_add_epi32(
+            _mm256_mullo_epi32(n2, loadAvx2(row.bonds[2], z)),
+            _mm256_mullo_epi32(n3, loadAvx2(row.bonds[3], z)));
+        const __m256i b45 = _mm256_add_epi32(
+            _mm256_mullo_epi32(n4, loadAvx2(row.bonds[4], z)),
+            _mm256_mullo_epi32(n5, loadAvx2(row.bonds[5], z)));
+        k = _mm256_add_epi32(_mm256_add_epi32(b01, b23), b45);
+      } else {
+        k = _mm256_mullo_epi32(
+            uniform,
+            _mm256_add_epi32(
+                _mm256_add_epi32(_mm256_add_epi32(n0, n1),
+                                 _mm256_add_epi32(n2, n3)),
+                _mm256_add_epi32(n4, n5)));
+      }
+
+      const __m256i s = loadAvx2(row.self, z);
+      __m256i updated;
+      if (row.heat_bath) {
+        const __m256i up = _mm256_cmpgt_epi32(
+            _mm256_i32gather_epi32(row.thresholds, k, 4), r31);
+        updated = _mm256_blendv_epi8(
+            s, _mm256_sub_epi32(minus_one, _mm256_add_epi32(up, up)), color);
+        const __m256i kept = _mm256_cmpeq_epi32(updated, s);
+        delta = _mm256_add_epi32(
+            delta, _mm256_andnot_si256(kept, _mm256_mullo_epi32(s, k)));
+      } else {
+        const __m256i m = _mm256_mullo_epi32(s, k);
+        const __m256i flip = _mm256_and_si256(
+            color,
+            _mm256_or_si256(_mm256_cmpgt_epi32(
+                                _mm256_i32gather_epi32(row.thresholds, m, 4),
+                                r31),
+                            _mm256_cmpgt_epi32(one, m)));
+        // -s == s ^ -2 for s = +/-1.
+        updated = _mm256_xor_si256(s, _mm256_and_si256(flip, minus_two));
+        delta = _mm256_add_epi32(delta, _mm256_and_si256(flip, m));
+      }
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(row.self + z), updated);
+    }
+  }
+  alignas(32) std::int32_t lanes[8];
+  _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), delta);
+  long total = 0;
+  for (int j = 0; j < 8; ++j) {
+    total += lanes[j];
+  }
+  if (z0 < row.length) {
+    total += chunkScalar(row, z0, rng);
+  }
+  return total;
+}
+
+// GCC 12 reports the _mm512_undefined_epi32() placeholders inside the
+// unmasked AVX-512 intrinsics as (maybe-)uninitialized.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#pragma GCC diagnostic ignored "-Wuninitialized"
+
+__attribute__((target("avx512f"))) inline __m512i loadAvx512(
+    const std::int32_t* p, int z) {
+  return _mm512_loadu_si512(p + z);
+}
+
+__attribute__((target("avx512f"))) long rowAvx512(const Row& row,
+                                                  CheckerboardRng& rng) {
+  const __m512i zero = _mm512_setzero_si512();
+  __m512i delta = zero;
+  const __m512i one = _mm512_set1_epi32(1);
+  const __m512i minus_one = _mm512_set1_epi32(-1);
+  const __m512i uniform = _mm512_set1_epi32(row.uniform_bond);
+  const __mmask16 color = row.parity == 0 ? 0x5555 : 0xAAAA;
+  __m512i s0 = _mm512_load_si512(rng.state[0]);
+  __m512i s1 = _mm512_load_si512(rng.state[1]);
+  __m512i s2 = _mm512_load_si512(rng.state[2]);
+  __m512i s3 = _mm512_load_si512(rng.state[3]);
+  int z0 = 0;
+  for (; z0 + LANES <= row.length; z0 += LANES) {
+    const __m512i r =
+        _mm512_add_epi32(_mm512_rol_epi32(_mm512_add_epi32(s0, s3), 7), s0);
+    const __m512i t = _mm512_slli_epi32(s1, 9);
+    s2 = _mm512_xor_si512(s2, s0);
+    s3 = _mm512_xor_si512(s3, s1);
+    s1 = _mm512_xor_si512(s1, s2);
+    s0 = _mm512_xor_si512(s0, s3);
+    s2 = _mm512_xor_si512(s2, t);
+    s3 = _mm512_rol_epi32(s3, 11);
+    const __m512i r31 = _mm512_srli_epi32(r, 1);
+
+    const int z = z0;
+    const __m512i n0 = loadAvx512(row.xm, z);
+    const __m512i n1 = loadAvx512(row.xp, z);
+    const __m512i n2 = loadAvx512(row.ym, z);
+    const __m512i n3 = loadAvx512(row.yp, z);
+    const __m512i n4 = loadAvx512(row.padded, z);
+    const __m512i n5 = loadAvx512(row.padded + 2, z);
+    __m512i k;
+    if (row.bonds[0] != nullptr) {
+      const __m512i b01 = _mm512_add_epi32(
+          _mm512_mullo_epi32(n0, loadAvx512(row.bonds[0], z)),
+          _mm512_mullo_epi32(n1, loadAvx512(row.bonds[1], z)));
+      const __m512i b23 = _mm512_add_epi32(
+          _mm512_mullo_epi32(n2, loadAvx512(row.bonds[2], z)),
+          _mm512_mullo_epi32(n3, loadAvx512(row.bonds[3], z)));
+      const __m512i b45 = _mm512_add_epi32(
+          _mm512_mullo_epi32(n4, loadAvx512(row.bonds[4], z)),
+          _mm512_mullo_epi32(n5, loadAvx512(row.bonds[5], z)));
+      k = _mm512_add_epi32(_mm512_add_epi32(b01, b23), b45);
+    } else {
+      k = _mm512_mullo_epi32(
+          uniform,
+          _mm512_add_epi32(_mm512_add_epi32(_mm512_add_epi32(n0, n1),
+                                            _mm512_add_epi32(n2, n3)),
+                           _mm512_add_epi32(n4, n5)));
+    }
+
+    const __m512i s = loadAvx512(row.self, z);
+    __m512i updated;
+    if (row.heat_bath) {
+      const __mmask16 up = _mm512_cmpgt_epi32_mask(
+          _mm512_i32gather_epi32(k, row.thresholds, 4), r31);
+      updated = _mm512_mask_blend_epi32(
+          color, s, _mm512_mask_blend_epi32(up, minus_one, one));
+      const __mmask16 changed = _mm512_cmpneq_epi32_mask(updated, s);
+      delta =
+          _mm512_mask_add_epi32(delta, changed, delta, _mm512_mullo_epi32(s, k));
+    } else {
+      const __m512i m = _mm512_mullo_epi32(s, k);
+      const __mmask16 flip =
+          color & (_mm512_cmpgt_epi32_mask(
+                       _mm512_i32gather_epi32(m, row.thresholds, 4), r31) |
+                   _mm512_cmpgt_epi32_mask(one, m));
+      updated = _mm512_mask_sub_epi32(s, flip, zero, s);
+      delta = _mm512_mask_add_epi32(delta, flip, delta, m);
+    }
+    _mm512_storeu_si512(row.self + z0, updated);
+  }
+  _mm512_store_si512(rng.state[0], s0);
+  _mm512_store_si512(rng.state[1], s1);
+  _mm512_store_si512(rng.state[2], s2);
+  _mm512_store_si512(rng.state[3], s3);
+  long total = _mm512_reduce_add_epi32(delta);
+  if (z0 < row.length) {
+    total += chunkScalar(row, z0, rng);
+  }
+  return total;
+}
+
+#pragma GCC diagnostic pop
+
+}  // namespace
+
+SimdLevel detectSimdLevel() {
+  if (__builtin_cpu_supports("avx512f")) {
+    return SimdLevel::avx512;
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    return SimdLevel::avx2;
+  }
+  return SimdLevel::scalar;
+}
+
+CheckerboardRng::CheckerboardRng(std::uint64_t seed) {
+  for (int j = 0; j < LANES; ++j) {
+    for (int w = 0; w < 4; w += 2) {
+      const std::uint64_t bits = splitMix64(seed);
+      state[w][j] = static_cast<std::uint32_t>(bits);
+      state[w + 1][j] = static_cast<std::uint32_t>(bits >> 32);
+    }
+  }
+}
+
+long checkerboardSweep(std::int32_t* spins, const CheckerboardLattice& lattice,
+                       double beta, bool heat_bath, int num_sweeps,
+                       CheckerboardRng& rng, SimdLevel level) {
+  const int L = lattice.system_size;
+  if (L % 2 != 0) {
+    throw std::invalid_argument(
+        "Checkerboard update requires an even system size");
+  }
+  const long num_spins = static_cast<long>(L) * L * L;
+  long (*row_func)(const Row&, CheckerboardRng&) = nullptr;
+  switch (level) {
+    case SimdLevel::scalar:
+      row_func = &rowScalar;
+      break;
+    case SimdLevel::avx2:
+      row_func = &rowAvx2;
+      break;
+    case SimdLevel::avx512:
+      row_func = &rowAvx512;
+      break;
+  }
+
+  Row row;
+  row.uniform_bond = lattice.uniform_bond;
+  row.length = L;
+  row.heat_bath = heat_bath;
+  row.thresholds = threshold_table.center(beta, heat_bath, lattice.bond_unit,
+                                          lattice.max_field);
+  padded_row.resize(L + 2);
+  row.padded = padded_row.data();
+
+  long delta = 0;
+  for (int sweep = 0; sweep < num_sweeps; ++sweep) {
+    for (int color = 0; color < 2; ++color) {
+      for (int x = 0; x < L; ++x) {
+        const int x_minus = (x == 0 ? L - 1 : x - 1) * L;
+        const int x_plus = (x == L - 1 ? 0 : x + 1) * L;
+        for (int y = 0; y < L; ++y) {
+          const int y_minus = y == 0 ? L - 1 : y - 1;
+          const int y_plus = y == L - 1 ? 0 : y + 1;
+          const long base = static_cast<long>(x * L + y) * L;
+          row.self = spins + base;
+          row.xm = spins + static_cast<long>(x_minus + y) * L;
+          row.xp = spins + static_cast<long>(x_plus + y) * L;
+          row.ym = spins + static_cast<long>(x * L + y_minus) * L;
+          row.yp = spins + static_cast<long>(x * L + y_plus) * L;
+          for (int n = 0; n < 6; ++n) {
+            row.bonds[n] = lattice.direction_bonds == nullptr
+                               ? nullptr
+                               : lattice.direction_bonds + n * num_spins + base;
+          }
+          row.parity = (color + x + y) & 1;
+          padded_row[0] = row.self[L - 1];
+          std::copy(row.self, row.self + L, padded_row.begin() + 1);
+          padded_row[L + 1] = row.self[0];
+          delta += row_func(row, rng);
+        }
+      }
+    }
+  }
+  return delta;
+}
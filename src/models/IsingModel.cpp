@@ -2,77 +2,932 @@
 
 #include <gsl/gsl_rng.h>
 
+#include <algorithm>
 #include <cassert>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <new>
+#include <numeric>
 #include <stdexcept>
+#include <type_traits>
+#include <utility>
 
+#include "ReplicaArena.hpp"
+#include "models/Ising3DHelpers.hpp"
+#include "models/IsingCheckerboard.hpp"
+#include "models/SparseGraphHelpers.hpp"
+
+namespace {
+
+// Spin access policies, one per SpinStorage layout. The Monte Carlo kernels
+// are instantiated once per policy so the storage choice costs nothing inside
+// the inner loops.
+template <typename T>
+struct ByteSpins {
+  using Word = T;
+  static std::size_t bytes(int num_spins) {
+    return static_cast<std::size_t>(num_spins) * sizeof(Word);
+  }
+  static int get(const void* spins, int i) {
+    return static_cast<const Word*>(spins)[i];
+  }
+  static void set(void* spins, int i, int val) {
+    static_cast<Word*>(spins)[i] = static_cast<Word>(val);
+  }
+  static void flip(void* spins, int i) {
+    Word* s = static_cast<Word*>(spins);
+    s[i] = static_cast<Word>(-s[i]);
+  }
+};
+using Int32Spins = ByteSpins<std::int32_t>;
+using Int8Spins = ByteSpins<std::int8_t>;
+
+// One bit per spin, set when the spin is -1. Bits past num_spins in the last
+// word are kept at zero so whole-word XOR/popcount needs no masking.
+struct BitSpins {
+  using Word = std::uint64_t;
+  static std::size_t bytes(int num_spins) {
+    return static_cast<std::size_t>((num_spins + 63) / 64) * sizeof(Word);
+  }
+  static int get(const void* spins, int i) {
+    const Word* w = static_cast<const Word*>(spins);
+    return 1 - 2 * static_cast<int>((w[i >> 6] >> (i & 63)) & 1);
+  }
+  static void set(void* spins, int i, int val) {
+    Word* w = static_cast<Word*>(spins);
+    const Word mask = Word{1} << (i & 63);
+    w[i >> 6] = (val == -1) ? (w[i >> 6] | mask) : (w[i >> 6] & ~mask);
+  }
+  static void flip(void* spins, int i) {
+    static_cast<Word*>(spins)[i >> 6] ^= Word{1} << (i & 63);
+  }
+};
+
+std::size_t spinBytes(SpinStorage storage, int num_spins) {
+  switch (storage) {
+    case SpinStorage::int32:
+      return Int32Spins::bytes(num_spins);
+    case SpinStorage::int8:
+      return Int8Spins::bytes(num_spins);
+    case SpinStorage::bit:
+      return BitSpins::bytes(num_spins);
+  }
+  throw std::invalid_argument("Unknown spin storage!");
+}
+
+// Flip probabilities for integer local fields k in [-max_field, max_field]
+// (in units of bond_unit): min(1, exp(-2 beta unit k)) for Metropolis, where
+// k is s_i times the field, and 1 / (1 + exp(-2 beta unit k)) for the heat
+// bath probability of spin up. Each thread keeps one table and rebuilds it
+// only when beta or the method changes, i.e. once per Population::equilibrate.
+struct FlipTable {
+  double beta = std::numeric_limits<double>::quiet_NaN();
+  bool heat_bath = false;
+  double bond_unit = 0.0;
+  int max_field = -1;
+  std::vector<double> values;
+
+  const double* center(double new_beta, bool new_heat_bath,
+                       double new_bond_unit, int new_max_field) {
+    if (new_beta != beta || new_heat_bath != heat_bath ||
+        new_bond_unit != bond_unit || new_max_field != max_field) {
+      beta = new_beta;
+      heat_bath = new_heat_bath;
+      bond_unit = new_bond_unit;
+      max_field = new_max_field;
+      values.resize(2 * max_field + 1);
+      for (int k = -max_field; k <= max_field; ++k) {
+        double h = bond_unit * k;
+        values[k + max_field] = heat_bath
+                                    ? 1 / (1 + exp(-2 * beta * h))
+                                    : (k <= 0 ? 1.0 : exp(-beta * (2 * h)));
+      }
+    }
+    return values.data() + max_field;
+  }
+};
+
+thread_local FlipTable flip_table;
+
+// Scratch space of the Wolff cluster builder, one per thread. Visited marks
+// carry the epoch of the cluster that set them, so starting a cluster bumps
+// the epoch instead of clearing num_spins flags, and the stack keeps its
+// capacity between clusters. For discrete bonds it also holds the add
+// probabilities 1 - exp(-2 beta unit k) for bond magnitudes k, rebuilt when
+// beta changes like FlipTable.
+struct ClusterWorkspace {
+  std::vector<std::uint32_t> marks;
+  std::uint32_t epoch = 0;
+  std::vector<int> stack;
+
+  double beta = std::numeric_limits<double>::quiet_NaN();
+  double bond_unit = 0.0;
+  std::vector<double> add_probabilities;
+
+  void beginCluster(int num_spins) {
+    if (marks.size() < static_cast<std::size_t>(num_spins)) {
+      marks.resize(num_spins, 0);
+      stack.reserve(num_spins);
+    }
+    if (++epoch == 0) {
+      std::fill(marks.begin(), marks.end(), 0);
+      epoch = 1;
+    }
+    stack.clear();
+  }
+  bool visited(int i) const { return marks[i] == epoch; }
+  void visit(int i) {
+    marks[i] = epoch;
+    stack.push_back(i);
+  }
+
+  const double* addProbabilities(double new_beta, double new_bond_unit,
+                                 int max_bond) {
+    if (new_beta != beta || new_bond_unit != bond_unit ||
+        add_probabilities.size() != static_cast<std::size_t>(max_bond + 1)) {
+      beta = new_beta;
+      bond_unit = new_bond_unit;
+      add_probabilities.resize(max_bond + 1);
+      for (int k = 0; k <= max_bond; ++k) {
+        add_probabilities[k] = 1 - exp(-2 * beta * bond_unit * k);
+      }
+    }
+    return add_probabilities.data();
+  }
+};
+
+thread_local ClusterWorkspace cluster_workspace;
+
+// Scratch space of the Swendsen-Wang update: union-find parents, per-site
+// cluster flip flags and per-chunk energy changes. The threads of one update
+// share the workspace of the thread that called it.
+struct SwendsenWangWorkspace {
+  std::vector<int> parents;
+  std::vector<std::uint8_t> flips;
+  std::vector<double> chunk_deltas;
+};
+
+thread_local SwendsenWangWorkspace swendsen_wang_workspace;
+
+// Scratch space of the n-fold way update: the sites of every class
+// c = s_i k_i + max_field (k_i the local field in units of bond_unit), each
+// site's class and its position within it. Buckets keep their capacity
+// between calls.
+struct NFoldWayWorkspace {
+  std::vector<std::vector<int>> buckets;
+  std::vector<int> site_class;
+  std::vector<int> position;
+
+  void reset(int num_spins, int num_classes) {
+    buckets.resize(num_classes);
+    for (auto& bucket : buckets) {
+      bucket.clear();
+    }
+    site_class.resize(num_spins);
+    position.resize(num_spins);
+  }
+  void insert(int i, int c) {
+    site_class[i] = c;
+    position[i] = static_cast<int>(buckets[c].size());
+    buckets[c].push_back(i);
+  }
+  void erase(int i) {
+    std::vector<int>& bucket = buckets[site_class[i]];
+    const int last = bucket.back();
+    bucket[position[i]] = last;
+    position[last] = position[i];
+    bucket.pop_back();
+  }
+};
+
+thread_local NFoldWayWorkspace n_fold_way_workspace;
+
+// Sites per work chunk of the Swendsen-Wang passes; a multiple of 64 so that
+// threads never share a word of bit storage.
+constexpr int SW_CHUNK = 4096;
+
+// Lock-free union-find with parents[i] <= i (after ECL-CC, Jaiganesh and
+// Burtscher, HPDC'18). A root is only ever linked under a smaller root, so
+// each cluster ends up rooted at its smallest site whatever order the unions
+// run in. Path halving only redirects non-roots to other ancestors, which
+// cannot conflict with the compare-and-swap on a root.
+inline int findRoot(int* parents, int i) {
+  int curr = __atomic_load_n(&parents[i], __ATOMIC_RELAXED);
+  if (curr != i) {
+    int prev = i;
+    int next;
+    while (curr > (next = __atomic_load_n(&parents[curr], __ATOMIC_RELAXED))) {
+      __atomic_store_n(&parents[prev], next, __ATOMIC_RELAXED);
+      prev = curr;
+      curr = next;
+    }
+  }
+  return curr;
+}
+
+inline void unite(int* parents, int i, int j) {
+  int a = findRoot(parents, i);
+  int b = findRoot(parents, j);
+  while (a != b) {
+    if (a > b) {
+      std::swap(a, b);
+    }
+    int expected = b;
+    if (__atomic_compare_exchange_n(&parents[b], &expected, a, false,
+                                    __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+      return;
+    }
+    // b was linked meanwhile; continue from the new roots.
+    a = findRoot(parents, a);
+    b = findRoot(parents, expected);
+  }
+}
+
+// Nearest integer to a local field that is an exact multiple of the bond unit
+// up to rounding; avoids a libm call in the inner loop.
+inline int fieldIndex(double multiple) {
+  return static_cast<int>(multiple + (multiple >= 0 ? 0.5 : -0.5));
+}
+
+// Calls f with the access policy matching storage.
+template <typename F>
+decltype(auto) withSpins(SpinStorage storage, F&& f) {
+  switch (storage) {
+    case SpinStorage::int32:
+      return f(Int32Spins{});
+    case SpinStorage::int8:
+      return f(Int8Spins{});
+    case SpinStorage::bit:
+      return f(BitSpins{});
+  }
+  throw std::invalid_argument("Unknown spin storage!");
+}
+
+// Bond policies of the single-spin kernels. With uniform bonds the local
+// field is bond_table[0] times the integer sum of the neighbor spins and the
+// bond table is never read; discrete bonds accumulate the field in doubles
+// and look the acceptance up in FlipTable; continuous bonds call exp().
+struct UniformBonds {};
+struct DiscreteBonds {};
+struct ContinuousBonds {};
+
+// Calls f with a std::integral_constant holding num_neighbors when a kernel
+// is specialized for it (2D square, 3D cubic and 4D hypercubic lattices),
+// and 0 (read at run time) otherwise.
+template <typename F>
+decltype(auto) withCoordination(int num_neighbors, F&& f) {
+  switch (num_neighbors) {
+    case 4:
+      return f(std::integral_constant<int, 4>{});
+    case 6:
+      return f(std::integral_constant<int, 6>{});
+    case 8:
+      return f(std::integral_constant<int, 8>{});
+    default:
+      return f(std::integral_constant<int, 0>{});
+  }
+}
+
+// Neighbor policies. site(i) returns the neighbors and bonds of site i as
+// neighbor(n) and bond(n), in the order of the neighbor table. The ordered
+// sweeps visit every site, or every site of one checkerboard color, through
+// forEachSite and forEachSiteOfColor.
+
+// Neighbor and bond tables, num_neighbors entries per site. Z is the number
+// of neighbors, or 0 for z read at run time.
+template <int Z>
+struct TableTopology {
+  const int* neighbor_table;
+  const double* bond_table;
+  int z_runtime;
+  int num_spins;
+  int L;
+
+  struct Site {
+    const int* neighbors;
+    const double* bonds;
+    int neighbor(int n) const { return neighbors[n]; }
+    double bond(int n) const { return bonds[n]; }
+  };
+
+  Site site(int i) const {
+    const int z = Z > 0 ? Z : z_runtime;
+    return {neighbor_table + i * z, bond_table + i * z};
+  }
+  template <typename F>
+  void forEachSite(F&& f) const {
+    for (int i = 0; i < num_spins; ++i) {
+      f(i, site(i));
+    }
+  }
+  // Only on the cubic lattice (SharedModelData::cubic_lattice).
+  template <typename F>
+  void forEachSiteOfColor(int color, F&& f) const {
+    for (int x = 0; x < L; ++x) {
+      for (int y = 0; y < L; ++y) {
+        const int base = (x * L + y) * L;
+        for (int z = (color + x + y) & 1; z < L; z += 2) {
+          f(base + z, site(base + z));
+        }
+      }
+    }
+  }
+};
+
+__extension__ typedef unsigned __int128 uint128_t;
+
+// Periodic hypercubic lattice of side L in D dimensions (0: dimension read at
+// run time), numbered like initializeNeighborTableND. The neighbors of site i
+// along dimension d are i -/+ stride_d, or i +/- (L - 1) stride_d across the
+// boundary, chosen by a compare and select on the coordinate. Random sites
+// get their coordinates by multiplying with a precomputed 2^64 / L (exact for
+// 32-bit indices, Lemire, Kaser and Kurz 2019) instead of dividing. The
+// ordered sweeps walk the lattice row by row along the last dimension, where
+// only the first and last site of a row wrap.
+template <int D>
+struct HypercubicTopology {
+  static constexpr int MAX_D =
+      D > 0 ? D : SharedModelData<IsingModel>::MAX_LATTICE_DIMENSION;
+
+  int L;
+  int dimension;
+  int num_spins;
+  const double* bonds;
+  std::uint64_t inverse_L;
+  int strides[MAX_D];
+
+  HypercubicTopology(int L, int dimension, int num_spins, const double* bonds)
+      : L(L),
+        dimension(D > 0 ? D : dimension),
+        num_spins(num_spins),
+        bonds(bonds),
+        inverse_L(~std::uint64_t{0} / L + 1) {
+    int stride = 1;
+    for (int d = dim() - 1; d >= 0; --d) {
+      strides[d] = stride;
+      stride *= L;
+    }
+  }
+
+  int dim() const { return D > 0 ? D : dimension; }
+
+  // Neighbor n of site i is i + offsets[n].
+  struct Site {
+    int i;
+    int offsets[2 * MAX_D];
+    const double* bonds;
+    int num_spins;
+    int neighbor(int n) const { return i + offsets[n]; }
+    // One bond table per dimension, holding the +1 bond of each site; the -1
+    // bond is the +1 bond of the neighbor.
+    double bond(int n) const {
+      const int holder = (n & 1) ? i : i + offsets[n];
+      return bonds[(n >> 1) * num_spins + holder];
+    }
+  };
+
+  void setOffsets(Site& site, int d, int x) const {
+    const int stride = strides[d];
+    const int wrap = (L - 1) * stride;
+    site.offsets[2 * d] = x == 0 ? wrap : -stride;
+    site.offsets[2 * d + 1] = x == L - 1 ? -wrap : stride;
+  }
+
+  Site site(int i) const {
+    Site site;
+    site.i = i;
+    site.bonds = bonds;
+    site.num_spins = num_spins;
+    std::uint32_t q = static_cast<std::uint32_t>(i);
+    for (int d = dim() - 1; d >= 0; --d) {
+      const std::uint32_t next = static_cast<std::uint32_t>(
+          (static_cast<uint128_t>(inverse_L) * q) >> 64);
+      setOffsets(site, d, static_cast<int>(q - next * L));
+      q = next;
+    }
+    return site;
+  }
+
+  // Calls f(i, site) for the sites in index order, or with color >= 0 for
+  // those whose coordinates sum to color modulo 2 (L even).
+  template <typename F>
+  void walk(int color, F&& f) const {
+    const int last = dim() - 1;
+    int coordinates[MAX_D] = {};
+    Site site;
+    site.bonds = bonds;
+    site.num_spins = num_spins;
+    for (int row = 0; row < num_spins; row += L) {
+      int parity = 0;
+      for (int d = 0; d < last; ++d) {
+        setOffsets(site, d, coordinates[d]);
+        parity += coordinates[d];
+      }
+      const int step = color < 0 ? 1 : 2;
+      for (int x = color < 0 ? 0 : (color + parity) & 1; x < L; x += step) {
+        site.i = row + x;
+        setOffsets(site, last, x);
+        f(site.i, site);
+      }
+      for (int d = last - 1; d >= 0; --d) {
+        if (++coordinates[d] < L) {
+          break;
+        }
+        coordinates[d] = 0;
+      }
+    }
+  }
+  template <typename F>
+  void forEachSite(F&& f) const {
+    walk(-1, f);
+  }
+  template <typename F>
+  void forEachSiteOfColor(int color, F&& f) const {
+    walk(color, f);
+  }
+};
+
+// Calls f with a std::integral_constant holding the lattice dimension.
+template <typename F>
+decltype(auto) withLatticeDimension(int dimension, F&& f) {
+  switch (dimension) {
+    case 2:
+      return f(std::integral_constant<int, 2>{});
+    case 3:
+      return f(std::integral_constant<int, 3>{});
+    case 4:
+      return f(std::integral_constant<int, 4>{});
+    case 5:
+      return f(std::integral_constant<int, 5>{});
+  }
+  throw std::invalid_argument("Unsupported lattice dimension");
+}
+
+}  // namespace
+
+template <typename F>
+decltype(auto) IsingModel::withTopology(F&& f) const {
+  if (lattice_dimension_ > 0) {
+    return f(HypercubicTopology<0>(system_size_, lattice_dimension_,
+                                   num_spins_, lattice_bonds_));
+  }
+  return f(TableTopology<0>{neighbor_table_, bond_table_, num_neighbors_,
+                            num_spins_, system_size_});
+}
+
+SharedModelData<IsingModel> SharedModelData<IsingModel>::relabeled(
+    int system_size, int num_spins, int num_neighbors,
+    const int* neighbor_table, const double* bond_table,
+    SpinOrder spin_order, SpinStorage spin_storage) {
+  // 4^3 int8 spins fill one cache line.
+  constexpr int TILE = 4;
+  const long num_entries = static_cast<long>(num_spins) * num_neighbors;
+  std::vector<int> order;
+  switch (spin_order) {
+    case SpinOrder::original:
+      order.resize(num_spins);
+      std::iota(order.begin(), order.end(), 0);
+      break;
+    case SpinOrder::morton:
+    case SpinOrder::tiled: {
+      // Any numbering of the neighbors of each site will do, e.g. tables
+      // written with the first coordinate fastest.
+      std::vector<int> cubic = initializeNeighborTable3D(system_size);
+      bool is_cubic = num_neighbors == 6 &&
+                      static_cast<long>(cubic.size()) == num_entries;
+      for (long row = 0; is_cubic && row < num_entries; row += 6) {
+        int given[6];
+        std::copy(neighbor_table + row, neighbor_table + row + 6, given);
+        std::sort(given, given + 6);
+        std::sort(cubic.begin() + row, cubic.begin() + row + 6);
+        is_cubic = std::equal(given, given + 6, cubic.begin() + row);
+      }
+      if (!is_cubic) {
+        throw std::invalid_argument(
+            "Morton and tiled orders need a periodic L x L x L cubic lattice");
+      }
+      order = spin_order == SpinOrder::morton
+                  ? mortonOrder3D(system_size)
+                  : tiledOrder3D(system_size, TILE);
+      break;
+    }
+    case SpinOrder::rcm: {
+      std::vector<long> row_offsets(num_spins + 1);
+      for (int i = 0; i <= num_spins; ++i) {
+        row_offsets[i] = static_cast<long>(i) * num_neighbors;
+      }
+      for (long b = 0; b < num_entries; ++b) {
+        if (neighbor_table[b] < 0 || neighbor_table[b] >= num_spins) {
+          throw std::invalid_argument("Neighbor index out of range");
+        }
+      }
+      order = reverseCuthillMcKee(
+          num_spins, row_offsets,
+          std::vector<int>(neighbor_table, neighbor_table + num_entries));
+      break;
+    }
+  }
+  return SharedModelData(system_size, num_spins, num_neighbors, neighbor_table,
+                         bond_table, std::move(order), spin_storage);
+}
+
+std::size_t IsingModel::stateBytes(
+    const SharedModelData<IsingModel>& shared_data) {
+  return spinBytes(shared_data.spin_storage, shared_data.num_spins);
+}
+
+std::uint64_t IsingModel::stateLayout(
+    const SharedModelData<IsingModel>& shared_data) {
+  const std::vector<int>& order = shared_data.order;
+  std::uint64_t hash = 0;
+  for (std::size_t k = 0; k < order.size(); ++k) {
+    if (order[k] != static_cast<int>(k)) {
+      // FNV-1a over the order
+      hash = 14695981039346656037ULL;
+      for (int i : order) {
+        hash = (hash ^ static_cast<std::uint32_t>(i)) * 1099511628211ULL;
+      }
+      break;
+    }
+  }
+  return hash;
+}
+
+// A null state allocates storage owned by this model.
 IsingModel::IsingModel(const SharedModelData<IsingModel>& shared_data)
+    : IsingModel(shared_data, nullptr) {}
+
+IsingModel::IsingModel(const SharedModelData<IsingModel>& shared_data,
+                       void* state)
     : num_spins_(shared_data.num_spins),
       num_neighbors_(shared_data.num_neighbors),
       system_size_(shared_data.system_size),
       neighbor_table_(shared_data.neighbor_table),
-      bond_table_(shared_data.bond_table) {
+      bond_table_(shared_data.bond_table),
+      spin_storage_(shared_data.spin_storage),
+      uniform_bonds_(shared_data.uniform_bonds),
+      uniform_bond_(shared_data.uniform_bond),
+      discrete_bonds_(shared_data.discrete_bonds),
+      bond_unit_(shared_data.bond_unit),
+      inv_bond_unit_(shared_data.discrete_bonds ? 1.0 / shared_data.bond_unit
+                                                : 0.0),
+      max_field_(shared_data.num_neighbors * shared_data.max_bond_multiple),
+      cubic_lattice_(shared_data.cubic_lattice),
+      direction_bonds_(shared_data.direction_bonds.empty()
+                           ? nullptr
+                           : shared_data.direction_bonds.data()),
+      lattice_dimension_(shared_data.lattice_dimension),
+      lattice_bonds_(shared_data.lattice_bonds.data()),
+      order_(shared_data.order.empty() ? nullptr : shared_data.order.data()),
+      label_(shared_data.label.empty() ? nullptr : shared_data.label.data()),
+      spins_(state),
+      state_bytes_(stateBytes(shared_data)),
+      owns_state_(state == nullptr) {
   assert(num_neighbors_ % 2 == 0 &&
          "Neighbor table must use even pairing (+/- directions)");
-  spins_ = new int[num_spins_];
-  for (int i = 0; i < num_spins_; ++i) {
-    spins_[i] = 1;
+  if (owns_state_) {
+    spins_ = ::operator new(state_bytes_,
+                            std::align_val_t{ReplicaArena::ALIGNMENT});
   }
+  std::memset(spins_, 0, state_bytes_);
+  withSpins(spin_storage_, [&](auto spins) {
+    using Spins = decltype(spins);
+    for (int i = 0; i < num_spins_; ++i) {
+      Spins::set(spins_, i, 1);
+    }
+  });
+  energy_ = computeEnergy();
 }
 
-IsingModel::~IsingModel() { delete[] spins_; }
+IsingModel::IsingModel(IsingModel&& other) noexcept
+    : Model(other),
+      num_spins_(other.num_spins_),
+      num_neighbors_(other.num_neighbors_),
+      system_size_(other.system_size_),
+      neighbor_table_(other.neighbor_table_),
+      bond_table_(other.bond_table_),
+      spin_storage_(other.spin_storage_),
+      uniform_bonds_(other.uniform_bonds_),
+      uniform_bond_(other.uniform_bond_),
+      discrete_bonds_(other.discrete_bonds_),
+      bond_unit_(other.bond_unit_),
+      inv_bond_unit_(other.inv_bond_unit_),
+      max_field_(other.max_field_),
+      cubic_lattice_(other.cubic_lattice_),
+      direction_bonds_(other.direction_bonds_),
+      lattice_dimension_(other.lattice_dimension_),
+      lattice_bonds_(other.lattice_bonds_),
+      order_(other.order_),
+      label_(other.label_),
+      spins_(other.spins_),
+      state_bytes_(other.state_bytes_),
+      owns_state_(other.owns_state_),
+      energy_(other.energy_) {
+  other.spins_ = nullptr;
+  other.owns_state_ = false;
+}
 
-void IsingModel::initializeState(gsl_rng* r) {
-  for (int i = 0; i < num_spins_; ++i) {
-    int s = gsl_rng_uniform_int(r, 2) * 2 - 1;
-    spins_[i] = s;
+IsingModel::~IsingModel() {
+  if (owns_state_) {
+    ::operator delete(spins_, std::align_val_t{ReplicaArena::ALIGNMENT});
   }
 }
 
-void IsingModel::copyStateFrom(const Model& other) {
-  const IsingModel& isingOther = static_cast<const IsingModel&>(other);
-  assert(this->system_size_ == isingOther.system_size_ &&
-         "System sizes must match!");
-  assert(this->num_spins_ == isingOther.num_spins_ &&
-         "Number of spins must match!");
-  for (int i = 0; i < num_spins_; ++i) {
-    this->spins_[i] = isingOther.spins_[i];
-    this->family_ = isingOther.family_;
-    this->parent_ = isingOther.parent_;
-  }
+void IsingModel::initializeState(gsl_rng* r) {
+  withSpins(spin_storage_, [&](auto spins) {
+    using Spins = decltype(spins);
+    for (int i = 0; i < num_spins_; ++i) {
+      int s = gsl_rng_uniform_int(r, 2) * 2 - 1;
+      Spins::set(spins_, i, s);
+    }
+  });
+  energy_ = computeEnergy();
+}
+
+void IsingModel::copyStateFrom(const IsingModel& other) {
+  assert(system_size_ == other.system_size_ && "System sizes must match!");
+  assert(num_spins_ == other.num_spins_ && "Number of spins must match!");
+  assert(spin_storage_ == other.spin_storage_ && "Spin storage must match!");
+  // Both buffers start on an ALIGNMENT boundary (owned or arena slot).
+  std::memcpy(__builtin_assume_aligned(spins_, ReplicaArena::ALIGNMENT),
+              __builtin_assume_aligned(other.spins_, ReplicaArena::ALIGNMENT),
+              state_bytes_);
+  energy_ = other.energy_;
+  copyGenealogyFrom(other);
+}
+
+void IsingModel::restoreState(const void* state, double energy) {
+  std::memcpy(spins_, state, state_bytes_);
+  energy_ = energy;
 }
 
 double IsingModel::measureEnergy() const {
-  double energy = 0.0;
+#ifndef NDEBUG
+  const double full_energy = computeEnergy();
+  assert(std::abs(energy_ - full_energy) <= 1e-6 * (1 + std::abs(full_energy)) &&
+         "Running energy out of sync with the spins");
+#endif
+  return energy_;
+}
+
+double IsingModel::computeEnergy() const {
+  return withSpins(spin_storage_, [&](auto spins) {
+    return this->computeEnergyImpl<decltype(spins)>();
+  });
+}
+
+// One Swendsen-Wang update: every satisfied bond is activated with
+// probability 1 - exp(-2 beta |J|), the resulting clusters are built with the
+// lock-free union-find, and each cluster is flipped with probability 1/2.
+// All passes run on the OpenMP threads available to the caller. The bond and
+// cluster decisions come from Philox blocks under a key drawn from r, indexed
+// by site and by cluster root, so the update does not depend on the number
+// of threads.
+template <typename Spins, typename Rng>
+void IsingModel::swendsenWang(Rng& r, double beta,
+                              const double* add_probabilities) {
+  SwendsenWangWorkspace& workspace = swendsen_wang_workspace;
+  const int num_chunks = (num_spins_ + SW_CHUNK - 1) / SW_CHUNK;
+  workspace.parents.resize(num_spins_);
+  workspace.flips.resize(num_spins_);
+  workspace.chunk_deltas.resize(num_chunks);
+  int* parents = workspace.parents.data();
+  std::uint8_t* flips = workspace.flips.data();
+  double* chunk_deltas = workspace.chunk_deltas.data();
+
+  const std::uint64_t key = rngBits64(r);
+  // Every bond is visited once, from the site that holds it as an even
+  // neighbor (as in computeEnergy), with one Philox word per bond.
+  const int half = num_neighbors_ / 2;
+  const int blocks_per_site = (half + 3) / 4;
+
+  #pragma omp parallel for schedule(static)
   for (int i = 0; i < num_spins_; ++i) {
-    // Skip every second neighbor to avoid double-counting bonds.
-    // Assumes symmetric neighbor table with even num_neighbors_.
-    for (int n = 0; n < num_neighbors_; n += 2) {
-      int j = neighbor_table_[i * num_neighbors_ + n];
-      energy -= spins_[i] * spins_[j] * bond_table_[i * num_neighbors_ + n];
+    parents[i] = i;
+  }
+
+  withTopology([&](const auto& topology) {
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < num_spins_; ++i) {
+      const auto site = topology.site(i);
+      const int spin = Spins::get(spins_, i);
+      std::uint32_t bits[4];
+      for (int h = 0; h < half; ++h) {
+        if (h % 4 == 0) {
+          Philox4x32::block(key, 0,
+                            static_cast<std::uint64_t>(i) * blocks_per_site +
+                                h / 4,
+                            bits);
+        }
+        const int j = site.neighbor(2 * h);
+        const double J = site.bond(2 * h);
+        if (spin * Spins::get(spins_, j) * J > 0) {
+          const double P_add =
+              add_probabilities
+                  ? add_probabilities[fieldIndex(std::abs(J) * inv_bond_unit_)]
+                  : -std::expm1(-2 * beta * std::abs(J));
+          if (bits[h % 4] * 0x1p-32 < P_add) {
+            unite(parents, i, j);
+          }
+        }
+      }
     }
+  });
+
+  #pragma omp parallel for schedule(static)
+  for (int i = 0; i < num_spins_; ++i) {
+    std::uint32_t bits[4];
+    Philox4x32::block(key, 1, findRoot(parents, i), bits);
+    flips[i] = bits[0] & 1;
+  }
+
+  // Bonds between a flipped and an unflipped cluster change sign. The energy
+  // change is summed per chunk and then over chunks in order.
+  withTopology([&](const auto& topology) {
+    #pragma omp parallel for schedule(static)
+    for (int c = 0; c < num_chunks; ++c) {
+      const int end = std::min(num_spins_, (c + 1) * SW_CHUNK);
+      double delta = 0.0;
+      for (int i = c * SW_CHUNK; i < end; ++i) {
+        const auto site = topology.site(i);
+        for (int h = 0; h < half; ++h) {
+          const int j = site.neighbor(2 * h);
+          if (flips[i] != flips[j]) {
+            delta += 2 * site.bond(2 * h) * Spins::get(spins_, i) *
+                     Spins::get(spins_, j);
+          }
+        }
+      }
+      chunk_deltas[c] = delta;
+    }
+  });
+
+  #pragma omp parallel for schedule(static)
+  for (int c = 0; c < num_chunks; ++c) {
+    const int end = std::min(num_spins_, (c + 1) * SW_CHUNK);
+    for (int i = c * SW_CHUNK; i < end; ++i) {
+      if (flips[i]) {
+        Spins::flip(spins_, i);
+      }
+    }
+  }
+  for (int c = 0; c < num_chunks; ++c) {
+    energy_ += chunk_deltas[c];
   }
-  return energy;
+}
+
+template <typename Spins>
+double IsingModel::computeEnergyImpl() const {
+  return withTopology([&](const auto& topology) {
+    double energy = 0.0;
+    if constexpr (std::is_same_v<Spins, BitSpins>) {
+      // Gather the neighbor bits of 64 consecutive sites into one word so
+      // that s_i * s_j = -1 shows up as a set bit of site_word ^
+      // neighbor_word.
+      const auto* words = static_cast<const BitSpins::Word*>(spins_);
+      for (int base = 0; base < num_spins_; base += 64) {
+        const int count = std::min(64, num_spins_ - base);
+        for (int n = 0; n < num_neighbors_; n += 2) {
+          BitSpins::Word neighbor_word = 0;
+          for (int k = 0; k < count; ++k) {
+            int j = topology.site(base + k).neighbor(n);
+            neighbor_word |= ((words[j >> 6] >> (j & 63)) & 1) << k;
+          }
+          const BitSpins::Word antiparallel = words[base >> 6] ^ neighbor_word;
+          if (uniform_bonds_) {
+            energy -= uniform_bond_ *
+                      (count - 2 * __builtin_popcountll(antiparallel));
+          } else {
+            for (int k = 0; k < count; ++k) {
+              double J = topology.site(base + k).bond(n);
+              energy -= ((antiparallel >> k) & 1) ? -J : J;
+            }
+          }
+        }
+      }
+    } else {
+      for (int i = 0; i < num_spins_; ++i) {
+        // Skip every second neighbor to avoid double-counting bonds.
+        // Assumes symmetric neighbor table with even num_neighbors_.
+        const auto site = topology.site(i);
+        for (int n = 0; n < num_neighbors_; n += 2) {
+          int j = site.neighbor(n);
+          energy -= Spins::get(spins_, i) * Spins::get(spins_, j) *
+                    site.bond(n);
+        }
+      }
+    }
+    return energy;
+  });
 }
 
 double IsingModel::measureMagnetization() const {
-  int mag = 0;
-  for (int i = 0; i < num_spins_; ++i) {
-    mag += spins_[i];
+  if (spin_storage_ == SpinStorage::bit) {
+    const auto* words = static_cast<const BitSpins::Word*>(spins_);
+    long down = 0;
+    for (std::size_t w = 0; w < state_bytes_ / sizeof(BitSpins::Word); ++w) {
+      down += __builtin_popcountll(words[w]);
+    }
+    return static_cast<double>(num_spins_ - 2 * down);
   }
-  return static_cast<double>(mag);
+  return withSpins(spin_storage_, [&](auto spins) {
+    using Spins = decltype(spins);
+    int mag = 0;
+    for (int i = 0; i < num_spins_; ++i) {
+      mag += Spins::get(spins_, i);
+    }
+    return static_cast<double>(mag);
+  });
+}
+
+double IsingModel::measureObservable(Observable observable) const {
+  switch (observable) {
+    case Observable::energy:
+      return measureEnergy();
+    case Observable::magnetization:
+      return measureMagnetization();
+    default:
+      throw std::invalid_argument("Unknown observable!");
+  }
+}
+
+double IsingModel::measureOverlap(const IsingModel& other) const {
+  assert(num_spins_ == other.num_spins_ && "Number of spins must match!");
+  assert(spin_storage_ == other.spin_storage_ && "Spin storage must match!");
+  if (spin_storage_ == SpinStorage::bit) {
+    const auto* a = static_cast<const BitSpins::Word*>(spins_);
+    const auto* b = static_cast<const BitSpins::Word*>(other.spins_);
+    long differ = 0;
+    for (std::size_t w = 0; w < state_bytes_ / sizeof(BitSpins::Word); ++w) {
+      differ += __builtin_popcountll(a[w] ^ b[w]);
+    }
+    return static_cast<double>(num_spins_ - 2 * differ);
+  }
+  return withSpins(spin_storage_, [&](auto spins) {
+    using Spins = decltype(spins);
+    int q = 0;
+    for (int i = 0; i < num_spins_; ++i) {
+      q += Spins::get(spins_, i) * Spins::get(other.spins_, i);
+    }
+    return static_cast<double>(q);
+  });
+}
+
+const std::vector<int> IsingModel::getState() const {
+  std::vector<int> state(num_spins_);
+  withSpins(spin_storage_, [&](auto spins) {
+    using Spins = decltype(spins);
+    for (int k = 0; k < num_spins_; ++k) {
+      state[order_ ? order_[k] : k] = Spins::get(spins_, k);
+    }
+  });
+  return state;
+}
+
+int IsingModel::houdayerMove(IsingModel& other, gsl_rng* r) {
+  assert(num_spins_ == other.num_spins_ && "Number of spins must match!");
+  assert(spin_storage_ == other.spin_storage_ && "Spin storage must match!");
+  return withSpins(spin_storage_, [&](auto spins) {
+    return this->houdayerMoveImpl<decltype(spins)>(other, r);
+  });
+}
+
+int IsingModel::houdayerMove(IsingModel& other, RandomStream& r) {
+  assert(num_spins_ == other.num_spins_ && "Number of spins must match!");
+  assert(spin_storage_ == other.spin_storage_ && "Spin storage must match!");
+  return withSpins(spin_storage_, [&](auto spins) {
+    return this->houdayerMoveImpl<decltype(spins)>(other, r);
+  });
 }
 
 void IsingModel::updateSweep(int num_sweeps, double beta, gsl_rng* r,
                              UpdateMethod method, bool sequential) {
-  void (IsingModel::*update_func)(gsl_rng*, double, int) = nullptr;
+  withSpins(spin_storage_, [&](auto spins) {
+    this->updateSweepImpl<decltype(spins)>(num_sweeps, beta, r, method,
+                                           sequential);
+  });
+}
+
+void IsingModel::updateSweep(int num_sweeps, double beta, RandomStream& r,
+                             UpdateMethod method, bool sequential) {
+  withSpins(spin_storage_, [&](auto spins) {
+    this->updateSweepImpl<decltype(spins)>(num_sweeps, beta, r, method,
+                                           sequential);
+  });
+}
+
+template <typename Spins, typename Rng>
+void IsingModel::updateSweepImpl(int num_sweeps, double beta, Rng& r,
+                                 UpdateMethod method, bool sequential) {
   switch (method) {
     case UpdateMethod::metropolis:
-      update_func = &IsingModel::metropolis;
-      break;
     case UpdateMethod::heat_bath:
-      update_func = &IsingModel::heatBath;
-      break;
+      singleSpinSweeps<Spins>(
+          num_sweeps, beta, r, method == UpdateMethod::heat_bath,
+          sequential ? SiteOrder::sequential : SiteOrder::random);
+      return;
     case UpdateMethod::wolff:
       if (sequential) {
         throw std::invalid_argument(
@@ -80,116 +935,435 @@ void IsingModel::updateSweep(int num_sweeps, double beta, gsl_rng* r,
       }
       // wolff method handled separately below due to randomness in number of
       // flipped spins
-      for (int sweep = 0; sweep < num_sweeps; ++sweep) {
-        int num_flipped = 0;
-        while (num_flipped < num_spins_) {
-          num_flipped += wolff(r, beta);
+      {
+        const double* add_probabilities =
+            discrete_bonds_ ? cluster_workspace.addProbabilities(
+                                  beta, bond_unit_, max_field_)
+                            : nullptr;
+        for (int sweep = 0; sweep < num_sweeps; ++sweep) {
+          int num_flipped = 0;
+          while (num_flipped < num_spins_) {
+            num_flipped += wolff<Spins>(r, beta, add_probabilities);
+          }
         }
       }
       return;
+    case UpdateMethod::swendsen_wang: {
+      const double* add_probabilities =
+          discrete_bonds_ ? cluster_workspace.addProbabilities(
+                                beta, bond_unit_, max_field_)
+                          : nullptr;
+      for (int sweep = 0; sweep < num_sweeps; ++sweep) {
+        swendsenWang<Spins>(r, beta, add_probabilities);
+      }
+      return;
+    }
+    case UpdateMethod::n_fold_way:
+      nFoldWay<Spins>(num_sweeps, beta, r);
+      return;
+    case UpdateMethod::metropolis_checkerboard:
+    case UpdateMethod::heat_bath_checkerboard:
+      checkerboardSweep<Spins>(
+          num_sweeps, beta, r, method == UpdateMethod::heat_bath_checkerboard);
+      return;
     default:
       throw std::invalid_argument("Unknown update method!");
   }
 
-  // For metropolis and heatBath, use the chosen update function pointer and
-  // flip spins individually
-  if (sequential) {
-    for (int sweep = 0; sweep < num_sweeps; ++sweep) {
-      for (int i = 0; i < num_spins_; ++i) {
-        (this->*update_func)(r, beta, i);
+}
+
+template <typename Spins, typename Rng>
+void IsingModel::singleSpinSweeps(int num_sweeps, double beta, Rng& r,
+                                  bool heat_bath, SiteOrder order) {
+  auto run = [&](const auto& topology, auto z) {
+    using Topology = std::decay_t<decltype(topology)>;
+    constexpr int Z = decltype(z)::value;
+    auto run_bonds = [&](auto bonds) {
+      using Bonds = decltype(bonds);
+      if (heat_bath) {
+        this->singleSpinKernel<Spins, Topology, Bonds, Z, true>(
+            topology, num_sweeps, beta, r, order);
+      } else {
+        this->singleSpinKernel<Spins, Topology, Bonds, Z, false>(
+            topology, num_sweeps, beta, r, order);
       }
+    };
+    if (uniform_bonds_ && discrete_bonds_) {
+      run_bonds(UniformBonds{});
+    } else if (discrete_bonds_) {
+      run_bonds(DiscreteBonds{});
+    } else {
+      run_bonds(ContinuousBonds{});
     }
+  };
+  if (lattice_dimension_ > 0) {
+    withLatticeDimension(lattice_dimension_, [&](auto d) {
+      constexpr int D = decltype(d)::value;
+      run(HypercubicTopology<D>(system_size_, D, num_spins_, lattice_bonds_),
+          std::integral_constant<int, 2 * D>{});
+    });
   } else {
-    for (int sweep = 0; sweep < num_sweeps; ++sweep) {
-      for (int i = 0; i < num_spins_; ++i) {
-        int s = gsl_rng_uniform_int(r, num_spins_);
-        (this->*update_func)(r, beta, s);
+    withCoordination(num_neighbors_, [&](auto z) {
+      constexpr int Z = decltype(z)::value;
+      run(TableTopology<Z>{neighbor_table_, bond_table_, num_neighbors_,
+                           num_spins_, system_size_},
+          z);
+    });
+  }
+}
+
+// The update of one site is inlined into the site loops, with the
+// coordination number and the bond type known at compile time, so the
+// neighbor loop is unrolled. The running energy is accumulated in a local:
+// spin stores through spins_ may alias any member, so energy_ itself would be
+// reloaded and stored on every accepted flip.
+template <typename Spins, typename Topology, typename Bonds, int Z,
+          bool HeatBath, typename Rng>
+void IsingModel::singleSpinKernel(const Topology& topology, int num_sweeps,
+                                  double beta, Rng& r, SiteOrder order) {
+  constexpr bool tabulated = !std::is_same_v<Bonds, ContinuousBonds>;
+  const int z = Z > 0 ? Z : num_neighbors_;
+  void* const spins = spins_;
+  const double bond_unit = bond_unit_;
+  const double inv_bond_unit = inv_bond_unit_;
+  const double* const flip_probabilities =
+      tabulated ? flip_table.center(beta, HeatBath, bond_unit, max_field_)
+                : nullptr;
+  // Sign of the uniform bond, in units of bond_unit.
+  const int uniform_multiple = uniform_bond_ > 0 ? 1 : -1;
+  double energy = energy_;
+
+  auto update = [&](int i, const auto& site) {
+    const int spin = Spins::get(spins, i);
+    if constexpr (tabulated) {
+      // Local field in units of bond_unit.
+      int field;
+      if constexpr (std::is_same_v<Bonds, UniformBonds>) {
+        int sum = 0;
+        for (int n = 0; n < z; ++n) {
+          sum += Spins::get(spins, site.neighbor(n));
+        }
+        field = uniform_multiple * sum;
+      } else {
+        double local_h = 0.0;
+        for (int n = 0; n < z; ++n) {
+          local_h += Spins::get(spins, site.neighbor(n)) * site.bond(n);
+        }
+        field = fieldIndex(local_h * inv_bond_unit);
+      }
+      if constexpr (HeatBath) {
+        const int new_spin = rngUniform(r) < flip_probabilities[field] ? 1 : -1;
+        if (new_spin != spin) {
+          Spins::set(spins, i, new_spin);
+          energy += 2 * bond_unit * spin * field;
+        }
+      } else {
+        const int k = field * spin;
+        if (k <= 0 || rngUniform(r) < flip_probabilities[k]) {
+          Spins::flip(spins, i);
+          energy += 2 * bond_unit * k;
+        }
+      }
+    } else {
+      double local_h = 0.0;
+      for (int n = 0; n < z; ++n) {
+        local_h += Spins::get(spins, site.neighbor(n)) * site.bond(n);
+      }
+      if constexpr (HeatBath) {
+        const double probUp = 1 / (1 + exp(-2 * beta * local_h));
+        const int new_spin = rngUniform(r) < probUp ? 1 : -1;
+        if (new_spin != spin) {
+          Spins::set(spins, i, new_spin);
+          energy += 2 * spin * local_h;
+        }
+      } else {
+        const double delta_E = 2 * spin * local_h;
+        if (delta_E <= 0 || rngUniform(r) < exp(-beta * delta_E)) {
+          Spins::flip(spins, i);
+          energy += delta_E;
+        }
       }
     }
+  };
+
+  for (int sweep = 0; sweep < num_sweeps; ++sweep) {
+    switch (order) {
+      case SiteOrder::random:
+        for (int n = 0; n < num_spins_; ++n) {
+          const int i = rngUniformInt(r, num_spins_);
+          update(i, topology.site(i));
+        }
+        break;
+      case SiteOrder::sequential:
+        topology.forEachSite(update);
+        break;
+      case SiteOrder::checkerboard:
+        for (int color = 0; color < 2; ++color) {
+          topology.forEachSiteOfColor(color, update);
+        }
+        break;
+    }
   }
+  energy_ = energy;
 }
 
-void IsingModel::setSpin(int i, int val) {
-  if (val != 1 && val != -1) {
-    throw std::invalid_argument("Spin value must be +1 or -1");
+template <typename Spins, typename Rng>
+void IsingModel::checkerboardSweep(int num_sweeps, double beta, Rng& r,
+                                   bool heat_bath) {
+  const int L = system_size_;
+  if (!(cubic_lattice_ || lattice_dimension_ > 0) || L % 2 != 0) {
+    throw std::invalid_argument(
+        "Checkerboard update requires a cubic or hypercubic lattice with even "
+        "system size");
   }
-  spins_[i] = val;
+  if constexpr (std::is_same_v<Spins, Int32Spins>) {
+    // An implicit lattice has no direction_bonds_ for non-uniform bonds.
+    if (discrete_bonds_ && cubic_lattice_ &&
+        (uniform_bonds_ || direction_bonds_ != nullptr)) {
+      static const SimdLevel simd_level = detectSimdLevel();
+      const CheckerboardLattice lattice{
+          L, direction_bonds_,
+          static_cast<int>(std::lround(uniform_bond_ * inv_bond_unit_)),
+          bond_unit_, max_field_};
+      CheckerboardRng rng(rngBits64(r));
+      const long delta =
+          ::checkerboardSweep(static_cast<std::int32_t*>(spins_), lattice,
+                              beta, heat_bath, num_sweeps, rng, simd_level);
+      energy_ += 2 * bond_unit_ * delta;
+      return;
+    }
+  }
+
+  // Same sublattice order with the per-site kernels, for the other storage
+  // layouts, for continuous bonds, in other dimensions and for non-uniform
+  // bonds on an implicit lattice.
+  singleSpinSweeps<Spins>(num_sweeps, beta, r, heat_bath,
+                          SiteOrder::checkerboard);
 }
 
-int IsingModel::getSpin(int i) const {
-  if (i < 0 || i >= num_spins_) {
-    throw std::out_of_range("Index out of range");
+// Random-site Metropolis accepts a flip of site i with probability
+// w_i / num_spins per attempt, w_i the tabulated Metropolis factor of its
+// class. With W = sum_i w_i, the number of rejected attempts before the next
+// flip is geometric with success probability W / num_spins, and the flipped
+// site is chosen with probability w_i / W: first a class by its total rate,
+// then a site of that class uniformly. Only the flipped site and its
+// neighbors change class. The classes are rebuilt at the start of every call,
+// which costs about one ordinary sweep.
+template <typename Spins, typename Rng>
+void IsingModel::nFoldWay(int num_sweeps, double beta, Rng& r) {
+  if (!discrete_bonds_) {
+    throw std::invalid_argument("n-fold way update requires discrete bonds");
   }
-  return spins_[i];
+  const double* rates = flip_table.center(beta, false, bond_unit_, max_field_);
+  const int num_classes = 2 * max_field_ + 1;
+  NFoldWayWorkspace& workspace = n_fold_way_workspace;
+  workspace.reset(num_spins_, num_classes);
+
+  withTopology([&](const auto& topology) {
+    auto site_class = [&](int i) {
+      const auto site = topology.site(i);
+      double local_h = 0.0;
+      for (int n = 0; n < num_neighbors_; ++n) {
+        local_h += Spins::get(spins_, site.neighbor(n)) * site.bond(n);
+      }
+      return fieldIndex(local_h * inv_bond_unit_) * Spins::get(spins_, i) +
+             max_field_;
+    };
+    for (int i = 0; i < num_spins_; ++i) {
+      workspace.insert(i, site_class(i));
+    }
+
+    long attempts_left = static_cast<long>(num_sweeps) * num_spins_;
+    while (attempts_left > 0) {
+      double total_rate = 0.0;
+      for (int c = 0; c < num_classes; ++c) {
+        total_rate += workspace.buckets[c].size() * rates[c - max_field_];
+      }
+      const double p = total_rate / num_spins_;
+      if (p <= 0.0) {
+        break;
+      }
+      if (p < 1.0) {
+        // Rejected attempts before the next flip.
+        const double rejected =
+            std::floor(std::log1p(-rngUniform(r)) / std::log1p(-p));
+        if (rejected >= attempts_left) {
+          break;
+        }
+        attempts_left -= static_cast<long>(rejected);
+      }
+      --attempts_left;
+
+      double target = rngUniform(r) * total_rate;
+      int c = 0;
+      for (; c < num_classes - 1; ++c) {
+        target -= workspace.buckets[c].size() * rates[c - max_field_];
+        if (target < 0.0 && !workspace.buckets[c].empty()) {
+          break;
+        }
+      }
+      while (workspace.buckets[c].empty()) {
+        --c;  // rounding left target just past the last nonempty class
+      }
+      const std::vector<int>& bucket = workspace.buckets[c];
+      const int i = bucket[rngUniformInt(r, bucket.size())];
+
+      Spins::flip(spins_, i);
+      energy_ += 2 * bond_unit_ * (c - max_field_);
+      workspace.erase(i);
+      workspace.insert(i, num_classes - 1 - c);
+      const auto site = topology.site(i);
+      for (int n = 0; n < num_neighbors_; ++n) {
+        const int j = site.neighbor(n);
+        const int new_class = site_class(j);
+        if (new_class != workspace.site_class[j]) {
+          workspace.erase(j);
+          workspace.insert(j, new_class);
+        }
+      }
+    }
+  });
 }
 
-void IsingModel::metropolis(gsl_rng* r, double beta, int i) {
-  double delta_E = 0.0;
-  for (int n = 0; n < num_neighbors_; ++n) {
-    int j = neighbor_table_[i * num_neighbors_ + n];
-    delta_E += spins_[j] * bond_table_[i * num_neighbors_ + n];
+void IsingModel::setSpin(int i, int val) {
+  if (val != 1 && val != -1) {
+    throw std::invalid_argument("Spin value must be +1 or -1");
   }
-  delta_E *= 2 * spins_[i];
-
-  if (delta_E <= 0 || gsl_rng_uniform(r) < exp(-beta * delta_E)) {
-    spins_[i] *= -1;
+  if (label_) {
+    i = label_[i];
   }
+  withSpins(spin_storage_, [&](auto spins) {
+    using Spins = decltype(spins);
+    if (Spins::get(spins_, i) != val) {
+      double local_h = 0.0;
+      withTopology([&](const auto& topology) {
+        const auto site = topology.site(i);
+        for (int n = 0; n < num_neighbors_; ++n) {
+          local_h += Spins::get(spins_, site.neighbor(n)) * site.bond(n);
+        }
+      });
+      energy_ += 2 * Spins::get(spins_, i) * local_h;
+      Spins::set(spins_, i, val);
+    }
+  });
 }
 
-void IsingModel::heatBath(gsl_rng* r, double beta, int i) {
-  double local_h = 0.0;
-  for (int n = 0; n < num_neighbors_; ++n) {
-    int j = neighbor_table_[i * num_neighbors_ + n];
-    local_h += spins_[j] * bond_table_[i * num_neighbors_ + n];
+int IsingModel::getSpin(int i) const {
+  if (i < 0 || i >= num_spins_) {
+    throw std::out_of_range("Index out of range");
   }
-  double probUp = 1 / (1 + exp(-2 * beta * local_h));
-  if (gsl_rng_uniform(r) < probUp) {
-    spins_[i] = 1;
-  } else {
-    spins_[i] = -1;
+  if (label_) {
+    i = label_[i];
   }
+  return withSpins(spin_storage_, [&](auto spins) {
+    return decltype(spins)::get(spins_, i);
+  });
 }
 
-int IsingModel::wolff(gsl_rng* r, double beta) {
-  std::vector<bool> visited(num_spins_, false);
-  std::vector<int> stack;
-  // To keep track of the cluster size
-  int clusterSize = 0;
-  // This implementation of the Wolff algorithm is set up for Ising models that
-  // have constant bond value.
-  double J = bond_table_[0];
+template <typename Spins, typename Rng>
+int IsingModel::wolff(Rng& r, double beta, const double* add_probabilities) {
+  return withTopology([&](const auto& topology) {
+    ClusterWorkspace& workspace = cluster_workspace;
+    workspace.beginCluster(num_spins_);
+    // To keep track of the cluster size
+    int clusterSize = 0;
 
-  // Pick a random starting spin
-  int ind = gsl_rng_uniform_int(r, num_spins_);
-  // Spin type of cluster
-  int clusterSpin = spins_[ind];
-  stack.push_back(ind);
-  visited[ind] = true;
+    // Pick a random starting spin
+    workspace.visit(rngUniformInt(r, num_spins_));
 
-  // Probability of adding bond to cluster
-  double P_add = 1 - exp(-2 * beta * J);
+    while (!workspace.stack.empty()) {
+      int i = workspace.stack.back();
+      workspace.stack.pop_back();
 
-  while (!stack.empty()) {
-    int i = stack.back();
-    stack.pop_back();
+      // Flip spin
+      int spin = Spins::get(spins_, i);
+      Spins::flip(spins_, i);
+      clusterSize++;
 
-    // Flip spin
-    spins_[i] *= -1;
-    clusterSize++;
+      // Check neighbors, accumulating the local field of i. No other spin
+      // changes before the loop ends, so the flip of i alone changed the energy
+      // by 2 * spin * local_h.
+      double local_h = 0.0;
+      const auto site = topology.site(i);
+      for (int n = 0; n < num_neighbors_; ++n) {
+        int j = site.neighbor(n);
+        double J = site.bond(n);
+        int neighbor_spin = Spins::get(spins_, j);
+        local_h += neighbor_spin * J;
 
-    // Check neighbors
-    for (int n = 0; n < num_neighbors_; ++n) {
-      int j = neighbor_table_[i * num_neighbors_ + n];
-
-      // If neighbor has the same spin and isn't visited, try adding to cluster
-      if (!visited[j] && spins_[j] == clusterSpin &&
-          gsl_rng_uniform(r) < P_add) {
-        stack.push_back(j);
-        visited[j] = true;
+        // A bond that was satisfied before the flip of i joins the cluster
+        // with probability 1 - exp(-2 beta |J|), so clusters follow the actual
+        // couplings (for ferromagnets: equal spins, constant probability).
+        if (!workspace.visited(j) && spin * neighbor_spin * J > 0) {
+          double P_add =
+              add_probabilities
+                  ? add_probabilities[fieldIndex(std::abs(J) * inv_bond_unit_)]
+                  : -std::expm1(-2 * beta * std::abs(J));
+          if (rngUniform(r) < P_add) {
+            workspace.visit(j);
+          }
+        }
       }
+      energy_ += 2 * spin * local_h;
     }
+
+    // Return the size of the cluster
+    return clusterSize;
+  });
+}
+
+template <typename Spins, typename Rng>
+int IsingModel::houdayerMoveImpl(IsingModel& other, Rng& r) {
+  // Seed uniformly among the sites where the replicas disagree. The move
+  // leaves the overlap unchanged, so the reverse move has the same seed
+  // probability and cluster.
+  int num_disagreeing = 0;
+  for (int i = 0; i < num_spins_; ++i) {
+    num_disagreeing += Spins::get(spins_, i) != Spins::get(other.spins_, i);
   }
+  if (num_disagreeing == 0) {
+    return 0;
+  }
+  int seed = -1;
+  for (int k = rngUniformInt(r, num_disagreeing); k >= 0; --k) {
+    do {
+      ++seed;
+    } while (Spins::get(spins_, seed) == Spins::get(other.spins_, seed));
+  }
+
+  return withTopology([&](const auto& topology) {
+    ClusterWorkspace& workspace = cluster_workspace;
+    workspace.beginCluster(num_spins_);
+    workspace.visit(seed);
+    int clusterSize = 0;
+    while (!workspace.stack.empty()) {
+      int i = workspace.stack.back();
+      workspace.stack.pop_back();
+
+      // Flip i in both replicas, updating each energy from its local field
+      // as in wolff.
+      int spin = Spins::get(spins_, i);
+      int other_spin = Spins::get(other.spins_, i);
+      Spins::flip(spins_, i);
+      Spins::flip(other.spins_, i);
+      clusterSize++;
 
-  // Return the size of the cluster
-  return clusterSize;
-}
\ No newline at end of file
+      double local_h = 0.0;
+      double other_local_h = 0.0;
+      const auto site = topology.site(i);
+      for (int n = 0; n < num_neighbors_; ++n) {
+        int j = site.neighbor(n);
+        int neighbor_spin = Spins::get(spins_, j);
+        int other_neighbor_spin = Spins::get(other.spins_, j);
+        local_h += neighbor_spin * site.bond(n);
+        other_local_h += other_neighbor_spin * site.bond(n);
+        if (!workspace.visited(j) && neighbor_spin != other_neighbor_spin) {
+          workspace.visit(j);
+        }
+      }
+      energy_ += 2 * spin * local_h;
+      other.energy_ += 2 * other_spin * other_local_h;
+    }
+    return clusterSize;
+  });
+}
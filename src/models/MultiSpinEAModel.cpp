@@ -0,0 +1,340 @@
+#include "models/MultiSpinEAModel.hpp"
+
+#include <gsl/gsl_rng.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+#include "ReplicaArena.hpp"
+#include "Rng.hpp"
+
+namespace {
+
+constexpr int MAX_CLASSES = 15;  // unsatisfied-bond counts 0..14
+
+// Adds one bit per lane into a bit-sliced counter (ripple carry).
+inline void bitSlicedAdd(std::uint64_t* planes, int num_planes,
+                         std::uint64_t bits) {
+  for (int p = 0; p < num_planes && bits; ++p) {
+    std::uint64_t carry = planes[p] & bits;
+    planes[p] ^= bits;
+    bits = carry;
+  }
+}
+
+}  // namespace
+
+std::size_t MultiSpinEAModel::stateBytes(
+    const SharedModelData<MultiSpinEAModel>& shared_data) {
+  return static_cast<std::size_t>(shared_data.num_spins) *
+         sizeof(std::uint64_t);
+}
+
+// A null state allocates storage owned by this model.
+MultiSpinEAModel::MultiSpinEAModel(
+    const SharedModelData<MultiSpinEAModel>& shared_data)
+    : MultiSpinEAModel(shared_data, nullptr) {}
+
+MultiSpinEAModel::MultiSpinEAModel(
+    const SharedModelData<MultiSpinEAModel>& shared_data, void* state)
+    : num_spins_(shared_data.num_spins),
+      num_neighbors_(shared_data.num_neighbors),
+      num_planes_(0),
+      neighbor_table_(shared_data.neighbor_table),
+      bond_masks_(shared_data.bond_masks.data()),
+      bond_magnitude_(shared_data.bond_magnitude),
+      spins_(static_cast<std::uint64_t*>(state)),
+      owns_state_(state == nullptr) {
+  if (owns_state_) {
+    spins_ = static_cast<std::uint64_t*>(::operator new(
+        stateBytes(shared_data), std::align_val_t{ReplicaArena::ALIGNMENT}));
+  }
+  std::fill(spins_, spins_ + num_spins_, std::uint64_t{0});
+  while ((1 << num_planes_) <= num_neighbors_) {
+    ++num_planes_;
+  }
+  families_.fill(-1);
+  parents_.fill(-1);
+  computeEnergies(energies_.data());
+}
+
+MultiSpinEAModel::MultiSpinEAModel(MultiSpinEAModel&& other) noexcept
+    : num_spins_(other.num_spins_),
+      num_neighbors_(other.num_neighbors_),
+      num_planes_(other.num_planes_),
+      neighbor_table_(other.neighbor_table_),
+      bond_masks_(other.bond_masks_),
+      bond_magnitude_(other.bond_magnitude_),
+      spins_(other.spins_),
+      owns_state_(other.owns_state_),
+      families_(other.families_),
+      parents_(other.parents_),
+      energies_(other.energies_) {
+  other.spins_ = nullptr;
+  other.owns_state_ = false;
+}
+
+MultiSpinEAModel::~MultiSpinEAModel() {
+  if (owns_state_) {
+    ::operator delete(spins_, std::align_val_t{ReplicaArena::ALIGNMENT});
+  }
+}
+
+void MultiSpinEAModel::initializeState(gsl_rng* r) {
+  for (int i = 0; i < num_spins_; ++i) {
+    spins_[i] = gslRandomWord(r);
+  }
+  computeEnergies(energies_.data());
+}
+
+void MultiSpinEAModel::copyLaneFrom(int lane, const MultiSpinEAModel& other,
+                                    int other_lane) {
+  assert(num_spins_ == other.num_spins_ && "Number of spins must match!");
+  const std::uint64_t mask = std::uint64_t{1} << lane;
+  for (int i = 0; i < num_spins_; ++i) {
+    std::uint64_t bit = (other.spins_[i] >> other_lane) & 1;
+    spins_[i] = (spins_[i] & ~mask) | (bit << lane);
+  }
+  families_[lane] = other.families_[other_lane];
+  parents_[lane] = other.parents_[other_lane];
+  energies_[lane] = other.energies_[other_lane];
+}
+
+void MultiSpinEAModel::restoreState(const void* state,
+                                    const double* energies) {
+  std::memcpy(spins_, state,
+              static_cast<std::size_t>(num_spins_) * sizeof(std::uint64_t));
+  std::copy(energies, energies + NUM_LANES, energies_.begin());
+}
+
+double MultiSpinEAModel::measureEnergy(int lane) const {
+  assert(energies_[lane] == computeEnergy(lane) &&
+         "Cached energy out of sync with the spins");
+  return energies_[lane];
+}
+
+void MultiSpinEAModel::measureEnergies(double* energies) const {
+  std::copy(energies_.begin(), energies_.end(), energies);
+}
+
+double MultiSpinEAModel::computeEnergy(int lane) const {
+  long unsatisfied = 0;
+  for (int i = 0; i < num_spins_; ++i) {
+    // Skip every second neighbor to avoid double-counting bonds.
+    for (int n = 0; n < num_neighbors_; n += 2) {
+      int b = i * num_neighbors_ + n;
+      std::uint64_t unsat =
+          spins_[i] ^ spins_[neighbor_table_[b]] ^ bond_masks_[b];
+      unsatisfied += (unsat >> lane) & 1;
+    }
+  }
+  long num_bonds = static_cast<long>(num_spins_) * (num_neighbors_ / 2);
+  return bond_magnitude_ * static_cast<double>(2 * unsatisfied - num_bonds);
+}
+
+void MultiSpinEAModel::computeEnergies(double* energies) const {
+  // 32 planes count up to 2^32 unsatisfied bonds per lane.
+  constexpr int COUNT_PLANES = 32;
+  std::uint64_t planes[COUNT_PLANES] = {};
+  for (int i = 0; i < num_spins_; ++i) {
+    for (int n = 0; n < num_neighbors_; n += 2) {
+      int b = i * num_neighbors_ + n;
+      bitSlicedAdd(planes, COUNT_PLANES,
+                   spins_[i] ^ spins_[neighbor_table_[b]] ^ bond_masks_[b]);
+    }
+  }
+  long num_bonds = static_cast<long>(num_spins_) * (num_neighbors_ / 2);
+  for (int lane = 0; lane < NUM_LANES; ++lane) {
+    long unsatisfied = 0;
+    for (int p = 0; p < COUNT_PLANES; ++p) {
+      unsatisfied |= static_cast<long>((planes[p] >> lane) & 1) << p;
+    }
+    energies[lane] =
+        bond_magnitude_ * static_cast<double>(2 * unsatisfied - num_bonds);
+  }
+}
+
+double MultiSpinEAModel::measureMagnetization(int lane) const {
+  int down = 0;
+  for (int i = 0; i < num_spins_; ++i) {
+    down += (spins_[i] >> lane) & 1;
+  }
+  return static_cast<double>(num_spins_ - 2 * down);
+}
+
+void MultiSpinEAModel::measureMagnetizations(double* magnetizations) const {
+  constexpr int COUNT_PLANES = 32;
+  std::uint64_t planes[COUNT_PLANES] = {};
+  for (int i = 0; i < num_spins_; ++i) {
+    bitSlicedAdd(planes, COUNT_PLANES, spins_[i]);
+  }
+  for (int lane = 0; lane < NUM_LANES; ++lane) {
+    long down = 0;
+    for (int p = 0; p < COUNT_PLANES; ++p) {
+      down |= static_cast<long>((planes[p] >> lane) & 1) << p;
+    }
+    magnetizations[lane] = static_cast<double>(num_spins_ - 2 * down);
+  }
+}
+
+void MultiSpinEAModel::measureObservables(Observable observable,
+                                          double* values) const {
+  switch (observable) {
+    case Observable::energy:
+      measureEnergies(values);
+      break;
+    case Observable::magnetization:
+      measureMagnetizations(values);
+      break;
+    default:
+      throw std::invalid_argument("Unknown observable!");
+  }
+}
+
+void MultiSpinEAModel::computeFlipProbabilities(double beta,
+                                                UpdateMethod method,
+                                                double* probabilities) const {
+  for (int u = 0; u <= num_neighbors_; ++u) {
+    // Flipping a site with u unsatisfied bonds out of z changes the energy by
+    // 2|J|(z - 2u).
+    double delta_E = 2.0 * bond_magnitude_ * (num_neighbors_ - 2 * u);
+    switch (method) {
+      case UpdateMethod::metropolis:
+        probabilities[u] = delta_E <= 0 ? 1.0 : std::exp(-beta * delta_E);
+        break;
+      case UpdateMethod::heat_bath:
+        probabilities[u] = 1.0 / (1.0 + std::exp(beta * delta_E));
+        break;
+      default:
+        throw std::invalid_argument("Unknown update method!");
+    }
+  }
+}
+
+// With a gsl_rng the per-lane random bits come from a xoshiro256** generator
+// reseeded from r at the start of every call, so runs remain reproducible
+// from the Population seeds without a gsl call per 64 bits.
+void MultiSpinEAModel::updateSweep(int num_sweeps, double beta, gsl_rng* r,
+                                   UpdateMethod method, bool sequential) {
+  Xoshiro256 rng(gslRandomWord(r));
+  updateSweepImpl(num_sweeps, beta, rng, method, sequential);
+}
+
+void MultiSpinEAModel::updateSweep(int num_sweeps, double beta,
+                                   RandomStream& r, UpdateMethod method,
+                                   bool sequential) {
+  updateSweepImpl(num_sweeps, beta, r, method, sequential);
+}
+
+template <typename Engine>
+void MultiSpinEAModel::updateSweepImpl(int num_sweeps, double beta,
+                                       Engine& rng, UpdateMethod method,
+                                       bool sequential) {
+  double probabilities[MAX_CLASSES];
+  computeFlipProbabilities(beta, method, probabilities);
+
+  // Probabilities become 32-bit fixed-point thresholds. Classes that always
+  // (or never) flip skip the random comparison entirely.
+  std::uint64_t thresholds[MAX_CLASSES] = {};
+  bool always[MAX_CLASSES] = {};
+  std::uint32_t classes_with_bit[32] = {};
+  for (int u = 0; u <= num_neighbors_; ++u) {
+    if (probabilities[u] >= 1.0) {
+      always[u] = true;
+      continue;
+    }
+    thresholds[u] = static_cast<std::uint64_t>(std::ldexp(probabilities[u], 32));
+    for (int b = 0; b < 32; ++b) {
+      if ((thresholds[u] >> b) & 1) {
+        classes_with_bit[b] |= 1u << u;
+      }
+    }
+  }
+
+  auto update_site = [&](int i) {
+    const std::uint64_t s = spins_[i];
+    const int* neighbors = neighbor_table_ + i * num_neighbors_;
+    const std::uint64_t* masks = bond_masks_ + i * num_neighbors_;
+
+    // Count unsatisfied bonds per lane.
+    std::uint64_t count[4] = {};
+    for (int n = 0; n < num_neighbors_; ++n) {
+      bitSlicedAdd(count, num_planes_, s ^ spins_[neighbors[n]] ^ masks[n]);
+    }
+
+    std::uint64_t class_masks[MAX_CLASSES];
+    std::uint64_t flip = 0;
+    std::uint64_t undecided = 0;
+    for (int u = 0; u <= num_neighbors_; ++u) {
+      std::uint64_t m = ~std::uint64_t{0};
+      for (int p = 0; p < num_planes_; ++p) {
+        m &= ((u >> p) & 1) ? count[p] : ~count[p];
+      }
+      class_masks[u] = m;
+      if (always[u]) {
+        flip |= m;
+      } else if (thresholds[u] != 0) {
+        undecided |= m;
+      }
+    }
+
+    // Bit-serial comparison of a fresh 32-bit uniform per lane against the
+    // lane's threshold, most significant bit first.
+    std::uint64_t less = 0;
+    for (int b = 31; b >= 0 && undecided; --b) {
+      std::uint64_t t = 0;
+      for (std::uint32_t c = classes_with_bit[b]; c; c &= c - 1) {
+        t |= class_masks[__builtin_ctz(c)];
+      }
+      std::uint64_t random_bits = rng.bits64();
+      less |= undecided & ~random_bits & t;
+      undecided &= ~(random_bits ^ t);
+    }
+    spins_[i] = s ^ (flip | less);
+  };
+
+  if (sequential) {
+    for (int sweep = 0; sweep < num_sweeps; ++sweep) {
+      for (int i = 0; i < num_spins_; ++i) {
+        update_site(i);
+      }
+    }
+  } else {
+    for (int sweep = 0; sweep < num_sweeps; ++sweep) {
+      for (int i = 0; i < num_spins_; ++i) {
+        update_site(rng.uniformInt(num_spins_));
+      }
+    }
+  }
+  // One bit-sliced pass refreshes all lane energies while the spins are
+  // still in cache, in parallel with the other objects' sweeps.
+  computeEnergies(energies_.data());
+}
+
+std::vector<int> MultiSpinEAModel::getState(int lane) const {
+  std::vector<int> state(num_spins_);
+  for (int i = 0; i < num_spins_; ++i) {
+    state[i] = ((spins_[i] >> lane) & 1) ? -1 : 1;
+  }
+  return state;
+}
+
+void MultiSpinEAModel::setSpin(int i, int lane, int val) {
+  if (val != 1 && val != -1) {
+    throw std::invalid_argument("Spin value must be +1 or -1");
+  }
+  const std::uint64_t mask = std::uint64_t{1} << lane;
+  spins_[i] = (val == -1) ? (spins_[i] | mask) : (spins_[i] & ~mask);
+  energies_[lane] = computeEnergy(lane);
+}
+
+int MultiSpinEAModel::getSpin(int i, int lane) const {
+  if (i < 0 || i >= num_spins_ || lane < 0 || lane >= NUM_LANES) {
+    throw std::out_of_range("Index out of range");
+  }
+  return ((spins_[i] >> lane) & 1) ? -1 : 1;
+}
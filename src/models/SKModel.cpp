@@ -0,0 +1,318 @@
+#include "models/SKModel.hpp"
+
+#include <gsl/gsl_rng.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+
+#include "ReplicaArena.hpp"
+
+namespace {
+
+// y += a * x over n entries; x and y start on an ALIGNMENT boundary and n is
+// a whole number of cache lines (see SharedModelData<SKModel>::row_stride).
+template <typename T>
+__attribute__((always_inline)) inline void axpyBody(T a, const T* x, T* y,
+                                                    int n) {
+  const T* __restrict xa =
+      static_cast<const T*>(__builtin_assume_aligned(x, ReplicaArena::ALIGNMENT));
+  T* __restrict ya =
+      static_cast<T*>(__builtin_assume_aligned(y, ReplicaArena::ALIGNMENT));
+  #pragma omp simd
+  for (int j = 0; j < n; ++j) {
+    ya[j] += a * xa[j];
+  }
+}
+
+template <typename T>
+void axpyScalar(T a, const T* x, T* y, int n) {
+  axpyBody(a, x, y, n);
+}
+
+template <typename T>
+__attribute__((target("avx2"))) void axpyAvx2(T a, const T* x, T* y, int n) {
+  axpyBody(a, x, y, n);
+}
+
+template <typename T>
+__attribute__((target("avx512f"))) void axpyAvx512(T a, const T* x, T* y,
+                                                   int n) {
+  axpyBody(a, x, y, n);
+}
+
+template <typename T>
+inline void axpy(SimdLevel level, T a, const T* x, T* y, int n) {
+  switch (level) {
+    case SimdLevel::avx512:
+      axpyAvx512(a, x, y, n);
+      return;
+    case SimdLevel::avx2:
+      axpyAvx2(a, x, y, n);
+      return;
+    case SimdLevel::scalar:
+      axpyScalar(a, x, y, n);
+      return;
+  }
+}
+
+std::size_t fieldBytes(const SharedModelData<SKModel>& shared_data) {
+  return static_cast<std::size_t>(shared_data.row_stride) *
+         (shared_data.precision == CouplingPrecision::float64 ? sizeof(double)
+                                                              : sizeof(float));
+}
+
+// Calls f with a null pointer of the coupling scalar type.
+template <typename F>
+decltype(auto) withPrecision(CouplingPrecision precision, F&& f) {
+  switch (precision) {
+    case CouplingPrecision::float64:
+      return f(static_cast<double*>(nullptr));
+    case CouplingPrecision::float32:
+      return f(static_cast<float*>(nullptr));
+  }
+  throw std::invalid_argument("Unknown coupling precision!");
+}
+
+}  // namespace
+
+std::size_t SKModel::stateBytes(const SharedModelData<SKModel>& shared_data) {
+  return fieldBytes(shared_data) +
+         static_cast<std::size_t>(shared_data.num_spins) * sizeof(std::int8_t);
+}
+
+// A null state allocates storage owned by this model.
+SKModel::SKModel(const SharedModelData<SKModel>& shared_data)
+    : SKModel(shared_data, nullptr) {}
+
+SKModel::SKModel(const SharedModelData<SKModel>& shared_data, void* state)
+    : num_spins_(shared_data.num_spins),
+      row_stride_(shared_data.row_stride),
+      precision_(shared_data.precision),
+      couplings_(shared_data.couplings.data()),
+      couplings_f32_(shared_data.couplings_f32.data()),
+      simd_level_(detectSimdLevel()),
+      state_(state),
+      state_bytes_(stateBytes(shared_data)),
+      owns_state_(state == nullptr) {
+  if (owns_state_) {
+    state_ = ::operator new(state_bytes_,
+                            std::align_val_t{ReplicaArena::ALIGNMENT});
+  }
+  fields_ = state_;
+  spins_ = static_cast<std::int8_t*>(state_) + fieldBytes(shared_data);
+  std::fill(spins_, spins_ + num_spins_, std::int8_t{1});
+  withPrecision(precision_, [&](auto* tag) {
+    this->refreshFields<std::remove_pointer_t<decltype(tag)>>();
+  });
+}
+
+SKModel::SKModel(SKModel&& other) noexcept
+    : Model(other),
+      num_spins_(other.num_spins_),
+      row_stride_(other.row_stride_),
+      precision_(other.precision_),
+      couplings_(other.couplings_),
+      couplings_f32_(other.couplings_f32_),
+      simd_level_(other.simd_level_),
+      state_(other.state_),
+      state_bytes_(other.state_bytes_),
+      owns_state_(other.owns_state_),
+      fields_(other.fields_),
+      spins_(other.spins_),
+      energy_(other.energy_) {
+  other.state_ = nullptr;
+  other.owns_state_ = false;
+}
+
+SKModel::~SKModel() {
+  if (owns_state_) {
+    ::operator delete(state_, std::align_val_t{ReplicaArena::ALIGNMENT});
+  }
+}
+
+void SKModel::initializeState(gsl_rng* r) {
+  for (int i = 0; i < num_spins_; ++i) {
+    spins_[i] = static_cast<std::int8_t>(gsl_rng_uniform_int(r, 2) * 2 - 1);
+  }
+  withPrecision(precision_, [&](auto* tag) {
+    this->refreshFields<std::remove_pointer_t<decltype(tag)>>();
+  });
+}
+
+void SKModel::copyStateFrom(const SKModel& other) {
+  assert(num_spins_ == other.num_spins_ && "Number of spins must match!");
+  assert(precision_ == other.precision_ && "Coupling precision must match!");
+  // Both buffers start on an ALIGNMENT boundary (owned or arena slot).
+  std::memcpy(__builtin_assume_aligned(state_, ReplicaArena::ALIGNMENT),
+              __builtin_assume_aligned(other.state_, ReplicaArena::ALIGNMENT),
+              state_bytes_);
+  energy_ = other.energy_;
+  copyGenealogyFrom(other);
+}
+
+void SKModel::restoreState(const void* state, double energy) {
+  std::memcpy(state_, state, state_bytes_);
+  energy_ = energy;
+}
+
+double SKModel::measureEnergy() const {
+#ifndef NDEBUG
+  const double full_energy = computeEnergy();
+  assert(std::abs(energy_ - full_energy) <= 1e-6 * (1 + std::abs(full_energy)) &&
+         "Running energy out of sync with the spins");
+#endif
+  return energy_;
+}
+
+// E = -1/2 sum_i s_i h_i
+double SKModel::computeEnergy() const {
+  return withPrecision(precision_, [&](auto* tag) {
+    using T = std::remove_pointer_t<decltype(tag)>;
+    const T* h = static_cast<const T*>(fields_);
+    double sum = 0.0;
+    for (int i = 0; i < num_spins_; ++i) {
+      sum += spins_[i] * static_cast<double>(h[i]);
+    }
+    return -0.5 * sum;
+  });
+}
+
+double SKModel::measureMagnetization() const {
+  int mag = 0;
+  for (int i = 0; i < num_spins_; ++i) {
+    mag += spins_[i];
+  }
+  return static_cast<double>(mag);
+}
+
+double SKModel::measureObservable(Observable observable) const {
+  switch (observable) {
+    case Observable::energy:
+      return measureEnergy();
+    case Observable::magnetization:
+      return measureMagnetization();
+    default:
+      throw std::invalid_argument("Unknown observable!");
+  }
+}
+
+double SKModel::measureOverlap(const SKModel& other) const {
+  assert(num_spins_ == other.num_spins_ && "Number of spins must match!");
+  int q = 0;
+  for (int i = 0; i < num_spins_; ++i) {
+    q += spins_[i] * other.spins_[i];
+  }
+  return static_cast<double>(q);
+}
+
+void SKModel::updateSweep(int num_sweeps, double beta, gsl_rng* r,
+                          UpdateMethod method, bool sequential) {
+  withPrecision(precision_, [&](auto* tag) {
+    this->updateSweepImpl<std::remove_pointer_t<decltype(tag)>>(
+        num_sweeps, beta, r, method, sequential);
+  });
+}
+
+void SKModel::updateSweep(int num_sweeps, double beta, RandomStream& r,
+                          UpdateMethod method, bool sequential) {
+  withPrecision(precision_, [&](auto* tag) {
+    this->updateSweepImpl<std::remove_pointer_t<decltype(tag)>>(
+        num_sweeps, beta, r, method, sequential);
+  });
+}
+
+template <typename T, typename Rng>
+void SKModel::updateSweepImpl(int num_sweeps, double beta, Rng& r,
+                              UpdateMethod method, bool sequential) {
+  if (method != UpdateMethod::metropolis && method != UpdateMethod::heat_bath) {
+    throw std::invalid_argument("Unknown update method!");
+  }
+  const T* h = static_cast<const T*>(fields_);
+  const bool heat_bath = method == UpdateMethod::heat_bath;
+
+  auto update_site = [&](int k) {
+    const double delta_E = 2.0 * spins_[k] * static_cast<double>(h[k]);
+    if (heat_bath) {
+      if (rngUniform(r) < 1 / (1 + exp(beta * delta_E))) {
+        flipSpin<T>(k);
+      }
+    } else if (delta_E <= 0 || rngUniform(r) < exp(-beta * delta_E)) {
+      flipSpin<T>(k);
+    }
+  };
+
+  for (int sweep = 0; sweep < num_sweeps; ++sweep) {
+    for (int n = 0; n < num_spins_; ++n) {
+      update_site(sequential ? n : static_cast<int>(rngUniformInt(r, num_spins_)));
+    }
+  }
+  if constexpr (std::is_same_v<T, float>) {
+    refreshFields<float>();
+  }
+}
+
+// h_j -= 2 s_k J_kj for all j; the scale is exact, so the AXPY rounds only
+// once per entry on every instruction set.
+template <typename T>
+void SKModel::flipSpin(int k) {
+  T* h = static_cast<T*>(fields_);
+  const T* row = (std::is_same_v<T, double>
+                      ? reinterpret_cast<const T*>(couplings_)
+                      : reinterpret_cast<const T*>(couplings_f32_)) +
+                 static_cast<std::size_t>(k) * row_stride_;
+  energy_ += 2.0 * spins_[k] * static_cast<double>(h[k]);
+  axpy(simd_level_, static_cast<T>(-2 * spins_[k]), row, h, row_stride_);
+  spins_[k] = static_cast<std::int8_t>(-spins_[k]);
+}
+
+template <typename T>
+void SKModel::refreshFields() {
+  T* h = static_cast<T*>(fields_);
+  const T* matrix = std::is_same_v<T, double>
+                        ? reinterpret_cast<const T*>(couplings_)
+                        : reinterpret_cast<const T*>(couplings_f32_);
+  std::fill(h, h + row_stride_, T{0});
+  // J is symmetric, so h = sum_i s_i J_i, one AXPY per row.
+  for (int i = 0; i < num_spins_; ++i) {
+    axpy(simd_level_, static_cast<T>(spins_[i]),
+         matrix + static_cast<std::size_t>(i) * row_stride_, h, row_stride_);
+  }
+  energy_ = computeEnergy();
+}
+
+std::vector<int> SKModel::getState() const {
+  return std::vector<int>(spins_, spins_ + num_spins_);
+}
+
+void SKModel::setSpin(int i, int val) {
+  if (val != 1 && val != -1) {
+    throw std::invalid_argument("Spin value must be +1 or -1");
+  }
+  if (getSpin(i) != val) {
+    withPrecision(precision_, [&](auto* tag) {
+      this->flipSpin<std::remove_pointer_t<decltype(tag)>>(i);
+    });
+  }
+}
+
+int SKModel::getSpin(int i) const {
+  if (i < 0 || i >= num_spins_) {
+    throw std::out_of_range("Index out of range");
+  }
+  return spins_[i];
+}
+
+double SKModel::getLocalField(int i) const {
+  if (i < 0 || i >= num_spins_) {
+    throw std::out_of_range("Index out of range");
+  }
+  return withPrecision(precision_, [&](auto* tag) {
+    using T = std::remove_pointer_t<decltype(tag)>;
+    return static_cast<double>(static_cast<const T*>(fields_)[i]);
+  });
+}
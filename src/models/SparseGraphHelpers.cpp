@@ -0,0 +1,47 @@
+#include "models/SparseGraphHelpers.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+std::vector<int> reverseCuthillMcKee(int num_vertices,
+                                     const std::vector<long>& row_offsets,
+                                     const std::vector<int>& column_indices) {
+  auto degree = [&](int v) {
+    return row_offsets[v + 1] - row_offsets[v];
+  };
+  // Component roots are tried in increasing degree.
+  std::vector<int> by_degree(num_vertices);
+  std::iota(by_degree.begin(), by_degree.end(), 0);
+  std::stable_sort(by_degree.begin(), by_degree.end(),
+                   [&](int a, int b) { return degree(a) < degree(b); });
+
+  std::vector<int> order;
+  order.reserve(num_vertices);
+  std::vector<char> visited(num_vertices, 0);
+  std::vector<int> neighbors;
+  for (int root : by_degree) {
+    if (visited[root]) {
+      continue;
+    }
+    visited[root] = 1;
+    // order doubles as the BFS queue of the component.
+    std::size_t head = order.size();
+    order.push_back(root);
+    for (; head < order.size(); ++head) {
+      const int v = order[head];
+      neighbors.clear();
+      for (long k = row_offsets[v]; k < row_offsets[v + 1]; ++k) {
+        const int u = column_indices[k];
+        if (!visited[u]) {
+          visited[u] = 1;
+          neighbors.push_back(u);
+        }
+      }
+      std::stable_sort(neighbors.begin(), neighbors.end(),
+                       [&](int a, int b) { return degree(a) < degree(b); });
+      order.insert(order.end(), neighbors.begin(), neighbors.end());
+    }
+  }
+  std::reverse(order.begin(), order.end());
+  return order;
+}
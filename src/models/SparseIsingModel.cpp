@@ -0,0 +1,381 @@
+#include "models/SparseIsingModel.hpp"
+
+#include <gsl/gsl_rng.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <new>
+#include <numeric>
+#include <stdexcept>
+#include <utility>
+
+#include "ReplicaArena.hpp"
+#include "models/SparseGraphHelpers.hpp"
+
+SharedModelData<SparseIsingModel>::SharedModelData(
+    int num_spins, std::vector<long> row_offsets,
+    std::vector<int> column_indices, std::vector<double> weights,
+    std::vector<double> fields, bool reorder)
+    : num_spins(num_spins) {
+  if (num_spins <= 0) {
+    throw std::invalid_argument("SparseIsingModel requires at least one spin");
+  }
+  if (row_offsets.size() != static_cast<std::size_t>(num_spins) + 1 ||
+      row_offsets[0] != 0 ||
+      row_offsets[num_spins] != static_cast<long>(column_indices.size()) ||
+      weights.size() != column_indices.size()) {
+    throw std::invalid_argument("Inconsistent CSR table sizes");
+  }
+  if (!fields.empty() && fields.size() != static_cast<std::size_t>(num_spins)) {
+    throw std::invalid_argument("fields must be empty or hold one per spin");
+  }
+  for (int i = 0; i < num_spins; ++i) {
+    if (row_offsets[i + 1] < row_offsets[i]) {
+      throw std::invalid_argument("CSR row offsets must be nondecreasing");
+    }
+    for (long k = row_offsets[i]; k < row_offsets[i + 1]; ++k) {
+      if (column_indices[k] < 0 || column_indices[k] >= num_spins ||
+          column_indices[k] == i) {
+        throw std::invalid_argument("CSR column index out of range or a self loop");
+      }
+    }
+  }
+
+  if (reorder) {
+    order = reverseCuthillMcKee(num_spins, row_offsets, column_indices);
+  } else {
+    order.resize(num_spins);
+    std::iota(order.begin(), order.end(), 0);
+  }
+  label.resize(num_spins);
+  for (int k = 0; k < num_spins; ++k) {
+    label[order[k]] = k;
+  }
+
+  // Rows in internal order, each sorted by internal column.
+  this->row_offsets.resize(num_spins + 1);
+  this->column_indices.resize(column_indices.size());
+  this->weights.resize(weights.size());
+  std::vector<std::pair<int, double>> row;
+  long next = 0;
+  for (int k = 0; k < num_spins; ++k) {
+    const int i = order[k];
+    this->row_offsets[k] = next;
+    row.clear();
+    for (long e = row_offsets[i]; e < row_offsets[i + 1]; ++e) {
+      row.emplace_back(label[column_indices[e]], weights[e]);
+    }
+    std::sort(row.begin(), row.end());
+    for (std::size_t e = 0; e < row.size(); ++e) {
+      if (e > 0 && row[e].first == row[e - 1].first) {
+        throw std::invalid_argument("CSR row lists a neighbor twice");
+      }
+      this->column_indices[next] = row[e].first;
+      this->weights[next] = row[e].second;
+      ++next;
+    }
+    max_degree = std::max(max_degree, static_cast<int>(row.size()));
+  }
+  this->row_offsets[num_spins] = next;
+
+  // Every edge must appear in the row of its other end with the same weight.
+  for (int k = 0; k < num_spins; ++k) {
+    for (long e = this->row_offsets[k]; e < this->row_offsets[k + 1]; ++e) {
+      const int j = this->column_indices[e];
+      const auto begin = this->column_indices.begin() + this->row_offsets[j];
+      const auto end = this->column_indices.begin() + this->row_offsets[j + 1];
+      const auto it = std::lower_bound(begin, end, k);
+      if (it == end || *it != k ||
+          this->weights[it - this->column_indices.begin()] != this->weights[e]) {
+        throw std::invalid_argument("CSR couplings must be symmetric");
+      }
+    }
+  }
+
+  if (!fields.empty()) {
+    this->fields.resize(num_spins);
+    for (int k = 0; k < num_spins; ++k) {
+      this->fields[k] = fields[order[k]];
+    }
+  }
+}
+
+SharedModelData<SparseIsingModel> SharedModelData<SparseIsingModel>::fromEdges(
+    int num_spins, const std::vector<SparseTerm>& edges,
+    std::vector<double> fields, bool reorder) {
+  std::vector<SparseTerm> merged;
+  merged.reserve(edges.size());
+  for (const SparseTerm& edge : edges) {
+    if (edge.i < 0 || edge.i >= num_spins || edge.j < 0 ||
+        edge.j >= num_spins || edge.i == edge.j) {
+      throw std::invalid_argument("Edge index out of range or a self loop");
+    }
+    merged.push_back({std::min(edge.i, edge.j), std::max(edge.i, edge.j),
+                      edge.weight});
+  }
+  std::sort(merged.begin(), merged.end(),
+            [](const SparseTerm& a, const SparseTerm& b) {
+              return a.i != b.i ? a.i < b.i : a.j < b.j;
+            });
+  std::size_t num_edges = 0;
+  for (std::size_t e = 0; e < merged.size(); ++e) {
+    if (num_edges > 0 && merged[num_edges - 1].i == merged[e].i &&
+        merged[num_edges - 1].j == merged[e].j) {
+      merged[num_edges - 1].weight += merged[e].weight;
+    } else {
+      merged[num_edges++] = merged[e];
+    }
+  }
+  merged.resize(num_edges);
+
+  std::vector<long> row_offsets(num_spins + 1, 0);
+  for (const SparseTerm& edge : merged) {
+    ++row_offsets[edge.i + 1];
+    ++row_offsets[edge.j + 1];
+  }
+  std::partial_sum(row_offsets.begin(), row_offsets.end(), row_offsets.begin());
+  std::vector<int> column_indices(row_offsets[num_spins]);
+  std::vector<double> weights(row_offsets[num_spins]);
+  std::vector<long> fill(row_offsets.begin(), row_offsets.end() - 1);
+  for (const SparseTerm& edge : merged) {
+    column_indices[fill[edge.i]] = edge.j;
+    weights[fill[edge.i]++] = edge.weight;
+    column_indices[fill[edge.j]] = edge.i;
+    weights[fill[edge.j]++] = edge.weight;
+  }
+  return SharedModelData(num_spins, std::move(row_offsets),
+                         std::move(column_indices), std::move(weights),
+                         std::move(fields), reorder);
+}
+
+// With x_i = (1 + s_i) / 2, Q_ij x_i x_j = Q_ij (1 + s_i + s_j + s_i s_j) / 4
+// for i != j and Q_ii x_i = Q_ii (1 + s_i) / 2.
+SharedModelData<SparseIsingModel> SharedModelData<SparseIsingModel>::fromQubo(
+    int num_variables, const std::vector<SparseTerm>& terms, bool reorder) {
+  std::vector<SparseTerm> edges;
+  std::vector<double> fields(num_variables, 0.0);
+  double offset = 0.0;
+  for (const SparseTerm& term : terms) {
+    if (term.i < 0 || term.i >= num_variables || term.j < 0 ||
+        term.j >= num_variables) {
+      throw std::invalid_argument("QUBO index out of range");
+    }
+    if (term.i == term.j) {
+      fields[term.i] -= term.weight / 2;
+      offset += term.weight / 2;
+    } else {
+      edges.push_back({term.i, term.j, -term.weight / 4});
+      fields[term.i] -= term.weight / 4;
+      fields[term.j] -= term.weight / 4;
+      offset += term.weight / 4;
+    }
+  }
+  SharedModelData data =
+      fromEdges(num_variables, edges, std::move(fields), reorder);
+  data.energy_offset = offset;
+  return data;
+}
+
+std::size_t SparseIsingModel::stateBytes(
+    const SharedModelData<SparseIsingModel>& shared_data) {
+  return static_cast<std::size_t>(shared_data.num_spins) * sizeof(std::int8_t);
+}
+
+// A null state allocates storage owned by this model.
+SparseIsingModel::SparseIsingModel(
+    const SharedModelData<SparseIsingModel>& shared_data)
+    : SparseIsingModel(shared_data, nullptr) {}
+
+SparseIsingModel::SparseIsingModel(
+    const SharedModelData<SparseIsingModel>& shared_data, void* state)
+    : num_spins_(shared_data.num_spins),
+      row_offsets_(shared_data.row_offsets.data()),
+      column_indices_(shared_data.column_indices.data()),
+      weights_(shared_data.weights.data()),
+      fields_(shared_data.fields.empty() ? nullptr : shared_data.fields.data()),
+      energy_offset_(shared_data.energy_offset),
+      order_(shared_data.order.data()),
+      label_(shared_data.label.data()),
+      spins_(static_cast<std::int8_t*>(state)),
+      owns_state_(state == nullptr) {
+  if (owns_state_) {
+    spins_ = static_cast<std::int8_t*>(::operator new(
+        stateBytes(shared_data), std::align_val_t{ReplicaArena::ALIGNMENT}));
+  }
+  std::fill(spins_, spins_ + num_spins_, std::int8_t{1});
+  energy_ = computeEnergy();
+}
+
+SparseIsingModel::SparseIsingModel(SparseIsingModel&& other) noexcept
+    : Model(other),
+      num_spins_(other.num_spins_),
+      row_offsets_(other.row_offsets_),
+      column_indices_(other.column_indices_),
+      weights_(other.weights_),
+      fields_(other.fields_),
+      energy_offset_(other.energy_offset_),
+      order_(other.order_),
+      label_(other.label_),
+      spins_(other.spins_),
+      owns_state_(other.owns_state_),
+      energy_(other.energy_) {
+  other.spins_ = nullptr;
+  other.owns_state_ = false;
+}
+
+SparseIsingModel::~SparseIsingModel() {
+  if (owns_state_) {
+    ::operator delete(spins_, std::align_val_t{ReplicaArena::ALIGNMENT});
+  }
+}
+
+void SparseIsingModel::initializeState(gsl_rng* r) {
+  for (int i = 0; i < num_spins_; ++i) {
+    spins_[i] = static_cast<std::int8_t>(gsl_rng_uniform_int(r, 2) * 2 - 1);
+  }
+  energy_ = computeEnergy();
+}
+
+void SparseIsingModel::copyStateFrom(const SparseIsingModel& other) {
+  assert(num_spins_ == other.num_spins_ && "Number of spins must match!");
+  std::memcpy(spins_, other.spins_, num_spins_);
+  energy_ = other.energy_;
+  copyGenealogyFrom(other);
+}
+
+void SparseIsingModel::restoreState(const void* state, double energy) {
+  std::memcpy(spins_, state, num_spins_);
+  energy_ = energy;
+}
+
+double SparseIsingModel::measureEnergy() const {
+#ifndef NDEBUG
+  const double full_energy = computeEnergy();
+  assert(std::abs(energy_ - full_energy) <= 1e-6 * (1 + std::abs(full_energy)) &&
+         "Running energy out of sync with the spins");
+#endif
+  return energy_;
+}
+
+inline double SparseIsingModel::localField(int i) const {
+  double h = fields_ ? fields_[i] : 0.0;
+  for (long k = row_offsets_[i]; k < row_offsets_[i + 1]; ++k) {
+    h += weights_[k] * spins_[column_indices_[k]];
+  }
+  return h;
+}
+
+// Every edge is stored in both rows, so the coupling sum over all rows counts
+// each bond twice; no assumption is made about how the rows pair up.
+double SparseIsingModel::computeEnergy() const {
+  double coupling_sum = 0.0;
+  double field_sum = 0.0;
+  for (int i = 0; i < num_spins_; ++i) {
+    double h = 0.0;
+    for (long k = row_offsets_[i]; k < row_offsets_[i + 1]; ++k) {
+      h += weights_[k] * spins_[column_indices_[k]];
+    }
+    coupling_sum += spins_[i] * h;
+    if (fields_) {
+      field_sum += spins_[i] * fields_[i];
+    }
+  }
+  return -0.5 * coupling_sum - field_sum + energy_offset_;
+}
+
+double SparseIsingModel::measureMagnetization() const {
+  int mag = 0;
+  for (int i = 0; i < num_spins_; ++i) {
+    mag += spins_[i];
+  }
+  return static_cast<double>(mag);
+}
+
+double SparseIsingModel::measureObservable(Observable observable) const {
+  switch (observable) {
+    case Observable::energy:
+      return measureEnergy();
+    case Observable::magnetization:
+      return measureMagnetization();
+    default:
+      throw std::invalid_argument("Unknown observable!");
+  }
+}
+
+double SparseIsingModel::measureOverlap(const SparseIsingModel& other) const {
+  assert(num_spins_ == other.num_spins_ && "Number of spins must match!");
+  int q = 0;
+  for (int i = 0; i < num_spins_; ++i) {
+    q += spins_[i] * other.spins_[i];
+  }
+  return static_cast<double>(q);
+}
+
+void SparseIsingModel::updateSweep(int num_sweeps, double beta, gsl_rng* r,
+                                   UpdateMethod method, bool sequential) {
+  updateSweepImpl(num_sweeps, beta, r, method, sequential);
+}
+
+void SparseIsingModel::updateSweep(int num_sweeps, double beta,
+                                   RandomStream& r, UpdateMethod method,
+                                   bool sequential) {
+  updateSweepImpl(num_sweeps, beta, r, method, sequential);
+}
+
+template <typename Rng>
+void SparseIsingModel::updateSweepImpl(int num_sweeps, double beta, Rng& r,
+                                       UpdateMethod method, bool sequential) {
+  if (method != UpdateMethod::metropolis && method != UpdateMethod::heat_bath) {
+    throw std::invalid_argument("Unknown update method!");
+  }
+  const bool heat_bath = method == UpdateMethod::heat_bath;
+
+  auto update_site = [&](int i) {
+    const double delta_E = 2.0 * spins_[i] * localField(i);
+    bool flip;
+    if (heat_bath) {
+      flip = rngUniform(r) < 1 / (1 + exp(beta * delta_E));
+    } else {
+      flip = delta_E <= 0 || rngUniform(r) < exp(-beta * delta_E);
+    }
+    if (flip) {
+      spins_[i] = static_cast<std::int8_t>(-spins_[i]);
+      energy_ += delta_E;
+    }
+  };
+
+  for (int sweep = 0; sweep < num_sweeps; ++sweep) {
+    for (int n = 0; n < num_spins_; ++n) {
+      update_site(sequential ? n
+                             : static_cast<int>(rngUniformInt(r, num_spins_)));
+    }
+  }
+}
+
+std::vector<int> SparseIsingModel::getState() const {
+  std::vector<int> state(num_spins_);
+  for (int k = 0; k < num_spins_; ++k) {
+    state[order_[k]] = spins_[k];
+  }
+  return state;
+}
+
+void SparseIsingModel::setSpin(int i, int val) {
+  if (val != 1 && val != -1) {
+    throw std::invalid_argument("Spin value must be +1 or -1");
+  }
+  if (getSpin(i) != val) {
+    const int k = label_[i];
+    energy_ += 2.0 * spins_[k] * localField(k);
+    spins_[k] = static_cast<std::int8_t>(val);
+  }
+}
+
+int SparseIsingModel::getSpin(int i) const {
+  if (i < 0 || i >= num_spins_) {
+    throw std::out_of_range("Index out of range");
+  }
+  return spins_[label_[i]];
+}
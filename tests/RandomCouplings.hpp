@@ -0,0 +1,42 @@
+#ifndef TESTS_RANDOM_COUPLINGS_HPP
+#define TESTS_RANDOM_COUPLINGS_HPP
+
+#include <gsl/gsl_rng.h>
+
+#include <cmath>
+#include <vector>
+
+#include "models/Ising3DHelpers.hpp"
+
+// Random couplings shared by the tests. Continuous values make running
+// energies carry rounding that a recomputation would not reproduce bit for
+// bit.
+
+// Standard normal deviate (Box-Muller).
+inline double gaussianDeviate(gsl_rng* r) {
+  return std::sqrt(-2 * std::log(1 - gsl_rng_uniform(r))) *
+         std::cos(2 * M_PI * gsl_rng_uniform(r));
+}
+
+// Symmetric Gaussian bonds on the cubic lattice built by
+// initializeNeighborTable3D, where neighbor 2d is the -1 and 2d+1 the +1 step
+// along axis d.
+inline std::vector<double> randomGaussianBonds(int L, unsigned long seed) {
+  const int num_spins = L * L * L;
+  const std::vector<int> neighbors = initializeNeighborTable3D(L);
+  std::vector<double> bonds(num_spins * 6);
+  gsl_rng* r = gsl_rng_alloc(gsl_rng_mt19937);
+  gsl_rng_set(r, seed);
+  for (int i = 0; i < num_spins; ++i) {
+    for (int d = 0; d < 3; ++d) {
+      const double J = gaussianDeviate(r);
+      const int j = neighbors[i * 6 + 2 * d + 1];
+      bonds[i * 6 + 2 * d + 1] = J;
+      bonds[j * 6 + 2 * d] = J;
+    }
+  }
+  gsl_rng_free(r);
+  return bonds;
+}
+
+#endif  // TESTS_RANDOM_COUPLINGS_HPP
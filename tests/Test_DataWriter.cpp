@@ -0,0 +1,171 @@
+#include <gtest/gtest.h>
+#include <gsl/gsl_rng.h>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "DataWriter.hpp"
+#include "Population.hpp"
+#include "StepRecorder.hpp"
+#include "models/IsingModel.hpp"
+#include "models/Ising3DHelpers.hpp"
+
+template <typename T>
+static std::vector<T> readColumn(const std::string& path) {
+  std::ifstream in(path, std::ios::binary);
+  std::vector<char> bytes((std::istreambuf_iterator<char>(in)),
+                          std::istreambuf_iterator<char>());
+  std::vector<T> values(bytes.size() / sizeof(T));
+  std::copy(bytes.begin(), bytes.end(), reinterpret_cast<char*>(values.data()));
+  return values;
+}
+
+class DataWriterTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    dir = ::testing::TempDir() + "pamc_data_" +
+          ::testing::UnitTest::GetInstance()->current_test_info()->name();
+    std::filesystem::remove_all(dir);
+  }
+  void TearDown() override { std::filesystem::remove_all(dir); }
+
+  std::string file(const std::string& name) const { return dir + "/" + name; }
+
+  std::string dir;
+};
+
+TEST_F(DataWriterTest, WritesScalarAndArrayColumns) {
+  DataWriter writer(dir);
+  const int beta = writer.addScalar("beta");
+  const int step = writer.addScalar("step", DataWriter::ColumnType::int64);
+  const int energies = writer.addArray("energies");
+  const int spins = writer.addArray("spins", DataWriter::ColumnType::int8);
+  for (int k = 0; k < 3; ++k) {
+    writer.set(beta, 0.25 * k);
+    writer.set(step, k);
+    writer.setArray(energies, std::vector<double>(k + 1, -1.5 * k));
+    writer.setArray(spins, std::vector<std::int8_t>{1, -1});
+    writer.endStep();
+  }
+  EXPECT_EQ(writer.numSteps(), 3);
+  writer.close();
+
+  EXPECT_EQ(readColumn<double>(file("beta.bin")),
+            (std::vector<double>{0.0, 0.25, 0.5}));
+  EXPECT_EQ(readColumn<std::int64_t>(file("step.bin")),
+            (std::vector<std::int64_t>{0, 1, 2}));
+  EXPECT_EQ(readColumn<double>(file("energies.bin")),
+            (std::vector<double>{0.0, -1.5, -1.5, -3.0, -3.0, -3.0}));
+  EXPECT_EQ(readColumn<std::int64_t>(file("energies.offsets.bin")),
+            (std::vector<std::int64_t>{0, 1, 3, 6}));
+  EXPECT_EQ(readColumn<std::int8_t>(file("spins.bin")),
+            (std::vector<std::int8_t>{1, -1, 1, -1, 1, -1}));
+
+  std::ifstream schema_file(file("schema.json"));
+  const std::string schema((std::istreambuf_iterator<char>(schema_file)),
+                           std::istreambuf_iterator<char>());
+  EXPECT_NE(schema.find("\"format\": \"pamc-columnar\""), std::string::npos);
+  EXPECT_NE(schema.find("{\"name\": \"spins\", \"kind\": \"array\", \"type\": "
+                        "\"int8\", \"file\": \"spins.bin\", \"offsets\": "
+                        "\"spins.offsets.bin\"}"),
+            std::string::npos);
+}
+
+TEST_F(DataWriterTest, UnsetValuesAndMisuse) {
+  DataWriter writer(dir);
+  const int x = writer.addScalar("x");
+  const int n = writer.addScalar("n", DataWriter::ColumnType::int32);
+  const int a = writer.addArray("a");
+  EXPECT_THROW(writer.addScalar("x"), std::invalid_argument);
+  EXPECT_THROW(writer.addScalar("a/b"), std::invalid_argument);
+  EXPECT_THROW(writer.set(a, 1.0), std::invalid_argument);
+  EXPECT_THROW(writer.setArray(a, std::vector<int>{1}), std::invalid_argument);
+
+  writer.set(x, 2.0);
+  writer.set(n, 7);
+  writer.endStep();
+  writer.endStep();
+  EXPECT_THROW(writer.addScalar("late"), std::logic_error);
+  writer.close();
+  EXPECT_THROW(writer.endStep(), std::logic_error);
+
+  const std::vector<double> xs = readColumn<double>(file("x.bin"));
+  ASSERT_EQ(xs.size(), 2u);
+  EXPECT_EQ(xs[0], 2.0);
+  EXPECT_TRUE(std::isnan(xs[1]));
+  EXPECT_EQ(readColumn<std::int32_t>(file("n.bin")),
+            (std::vector<std::int32_t>{7, 0}));
+  EXPECT_EQ(readColumn<std::int64_t>(file("a.offsets.bin")),
+            (std::vector<std::int64_t>{0, 0, 0}));
+}
+
+// Writes to /dev/full are buffered and only fail once they are flushed.
+TEST_F(DataWriterTest, FlushReportsBufferedWriteErrors) {
+  if (!std::filesystem::exists("/dev/full")) {
+    GTEST_SKIP() << "needs /dev/full";
+  }
+  std::filesystem::create_directories(dir);
+  std::filesystem::create_symlink("/dev/full", file("x.bin"));
+  DataWriter writer(dir);
+  const int x = writer.addScalar("x");
+  writer.set(x, 1.0);
+  writer.endStep();
+  EXPECT_THROW(writer.flush(), std::runtime_error);
+  EXPECT_THROW(writer.close(), std::runtime_error);
+}
+
+TEST_F(DataWriterTest, StepRecorderWritesPopulationRecords) {
+  const int L = 4;
+  const int num_spins = L * L * L;
+  std::vector<int> neighbor_table = initializeNeighborTable3D(L);
+  std::vector<double> bond_table(num_spins * 6, 1.0);
+  SharedModelData<IsingModel> shared_data(L, num_spins, 6,
+                                          neighbor_table.data(),
+                                          bond_table.data());
+  Population<IsingModel> population(100, gsl_rng_mt19937, shared_data, 3);
+  ObservableSet<IsingModel> observables;
+  observables.add(IsingModel::Observable::magnetization, 2);
+  population.setObservables(observables);
+
+  std::vector<double> betas;
+  std::vector<double> mean_energies;
+  std::vector<double> m2;
+  std::vector<double> load_imbalances;
+  std::vector<double> energies;
+  std::vector<std::int32_t> families;
+  {
+    DataWriter writer(dir);
+    StepRecorder<IsingModel> recorder(writer, {"m2"}, true);
+    double beta = 0.0;
+    for (int step = 0; step < 4; ++step) {
+      population.equilibrate(5, beta, IsingModel::UpdateMethod::metropolis,
+                             false);
+      recorder.record(step, population);
+      betas.push_back(beta);
+      mean_energies.push_back(population.measureEnergy());
+      m2.push_back(population.measureObservables()[0]);
+      load_imbalances.push_back(population.getLoadImbalance());
+      for (int i = 0; i < population.getPopSize(); ++i) {
+        energies.push_back(population.getEnergies()[i]);
+        families.push_back(population.getFamily(i));
+      }
+      beta = population.suggestNextBeta(beta, 0.3);
+      population.resample(beta);
+    }
+  }  // the destructor writes the remaining steps
+
+  EXPECT_EQ(readColumn<double>(file("beta.bin")), betas);
+  EXPECT_EQ(readColumn<double>(file("mean_energy.bin")), mean_energies);
+  EXPECT_EQ(readColumn<double>(file("m2.bin")), m2);
+  EXPECT_EQ(readColumn<double>(file("load_imbalance.bin")), load_imbalances);
+  EXPECT_EQ(readColumn<std::int64_t>(file("step.bin")),
+            (std::vector<std::int64_t>{0, 1, 2, 3}));
+  EXPECT_EQ(readColumn<double>(file("energies.bin")), energies);
+  EXPECT_EQ(readColumn<std::int32_t>(file("families.bin")), families);
+  EXPECT_EQ(readColumn<std::int64_t>(file("families.offsets.bin")).back(),
+            static_cast<std::int64_t>(families.size()));
+}
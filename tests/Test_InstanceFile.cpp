@@ -0,0 +1,151 @@
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "SharedModelData.hpp"
+#include "models/EAModel3DHelpers.hpp"
+#include "models/Ising3DHelpers.hpp"
+#include "models/IsingModel.hpp"
+
+class InstanceFileTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    const std::string prefix =
+        ::testing::TempDir() + "pamc_instance_" +
+        ::testing::UnitTest::GetInstance()->current_test_info()->name();
+    neighbor_path = prefix + "_neighbors.txt";
+    bond_path = prefix + "_bonds.txt";
+    instance_path = prefix + ".bin";
+    neighbors = initializeNeighborTable3D(L);
+    bonds.resize(num_spins * num_neighbors);
+    for (std::size_t b = 0; b < bonds.size(); ++b) {
+      bonds[b] = (b % 3 == 0 ? -1.0 : 1.0) * (0.125 + 0.001 * b);
+    }
+  }
+
+  void TearDown() override {
+    std::remove(neighbor_path.c_str());
+    std::remove(bond_path.c_str());
+    std::remove(instance_path.c_str());
+  }
+
+  // Writes the tables in the text format, skipping the last num_missing
+  // entries of each.
+  void writeText(int num_missing = 0) {
+    std::ofstream nb(neighbor_path);
+    std::ofstream bd(bond_path);
+    bd.precision(17);
+    for (std::size_t k = 0; k + num_missing < neighbors.size(); ++k) {
+      nb << neighbors[k] << ((k + 1) % num_neighbors == 0 ? " \n" : " ");
+      bd << bonds[k] << ((k + 1) % num_neighbors == 0 ? " \n" : " ");
+    }
+  }
+
+  const int L = 4;
+  const int num_spins = L * L * L;
+  const int num_neighbors = 6;
+  std::vector<int> neighbors;
+  std::vector<double> bonds;
+  std::string neighbor_path;
+  std::string bond_path;
+  std::string instance_path;
+};
+
+TEST_F(InstanceFileTest, ConvertedInstanceMapsTheTextTables) {
+  writeText();
+  EXPECT_FALSE(isInstanceFile(neighbor_path));
+  convertTextInstance(neighbor_path, bond_path, instance_path, L, num_spins,
+                      num_neighbors);
+  ASSERT_TRUE(isInstanceFile(instance_path));
+
+  InstanceFile instance(instance_path);
+  EXPECT_EQ(instance.systemSize(), L);
+  EXPECT_EQ(instance.numSpins(), num_spins);
+  EXPECT_EQ(instance.numNeighbors(), num_neighbors);
+  EXPECT_EQ(reinterpret_cast<std::uintptr_t>(instance.neighborTable()) %
+                INSTANCE_ALIGNMENT,
+            0u);
+  EXPECT_EQ(reinterpret_cast<std::uintptr_t>(instance.bondTable()) %
+                INSTANCE_ALIGNMENT,
+            0u);
+  EXPECT_EQ(std::vector<int>(instance.neighborTable(),
+                             instance.neighborTable() + neighbors.size()),
+            neighbors);
+  EXPECT_EQ(std::vector<double>(instance.bondTable(),
+                                instance.bondTable() + bonds.size()),
+            bonds);
+
+  // The model data refers to the mapped tables rather than a copy.
+  SharedModelData<IsingModel> shared_data(
+      L, num_spins, num_neighbors, instance.neighborTable(),
+      instance.bondTable());
+  EXPECT_EQ(shared_data.neighbor_table, instance.neighborTable());
+  EXPECT_TRUE(shared_data.cubic_lattice);
+}
+
+TEST_F(InstanceFileTest, TextTablesMustMatchTheGivenSize) {
+  writeText(1);
+  EXPECT_THROW(loadNeighborTable(neighbor_path, num_spins, num_neighbors),
+               std::runtime_error);
+  EXPECT_THROW(loadBondTable(bond_path, num_spins, num_neighbors),
+               std::runtime_error);
+  writeText();
+  EXPECT_THROW(loadBondTable(bond_path, num_spins - 1, num_neighbors),
+               std::runtime_error);
+  EXPECT_NO_THROW(loadBondTable(bond_path, num_spins, num_neighbors));
+
+  neighbors[17] = num_spins;
+  writeText();
+  EXPECT_THROW(loadNeighborTable(neighbor_path, num_spins, num_neighbors),
+               std::runtime_error);
+  EXPECT_THROW(writeInstanceFile(instance_path, L, num_spins, num_neighbors,
+                                 neighbors.data(), bonds.data()),
+               std::runtime_error);
+}
+
+TEST_F(InstanceFileTest, RejectsDamagedInstances) {
+  writeInstanceFile(instance_path, L, num_spins, num_neighbors,
+                    neighbors.data(), bonds.data());
+  std::string contents;
+  {
+    std::ifstream in(instance_path, std::ios::binary);
+    contents.assign(std::istreambuf_iterator<char>(in), {});
+  }
+  auto rewrite = [&](const std::string& bytes) {
+    std::ofstream out(instance_path, std::ios::binary | std::ios::trunc);
+    out.write(bytes.data(), bytes.size());
+  };
+
+  rewrite(contents.substr(0, contents.size() - 8));
+  EXPECT_THROW(InstanceFile{instance_path}, std::runtime_error);
+
+  std::string wrong_size = contents;
+  InstanceHeader header;
+  std::memcpy(&header, wrong_size.data(), sizeof(header));
+  header.num_spins = num_spins / 2;
+  std::memcpy(&wrong_size[0], &header, sizeof(header));
+  rewrite(wrong_size);
+  EXPECT_THROW(InstanceFile{instance_path}, std::runtime_error);
+
+  std::string wrong_type = contents;
+  std::memcpy(&header, wrong_type.data(), sizeof(header));
+  header.bond_dtype = 7;
+  std::memcpy(&wrong_type[0], &header, sizeof(header));
+  rewrite(wrong_type);
+  EXPECT_THROW(InstanceFile{instance_path}, std::runtime_error);
+
+  std::string bad_neighbor = contents;
+  std::memcpy(&header, bad_neighbor.data(), sizeof(header));
+  const std::int32_t out_of_range = num_spins;
+  std::memcpy(&bad_neighbor[header.neighbor_offset + 17 * sizeof(std::int32_t)],
+              &out_of_range, sizeof(out_of_range));
+  rewrite(bad_neighbor);
+  EXPECT_THROW(InstanceFile{instance_path}, std::runtime_error);
+
+  EXPECT_THROW(InstanceFile{neighbor_path}, std::runtime_error);
+}
@@ -0,0 +1,106 @@
+#include <gtest/gtest.h>
+#include <gsl/gsl_rng.h>
+#include <vector>
+#include <cmath>
+
+#include "Population.hpp"
+#include "models/BatchedEAModel.hpp"
+#include "SharedModelData.hpp"
+#include "models/Ising3DHelpers.hpp"
+#include "Genealogy.hpp"
+
+class PopulationBatchedEAModelTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    L = 5;
+    num_spins = L * L * L;
+    num_neighbors = 6;
+    J = 1.0;
+
+    neighbor_table = initializeNeighborTable3D(L);
+    bond_table.resize(num_spins * num_neighbors, J);  // ferromagnetic bonds
+
+    shared_data = new SharedModelData<BatchedEAModel>(
+        L, num_spins, num_neighbors, neighbor_table.data(), bond_table.data());
+
+    // Deliberately not a multiple of the 8 lanes per model object.
+    pop_size = 500;
+    population = std::make_unique<Population<BatchedEAModel>>(
+        pop_size, gsl_rng_mt19937, *shared_data, 6416);
+  }
+
+  void TearDown() override { delete shared_data; }
+
+  int L;
+  int num_spins;
+  int num_neighbors;
+  double J;
+  int pop_size;
+  std::vector<int> neighbor_table;
+  std::vector<double> bond_table;
+  SharedModelData<BatchedEAModel>* shared_data;
+  std::unique_ptr<Population<BatchedEAModel>> population;
+};
+
+TEST_F(PopulationBatchedEAModelTest, PopulationInitializesCorrectly) {
+  EXPECT_EQ(population->getPopSize(), pop_size);
+  EXPECT_EQ(population->getModels().size(), 63);
+  GenealogyStatistics stats = population->computeGenealogyStatistics();
+  EXPECT_EQ(stats.num_unique_families, pop_size);
+  EXPECT_NEAR(stats.rho_t, 1.0, 1e-8);
+  EXPECT_NEAR(population->measureEnergy() / num_spins, 0.0,
+              sqrt(3.0 / num_spins));
+}
+
+TEST_F(PopulationBatchedEAModelTest, AnnealWithMetropolisToLowBeta) {
+  double beta = 0.05;
+  while (beta <= 0.15) {
+    population->equilibrate(20, beta,
+                            BatchedEAModel::UpdateMethod::metropolis, true);
+    EXPECT_NEAR(population->measureEnergy() / num_spins,
+                -3 * J * tanh(beta * J), 5e-2);
+    beta += 0.05;
+    population->resample(beta);
+  }
+}
+
+// Replicas that survive resampling must carry their spins, energy and family
+// with them, whichever lane they land in.
+TEST_F(PopulationBatchedEAModelTest, ResampleKeepsReplicaStateAndFamily) {
+  double beta = 0.0;
+  while (beta < 0.5) {
+    population->equilibrate(5, beta, BatchedEAModel::UpdateMethod::heat_bath,
+                            false);
+    beta = population->suggestNextBeta(beta, 0.1);
+    population->resample(beta);
+  }
+  population->measureEnergy(true);
+  GenealogyStatistics stats = population->computeGenealogyStatistics();
+  EXPECT_GT(stats.rho_t, 1.0);
+  EXPECT_LT(stats.num_unique_families, pop_size);
+
+  auto& models = population->getModels();
+  for (int i = 0; i < population->getPopSize(); ++i) {
+    int lane = i % BatchedEAModel::NUM_LANES;
+    const auto& model = models[i / BatchedEAModel::NUM_LANES];
+    EXPECT_GE(model.getFamily(lane), 0);
+    EXPECT_EQ(population->getState(i), model.getState(lane));
+    EXPECT_NEAR(model.measureEnergy(lane), model.computeEnergy(lane), 1e-9);
+  }
+}
+
+TEST_F(PopulationBatchedEAModelTest, AnnealWithBetaScheduler) {
+  double beta = 0.0;
+  while (beta < 2) {
+    population->equilibrate(10, beta,
+                            BatchedEAModel::UpdateMethod::metropolis, true);
+    beta = population->suggestNextBeta(beta, 0.1);
+    if (beta > 2) {
+      beta = 2;
+    }
+    population->resample(beta);
+  }
+  population->equilibrate(10, beta, BatchedEAModel::UpdateMethod::metropolis,
+                          true);
+  EXPECT_NEAR(population->getMinEnergy() / num_spins, -3, 1e-10);
+}
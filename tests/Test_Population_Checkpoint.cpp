@@ -0,0 +1,206 @@
+#include <gtest/gtest.h>
+#include <gsl/gsl_rng.h>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "Population.hpp"
+#include "models/BatchedEAModel.hpp"
+#include "models/IsingModel.hpp"
+#include "SharedModelData.hpp"
+#include "models/Ising3DHelpers.hpp"
+#include "Genealogy.hpp"
+#include "RandomCouplings.hpp"
+
+// Everything a continued run produces: per-step energies, free energy,
+// genealogy and population size, then every replica's spins.
+template <typename ModelType>
+static std::vector<double> continueRun(Population<ModelType>& population,
+                                       double beta, int num_steps,
+                                       bool serial_resample) {
+  std::vector<double> trace;
+  for (int step = 0; step < num_steps; ++step) {
+    population.equilibrate(5, beta, ModelType::UpdateMethod::metropolis, false);
+    trace.push_back(population.measureEnergy());
+    trace.push_back(population.getMinEnergy());
+    trace.push_back(population.computeGenealogyStatistics().rho_t);
+    beta = population.suggestNextBeta(beta, 0.5);
+    if (serial_resample) {
+      population.resample(beta, nullptr);
+    } else {
+      population.resample(beta);
+    }
+    trace.push_back(beta);
+    trace.push_back(population.getDeltaBetaF());
+    trace.push_back(population.getPopSize());
+  }
+  for (int i = 0; i < population.getPopSize(); ++i) {
+    for (int s : population.getState(i)) {
+      trace.push_back(s);
+    }
+  }
+  return trace;
+}
+
+class PopulationCheckpointTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    neighbor_table = initializeNeighborTable3D(L);
+    bond_table = randomGaussianBonds(L, 11);
+    path = ::testing::TempDir() + "pamc_checkpoint_" +
+           ::testing::UnitTest::GetInstance()->current_test_info()->name();
+  }
+
+  void TearDown() override { std::remove(path.c_str()); }
+
+  // Anneals a fresh population for a few steps and returns the beta reached.
+  template <typename ModelType>
+  double anneal(Population<ModelType>& population, bool serial_resample) {
+    double beta = 0.0;
+    for (int step = 0; step < 4; ++step) {
+      population.equilibrate(5, beta, ModelType::UpdateMethod::metropolis,
+                             false);
+      beta = population.suggestNextBeta(beta, 0.5);
+      if (serial_resample) {
+        population.resample(beta, nullptr);
+      } else {
+        population.resample(beta);
+      }
+    }
+    return beta;
+  }
+
+  const int L = 4;
+  const int num_spins = L * L * L;
+  const int num_neighbors = 6;
+  std::vector<int> neighbor_table;
+  std::vector<double> bond_table;
+  std::string path;
+};
+
+TEST_F(PopulationCheckpointTest, IsingModelRestartContinuesBitwise) {
+  SharedModelData<IsingModel> shared_data(L, num_spins, num_neighbors,
+                                          neighbor_table.data(),
+                                          bond_table.data());
+  Population<IsingModel> population(200, gsl_rng_mt19937, shared_data, 31);
+  // Serial resampling draws from the population's gsl_rng, whose state must
+  // survive the restart too.
+  const double beta = anneal(population, true);
+  population.saveCheckpoint(path);
+  const std::vector<double> expected = continueRun(population, beta, 3, true);
+
+  Population<IsingModel> restarted(200, gsl_rng_mt19937, shared_data, 5);
+  restarted.loadCheckpoint(path);
+  EXPECT_EQ(continueRun(restarted, beta, 3, true), expected);
+}
+
+TEST_F(PopulationCheckpointTest, AsyncSaveRunsAlongsideEquilibrate) {
+  SharedModelData<IsingModel> shared_data(L, num_spins, num_neighbors,
+                                          neighbor_table.data(),
+                                          bond_table.data());
+  Population<IsingModel> population(200, gsl_rng_mt19937, shared_data, 31);
+  const double beta = anneal(population, false);
+  population.saveCheckpointAsync(path);
+  // Sweeps modify the replicas while the snapshot is written.
+  const std::vector<double> expected = continueRun(population, beta, 3, false);
+  population.waitForCheckpoint();
+
+  Population<IsingModel> restarted(200, gsl_rng_mt19937, shared_data, 31);
+  restarted.loadCheckpoint(path);
+  EXPECT_EQ(continueRun(restarted, beta, 3, false), expected);
+}
+
+TEST_F(PopulationCheckpointTest, MultiLaneRestartContinuesBitwise) {
+  SharedModelData<BatchedEAModel> shared_data(L, num_spins, num_neighbors,
+                                              neighbor_table.data(),
+                                              bond_table.data());
+  // Not a multiple of the lanes, so the last object has unused lanes.
+  Population<BatchedEAModel> population(203, gsl_rng_mt19937, shared_data, 31);
+  const double beta = anneal(population, false);
+  population.saveCheckpoint(path);
+  const std::vector<double> expected = continueRun(population, beta, 3, false);
+
+  Population<BatchedEAModel> restarted(203, gsl_rng_mt19937, shared_data, 31);
+  restarted.loadCheckpoint(path);
+  EXPECT_EQ(continueRun(restarted, beta, 3, false), expected);
+}
+
+TEST_F(PopulationCheckpointTest, RejectsMismatchedOrDamagedFiles) {
+  SharedModelData<IsingModel> shared_data(L, num_spins, num_neighbors,
+                                          neighbor_table.data(),
+                                          bond_table.data());
+  Population<IsingModel> population(100, gsl_rng_mt19937, shared_data, 31);
+  population.saveCheckpoint(path);
+
+  Population<IsingModel> other_size(120, gsl_rng_mt19937, shared_data, 31);
+  EXPECT_THROW(other_size.loadCheckpoint(path), std::runtime_error);
+  Population<IsingModel> other_backend(100, gsl_rng_mt19937, shared_data, 31,
+                                       RngBackend::xoshiro);
+  EXPECT_THROW(other_backend.loadCheckpoint(path), std::runtime_error);
+
+  std::string contents;
+  {
+    std::ifstream in(path, std::ios::binary);
+    contents.assign(std::istreambuf_iterator<char>(in), {});
+  }
+  {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(contents.data(), contents.size() - 1);
+  }
+  Population<IsingModel> restarted(100, gsl_rng_mt19937, shared_data, 31);
+  EXPECT_THROW(restarted.loadCheckpoint(path), std::runtime_error);
+  EXPECT_THROW(restarted.loadCheckpoint(path + ".missing"), std::runtime_error);
+
+  // Counts that do not fit the population, in an otherwise consistent file.
+  auto rewriteCounts = [&](int pop_size, int num_models) {
+    CheckpointHeader header;
+    std::memcpy(&header, contents.data(), sizeof(header));
+    header.pop_size = pop_size;
+    header.num_models = num_models;
+    layoutCheckpoint(header);
+    std::string bytes(header.file_bytes, '\0');
+    std::memcpy(&bytes[0], &header, sizeof(header));
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(bytes.data(), bytes.size());
+  };
+  rewriteCounts(100, 1);
+  EXPECT_THROW(restarted.loadCheckpoint(path), std::runtime_error);
+  rewriteCounts(100, 150);
+  EXPECT_THROW(restarted.loadCheckpoint(path), std::runtime_error);
+  rewriteCounts(1000, 1000);
+  EXPECT_THROW(restarted.loadCheckpoint(path), std::runtime_error);
+  EXPECT_EQ(restarted.getPopSize(), 100);
+}
+
+// Relabeled lattices checkpoint their spins in the internal order, so a
+// restart needs the same spin order.
+TEST_F(PopulationCheckpointTest, SpinOrderMustMatch) {
+  const auto morton = SharedModelData<IsingModel>::relabeled(
+      L, num_spins, num_neighbors, neighbor_table.data(), bond_table.data(),
+      SpinOrder::morton);
+  const auto rcm = SharedModelData<IsingModel>::relabeled(
+      L, num_spins, num_neighbors, neighbor_table.data(), bond_table.data(),
+      SpinOrder::rcm);
+  SharedModelData<IsingModel> original(L, num_spins, num_neighbors,
+                                       neighbor_table.data(),
+                                       bond_table.data());
+  EXPECT_EQ(IsingModel::stateLayout(original), 0u);
+  EXPECT_NE(IsingModel::stateLayout(morton), 0u);
+
+  Population<IsingModel> population(100, gsl_rng_mt19937, morton, 31);
+  const double beta = anneal(population, true);
+  population.saveCheckpoint(path);
+  const std::vector<double> expected = continueRun(population, beta, 2, true);
+
+  Population<IsingModel> other_order(100, gsl_rng_mt19937, rcm, 31);
+  EXPECT_THROW(other_order.loadCheckpoint(path), std::runtime_error);
+  Population<IsingModel> original_order(100, gsl_rng_mt19937, original, 31);
+  EXPECT_THROW(original_order.loadCheckpoint(path), std::runtime_error);
+
+  Population<IsingModel> restarted(100, gsl_rng_mt19937, morton, 5);
+  restarted.loadCheckpoint(path);
+  EXPECT_EQ(continueRun(restarted, beta, 2, true), expected);
+}
@@ -2,6 +2,8 @@
 #include <gsl/gsl_rng.h>
 #include <vector>
 #include <cmath>
+#include <numeric>
+#include <algorithm>
 
 #include "Population.hpp"
 #include "models/IsingModel.hpp"
@@ -180,4 +182,323 @@ TEST_F(LargePopulationIsingModelTest, InitialRhotRhos) {
   EXPECT_GT(new_stats.rho_t, stats.rho_t);
   EXPECT_GT(new_stats.rho_s, stats.rho_s);
 
-}
\ No newline at end of file
+}
+
+// Replicas live in a preallocated arena: resampling up and down must never
+// reallocate the model vector.
+TEST_F(LargePopulationIsingModelTest, ResampleDoesNotReallocate) {
+  std::vector<IsingModel>& models = population->getModels();
+  const IsingModel* data = models.data();
+  std::size_t capacity = models.capacity();
+  double beta = 0.0;
+  while (beta < 1.0) {
+    population->equilibrate(2, beta, IsingModel::UpdateMethod::metropolis, true);
+    beta = population->suggestNextBeta(beta, 0.3);
+    population->resample(beta);
+    EXPECT_EQ(models.data(), data);
+    EXPECT_EQ(models.capacity(), capacity);
+  }
+}
+
+// A gsl-backed RandomStream must drive equilibrate and resample exactly like
+// the gsl_rng it wraps.
+TEST_F(PopulationIsingModelTest, GslRandomStreamMatchesGslRng) {
+  Population<IsingModel> other(pop_size, gsl_rng_mt19937, *shared_data, 6416);
+  RandomStream stream(RngBackend::gsl, 56);
+
+  population->equilibrate(5, 0.3, IsingModel::UpdateMethod::metropolis, false,
+                          rng_);
+  other.equilibrate(5, 0.3, IsingModel::UpdateMethod::metropolis, false,
+                    stream);
+  population->resample(0.4, rng_);
+  other.resample(0.4, stream);
+
+  ASSERT_EQ(other.getPopSize(), population->getPopSize());
+  for (int i = 0; i < pop_size; ++i) {
+    EXPECT_EQ(other.getState(i), population->getState(i));
+  }
+}
+
+// setRngSeed also keys the parallel resample, so reseeding with the same
+// value reproduces its copy counts and another value changes them.
+TEST_F(LargePopulationIsingModelTest, SetRngSeedKeysParallelResample) {
+  std::vector<int> families[3];
+  const unsigned long int seeds[3] = {7, 7, 8};
+  for (int run = 0; run < 3; ++run) {
+    Population<IsingModel> pop(pop_size, gsl_rng_mt19937, *shared_data, 6416);
+    pop.equilibrate(5, 0.3, IsingModel::UpdateMethod::metropolis, false);
+    pop.setRngSeed(seeds[run]);
+    pop.resample(0.6);
+    for (int i = 0; i < pop.getPopSize(); ++i) {
+      families[run].push_back(pop.getFamily(i));
+    }
+  }
+  EXPECT_EQ(families[0], families[1]);
+  EXPECT_NE(families[0], families[2]);
+}
+
+TEST_F(LargePopulationIsingModelTest, AnnealWithEachRngBackend) {
+  for (RngBackend backend :
+       {RngBackend::philox, RngBackend::xoshiro, RngBackend::gsl}) {
+    Population<IsingModel> pop(pop_size, gsl_rng_mt19937, *shared_data, 6416,
+                               backend);
+    double beta = 0.0;
+    while (beta < 0.5) {
+      pop.equilibrate(5, beta, IsingModel::UpdateMethod::metropolis, false);
+      beta += 0.05;
+      pop.resample(beta);
+    }
+    // Well inside the ordered phase the energy per spin is close to -3.
+    EXPECT_LT(pop.measureEnergy() / num_spins, -2.5);
+  }
+}
+
+// Per-replica streams make a run independent of the number of OpenMP threads.
+TEST_F(LargePopulationIsingModelTest, ResultsIndependentOfThreadCount) {
+  const int max_threads = omp_get_max_threads();
+  for (RngBackend backend : {RngBackend::philox, RngBackend::gsl}) {
+    std::vector<std::vector<int>> states[2];
+    double energies[2];
+    for (int run = 0; run < 2; ++run) {
+      omp_set_num_threads(run == 0 ? 1 : 4);
+      Population<IsingModel> pop(pop_size, gsl_rng_mt19937, *shared_data, 99,
+                                 backend);
+      double beta = 0.0;
+      for (int step = 0; step < 5; ++step) {
+        pop.equilibrate(3, beta, IsingModel::UpdateMethod::metropolis, false);
+        beta += 0.1;
+        pop.resample(beta);
+      }
+      energies[run] = pop.measureEnergy();
+      for (int i = 0; i < pop.getPopSize(); ++i) {
+        states[run].push_back(pop.getState(i));
+      }
+    }
+    EXPECT_EQ(energies[0], energies[1]);
+    EXPECT_EQ(states[0], states[1]);
+  }
+  omp_set_num_threads(max_threads);
+}
+
+// Raising the thread count after construction must neither overrun the
+// per-thread streams nor change the results.
+TEST_F(LargePopulationIsingModelTest, ThreadCountMayGrowAfterConstruction) {
+  const int max_threads = omp_get_max_threads();
+  std::vector<std::vector<int>> states[2];
+  for (int run = 0; run < 2; ++run) {
+    omp_set_num_threads(run == 0 ? 1 : 8);
+    Population<IsingModel> pop(pop_size, gsl_rng_mt19937, *shared_data, 99);
+    omp_set_num_threads(8);
+    double beta = 0.0;
+    for (int step = 0; step < 3; ++step) {
+      pop.equilibrate(3, beta, IsingModel::UpdateMethod::metropolis, false);
+      pop.houdayerMoves();
+      beta += 0.1;
+      pop.resample(beta);
+    }
+    EXPECT_GE(pop.getLoadImbalance(), 1.0);
+    for (int i = 0; i < pop.getPopSize(); ++i) {
+      states[run].push_back(pop.getState(i));
+    }
+  }
+  EXPECT_EQ(states[0], states[1]);
+  omp_set_num_threads(max_threads);
+}
+
+// Slot layout of the serial resample (forwardCopy then backfillHoles) for the
+// given copy counts: the index of the replica each slot ends up holding.
+static std::vector<int> serialResampleLayout(std::vector<int> counts,
+                                             int new_size) {
+  const int old_size = static_cast<int>(counts.size());
+  counts.resize(std::max(old_size, new_size), 0);
+  std::vector<int> source(counts.size());
+  std::iota(source.begin(), source.end(), 0);
+  int to = 0, from = 0;
+  while (to < new_size && counts[to] > 0) ++to;
+  while (from < old_size && counts[from] <= 1) ++from;
+  while (from < old_size && to < new_size) {
+    source[to] = source[from];
+    --counts[from];
+    ++counts[to];
+    while (to < new_size && counts[to] > 0) ++to;
+    while (from < old_size && counts[from] <= 1) ++from;
+  }
+  to = 0;
+  from = old_size - 1;
+  while (to < from) {
+    while (to < from && counts[to] > 0) ++to;
+    while (to < from && counts[from] == 0) --from;
+    if (to < from) {
+      source[to] = source[from];
+      counts[to] = 1;
+      --counts[from];
+      ++to;
+      --from;
+    }
+  }
+  source.resize(new_size);
+  return source;
+}
+
+// The parallel resample must leave every replica where the serial one would
+// for the same copy counts, with the parent's state, energy and family. The
+// population spans several scan chunks.
+TEST_F(LargePopulationIsingModelTest, ParallelResampleMatchesSerialLayout) {
+  const int size = 10000;
+  Population<IsingModel> pop(size, gsl_rng_mt19937, *shared_data, 11);
+  double beta = 0.0;
+  for (int step = 0; step < 6; ++step) {
+    pop.equilibrate(2, beta, IsingModel::UpdateMethod::metropolis, false);
+    const int old_size = pop.getPopSize();
+    std::vector<std::vector<int>> states(old_size);
+    std::vector<int> families(old_size);
+    std::vector<double> energies(old_size);
+    for (int i = 0; i < old_size; ++i) {
+      states[i] = pop.getState(i);
+      families[i] = pop.getModels()[i].getFamily();
+      energies[i] = pop.getModels()[i].measureEnergy();
+    }
+
+    beta += 0.1;
+    pop.resample(beta);
+    const int new_size = pop.getPopSize();
+    std::vector<int> counts(old_size, 0);
+    for (int i = 0; i < new_size; ++i) {
+      ++counts[pop.getModels()[i].getParent()];
+    }
+    const std::vector<int> expected = serialResampleLayout(counts, new_size);
+    for (int i = 0; i < new_size; ++i) {
+      const IsingModel& model = pop.getModels()[i];
+      ASSERT_EQ(model.getParent(), expected[i]);
+      ASSERT_EQ(model.getFamily(), families[expected[i]]);
+      ASSERT_EQ(model.measureEnergy(), energies[expected[i]]);
+      ASSERT_EQ(pop.getState(i), states[expected[i]]);
+    }
+  }
+}
+
+// Both resampling paths update delta_betaF_ from the same weights.
+TEST_F(LargePopulationIsingModelTest, ParallelResampleFreeEnergyMatchesSerial) {
+  Population<IsingModel> other(pop_size, gsl_rng_mt19937, *shared_data, 6416);
+  population->equilibrate(5, 0.3, IsingModel::UpdateMethod::metropolis, false);
+  other.equilibrate(5, 0.3, IsingModel::UpdateMethod::metropolis, false);
+  population->resample(0.4);
+  other.resample(0.4, rng_);
+  EXPECT_EQ(population->getDeltaBetaF(), other.getDeltaBetaF());
+  EXPECT_NEAR(population->getPopSize(), pop_size, 5 * std::sqrt(pop_size));
+}
+
+// The averages measured at the end of equilibrate match a plain loop over
+// the replicas.
+TEST_F(LargePopulationIsingModelTest, MeasureObservablesMatchesSerialLoop) {
+  using Observable = IsingModel::Observable;
+  ObservableSet<IsingModel> observables;
+  const int energy = observables.add(Observable::energy);
+  const int abs_m = observables.add(Observable::magnetization, 1, true);
+  const int m2 = observables.add(Observable::magnetization, 2);
+  const int m4 = observables.add(Observable::magnetization, 4);
+  const int spin0 = observables.add(
+      [](const IsingModel& model) { return model.getSpin(0); });
+  EXPECT_EQ(observables.size(), 5);
+  population->setObservables(observables);
+
+  for (double beta : {0.1, 0.3}) {
+    population->equilibrate(5, beta, IsingModel::UpdateMethod::metropolis,
+                            false);
+    const std::vector<double> values = population->measureObservables();
+    double sum_e = 0.0, sum_abs_m = 0.0, sum_m2 = 0.0, sum_m4 = 0.0;
+    double sum_spin0 = 0.0;
+    for (int i = 0; i < population->getPopSize(); ++i) {
+      const IsingModel& model = population->getModels()[i];
+      const double m = model.measureMagnetization();
+      sum_e += model.computeEnergy();
+      sum_abs_m += std::abs(m);
+      sum_m2 += m * m;
+      sum_m4 += m * m * m * m;
+      sum_spin0 += model.getSpin(0);
+    }
+    const double n = population->getPopSize();
+    EXPECT_NEAR(values[energy], sum_e / n, 1e-9);
+    EXPECT_NEAR(values[energy], population->measureEnergy(), 1e-9);
+    EXPECT_NEAR(values[abs_m], sum_abs_m / n, 1e-9);
+    EXPECT_NEAR(values[m2] / (sum_m2 / n), 1.0, 1e-12);
+    EXPECT_NEAR(values[m4] / (sum_m4 / n), 1.0, 1e-12);
+    EXPECT_NEAR(values[spin0], sum_spin0 / n, 1e-12);
+    population->resample(beta + 0.1);
+  }
+}
+
+// Wolff sweeps vary widely in cost per replica; every schedule must still
+// produce the same run, and report a load imbalance of at least 1.
+TEST_F(LargePopulationIsingModelTest, SchedulesGiveIdenticalResults) {
+  std::vector<std::vector<int>> states[3];
+  const EquilibrateSchedule schedules[3] = {
+      EquilibrateSchedule::static_blocks, EquilibrateSchedule::dynamic,
+      EquilibrateSchedule::longest_first};
+  for (int s = 0; s < 3; ++s) {
+    Population<IsingModel> pop(pop_size, gsl_rng_mt19937, *shared_data, 5);
+    pop.setSchedule(schedules[s]);
+    double beta = 0.1;
+    for (int step = 0; step < 4; ++step) {
+      pop.equilibrate(2, beta, IsingModel::UpdateMethod::wolff, false);
+      EXPECT_GE(pop.getLoadImbalance(), 1.0);
+      beta += 0.05;
+      pop.resample(beta);
+    }
+    for (int i = 0; i < pop.getPopSize(); ++i) {
+      states[s].push_back(pop.getState(i));
+    }
+  }
+  EXPECT_EQ(states[0], states[1]);
+  EXPECT_EQ(states[0], states[2]);
+}
+
+// A population smaller than the thread count runs Swendsen-Wang one replica
+// at a time on all threads, with the same results for any thread count.
+TEST_F(LargePopulationIsingModelTest, SwendsenWangSmallPopulation) {
+  const int max_threads = omp_get_max_threads();
+  std::vector<std::vector<int>> states[2];
+  for (int run = 0; run < 2; ++run) {
+    omp_set_num_threads(run == 0 ? 1 : 4);
+    Population<IsingModel> pop(2, gsl_rng_mt19937, *shared_data, 8);
+    double beta = 0.0;
+    while (beta < 0.5) {
+      pop.equilibrate(3, beta, IsingModel::UpdateMethod::swendsen_wang, false);
+      beta += 0.1;
+      pop.resample(beta);
+    }
+    pop.equilibrate(3, beta, IsingModel::UpdateMethod::swendsen_wang, false);
+    EXPECT_LT(pop.measureEnergy() / num_spins, -2.5);
+    for (int i = 0; i < pop.getPopSize(); ++i) {
+      states[run].push_back(pop.getState(i));
+    }
+  }
+  omp_set_num_threads(max_threads);
+  EXPECT_EQ(states[0], states[1]);
+}
+
+// Houdayer moves conserve the summed energy of each pair, so the population
+// average is unchanged, and they run the same for any thread count.
+TEST_F(LargePopulationIsingModelTest, HoudayerMovesIndependentOfThreadCount) {
+  const int max_threads = omp_get_max_threads();
+  std::vector<std::vector<int>> states[2];
+  for (int run = 0; run < 2; ++run) {
+    omp_set_num_threads(run == 0 ? 1 : 4);
+    Population<IsingModel> pop(pop_size, gsl_rng_mt19937, *shared_data, 21);
+    double beta = 0.0;
+    for (int step = 0; step < 4; ++step) {
+      pop.equilibrate(2, beta, IsingModel::UpdateMethod::metropolis, false);
+      const double energy = pop.measureEnergy();
+      pop.houdayerMoves(2);
+      EXPECT_NEAR(pop.measureEnergy(), energy, 1e-9);
+      EXPECT_EQ(pop.measureEnergy(), pop.measureEnergy(true));
+      beta += 0.1;
+      pop.resample(beta);
+    }
+    for (int i = 0; i < pop.getPopSize(); ++i) {
+      states[run].push_back(pop.getState(i));
+    }
+  }
+  omp_set_num_threads(max_threads);
+  EXPECT_EQ(states[0], states[1]);
+}
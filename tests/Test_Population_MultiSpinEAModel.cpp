@@ -0,0 +1,135 @@
+#include <gtest/gtest.h>
+#include <gsl/gsl_rng.h>
+#include <vector>
+#include <cmath>
+
+#include "Population.hpp"
+#include "models/MultiSpinEAModel.hpp"
+#include "SharedModelData.hpp"
+#include "models/Ising3DHelpers.hpp"
+#include "Genealogy.hpp"
+
+class PopulationMultiSpinEAModelTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    L = 5;
+    num_spins = L * L * L;
+    num_neighbors = 6;
+    J = 1.0;
+
+    neighbor_table = initializeNeighborTable3D(L);
+    bond_table.resize(num_spins * num_neighbors, J);  // ferromagnetic bonds
+
+    shared_data = new SharedModelData<MultiSpinEAModel>(
+        L, num_spins, num_neighbors, neighbor_table.data(), bond_table.data());
+
+    // Deliberately not a multiple of the 64 lanes per model object.
+    pop_size = 1000;
+    population = std::make_unique<Population<MultiSpinEAModel>>(
+        pop_size, gsl_rng_mt19937, *shared_data, 6416);
+  }
+
+  void TearDown() override { delete shared_data; }
+
+  int L;
+  int num_spins;
+  int num_neighbors;
+  double J;
+  int pop_size;
+  std::vector<int> neighbor_table;
+  std::vector<double> bond_table;
+  SharedModelData<MultiSpinEAModel>* shared_data;
+  std::unique_ptr<Population<MultiSpinEAModel>> population;
+};
+
+TEST_F(PopulationMultiSpinEAModelTest, PopulationInitializesCorrectly) {
+  EXPECT_EQ(population->getPopSize(), pop_size);
+  EXPECT_EQ(population->getModels().size(), 16);
+  GenealogyStatistics stats = population->computeGenealogyStatistics();
+  EXPECT_EQ(stats.num_unique_families, pop_size);
+  EXPECT_NEAR(stats.rho_t, 1.0, 1e-8);
+  EXPECT_NEAR(population->measureEnergy() / num_spins, 0.0,
+              sqrt(3.0 / num_spins));
+}
+
+TEST_F(PopulationMultiSpinEAModelTest, AnnealWithMetropolisToLowBeta) {
+  double beta = 0.05;
+  while (beta <= 0.15) {
+    population->equilibrate(20, beta,
+                            MultiSpinEAModel::UpdateMethod::metropolis, true);
+    EXPECT_NEAR(population->measureEnergy() / num_spins,
+                -3 * J * tanh(beta * J), 5e-2);
+    beta += 0.05;
+    population->resample(beta);
+  }
+}
+
+// Replicas that survive resampling must carry their spins and family with
+// them, whichever lane they land in.
+TEST_F(PopulationMultiSpinEAModelTest, ResampleKeepsReplicaStateAndFamily) {
+  double beta = 0.0;
+  while (beta < 0.5) {
+    population->equilibrate(5, beta,
+                            MultiSpinEAModel::UpdateMethod::metropolis, true);
+    beta = population->suggestNextBeta(beta, 0.1);
+    population->resample(beta);
+  }
+  population->measureEnergy(true);
+  GenealogyStatistics stats = population->computeGenealogyStatistics();
+  EXPECT_GT(stats.rho_t, 1.0);
+  EXPECT_LT(stats.num_unique_families, pop_size);
+
+  auto& models = population->getModels();
+  for (int i = 0; i < population->getPopSize(); ++i) {
+    int lane = i % MultiSpinEAModel::NUM_LANES;
+    const auto& model = models[i / MultiSpinEAModel::NUM_LANES];
+    EXPECT_GE(model.getFamily(lane), 0);
+    EXPECT_EQ(population->getState(i), model.getState(lane));
+  }
+}
+
+TEST_F(PopulationMultiSpinEAModelTest, AnnealWithBetaScheduler) {
+  double beta = 0.0;
+  while (beta < 2) {
+    population->equilibrate(10, beta,
+                            MultiSpinEAModel::UpdateMethod::metropolis, true);
+    beta = population->suggestNextBeta(beta, 0.1);
+    if (beta > 2) {
+      beta = 2;
+    }
+    population->resample(beta);
+  }
+  population->equilibrate(10, beta, MultiSpinEAModel::UpdateMethod::metropolis,
+                          true);
+  EXPECT_NEAR(population->getMinEnergy() / num_spins, -3, 1e-10);
+}
+
+// Observables are averaged over the replicas, not over whole model objects.
+TEST_F(PopulationMultiSpinEAModelTest, MeasureObservablesPerLane) {
+  using Observable = MultiSpinEAModel::Observable;
+  ObservableSet<MultiSpinEAModel> observables;
+  const int m2 = observables.add(Observable::magnetization, 2);
+  const int abs_m = observables.add(Observable::magnetization, 1, true);
+  const int spin0 = observables.add(
+      [](const MultiSpinEAModel& model, int lane) {
+        return static_cast<double>(model.getSpin(0, lane));
+      });
+  population->setObservables(observables);
+  population->equilibrate(5, 0.2, MultiSpinEAModel::UpdateMethod::metropolis,
+                          true);
+  const std::vector<double> values = population->measureObservables();
+
+  double sum_m2 = 0.0, sum_abs_m = 0.0, sum_spin0 = 0.0;
+  const auto& models = population->getModels();
+  for (int i = 0; i < pop_size; ++i) {
+    const int lane = i % MultiSpinEAModel::NUM_LANES;
+    const auto& model = models[i / MultiSpinEAModel::NUM_LANES];
+    const double m = model.measureMagnetization(lane);
+    sum_m2 += m * m;
+    sum_abs_m += std::abs(m);
+    sum_spin0 += model.getSpin(0, lane);
+  }
+  EXPECT_NEAR(values[m2], sum_m2 / pop_size, 1e-9);
+  EXPECT_NEAR(values[abs_m], sum_abs_m / pop_size, 1e-9);
+  EXPECT_NEAR(values[spin0], sum_spin0 / pop_size, 1e-12);
+}
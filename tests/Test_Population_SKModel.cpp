@@ -0,0 +1,92 @@
+#include <gtest/gtest.h>
+#include <gsl/gsl_rng.h>
+#include <vector>
+#include <cmath>
+
+#include "Population.hpp"
+#include "models/SKModel.hpp"
+#include "SharedModelData.hpp"
+#include "Genealogy.hpp"
+
+class PopulationSKModelTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    num_spins = 10;
+    couplings.assign(num_spins * num_spins, 0.0);
+    gsl_rng* r = gsl_rng_alloc(gsl_rng_mt19937);
+    gsl_rng_set(r, 2024);
+    for (int i = 0; i < num_spins; ++i) {
+      for (int j = i + 1; j < num_spins; ++j) {
+        const double J = (2 * gsl_rng_uniform(r) - 1) / std::sqrt(num_spins);
+        couplings[i * num_spins + j] = couplings[j * num_spins + i] = J;
+      }
+    }
+    gsl_rng_free(r);
+    shared_data = std::make_unique<SharedModelData<SKModel>>(
+        num_spins, couplings.data());
+
+    pop_size = 2000;
+    population = std::make_unique<Population<SKModel>>(
+        pop_size, gsl_rng_mt19937, *shared_data, 77);
+  }
+
+  // Exact thermal energy and ground state energy by enumeration.
+  void enumerate(double beta, double& mean_energy, double& ground_energy) const {
+    double Z = 0.0, sum_E = 0.0;
+    ground_energy = 0.0;
+    for (int state = 0; state < (1 << num_spins); ++state) {
+      double E = 0.0;
+      for (int i = 0; i < num_spins; ++i) {
+        for (int j = i + 1; j < num_spins; ++j) {
+          const int sij = (((state >> i) ^ (state >> j)) & 1) ? -1 : 1;
+          E -= couplings[i * num_spins + j] * sij;
+        }
+      }
+      Z += std::exp(-beta * E);
+      sum_E += E * std::exp(-beta * E);
+      ground_energy = std::min(ground_energy, E);
+    }
+    mean_energy = sum_E / Z;
+  }
+
+  int num_spins;
+  int pop_size;
+  std::vector<double> couplings;
+  std::unique_ptr<SharedModelData<SKModel>> shared_data;
+  std::unique_ptr<Population<SKModel>> population;
+};
+
+TEST_F(PopulationSKModelTest, AnnealMatchesExactEnumeration) {
+  double beta = 0.0;
+  while (beta < 2.0) {
+    population->equilibrate(10, beta, SKModel::UpdateMethod::metropolis, false);
+    beta = std::min(population->suggestNextBeta(beta, 0.2), 2.0);
+    population->resample(beta);
+  }
+  population->equilibrate(10, beta, SKModel::UpdateMethod::metropolis, false);
+
+  double mean_energy, ground_energy;
+  enumerate(beta, mean_energy, ground_energy);
+  EXPECT_NEAR(population->measureEnergy(), mean_energy, 0.05);
+  EXPECT_NEAR(population->getMinEnergy(), ground_energy, 1e-10);
+}
+
+// Replicas live in the population arena and carry their fields, energy and
+// family through resampling.
+TEST_F(PopulationSKModelTest, ResampleKeepsReplicaState) {
+  double beta = 0.0;
+  while (beta < 1.0) {
+    population->equilibrate(5, beta, SKModel::UpdateMethod::heat_bath, false);
+    beta = population->suggestNextBeta(beta, 0.2);
+    population->resample(beta);
+  }
+  GenealogyStatistics stats = population->computeGenealogyStatistics();
+  EXPECT_GT(stats.rho_t, 1.0);
+
+  const auto& models = population->getModels();
+  for (int i = 0; i < population->getPopSize(); ++i) {
+    const SKModel& model = models[i];
+    EXPECT_GE(model.getFamily(), 0);
+    EXPECT_NEAR(model.measureEnergy(), model.computeEnergy(), 1e-10);
+  }
+}
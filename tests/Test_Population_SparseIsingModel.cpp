@@ -0,0 +1,74 @@
+#include <gtest/gtest.h>
+#include <gsl/gsl_rng.h>
+#include <vector>
+#include <cmath>
+
+#include "Population.hpp"
+#include "models/SparseIsingModel.hpp"
+#include "SharedModelData.hpp"
+#include "Genealogy.hpp"
+
+// Max-Cut on a small random graph with varying degrees: J_ij = -w_ij, so the
+// ground state energy is -(W - 2 cut) and annealing must find the best cut.
+class PopulationSparseIsingModelTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    num_spins = 14;
+    gsl_rng* r = gsl_rng_alloc(gsl_rng_mt19937);
+    gsl_rng_set(r, 99);
+    for (int i = 0; i < num_spins; ++i) {
+      for (int j = i + 1; j < num_spins; ++j) {
+        if (gsl_rng_uniform(r) < 0.3) {
+          edges.push_back({i, j, -(1.0 + gsl_rng_uniform_int(r, 3))});
+        }
+      }
+    }
+    gsl_rng_free(r);
+    shared_data = std::make_unique<SharedModelData<SparseIsingModel>>(
+        SharedModelData<SparseIsingModel>::fromEdges(num_spins, edges));
+
+    pop_size = 1000;
+    population = std::make_unique<Population<SparseIsingModel>>(
+        pop_size, gsl_rng_mt19937, *shared_data, 31);
+  }
+
+  double groundStateEnergy() const {
+    double ground = 0.0;
+    for (int state = 0; state < (1 << num_spins); ++state) {
+      double E = 0.0;
+      for (const SparseTerm& edge : edges) {
+        E -= edge.weight *
+             ((((state >> edge.i) ^ (state >> edge.j)) & 1) ? -1 : 1);
+      }
+      ground = std::min(ground, E);
+    }
+    return ground;
+  }
+
+  int num_spins;
+  int pop_size;
+  std::vector<SparseTerm> edges;
+  std::unique_ptr<SharedModelData<SparseIsingModel>> shared_data;
+  std::unique_ptr<Population<SparseIsingModel>> population;
+};
+
+TEST_F(PopulationSparseIsingModelTest, AnnealFindsMaxCut) {
+  double beta = 0.0;
+  while (beta < 3.0) {
+    population->equilibrate(10, beta, SparseIsingModel::UpdateMethod::metropolis,
+                            true);
+    beta = std::min(population->suggestNextBeta(beta, 0.2), 3.0);
+    population->resample(beta);
+  }
+  population->equilibrate(10, beta, SparseIsingModel::UpdateMethod::metropolis,
+                          true);
+  EXPECT_NEAR(population->getMinEnergy(), groundStateEnergy(), 1e-10);
+
+  GenealogyStatistics stats = population->computeGenealogyStatistics();
+  EXPECT_GT(stats.rho_t, 1.0);
+  const auto& models = population->getModels();
+  for (int i = 0; i < population->getPopSize(); ++i) {
+    EXPECT_NEAR(models[i].measureEnergy(), models[i].computeEnergy(), 1e-10);
+    EXPECT_EQ(population->getState(i), models[i].getState());
+  }
+}
@@ -0,0 +1,61 @@
+#include <gtest/gtest.h>
+#include <gsl/gsl_rng.h>
+
+#include <cstdint>
+#include <set>
+#include <vector>
+
+#include "ReplicaArena.hpp"
+#include "SharedModelData.hpp"
+#include "models/Ising3DHelpers.hpp"
+#include "models/IsingModel.hpp"
+
+TEST(ReplicaArenaTest, SlotsAreAlignedAndDistinct) {
+  ReplicaArena arena(100, 8);
+  EXPECT_EQ(arena.slotBytes(), 128);
+  EXPECT_EQ(arena.numFree(), 8);
+
+  std::set<void*> slots;
+  for (int s = 0; s < 8; ++s) {
+    void* p = arena.acquire();
+    EXPECT_EQ(reinterpret_cast<std::uintptr_t>(p) % ReplicaArena::ALIGNMENT, 0);
+    EXPECT_EQ(arena.slotIndex(p), s);
+    slots.insert(p);
+  }
+  EXPECT_EQ(slots.size(), 8);
+  EXPECT_EQ(arena.numFree(), 0);
+  EXPECT_THROW(arena.acquire(), std::runtime_error);
+}
+
+TEST(ReplicaArenaTest, ReleasedSlotsAreReused) {
+  ReplicaArena arena(64, 4);
+  void* a = arena.acquire();
+  void* b = arena.acquire();
+  arena.release(a);
+  EXPECT_EQ(arena.acquire(), a);
+  arena.release(b);
+  EXPECT_EQ(arena.numFree(), 3);
+}
+
+// IsingModel views write only into their own slot.
+TEST(ReplicaArenaTest, IsingModelViews) {
+  int L = 4;
+  int num_spins = L * L * L;
+  std::vector<int> neighbor_table = initializeNeighborTable3D(L);
+  std::vector<double> bond_table(num_spins * 6, 1.0);
+  SharedModelData<IsingModel> shared_data(L, num_spins, 6,
+                                          neighbor_table.data(),
+                                          bond_table.data());
+  ReplicaArena arena(IsingModel::stateBytes(shared_data), 2);
+  IsingModel a(shared_data, arena.acquire());
+  IsingModel b(shared_data, arena.acquire());
+  EXPECT_EQ(a.stateData(), arena.slot(0));
+
+  gsl_rng* r = gsl_rng_alloc(gsl_rng_mt19937);
+  gsl_rng_set(r, 3);
+  a.initializeState(r);
+  EXPECT_NEAR(b.measureEnergy(), -3.0 * num_spins, 1e-10);
+  b.copyStateFrom(a);
+  EXPECT_EQ(b.getState(), a.getState());
+  gsl_rng_free(r);
+}
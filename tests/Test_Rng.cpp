@@ -0,0 +1,99 @@
+#include <gsl/gsl_rng.h>
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "Rng.hpp"
+
+// Known-answer vectors of the Random123 reference implementation.
+TEST(RngTest, PhiloxKnownAnswers) {
+  std::uint32_t out[4];
+  Philox4x32::block(0, 0, 0, out);
+  EXPECT_EQ(out[0], 0x6627e8d5u);
+  EXPECT_EQ(out[1], 0xe169c58du);
+  EXPECT_EQ(out[2], 0xbc57ac4cu);
+  EXPECT_EQ(out[3], 0x9b00dbd8u);
+
+  Philox4x32::block(~std::uint64_t{0}, ~std::uint64_t{0}, ~std::uint64_t{0},
+                    out);
+  EXPECT_EQ(out[0], 0x408f276du);
+  EXPECT_EQ(out[1], 0x41c83b0eu);
+  EXPECT_EQ(out[2], 0xa20bc7c6u);
+  EXPECT_EQ(out[3], 0x6d5451fdu);
+
+  Philox4x32::block(0x299f31d0a4093822ULL, 0x0370734413198a2eULL,
+                    0x85a308d3243f6a88ULL, out);
+  EXPECT_EQ(out[0], 0xd16cfe09u);
+  EXPECT_EQ(out[1], 0x94fdccebu);
+  EXPECT_EQ(out[2], 0x5001e420u);
+  EXPECT_EQ(out[3], 0x24126ea1u);
+}
+
+TEST(RngTest, GslBackendMatchesGslRng) {
+  RandomStream stream(RngBackend::gsl, 1234);
+  gsl_rng* r = gsl_rng_alloc(gsl_rng_mt19937);
+  gsl_rng_set(r, 1234);
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_EQ(stream.uniform(), gsl_rng_uniform(r));
+    EXPECT_EQ(stream.uniformInt(1000), gsl_rng_uniform_int(r, 1000));
+  }
+  gsl_rng_free(r);
+}
+
+// mt19937 keeps 32 bits of seed, but the high half of a 64-bit seed still
+// selects a different stream.
+TEST(RngTest, GslStreamsUseTheWholeSeed) {
+  RandomStream low(RngBackend::gsl, 5, 3);
+  RandomStream high(RngBackend::gsl, 5 | (std::uint64_t{1} << 40), 3);
+  bool differ = false;
+  for (int i = 0; i < 8; ++i) {
+    differ |= low.bits32() != high.bits32();
+  }
+  EXPECT_TRUE(differ);
+}
+
+TEST(RngTest, StreamsAreReproducibleAndDistinct) {
+  for (RngBackend backend : {RngBackend::philox, RngBackend::xoshiro}) {
+    RandomStream a(backend, 7, 0), b(backend, 7, 0), c(backend, 7, 1);
+    int same_as_c = 0;
+    for (int i = 0; i < 1000; ++i) {
+      std::uint32_t x = a.bits32();
+      EXPECT_EQ(x, b.bits32());
+      same_as_c += (x == c.bits32());
+    }
+    EXPECT_LT(same_as_c, 3);
+
+    a.seed(7, 0);
+    b.seed(7, 0);
+    EXPECT_EQ(a.bits64(), b.bits64());
+  }
+}
+
+TEST(RngTest, UniformMoments) {
+  for (RngBackend backend : {RngBackend::philox, RngBackend::xoshiro}) {
+    RandomStream stream(backend, 99);
+    const int n = 200000;
+    std::vector<double> values(n);
+    stream.fillUniform(values.data(), n);
+    double mean = 0.0, mean_sq = 0.0;
+    for (double u : values) {
+      ASSERT_GE(u, 0.0);
+      ASSERT_LT(u, 1.0);
+      mean += u;
+      mean_sq += u * u;
+    }
+    EXPECT_NEAR(mean / n, 0.5, 5e-3);
+    EXPECT_NEAR(mean_sq / n, 1.0 / 3.0, 5e-3);
+
+    std::vector<int> counts(7, 0);
+    for (int i = 0; i < 70000; ++i) {
+      unsigned long k = stream.uniformInt(7);
+      ASSERT_LT(k, 7u);
+      ++counts[k];
+    }
+    for (int count : counts) {
+      EXPECT_NEAR(count, 10000, 500);
+    }
+  }
+}
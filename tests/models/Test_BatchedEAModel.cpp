@@ -0,0 +1,163 @@
+#include <gsl/gsl_rng.h>
+#include <gtest/gtest.h>
+#include <cmath>
+
+#include <vector>
+
+#include "SharedModelData.hpp"
+#include "models/BatchedEAModel.hpp"
+#include "models/Ising3DHelpers.hpp"
+#include "models/IsingModel.hpp"
+#include "../RandomCouplings.hpp"
+
+class TestBatchedEAModel : public ::testing::Test {
+ protected:
+  int L = 5;
+  int num_spins = L * L * L;
+  int num_neighbors = 6;
+  std::vector<int> neighbor_table = initializeNeighborTable3D(L);
+  std::vector<double> ferro_bonds =
+      std::vector<double>(num_spins * num_neighbors, 1.0);
+  std::vector<double> ea_bonds = randomGaussianBonds(L, 17);
+  SharedModelData<BatchedEAModel> ferro_data =
+      SharedModelData<BatchedEAModel>(L, num_spins, num_neighbors,
+                                      neighbor_table.data(),
+                                      ferro_bonds.data());
+  SharedModelData<BatchedEAModel> ea_data =
+      SharedModelData<BatchedEAModel>(L, num_spins, num_neighbors,
+                                      neighbor_table.data(), ea_bonds.data());
+};
+
+TEST_F(TestBatchedEAModel, Construct) {
+  BatchedEAModel model(ferro_data);
+  std::vector<double> energies(BatchedEAModel::NUM_LANES);
+  model.measureEnergies(energies.data());
+  for (int lane = 0; lane < BatchedEAModel::NUM_LANES; ++lane) {
+    EXPECT_EQ(model.getSpin(0, lane), 1);
+    EXPECT_NEAR(energies[lane], -3.0 * num_spins, 1e-10);
+  }
+}
+
+// Every lane must agree with IsingModel holding the same spins.
+TEST_F(TestBatchedEAModel, EnergyMatchesIsingModel) {
+  SharedModelData<IsingModel> ising_data(L, num_spins, num_neighbors,
+                                         neighbor_table.data(),
+                                         ea_bonds.data());
+  BatchedEAModel model(ea_data);
+  IsingModel reference(ising_data);
+  gsl_rng* r = gsl_rng_alloc(gsl_rng_mt19937);
+  gsl_rng_set(r, 42);
+  model.initializeState(r);
+
+  std::vector<double> energies(BatchedEAModel::NUM_LANES);
+  std::vector<double> magnetizations(BatchedEAModel::NUM_LANES);
+  model.measureEnergies(energies.data());
+  model.measureObservables(BatchedEAModel::Observable::magnetization,
+                           magnetizations.data());
+  for (int lane = 0; lane < BatchedEAModel::NUM_LANES; ++lane) {
+    std::vector<int> state = model.getState(lane);
+    for (int i = 0; i < num_spins; ++i) {
+      reference.setSpin(i, state[i]);
+    }
+    EXPECT_NEAR(energies[lane], reference.computeEnergy(), 1e-10);
+    EXPECT_NEAR(model.measureEnergy(lane), reference.computeEnergy(), 1e-10);
+    EXPECT_NEAR(model.measureMagnetization(lane),
+                reference.measureMagnetization(), 1e-10);
+    EXPECT_EQ(magnetizations[lane], model.measureMagnetization(lane));
+  }
+  gsl_rng_free(r);
+}
+
+TEST_F(TestBatchedEAModel, CopyLane) {
+  BatchedEAModel model(ea_data);
+  BatchedEAModel model2(ea_data);
+  gsl_rng* r = gsl_rng_alloc(gsl_rng_mt19937);
+  gsl_rng_set(r, 42);
+  model.initializeState(r);
+  model2.initializeState(r);
+  model.setFamily(3, 7);
+  model.setParent(3, 9);
+
+  std::vector<int> untouched = model2.getState(6);
+  model2.copyLaneFrom(5, model, 3);
+  EXPECT_EQ(model2.getState(5), model.getState(3));
+  EXPECT_EQ(model2.getState(6), untouched);
+  EXPECT_EQ(model2.getFamily(5), 7);
+  EXPECT_EQ(model2.getParent(5), 9);
+  EXPECT_EQ(model2.measureEnergy(5), model.measureEnergy(3));
+  gsl_rng_free(r);
+}
+
+TEST_F(TestBatchedEAModel, RunningEnergiesTrackUpdates) {
+  using Method = BatchedEAModel::UpdateMethod;
+  BatchedEAModel model(ea_data);
+  gsl_rng* r = gsl_rng_alloc(gsl_rng_mt19937);
+  gsl_rng_set(r, 4);
+  model.initializeState(r);
+  for (Method method : {Method::metropolis, Method::heat_bath}) {
+    for (bool sequential : {false, true}) {
+      model.updateSweep(3, 0.8, r, method, sequential);
+      double running[BatchedEAModel::NUM_LANES];
+      double full[BatchedEAModel::NUM_LANES];
+      model.measureEnergies(running);
+      model.computeEnergies(full);
+      for (int lane = 0; lane < BatchedEAModel::NUM_LANES; ++lane) {
+        EXPECT_NEAR(running[lane], full[lane], 1e-9);
+      }
+    }
+  }
+  model.setSpin(5, 2, -model.getSpin(5, 2));
+  EXPECT_NEAR(model.measureEnergy(2), model.computeEnergy(2), 1e-9);
+  gsl_rng_free(r);
+}
+
+// Averaged over lanes, both methods must sample the same Gaussian-bond
+// equilibrium as IsingModel.
+TEST_F(TestBatchedEAModel, SweepsMatchIsingModel) {
+  using Method = BatchedEAModel::UpdateMethod;
+  SharedModelData<IsingModel> ising_data(L, num_spins, num_neighbors,
+                                         neighbor_table.data(),
+                                         ea_bonds.data());
+  const double beta = 0.5;
+  const int num_samples = 400;
+  gsl_rng* r = gsl_rng_alloc(gsl_rng_mt19937);
+  gsl_rng_set(r, 42);
+
+  IsingModel reference(ising_data);
+  reference.initializeState(r);
+  reference.updateSweep(200, beta, r, IsingModel::UpdateMethod::metropolis);
+  double reference_energy = 0.0;
+  for (int s = 0; s < num_samples * BatchedEAModel::NUM_LANES; ++s) {
+    reference.updateSweep(2, beta, r, IsingModel::UpdateMethod::metropolis);
+    reference_energy += reference.measureEnergy();
+  }
+  reference_energy /= num_samples * BatchedEAModel::NUM_LANES * num_spins;
+
+  for (Method method : {Method::metropolis, Method::heat_bath}) {
+    BatchedEAModel model(ea_data);
+    model.initializeState(r);
+    model.updateSweep(200, beta, r, method);
+    double energies[BatchedEAModel::NUM_LANES];
+    double avg_energy = 0.0;
+    for (int s = 0; s < num_samples; ++s) {
+      model.updateSweep(2, beta, r, method);
+      model.measureEnergies(energies);
+      for (double e : energies) {
+        avg_energy += e;
+      }
+    }
+    avg_energy /= num_samples * BatchedEAModel::NUM_LANES * num_spins;
+    EXPECT_NEAR(avg_energy, reference_energy, 1e-2);
+  }
+  gsl_rng_free(r);
+}
+
+// Lanes must not move in lock-step even though they share the site order.
+TEST_F(TestBatchedEAModel, LanesEvolveIndependently) {
+  BatchedEAModel model(ea_data);
+  gsl_rng* r = gsl_rng_alloc(gsl_rng_mt19937);
+  gsl_rng_set(r, 42);
+  model.updateSweep(5, 0.5, r, BatchedEAModel::UpdateMethod::metropolis, true);
+  EXPECT_NE(model.getState(0), model.getState(1));
+  gsl_rng_free(r);
+}
@@ -0,0 +1,107 @@
+#include <gsl/gsl_rng.h>
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "SharedModelData.hpp"
+#include "models/Ising3DHelpers.hpp"
+#include "models/IsingCheckerboard.hpp"
+#include "models/IsingModel.hpp"
+
+// L = 20 covers one full 16-site chunk per row plus a partial tail chunk.
+class TestIsingCheckerboard : public ::testing::Test {
+ protected:
+  int L = 20;
+  int num_spins = L * L * L;
+  std::vector<int> neighbor_table = initializeNeighborTable3D(L);
+
+  std::vector<double> plusMinusJBonds(unsigned long seed) {
+    std::vector<double> bonds(num_spins * 6);
+    gsl_rng* r = gsl_rng_alloc(gsl_rng_mt19937);
+    gsl_rng_set(r, seed);
+    for (int i = 0; i < num_spins; ++i) {
+      for (int n = 1; n < 6; n += 2) {
+        double J = gsl_rng_uniform_int(r, 2) ? 1.0 : -1.0;
+        bonds[i * 6 + n] = J;
+        bonds[neighbor_table[i * 6 + n] * 6 + n - 1] = J;
+      }
+    }
+    gsl_rng_free(r);
+    return bonds;
+  }
+
+  // Runs the kernel at the given level from a fixed random start.
+  std::vector<std::int32_t> sweep(const SharedModelData<IsingModel>& data,
+                                  bool heat_bath, SimdLevel level) {
+    std::vector<std::int32_t> spins(num_spins);
+    gsl_rng* r = gsl_rng_alloc(gsl_rng_mt19937);
+    gsl_rng_set(r, 3);
+    for (auto& s : spins) {
+      s = gsl_rng_uniform_int(r, 2) * 2 - 1;
+    }
+    gsl_rng_free(r);
+    const CheckerboardLattice lattice{
+        L,
+        data.direction_bonds.empty() ? nullptr : data.direction_bonds.data(),
+        static_cast<int>(data.bond_table[0] / data.bond_unit), data.bond_unit,
+        6 * data.max_bond_multiple};
+    CheckerboardRng rng(17);
+    checkerboardSweep(spins.data(), lattice, 0.8, heat_bath, 10, rng, level);
+    return spins;
+  }
+};
+
+TEST_F(TestIsingCheckerboard, DirectionBonds) {
+  std::vector<double> bonds = plusMinusJBonds(5);
+  SharedModelData<IsingModel> data(L, num_spins, 6, neighbor_table.data(),
+                                   bonds.data());
+  ASSERT_TRUE(data.cubic_lattice);
+  ASSERT_EQ(data.direction_bonds.size(), bonds.size());
+  for (int i = 0; i < num_spins; ++i) {
+    for (int n = 0; n < 6; ++n) {
+      EXPECT_EQ(data.direction_bonds[n * num_spins + i], bonds[i * 6 + n]);
+    }
+  }
+}
+
+// Every instruction set supported by this CPU must give the scalar result bit
+// for bit.
+TEST_F(TestIsingCheckerboard, SimdLevelsAgree) {
+  std::vector<double> ferro(num_spins * 6, 1.0);
+  std::vector<double> spin_glass = plusMinusJBonds(5);
+  const SimdLevel best = detectSimdLevel();
+  for (const double* bonds : {ferro.data(), spin_glass.data()}) {
+    SharedModelData<IsingModel> data(L, num_spins, 6, neighbor_table.data(),
+                                     bonds);
+    for (bool heat_bath : {false, true}) {
+      std::vector<std::int32_t> expected =
+          sweep(data, heat_bath, SimdLevel::scalar);
+      if (best >= SimdLevel::avx2) {
+        EXPECT_EQ(sweep(data, heat_bath, SimdLevel::avx2), expected);
+      }
+      if (best >= SimdLevel::avx512) {
+        EXPECT_EQ(sweep(data, heat_bath, SimdLevel::avx512), expected);
+      }
+    }
+  }
+}
+
+// Low temperature +/-J run: the energy must decrease well below the random
+// start and stay consistent with measureEnergy.
+TEST_F(TestIsingCheckerboard, SpinGlassAnneal) {
+  std::vector<double> bonds = plusMinusJBonds(9);
+  SharedModelData<IsingModel> data(L, num_spins, 6, neighbor_table.data(),
+                                   bonds.data());
+  IsingModel model(data);
+  gsl_rng* r = gsl_rng_alloc(gsl_rng_mt19937);
+  gsl_rng_set(r, 1);
+  model.initializeState(r);
+  for (double beta = 0.1; beta < 2.0; beta += 0.1) {
+    model.updateSweep(20, beta, r,
+                      IsingModel::UpdateMethod::metropolis_checkerboard);
+  }
+  // Ground state energy per spin of the 3D +/-J model is about -1.70.
+  EXPECT_LT(model.measureEnergy() / num_spins, -1.5);
+  gsl_rng_free(r);
+}
@@ -1,7 +1,12 @@
 #include <gsl/gsl_rng.h>
 #include <gtest/gtest.h>
 #include <cmath>
+#include <omp.h>
 
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 #include "SharedModelData.hpp"
@@ -42,6 +47,26 @@ TEST_F(TestIsingModel, CopyState) {
   gsl_rng_free(r);
 }
 
+// The model interface is checked at compile time and needs no vtable; the
+// genealogy kept by the Model base travels with copyStateFrom and moves.
+TEST_F(TestIsingModel, CopyStateCarriesGenealogy) {
+  static_assert(checkModelInterface<IsingModel>());
+  static_assert(!std::is_polymorphic_v<IsingModel>);
+
+  IsingModel model(shared_data);
+  IsingModel model2(shared_data);
+  model.setFamily(3);
+  model.setParent(5);
+  model2.copyStateFrom(model);
+  EXPECT_EQ(model2.getFamily(), 3);
+  EXPECT_EQ(model2.getParent(), 5);
+  EXPECT_THROW(model2.setFamily(4), std::logic_error);
+
+  IsingModel moved(std::move(model2));
+  EXPECT_EQ(moved.getFamily(), 3);
+  EXPECT_EQ(moved.getParent(), 5);
+}
+
 TEST_F(TestIsingModel, GetState) {
   IsingModel model(shared_data);
 
@@ -58,6 +83,23 @@ TEST_F(TestIsingModel, GetState) {
   gsl_rng_free(r);
 }
 
+// Growing a std::vector<IsingModel> moves models; the spins must survive.
+TEST_F(TestIsingModel, MoveKeepsState) {
+  gsl_rng* r = gsl_rng_alloc(gsl_rng_mt19937);
+  gsl_rng_set(r, 42);
+  std::vector<IsingModel> models;
+  std::vector<std::vector<int>> states;
+  for (int m = 0; m < 20; ++m) {
+    models.emplace_back(shared_data);
+    models.back().initializeState(r);
+    states.push_back(models.back().getState());
+  }
+  for (int m = 0; m < 20; ++m) {
+    EXPECT_EQ(models[m].getState(), states[m]);
+  }
+  gsl_rng_free(r);
+}
+
 TEST(IsingModelTest, CreateNeighborTable) {
   int L = 4;
   std::vector<int> table = initializeNeighborTable3D(L);
@@ -177,4 +219,847 @@ TEST_F(TestIsingModel, WolffSweep) {
   EXPECT_NEAR(avg_energy, -3, 5e-2);
   EXPECT_NEAR(avg_mag, 1.0, 5e-2);
   gsl_rng_free(r);
-}
\ No newline at end of file
+}
+// Clusters grow along satisfied bonds, so Wolff orders an antiferromagnet
+// (where every bond is satisfied in the Neel state) as well as a ferromagnet.
+TEST_F(TestIsingModel, WolffSweepAntiferromagnet) {
+  const int L_even = 4;
+  const int n = L_even * L_even * L_even;
+  std::vector<int> neighbors = initializeNeighborTable3D(L_even);
+  std::vector<double> bonds(n * 6, -1.0);
+  SharedModelData<IsingModel> data(L_even, n, 6, neighbors.data(),
+                                   bonds.data());
+  IsingModel model(data);
+  gsl_rng* r = gsl_rng_alloc(gsl_rng_mt19937);
+  gsl_rng_set(r, 42);
+  model.initializeState(r);
+  model.updateSweep(50, 2.0, r, IsingModel::UpdateMethod::wolff, false);
+  EXPECT_NEAR(model.measureEnergy() / n, -3.0, 0.2);
+  gsl_rng_free(r);
+}
+
+// With +/-J (tabulated) and Gaussian (per-bond) couplings, Wolff samples the
+// same average energy as Metropolis.
+TEST_F(TestIsingModel, WolffMatchesMetropolisForSpinGlasses) {
+  std::vector<double> pm_bonds(num_spins * num_neighbors);
+  std::vector<double> gaussian(num_spins * num_neighbors);
+  gsl_rng* r = gsl_rng_alloc(gsl_rng_mt19937);
+  gsl_rng_set(r, 3);
+  for (int i = 0; i < num_spins; ++i) {
+    for (int n = 1; n < num_neighbors; n += 2) {
+      const int j = neighbor_table[i * num_neighbors + n];
+      const double pm = gsl_rng_uniform(r) < 0.5 ? -1.0 : 1.0;
+      const double g = 2 * gsl_rng_uniform(r) - 1;
+      pm_bonds[i * num_neighbors + n] = pm_bonds[j * num_neighbors + n - 1] = pm;
+      gaussian[i * num_neighbors + n] = gaussian[j * num_neighbors + n - 1] = g;
+    }
+  }
+
+  const double beta = 0.4;
+  const int num_samples = 2000;
+  for (const double* bonds : {pm_bonds.data(), gaussian.data()}) {
+    SharedModelData<IsingModel> data(L, num_spins, num_neighbors,
+                                     neighbor_table.data(), bonds);
+    double averages[2];
+    int k = 0;
+    for (auto method : {IsingModel::UpdateMethod::metropolis,
+                        IsingModel::UpdateMethod::wolff}) {
+      IsingModel model(data);
+      model.initializeState(r);
+      model.updateSweep(100, beta, r, method, false);
+      double sum = 0.0;
+      for (int s = 0; s < num_samples; ++s) {
+        model.updateSweep(1, beta, r, method, false);
+        sum += model.measureEnergy();
+      }
+      averages[k++] = sum / (num_samples * num_spins);
+    }
+    EXPECT_NEAR(averages[0], averages[1], 0.02);
+  }
+  gsl_rng_free(r);
+}
+
+// Swendsen-Wang samples the same average energy as Metropolis, for the
+// ferromagnet and for +/-J and Gaussian spin glasses, in every spin
+// storage mode.
+TEST_F(TestIsingModel, SwendsenWangMatchesMetropolis) {
+  std::vector<double> pm_bonds(num_spins * num_neighbors);
+  std::vector<double> gaussian(num_spins * num_neighbors);
+  gsl_rng* r = gsl_rng_alloc(gsl_rng_mt19937);
+  gsl_rng_set(r, 8);
+  for (int i = 0; i < num_spins; ++i) {
+    for (int n = 1; n < num_neighbors; n += 2) {
+      const int j = neighbor_table[i * num_neighbors + n];
+      const double pm = gsl_rng_uniform(r) < 0.5 ? -1.0 : 1.0;
+      const double g = 2 * gsl_rng_uniform(r) - 1;
+      pm_bonds[i * num_neighbors + n] = pm_bonds[j * num_neighbors + n - 1] = pm;
+      gaussian[i * num_neighbors + n] = gaussian[j * num_neighbors + n - 1] = g;
+    }
+  }
+
+  const int num_samples = 2000;
+  for (const double* bonds :
+       {bond_table.data(), pm_bonds.data(), gaussian.data()}) {
+    const double beta = bonds == bond_table.data() ? 0.18 : 0.4;
+    for (SpinStorage storage : {SpinStorage::int32, SpinStorage::bit}) {
+      SharedModelData<IsingModel> data(L, num_spins, num_neighbors,
+                                       neighbor_table.data(), bonds, storage);
+      double averages[2];
+      int k = 0;
+      for (auto method : {IsingModel::UpdateMethod::metropolis,
+                          IsingModel::UpdateMethod::swendsen_wang}) {
+        IsingModel model(data);
+        model.initializeState(r);
+        model.updateSweep(100, beta, r, method, false);
+        double sum = 0.0;
+        for (int s = 0; s < num_samples; ++s) {
+          model.updateSweep(1, beta, r, method, false);
+          sum += model.measureEnergy();
+        }
+        averages[k++] = sum / (num_samples * num_spins);
+      }
+      EXPECT_NEAR(averages[0], averages[1], 0.03);
+    }
+  }
+  gsl_rng_free(r);
+}
+
+// The n-fold way runs the random-site Metropolis dynamics without the
+// rejected attempts, so both must sample the same energies.
+TEST_F(TestIsingModel, NFoldWayMatchesMetropolis) {
+  std::vector<double> pm_bonds(num_spins * num_neighbors);
+  gsl_rng* r = gsl_rng_alloc(gsl_rng_mt19937);
+  gsl_rng_set(r, 13);
+  for (int i = 0; i < num_spins; ++i) {
+    for (int n = 1; n < num_neighbors; n += 2) {
+      const int j = neighbor_table[i * num_neighbors + n];
+      const double pm = gsl_rng_uniform(r) < 0.5 ? -1.0 : 1.0;
+      pm_bonds[i * num_neighbors + n] = pm_bonds[j * num_neighbors + n - 1] = pm;
+    }
+  }
+
+  const int num_samples = 2000;
+  for (const double* bonds : {bond_table.data(), pm_bonds.data()}) {
+    const double beta = bonds == bond_table.data() ? 0.18 : 0.8;
+    for (SpinStorage storage : {SpinStorage::int32, SpinStorage::bit}) {
+      SharedModelData<IsingModel> data(L, num_spins, num_neighbors,
+                                       neighbor_table.data(), bonds, storage);
+      double averages[2];
+      int k = 0;
+      for (auto method : {IsingModel::UpdateMethod::metropolis,
+                          IsingModel::UpdateMethod::n_fold_way}) {
+        IsingModel model(data);
+        model.initializeState(r);
+        model.updateSweep(100, beta, r, method, false);
+        double sum = 0.0;
+        for (int s = 0; s < num_samples; ++s) {
+          model.updateSweep(1, beta, r, method, false);
+          sum += model.measureEnergy();
+        }
+        EXPECT_NEAR(model.measureEnergy(), model.computeEnergy(), 1e-9);
+        averages[k++] = sum / (num_samples * num_spins);
+      }
+      EXPECT_NEAR(averages[0], averages[1], 0.03);
+    }
+  }
+  gsl_rng_free(r);
+}
+
+// Deep in the low temperature phase, where nearly every Metropolis proposal
+// is rejected, the n-fold way must still sample the exact Boltzmann average
+// of a +/-J system small enough to enumerate (L = 2, 256 states).
+TEST(IsingModelTest, NFoldWayMatchesExactEnumeration) {
+  const int L = 2, N = 8, z = 6;
+  const double beta = 1.5;
+  std::vector<int> neighbors = initializeNeighborTable3D(L);
+  std::vector<double> bonds(N * z);
+  gsl_rng* r = gsl_rng_alloc(gsl_rng_mt19937);
+  gsl_rng_set(r, 21);
+  for (int i = 0; i < N; ++i) {
+    for (int n = 1; n < z; n += 2) {
+      const int j = neighbors[i * z + n];
+      bonds[i * z + n] = bonds[j * z + n - 1] =
+          gsl_rng_uniform(r) < 0.5 ? -1.0 : 1.0;
+    }
+  }
+  SharedModelData<IsingModel> data(L, N, z, neighbors.data(), bonds.data());
+  IsingModel model(data);
+
+  double Z = 0.0, sum_E = 0.0;
+  for (int state = 0; state < (1 << N); ++state) {
+    for (int i = 0; i < N; ++i) {
+      model.setSpin(i, ((state >> i) & 1) ? -1 : 1);
+    }
+    const double E = model.computeEnergy();
+    Z += std::exp(-beta * E);
+    sum_E += E * std::exp(-beta * E);
+  }
+
+  model.initializeState(r);
+  model.updateSweep(100, beta, r, IsingModel::UpdateMethod::n_fold_way, false);
+  const int num_samples = 100000;
+  double mean = 0.0;
+  for (int s = 0; s < num_samples; ++s) {
+    model.updateSweep(1, beta, r, IsingModel::UpdateMethod::n_fold_way, false);
+    mean += model.measureEnergy();
+  }
+  EXPECT_NEAR(model.measureEnergy(), model.computeEnergy(), 1e-9);
+  EXPECT_NEAR(mean / num_samples, sum_E / Z, 0.05);
+
+  // Zero sweeps leave the state alone.
+  const std::vector<int> state = model.getState();
+  model.updateSweep(0, beta, r, IsingModel::UpdateMethod::n_fold_way, false);
+  EXPECT_EQ(model.getState(), state);
+  gsl_rng_free(r);
+}
+
+TEST_F(TestIsingModel, NFoldWayRequiresDiscreteBonds) {
+  std::vector<double> gaussian(num_spins * num_neighbors);
+  gsl_rng* r = gsl_rng_alloc(gsl_rng_mt19937);
+  gsl_rng_set(r, 6);
+  for (int i = 0; i < num_spins; ++i) {
+    for (int n = 1; n < num_neighbors; n += 2) {
+      const int j = neighbor_table[i * num_neighbors + n];
+      const double g = 2 * gsl_rng_uniform(r) - 1;
+      gaussian[i * num_neighbors + n] = gaussian[j * num_neighbors + n - 1] = g;
+    }
+  }
+  SharedModelData<IsingModel> data(L, num_spins, num_neighbors,
+                                   neighbor_table.data(), gaussian.data());
+  ASSERT_FALSE(data.discrete_bonds);
+  IsingModel model(data);
+  EXPECT_THROW(
+      model.updateSweep(1, 1.0, r, IsingModel::UpdateMethod::n_fold_way, false),
+      std::invalid_argument);
+  gsl_rng_free(r);
+}
+
+// The update is parallel within the replica but must not depend on the number
+// of threads. The lattice spans several work chunks.
+TEST(IsingModelTest, SwendsenWangIndependentOfThreadCount) {
+  const int L = 20;
+  const int num_spins = L * L * L;
+  std::vector<int> neighbor_table = initializeNeighborTable3D(L);
+  std::vector<double> bonds(num_spins * 6, 1.0);
+  SharedModelData<IsingModel> data(L, num_spins, 6, neighbor_table.data(),
+                                   bonds.data());
+  const int max_threads = omp_get_max_threads();
+  std::vector<int> states[2];
+  double energies[2];
+  for (int run = 0; run < 2; ++run) {
+    omp_set_num_threads(run == 0 ? 1 : 4);
+    IsingModel model(data);
+    RandomStream r(RngBackend::philox, 17);
+    model.updateSweep(5, 0.2216, r, IsingModel::UpdateMethod::swendsen_wang);
+    states[run] = model.getState();
+    energies[run] = model.measureEnergy();
+    EXPECT_NEAR(energies[run], model.computeEnergy(), 1e-9);
+  }
+  omp_set_num_threads(max_threads);
+  EXPECT_EQ(states[0], states[1]);
+  EXPECT_EQ(energies[0], energies[1]);
+}
+
+// A Houdayer move flips a whole connected cluster of the sites where the two
+// replicas disagree, in both of them. That swaps the cluster, so the summed
+// energy and the overlap are unchanged, and each running energy stays exact.
+TEST_F(TestIsingModel, HoudayerMoveSwapsDisagreeingCluster) {
+  std::vector<double> gaussian(num_spins * num_neighbors);
+  gsl_rng* r = gsl_rng_alloc(gsl_rng_mt19937);
+  gsl_rng_set(r, 5);
+  for (int i = 0; i < num_spins; ++i) {
+    for (int n = 1; n < num_neighbors; n += 2) {
+      const int j = neighbor_table[i * num_neighbors + n];
+      const double g = 2 * gsl_rng_uniform(r) - 1;
+      gaussian[i * num_neighbors + n] = gaussian[j * num_neighbors + n - 1] = g;
+    }
+  }
+
+  for (SpinStorage storage : {SpinStorage::int32, SpinStorage::bit}) {
+    SharedModelData<IsingModel> data(L, num_spins, num_neighbors,
+                                     neighbor_table.data(), gaussian.data(),
+                                     storage);
+    IsingModel a(data), b(data);
+    a.initializeState(r);
+    b.initializeState(r);
+    a.updateSweep(5, 1.0, r, IsingModel::UpdateMethod::metropolis, false);
+    b.updateSweep(5, 1.0, r, IsingModel::UpdateMethod::metropolis, false);
+    for (int move = 0; move < 20; ++move) {
+      const std::vector<int> old_a = a.getState(), old_b = b.getState();
+      const double old_sum = a.measureEnergy() + b.measureEnergy();
+      const int size = a.houdayerMove(b, r);
+
+      int flipped = 0, overlap = 0, old_overlap = 0;
+      for (int i = 0; i < num_spins; ++i) {
+        const bool flip = a.getSpin(i) != old_a[i];
+        EXPECT_EQ(flip, b.getSpin(i) != old_b[i]);
+        if (flip) {
+          EXPECT_NE(old_a[i], old_b[i]);
+          // No disagreeing neighbor is left out of the cluster.
+          for (int n = 0; n < num_neighbors; ++n) {
+            const int j = neighbor_table[i * num_neighbors + n];
+            if (old_a[j] != old_b[j]) {
+              EXPECT_NE(a.getSpin(j), old_a[j]);
+            }
+          }
+        }
+        flipped += flip;
+        overlap += a.getSpin(i) * b.getSpin(i);
+        old_overlap += old_a[i] * old_b[i];
+      }
+      EXPECT_EQ(size, flipped);
+      EXPECT_GT(size, 0);
+      EXPECT_EQ(overlap, old_overlap);
+      EXPECT_NEAR(a.measureEnergy() + b.measureEnergy(), old_sum, 1e-9);
+      EXPECT_NEAR(a.measureEnergy(), a.computeEnergy(), 1e-9);
+      EXPECT_NEAR(b.measureEnergy(), b.computeEnergy(), 1e-9);
+    }
+
+    b.copyStateFrom(a);
+    RandomStream stream(RngBackend::philox, 3);
+    EXPECT_EQ(a.houdayerMove(b, stream), 0);
+  }
+  gsl_rng_free(r);
+}
+
+// Checkerboard sweeps on an even lattice, vectorized (int32) and per-site
+// (int8), must reproduce the high temperature energy.
+TEST(IsingModelTest, CheckerboardSweep) {
+  const int L = 6;
+  const int num_spins = L * L * L;
+  const double beta = 0.1;
+  std::vector<int> neighbor_table = initializeNeighborTable3D(L);
+  std::vector<double> bond_table(num_spins * 6, 1.0);
+  gsl_rng* r = gsl_rng_alloc(gsl_rng_mt19937);
+  gsl_rng_set(r, 42);
+
+  for (SpinStorage storage : {SpinStorage::int32, SpinStorage::int8}) {
+    SharedModelData<IsingModel> data(L, num_spins, 6, neighbor_table.data(),
+                                     bond_table.data(), storage);
+    ASSERT_TRUE(data.cubic_lattice);
+    for (auto method : {IsingModel::UpdateMethod::metropolis_checkerboard,
+                        IsingModel::UpdateMethod::heat_bath_checkerboard}) {
+      IsingModel model(data);
+      model.initializeState(r);
+      model.updateSweep(100, beta, r, method);
+      double avg_energy = 0.0;
+      for (int i = 0; i < 1000; ++i) {
+        model.updateSweep(5, beta, r, method);
+        avg_energy += model.measureEnergy();
+      }
+      avg_energy /= 1000 * num_spins;
+      EXPECT_NEAR(avg_energy, -3 * tanh(beta), 2e-2);
+    }
+  }
+  gsl_rng_free(r);
+}
+
+TEST_F(TestIsingModel, CheckerboardRequiresEvenCubicLattice) {
+  EXPECT_TRUE(shared_data.cubic_lattice);
+  IsingModel model(shared_data);
+  gsl_rng* r = gsl_rng_alloc(gsl_rng_mt19937);
+  EXPECT_THROW(model.updateSweep(
+                   1, 0.1, r, IsingModel::UpdateMethod::metropolis_checkerboard),
+               std::invalid_argument);
+
+  std::vector<int> shuffled = neighbor_table;
+  std::swap(shuffled[0], shuffled[1]);
+  SharedModelData<IsingModel> other(L, num_spins, num_neighbors,
+                                    shuffled.data(), bond_table.data());
+  EXPECT_FALSE(other.cubic_lattice);
+  gsl_rng_free(r);
+}
+
+// The running energy must follow every kind of update, the copy and setSpin.
+TEST(IsingModelTest, RunningEnergyTracksUpdates) {
+  using Method = IsingModel::UpdateMethod;
+  const int L = 6;
+  const int num_spins = L * L * L;
+  std::vector<int> neighbor_table = initializeNeighborTable3D(L);
+  std::vector<double> ferro(num_spins * 6, 1.0);
+  std::vector<double> gaussian(num_spins * 6);
+  gsl_rng* r = gsl_rng_alloc(gsl_rng_mt19937);
+  gsl_rng_set(r, 21);
+  for (int i = 0; i < num_spins; ++i) {
+    for (int n = 1; n < 6; n += 2) {
+      double J = gsl_rng_uniform(r) - 0.5;
+      gaussian[i * 6 + n] = J;
+      gaussian[neighbor_table[i * 6 + n] * 6 + n - 1] = J;
+    }
+  }
+
+  for (const double* bonds : {ferro.data(), gaussian.data()}) {
+    for (SpinStorage storage : {SpinStorage::int32, SpinStorage::bit}) {
+      SharedModelData<IsingModel> data(L, num_spins, 6, neighbor_table.data(),
+                                       bonds, storage);
+      IsingModel model(data), copy(data);
+      EXPECT_NEAR(model.measureEnergy(), model.computeEnergy(), 1e-9);
+      model.initializeState(r);
+      for (Method method :
+           {Method::metropolis, Method::heat_bath, Method::wolff,
+            Method::metropolis_checkerboard, Method::heat_bath_checkerboard,
+            Method::swendsen_wang}) {
+        model.updateSweep(3, 0.7, r, method);
+        EXPECT_NEAR(model.measureEnergy(), model.computeEnergy(), 1e-9);
+      }
+      model.setSpin(7, -model.getSpin(7));
+      EXPECT_NEAR(model.measureEnergy(), model.computeEnergy(), 1e-9);
+      copy.copyStateFrom(model);
+      EXPECT_EQ(copy.measureEnergy(), model.measureEnergy());
+    }
+  }
+  gsl_rng_free(r);
+}
+
+// The single-spin kernels are specialized for 4 and 6 neighbors and fall back
+// to a run-time count otherwise. On a periodic chain (2 neighbors, E/N =
+// -tanh(beta) for uniform and +/-J bonds alike up to O(e^-N) corrections) and
+// a square lattice (4 neighbors), every bond type must keep the running energy
+// in sync and the chain must reach the exact energy.
+TEST(IsingModelTest, SingleSpinKernelsOnOtherLattices) {
+  using Method = IsingModel::UpdateMethod;
+  gsl_rng* r = gsl_rng_alloc(gsl_rng_mt19937);
+  gsl_rng_set(r, 33);
+
+  const int L = 8;
+  const int num_spins = L * L;
+  std::vector<int> square(num_spins * 4);
+  for (int x = 0; x < L; ++x) {
+    for (int y = 0; y < L; ++y) {
+      const int i = x * L + y;
+      square[i * 4 + 0] = ((x + 1) % L) * L + y;
+      square[i * 4 + 1] = ((x + L - 1) % L) * L + y;
+      square[i * 4 + 2] = x * L + (y + 1) % L;
+      square[i * 4 + 3] = x * L + (y + L - 1) % L;
+    }
+  }
+  const int chain_length = 256;
+  std::vector<int> chain(chain_length * 2);
+  for (int i = 0; i < chain_length; ++i) {
+    chain[i * 2 + 0] = (i + 1) % chain_length;
+    chain[i * 2 + 1] = (i + chain_length - 1) % chain_length;
+  }
+
+  auto make_bonds = [&](const std::vector<int>& neighbors, int z, int kind) {
+    const int n = static_cast<int>(neighbors.size()) / z;
+    std::vector<double> bonds(neighbors.size(), 1.0);
+    for (int i = 0; i < n; ++i) {
+      for (int k = 0; k < z; k += 2) {
+        const double J = kind == 1   ? (gsl_rng_uniform(r) < 0.5 ? -1.0 : 1.0)
+                         : kind == 2 ? gsl_rng_uniform(r) - 0.5
+                                     : 1.0;
+        bonds[i * z + k] = J;
+        bonds[neighbors[i * z + k] * z + k + 1] = J;
+      }
+    }
+    return bonds;
+  };
+
+  for (int kind = 0; kind < 3; ++kind) {
+    std::vector<double> bonds = make_bonds(square, 4, kind);
+    SharedModelData<IsingModel> data(L, num_spins, 4, square.data(),
+                                     bonds.data(), SpinStorage::int8);
+    IsingModel model(data);
+    model.initializeState(r);
+    for (Method method : {Method::metropolis, Method::heat_bath}) {
+      for (bool sequential : {false, true}) {
+        model.updateSweep(5, 0.6, r, method, sequential);
+        EXPECT_NEAR(model.measureEnergy(), model.computeEnergy(), 1e-9);
+      }
+    }
+  }
+
+  const double beta = 0.8;
+  for (int kind = 0; kind < 2; ++kind) {
+    std::vector<double> bonds = make_bonds(chain, 2, kind);
+    SharedModelData<IsingModel> data(chain_length, chain_length, 2,
+                                     chain.data(), bonds.data());
+    for (Method method : {Method::metropolis, Method::heat_bath}) {
+      IsingModel model(data);
+      model.initializeState(r);
+      model.updateSweep(200, beta, r, method);
+      double sum = 0.0;
+      const int num_samples = 2000;
+      for (int s = 0; s < num_samples; ++s) {
+        model.updateSweep(1, beta, r, method);
+        sum += model.measureEnergy();
+      }
+      EXPECT_NEAR(model.measureEnergy(), model.computeEnergy(), 1e-9);
+      EXPECT_NEAR(sum / num_samples / chain_length, -std::tanh(beta), 0.01);
+    }
+  }
+  gsl_rng_free(r);
+}
+
+// The same random configuration must give identical observables in every spin
+// storage mode.
+TEST_F(TestIsingModel, SpinStorageModesAgree) {
+  std::vector<double> ea_bonds(num_spins * num_neighbors);
+  gsl_rng* r = gsl_rng_alloc(gsl_rng_mt19937);
+  gsl_rng_set(r, 7);
+  for (int i = 0; i < num_spins; ++i) {
+    for (int n = 1; n < num_neighbors; n += 2) {
+      double J = gsl_rng_uniform(r) - 0.5;
+      ea_bonds[i * num_neighbors + n] = J;
+      ea_bonds[neighbor_table[i * num_neighbors + n] * num_neighbors + n - 1] = J;
+    }
+  }
+
+  for (const double* bonds : {bond_table.data(), ea_bonds.data()}) {
+    SharedModelData<IsingModel> data32(L, num_spins, num_neighbors,
+                                       neighbor_table.data(), bonds,
+                                       SpinStorage::int32);
+    SharedModelData<IsingModel> data8(L, num_spins, num_neighbors,
+                                      neighbor_table.data(), bonds,
+                                      SpinStorage::int8);
+    SharedModelData<IsingModel> data1(L, num_spins, num_neighbors,
+                                      neighbor_table.data(), bonds,
+                                      SpinStorage::bit);
+    IsingModel model32(data32), model8(data8), model1(data1), other1(data1);
+    gsl_rng_set(r, 42);
+    model32.initializeState(r);
+    gsl_rng_set(r, 42);
+    model8.initializeState(r);
+    gsl_rng_set(r, 42);
+    model1.initializeState(r);
+
+    EXPECT_EQ(model8.getState(), model32.getState());
+    EXPECT_EQ(model1.getState(), model32.getState());
+    EXPECT_NEAR(model8.measureEnergy(), model32.measureEnergy(), 1e-10);
+    EXPECT_NEAR(model1.measureEnergy(), model32.measureEnergy(), 1e-10);
+    EXPECT_EQ(model1.measureMagnetization(), model32.measureMagnetization());
+
+    other1.copyStateFrom(model1);
+    EXPECT_EQ(other1.getState(), model1.getState());
+    EXPECT_EQ(other1.measureOverlap(model1), num_spins);
+    other1.setSpin(3, -other1.getSpin(3));
+    EXPECT_EQ(other1.measureOverlap(model1), num_spins - 2);
+  }
+  gsl_rng_free(r);
+}
+
+TEST_F(TestIsingModel, BitStorageMetropolisSweep) {
+  double beta = 0.1;
+  int num_samples = 100;
+  SharedModelData<IsingModel> packed_data(L, num_spins, num_neighbors,
+                                          neighbor_table.data(),
+                                          bond_table.data(), SpinStorage::bit);
+
+  IsingModel model(packed_data);
+  gsl_rng* r = gsl_rng_alloc(gsl_rng_mt19937);
+  gsl_rng_set(r, 42);
+  model.initializeState(r);
+  model.updateSweep(1000, beta, r, IsingModel::UpdateMethod::metropolis, true);
+
+  double avg_energy = 0.0;
+  for (int i = 0; i < num_samples; ++i) {
+    model.updateSweep(100, beta, r, IsingModel::UpdateMethod::metropolis,
+                      true);
+    avg_energy += model.measureEnergy();
+  }
+  avg_energy /= num_samples * num_spins;
+
+  EXPECT_NEAR(avg_energy, -3 * J * tanh(beta * J), 5e-2);
+  gsl_rng_free(r);
+}
+
+TEST_F(TestIsingModel, DetectsDiscreteBonds) {
+  EXPECT_TRUE(shared_data.discrete_bonds);
+  EXPECT_EQ(shared_data.bond_unit, 1.0);
+  EXPECT_EQ(shared_data.max_bond_multiple, 1);
+
+  std::vector<double> pm_bonds(num_spins * num_neighbors, 0.5);
+  pm_bonds[3] = -0.5;
+  pm_bonds[8] = 1.0;
+  SharedModelData<IsingModel> pm_data(L, num_spins, num_neighbors,
+                                      neighbor_table.data(), pm_bonds.data());
+  EXPECT_TRUE(pm_data.discrete_bonds);
+  EXPECT_EQ(pm_data.bond_unit, 0.5);
+  EXPECT_EQ(pm_data.max_bond_multiple, 2);
+
+  pm_bonds[5] = 0.3;
+  SharedModelData<IsingModel> gauss_data(L, num_spins, num_neighbors,
+                                         neighbor_table.data(),
+                                         pm_bonds.data());
+  EXPECT_FALSE(gauss_data.discrete_bonds);
+}
+
+// The tabulated Metropolis path must make exactly the decisions of the exp()
+// formula for the same random numbers.
+TEST_F(TestIsingModel, TabulatedMetropolisMatchesExp) {
+  std::vector<double> pm_bonds(num_spins * num_neighbors);
+  gsl_rng* r = gsl_rng_alloc(gsl_rng_mt19937);
+  gsl_rng_set(r, 11);
+  for (int i = 0; i < num_spins; ++i) {
+    for (int n = 1; n < num_neighbors; n += 2) {
+      double J = gsl_rng_uniform_int(r, 2) ? 0.5 : -0.5;
+      pm_bonds[i * num_neighbors + n] = J;
+      pm_bonds[neighbor_table[i * num_neighbors + n] * num_neighbors + n - 1] = J;
+    }
+  }
+  SharedModelData<IsingModel> pm_data(L, num_spins, num_neighbors,
+                                      neighbor_table.data(), pm_bonds.data());
+  ASSERT_TRUE(pm_data.discrete_bonds);
+
+  double beta = 0.7;
+  IsingModel model(pm_data);
+  gsl_rng_set(r, 5);
+  model.initializeState(r);
+  std::vector<int> spins = model.getState();
+
+  gsl_rng* r_ref = gsl_rng_alloc(gsl_rng_mt19937);
+  gsl_rng_set(r_ref, 99);
+  gsl_rng_set(r, 99);
+  model.updateSweep(20, beta, r, IsingModel::UpdateMethod::metropolis, true);
+  for (int sweep = 0; sweep < 20; ++sweep) {
+    for (int i = 0; i < num_spins; ++i) {
+      double delta_E = 0.0;
+      for (int n = 0; n < num_neighbors; ++n) {
+        delta_E += spins[neighbor_table[i * num_neighbors + n]] *
+                   pm_bonds[i * num_neighbors + n];
+      }
+      delta_E *= 2 * spins[i];
+      if (delta_E <= 0 || gsl_rng_uniform(r_ref) < exp(-beta * delta_E)) {
+        spins[i] *= -1;
+      }
+    }
+  }
+  EXPECT_EQ(model.getState(), spins);
+  gsl_rng_free(r_ref);
+  gsl_rng_free(r);
+}
+
+// Symmetric bonds for the neighbor table of initializeNeighborTableND: uniform
+// (kind 0), +/-J (kind 1) or continuous (kind 2).
+static std::vector<double> hypercubicBonds(const std::vector<int>& neighbors,
+                                           int z, int kind, gsl_rng* r) {
+  std::vector<double> bonds(neighbors.size(), 1.0);
+  const int num_spins = static_cast<int>(neighbors.size()) / z;
+  for (int i = 0; i < num_spins; ++i) {
+    for (int n = 1; n < z; n += 2) {
+      const double J = kind == 1   ? (gsl_rng_uniform(r) < 0.5 ? -1.0 : 1.0)
+                       : kind == 2 ? gsl_rng_uniform(r) - 0.5
+                                   : 1.0;
+      bonds[i * z + n] = J;
+      bonds[neighbors[i * z + n] * z + n - 1] = J;
+    }
+  }
+  return bonds;
+}
+
+// An implicit hypercubic lattice must reproduce the updates on the
+// equivalent neighbor table exactly: same random numbers, same neighbors and
+// bonds in the same order, hence the same spins and running energies.
+TEST(IsingModelTest, ImplicitLatticeMatchesNeighborTable) {
+  using Method = IsingModel::UpdateMethod;
+  EXPECT_EQ(initializeNeighborTableND(4, 3), initializeNeighborTable3D(4));
+  gsl_rng* r = gsl_rng_alloc(gsl_rng_mt19937);
+  gsl_rng_set(r, 17);
+  gsl_rng* r_table = gsl_rng_alloc(gsl_rng_mt19937);
+  gsl_rng* r_implicit = gsl_rng_alloc(gsl_rng_mt19937);
+
+  // Odd sides exercise the wrap of the random-site path away from powers of
+  // two; the checkerboard needs even sides, and the neighbor table D = 3.
+  const std::vector<std::pair<int, int>> lattices = {
+      {2, 8}, {2, 5}, {3, 4}, {3, 5}, {4, 4}, {5, 4}};
+  for (auto [D, L] : lattices) {
+    const int z = 2 * D;
+    std::vector<int> neighbors = initializeNeighborTableND(L, D);
+    const int num_spins = static_cast<int>(neighbors.size()) / z;
+    for (int kind = 0; kind < 3; ++kind) {
+      SCOPED_TRACE("D = " + std::to_string(D) + ", L = " + std::to_string(L) +
+                   ", bonds " + std::to_string(kind));
+      std::vector<double> bonds = hypercubicBonds(neighbors, z, kind, r);
+      for (SpinStorage storage : {SpinStorage::int32, SpinStorage::bit}) {
+        SharedModelData<IsingModel> table(L, num_spins, z, neighbors.data(),
+                                          bonds.data(), storage);
+        SharedModelData<IsingModel> implicit =
+            SharedModelData<IsingModel>::hypercubic(L, D, bonds.data(),
+                                                    storage);
+        EXPECT_EQ(implicit.neighbor_table, nullptr);
+        EXPECT_EQ(implicit.num_spins, num_spins);
+        EXPECT_EQ(implicit.discrete_bonds, table.discrete_bonds);
+        EXPECT_EQ(implicit.uniform_bonds, table.uniform_bonds);
+
+        IsingModel a(table), b(table), c(implicit), d(implicit);
+        gsl_rng_set(r_table, 3);
+        gsl_rng_set(r_implicit, 3);
+        a.initializeState(r_table);
+        b.initializeState(r_table);
+        c.initializeState(r_implicit);
+        d.initializeState(r_implicit);
+        EXPECT_EQ(c.computeEnergy(), a.computeEnergy());
+
+        std::vector<std::pair<Method, bool>> updates = {
+            {Method::metropolis, false}, {Method::heat_bath, false},
+            {Method::metropolis, true},  {Method::heat_bath, true},
+            {Method::wolff, false},      {Method::swendsen_wang, false}};
+        // Both lattices take the same checkerboard path, except for
+        // non-uniform discrete bonds with int32 spins, which only the
+        // neighbor table sweeps with the vectorized kernels.
+        const bool same_checkerboard =
+            D == 3 && L % 2 == 0 &&
+            !(kind == 1 && storage == SpinStorage::int32);
+        if (same_checkerboard) {
+          updates.push_back({Method::metropolis_checkerboard, false});
+          updates.push_back({Method::heat_bath_checkerboard, false});
+        }
+        if (kind < 2) {
+          updates.push_back({Method::n_fold_way, false});
+        }
+        for (auto [method, sequential] : updates) {
+          a.updateSweep(2, 0.4, r_table, method, sequential);
+          c.updateSweep(2, 0.4, r_implicit, method, sequential);
+          ASSERT_EQ(c.getState(), a.getState());
+          ASSERT_EQ(c.measureEnergy(), a.measureEnergy());
+        }
+        a.houdayerMove(b, r_table);
+        c.houdayerMove(d, r_implicit);
+        EXPECT_EQ(c.getState(), a.getState());
+        EXPECT_EQ(d.getState(), b.getState());
+        EXPECT_EQ(d.measureEnergy(), b.measureEnergy());
+        a.setSpin(1, -a.getSpin(1));
+        c.setSpin(1, -c.getSpin(1));
+        EXPECT_EQ(c.measureEnergy(), a.measureEnergy());
+        EXPECT_NEAR(c.measureEnergy(), c.computeEnergy(), 1e-9);
+        // Only the implicit lattice has a checkerboard in other dimensions.
+        if (!same_checkerboard && L % 2 == 0) {
+          c.updateSweep(2, 0.4, r_implicit, Method::heat_bath_checkerboard);
+          EXPECT_NEAR(c.measureEnergy(), c.computeEnergy(), 1e-9);
+        }
+      }
+    }
+  }
+  gsl_rng_free(r_implicit);
+  gsl_rng_free(r_table);
+  gsl_rng_free(r);
+}
+
+TEST(IsingModelTest, HypercubicRejectsInvalidLattices) {
+  gsl_rng* r = gsl_rng_alloc(gsl_rng_mt19937);
+  std::vector<int> neighbors = initializeNeighborTableND(4, 2);
+  std::vector<double> bonds = hypercubicBonds(neighbors, 4, 2, r);
+  EXPECT_NO_THROW(SharedModelData<IsingModel>::hypercubic(4, 2, bonds.data()));
+  EXPECT_THROW(SharedModelData<IsingModel>::hypercubic(4, 1, bonds.data()),
+               std::invalid_argument);
+  EXPECT_THROW(SharedModelData<IsingModel>::hypercubic(4, 6, bonds.data()),
+               std::invalid_argument);
+  EXPECT_THROW(SharedModelData<IsingModel>::hypercubic(1, 2, bonds.data()),
+               std::invalid_argument);
+  bonds[5] += 0.25;
+  EXPECT_THROW(SharedModelData<IsingModel>::hypercubic(4, 2, bonds.data()),
+               std::invalid_argument);
+  gsl_rng_free(r);
+}
+
+// Energy of a state given in the labelling of the neighbor table.
+static double tableEnergy(const std::vector<int>& state,
+                          const std::vector<int>& neighbors,
+                          const std::vector<double>& bonds, int z) {
+  double energy = 0.0;
+  for (std::size_t b = 0; b < neighbors.size(); ++b) {
+    energy -= 0.5 * bonds[b] * state[b / z] * state[neighbors[b]];
+  }
+  return energy;
+}
+
+// A relabeled lattice stores the spins in another order, but every public
+// index and state stays in the labelling of the neighbor table.
+TEST(IsingModelTest, RelabeledLatticeKeepsOriginalLabels) {
+  using Method = IsingModel::UpdateMethod;
+  gsl_rng* r = gsl_rng_alloc(gsl_rng_mt19937);
+  gsl_rng_set(r, 23);
+  const int L = 6;
+  const int num_spins = L * L * L;
+  const std::vector<int> neighbors = initializeNeighborTable3D(L);
+  const std::vector<double> bonds = hypercubicBonds(neighbors, 6, 2, r);
+  std::vector<int> pattern(num_spins);
+  for (int& s : pattern) {
+    s = gsl_rng_uniform(r) < 0.5 ? -1 : 1;
+  }
+
+  for (SpinOrder order : {SpinOrder::original, SpinOrder::morton,
+                          SpinOrder::tiled, SpinOrder::rcm}) {
+    for (SpinStorage storage : {SpinStorage::int32, SpinStorage::bit}) {
+      const auto shared_data = SharedModelData<IsingModel>::relabeled(
+          L, num_spins, 6, neighbors.data(), bonds.data(), order, storage);
+      ASSERT_EQ(shared_data.order.size(), static_cast<std::size_t>(num_spins));
+      EXPECT_EQ(shared_data.cubic_lattice, order == SpinOrder::original);
+
+      IsingModel model(shared_data);
+      IsingModel other(shared_data);
+      for (int i = 0; i < num_spins; ++i) {
+        model.setSpin(i, pattern[i]);
+      }
+      EXPECT_EQ(model.getState(), pattern);
+      for (int i = 0; i < num_spins; i += 7) {
+        EXPECT_EQ(model.getSpin(i), pattern[i]);
+      }
+      EXPECT_NEAR(model.measureEnergy(),
+                  tableEnergy(pattern, neighbors, bonds, 6), 1e-9);
+
+      other.initializeState(r);
+      for (Method method : {Method::metropolis, Method::heat_bath,
+                            Method::wolff, Method::swendsen_wang}) {
+        for (bool sequential : {false, method != Method::wolff}) {
+          model.updateSweep(3, 0.8, r, method, sequential);
+          EXPECT_NEAR(model.measureEnergy(),
+                      tableEnergy(model.getState(), neighbors, bonds, 6),
+                      1e-9);
+        }
+      }
+      model.houdayerMove(other, r);
+      EXPECT_NEAR(model.measureEnergy(),
+                  tableEnergy(model.getState(), neighbors, bonds, 6), 1e-9);
+      EXPECT_NEAR(other.measureEnergy(),
+                  tableEnergy(other.getState(), neighbors, bonds, 6), 1e-9);
+    }
+  }
+
+  // Z-order and tiles need lattice coordinates, but not a particular
+  // neighbor order; RCM takes any table.
+  std::vector<int> swapped = neighbors;
+  for (int i = 0; i < num_spins; ++i) {
+    std::swap(swapped[i * 6], swapped[i * 6 + 5]);
+  }
+  EXPECT_NO_THROW(SharedModelData<IsingModel>::relabeled(
+      L, num_spins, 6, swapped.data(), bonds.data(), SpinOrder::tiled));
+  const std::vector<int> square = initializeNeighborTableND(8, 2);
+  const std::vector<double> square_bonds(square.size(), 1.0);
+  EXPECT_THROW(SharedModelData<IsingModel>::relabeled(
+                   8, 64, 4, square.data(), square_bonds.data(),
+                   SpinOrder::morton),
+               std::invalid_argument);
+  EXPECT_NO_THROW(SharedModelData<IsingModel>::relabeled(
+      8, 64, 4, square.data(), square_bonds.data(), SpinOrder::rcm));
+  gsl_rng_free(r);
+}
+
+// hypercubic() reads bond_table only while it is built, so the caller may
+// free it right away.
+TEST(IsingModelTest, HypercubicDoesNotKeepTheBondTable) {
+  using Method = IsingModel::UpdateMethod;
+  gsl_rng* r = gsl_rng_alloc(gsl_rng_mt19937);
+  gsl_rng_set(r, 5);
+  for (int kind = 0; kind < 3; ++kind) {
+    for (SpinStorage storage : {SpinStorage::int32, SpinStorage::bit}) {
+      auto bonds = std::make_unique<std::vector<double>>(
+          hypercubicBonds(initializeNeighborTableND(4, 3), 6, kind, r));
+      const auto shared_data = SharedModelData<IsingModel>::hypercubic(
+          4, 3, bonds->data(), storage);
+      bonds.reset();
+      EXPECT_EQ(shared_data.bond_table, nullptr);
+      EXPECT_TRUE(shared_data.direction_bonds.empty());
+
+      IsingModel model(shared_data);
+      model.initializeState(r);
+      for (Method method :
+           {Method::metropolis, Method::heat_bath, Method::wolff,
+            Method::swendsen_wang, Method::metropolis_checkerboard}) {
+        model.updateSweep(2, 0.6, r, method, false);
+        EXPECT_NEAR(model.measureEnergy(), model.computeEnergy(), 1e-9);
+      }
+    }
+  }
+  gsl_rng_free(r);
+}
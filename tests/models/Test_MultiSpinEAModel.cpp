@@ -0,0 +1,205 @@
+#include <gsl/gsl_rng.h>
+#include <gtest/gtest.h>
+#include <cmath>
+
+#include <vector>
+
+#include "SharedModelData.hpp"
+#include "models/Ising3DHelpers.hpp"
+#include "models/IsingModel.hpp"
+#include "models/MultiSpinEAModel.hpp"
+
+// Symmetric +/-J bonds on the cubic lattice built by initializeNeighborTable3D,
+// where neighbor 2d is the -1 and 2d+1 the +1 step along axis d.
+static std::vector<double> randomPlusMinusJBonds(int L, unsigned long seed) {
+  int num_spins = L * L * L;
+  std::vector<int> neighbors = initializeNeighborTable3D(L);
+  std::vector<double> bonds(num_spins * 6);
+  gsl_rng* r = gsl_rng_alloc(gsl_rng_mt19937);
+  gsl_rng_set(r, seed);
+  for (int i = 0; i < num_spins; ++i) {
+    for (int d = 0; d < 3; ++d) {
+      double J = gsl_rng_uniform_int(r, 2) ? 1.0 : -1.0;
+      int j = neighbors[i * 6 + 2 * d + 1];
+      bonds[i * 6 + 2 * d + 1] = J;
+      bonds[j * 6 + 2 * d] = J;
+    }
+  }
+  gsl_rng_free(r);
+  return bonds;
+}
+
+class TestMultiSpinEAModel : public ::testing::Test {
+ protected:
+  int L = 5;
+  int num_spins = L * L * L;
+  int num_neighbors = 6;
+  std::vector<int> neighbor_table = initializeNeighborTable3D(L);
+  std::vector<double> ferro_bonds =
+      std::vector<double>(num_spins * num_neighbors, 1.0);
+  std::vector<double> ea_bonds = randomPlusMinusJBonds(L, 17);
+  SharedModelData<MultiSpinEAModel> ferro_data =
+      SharedModelData<MultiSpinEAModel>(L, num_spins, num_neighbors,
+                                        neighbor_table.data(),
+                                        ferro_bonds.data());
+  SharedModelData<MultiSpinEAModel> ea_data =
+      SharedModelData<MultiSpinEAModel>(L, num_spins, num_neighbors,
+                                        neighbor_table.data(),
+                                        ea_bonds.data());
+};
+
+TEST_F(TestMultiSpinEAModel, Construct) {
+  MultiSpinEAModel model(ferro_data);
+  std::vector<double> energies(MultiSpinEAModel::NUM_LANES);
+  model.measureEnergies(energies.data());
+  for (int lane = 0; lane < MultiSpinEAModel::NUM_LANES; ++lane) {
+    EXPECT_EQ(model.getSpin(0, lane), 1);
+    EXPECT_NEAR(energies[lane], -3.0 * num_spins, 1e-10);
+  }
+}
+
+TEST_F(TestMultiSpinEAModel, RejectsGaussianBonds) {
+  std::vector<double> bonds(num_spins * num_neighbors, 1.0);
+  bonds[7] = 0.5;
+  EXPECT_THROW(SharedModelData<MultiSpinEAModel>(L, num_spins, num_neighbors,
+                                                 neighbor_table.data(),
+                                                 bonds.data()),
+               std::invalid_argument);
+}
+
+// Every lane must agree with IsingModel holding the same spins.
+TEST_F(TestMultiSpinEAModel, EnergyMatchesIsingModel) {
+  SharedModelData<IsingModel> ising_data(L, num_spins, num_neighbors,
+                                         neighbor_table.data(),
+                                         ea_bonds.data());
+  MultiSpinEAModel model(ea_data);
+  IsingModel reference(ising_data);
+  gsl_rng* r = gsl_rng_alloc(gsl_rng_mt19937);
+  gsl_rng_set(r, 42);
+  model.initializeState(r);
+
+  std::vector<double> energies(MultiSpinEAModel::NUM_LANES);
+  std::vector<double> magnetizations(MultiSpinEAModel::NUM_LANES);
+  model.measureEnergies(energies.data());
+  model.measureObservables(MultiSpinEAModel::Observable::magnetization,
+                           magnetizations.data());
+  for (int lane = 0; lane < MultiSpinEAModel::NUM_LANES; ++lane) {
+    std::vector<int> state = model.getState(lane);
+    for (int i = 0; i < num_spins; ++i) {
+      reference.setSpin(i, state[i]);
+    }
+    EXPECT_NEAR(energies[lane], reference.measureEnergy(), 1e-10);
+    EXPECT_NEAR(model.measureEnergy(lane), reference.measureEnergy(), 1e-10);
+    EXPECT_NEAR(model.measureMagnetization(lane),
+                reference.measureMagnetization(), 1e-10);
+    EXPECT_EQ(magnetizations[lane], model.measureMagnetization(lane));
+  }
+  gsl_rng_free(r);
+}
+
+TEST_F(TestMultiSpinEAModel, CopyLane) {
+  MultiSpinEAModel model(ea_data);
+  MultiSpinEAModel model2(ea_data);
+  gsl_rng* r = gsl_rng_alloc(gsl_rng_mt19937);
+  gsl_rng_set(r, 42);
+  model.initializeState(r);
+  model2.initializeState(r);
+  model.setFamily(3, 7);
+  model.setParent(3, 9);
+
+  std::vector<int> untouched = model2.getState(12);
+  model2.copyLaneFrom(11, model, 3);
+  EXPECT_EQ(model2.getState(11), model.getState(3));
+  EXPECT_EQ(model2.getState(12), untouched);
+  EXPECT_EQ(model2.getFamily(11), 7);
+  EXPECT_EQ(model2.getParent(11), 9);
+  gsl_rng_free(r);
+}
+
+TEST_F(TestMultiSpinEAModel, CachedEnergiesTrackUpdates) {
+  MultiSpinEAModel model(ea_data);
+  MultiSpinEAModel other(ea_data);
+  gsl_rng* r = gsl_rng_alloc(gsl_rng_mt19937);
+  gsl_rng_set(r, 4);
+  model.initializeState(r);
+  other.initializeState(r);
+  model.updateSweep(3, 0.8, r, MultiSpinEAModel::UpdateMethod::metropolis);
+  model.setSpin(5, 2, -model.getSpin(5, 2));
+  other.copyLaneFrom(9, model, 2);
+
+  double cached[MultiSpinEAModel::NUM_LANES];
+  double full[MultiSpinEAModel::NUM_LANES];
+  model.measureEnergies(cached);
+  model.computeEnergies(full);
+  for (int lane = 0; lane < MultiSpinEAModel::NUM_LANES; ++lane) {
+    EXPECT_EQ(cached[lane], full[lane]);
+  }
+  EXPECT_EQ(other.measureEnergy(9), model.computeEnergy(2));
+  gsl_rng_free(r);
+}
+
+// Check that all lanes reach the expected high temperature energy
+TEST_F(TestMultiSpinEAModel, MetropolisSweep) {
+  double beta = 0.1;
+  int num_samples = 50;
+
+  MultiSpinEAModel model(ferro_data);
+  gsl_rng* r = gsl_rng_alloc(gsl_rng_mt19937);
+  gsl_rng_set(r, 42);
+  model.initializeState(r);
+  model.updateSweep(100, beta, r, MultiSpinEAModel::UpdateMethod::metropolis,
+                    true);
+
+  std::vector<double> energies(MultiSpinEAModel::NUM_LANES);
+  double avg_energy = 0.0;
+  for (int i = 0; i < num_samples; ++i) {
+    model.updateSweep(10, beta, r, MultiSpinEAModel::UpdateMethod::metropolis,
+                      true);
+    model.measureEnergies(energies.data());
+    for (double e : energies) {
+      avg_energy += e;
+    }
+  }
+  avg_energy /= num_samples * MultiSpinEAModel::NUM_LANES * num_spins;
+
+  EXPECT_NEAR(avg_energy, -3 * tanh(beta), 2e-2);
+  gsl_rng_free(r);
+}
+
+TEST_F(TestMultiSpinEAModel, HeatBathSweep) {
+  double beta = 0.1;
+  int num_samples = 50;
+
+  MultiSpinEAModel model(ferro_data);
+  gsl_rng* r = gsl_rng_alloc(gsl_rng_mt19937);
+  gsl_rng_set(r, 42);
+  model.initializeState(r);
+  model.updateSweep(100, beta, r, MultiSpinEAModel::UpdateMethod::heat_bath,
+                    false);
+
+  std::vector<double> energies(MultiSpinEAModel::NUM_LANES);
+  double avg_energy = 0.0;
+  for (int i = 0; i < num_samples; ++i) {
+    model.updateSweep(10, beta, r, MultiSpinEAModel::UpdateMethod::heat_bath,
+                      false);
+    model.measureEnergies(energies.data());
+    for (double e : energies) {
+      avg_energy += e;
+    }
+  }
+  avg_energy /= num_samples * MultiSpinEAModel::NUM_LANES * num_spins;
+
+  EXPECT_NEAR(avg_energy, -3 * tanh(beta), 2e-2);
+  gsl_rng_free(r);
+}
+
+// Lanes must not move in lock-step even though they share the site order.
+TEST_F(TestMultiSpinEAModel, LanesEvolveIndependently) {
+  MultiSpinEAModel model(ea_data);
+  gsl_rng* r = gsl_rng_alloc(gsl_rng_mt19937);
+  gsl_rng_set(r, 42);
+  model.updateSweep(5, 0.5, r, MultiSpinEAModel::UpdateMethod::metropolis,
+                    true);
+  EXPECT_NE(model.getState(0), model.getState(1));
+  gsl_rng_free(r);
+}
@@ -0,0 +1,149 @@
+#include <gsl/gsl_rng.h>
+#include <gtest/gtest.h>
+#include <cmath>
+
+#include <cstdint>
+#include <vector>
+
+#include "Rng.hpp"
+#include "SharedModelData.hpp"
+#include "models/SKModel.hpp"
+#include "../RandomCouplings.hpp"
+
+// Symmetric Gaussian couplings with variance 1/N and a zero diagonal.
+static std::vector<double> randomSKCouplings(int N, unsigned long seed) {
+  std::vector<double> J(N * N, 0.0);
+  gsl_rng* r = gsl_rng_alloc(gsl_rng_mt19937);
+  gsl_rng_set(r, seed);
+  for (int i = 0; i < N; ++i) {
+    for (int j = i + 1; j < N; ++j) {
+      J[i * N + j] = J[j * N + i] = gaussianDeviate(r) / std::sqrt(N);
+    }
+  }
+  gsl_rng_free(r);
+  return J;
+}
+
+static double bruteForceEnergy(const std::vector<double>& J,
+                               const std::vector<int>& s) {
+  const int N = static_cast<int>(s.size());
+  double energy = 0.0;
+  for (int i = 0; i < N; ++i) {
+    for (int j = i + 1; j < N; ++j) {
+      energy -= J[i * N + j] * s[i] * s[j];
+    }
+  }
+  return energy;
+}
+
+class TestSKModel : public ::testing::Test {
+ protected:
+  int N = 37;  // not a multiple of the row padding
+  std::vector<double> couplings = randomSKCouplings(N, 11);
+};
+
+TEST_F(TestSKModel, Construct) {
+  SharedModelData<SKModel> data(N, couplings.data());
+  EXPECT_EQ(data.row_stride % 8, 0);
+  EXPECT_GE(data.row_stride, N);
+  SKModel model(data);
+  EXPECT_EQ(model.getSpin(0), 1);
+  EXPECT_NEAR(model.measureEnergy(), bruteForceEnergy(couplings, model.getState()),
+              1e-10);
+  EXPECT_EQ(reinterpret_cast<std::uintptr_t>(model.stateData()) % 64, 0u);
+}
+
+TEST_F(TestSKModel, RejectsInvalidCouplings) {
+  std::vector<double> asymmetric = couplings;
+  asymmetric[1] += 0.5;
+  EXPECT_THROW(SharedModelData<SKModel>(N, asymmetric.data()),
+               std::invalid_argument);
+  std::vector<double> diagonal = couplings;
+  diagonal[2 * N + 2] = 1.0;
+  EXPECT_THROW(SharedModelData<SKModel>(N, diagonal.data()),
+               std::invalid_argument);
+}
+
+// The incrementally updated local fields and energy must match a full
+// recomputation after many accepted flips, in both precisions.
+TEST_F(TestSKModel, LocalFieldsStayExact) {
+  for (CouplingPrecision precision :
+       {CouplingPrecision::float64, CouplingPrecision::float32}) {
+    SharedModelData<SKModel> data(N, couplings.data(), precision);
+    const double tolerance =
+        precision == CouplingPrecision::float64 ? 1e-10 : 1e-4;
+    SKModel model(data);
+    gsl_rng* r = gsl_rng_alloc(gsl_rng_mt19937);
+    gsl_rng_set(r, 3);
+    model.initializeState(r);
+    for (auto method :
+         {SKModel::UpdateMethod::metropolis, SKModel::UpdateMethod::heat_bath}) {
+      model.updateSweep(50, 0.5, r, method, false);
+      const std::vector<int> s = model.getState();
+      for (int i = 0; i < N; ++i) {
+        double h = 0.0;
+        for (int j = 0; j < N; ++j) {
+          h += couplings[i * N + j] * s[j];
+        }
+        EXPECT_NEAR(model.getLocalField(i), h, tolerance);
+      }
+      EXPECT_NEAR(model.measureEnergy(), bruteForceEnergy(couplings, s),
+                  tolerance);
+    }
+    model.setSpin(4, -model.getSpin(4));
+    EXPECT_NEAR(model.measureEnergy(),
+                bruteForceEnergy(couplings, model.getState()), tolerance);
+    gsl_rng_free(r);
+  }
+}
+
+// Both update methods sample the Boltzmann distribution of a system small
+// enough to enumerate.
+TEST(SKModelTest, MatchesExactEnumeration) {
+  const int N = 8;
+  const double beta = 0.8;
+  std::vector<double> couplings = randomSKCouplings(N, 5);
+  double Z = 0.0, sum_E = 0.0;
+  for (int state = 0; state < (1 << N); ++state) {
+    std::vector<int> s(N);
+    for (int i = 0; i < N; ++i) {
+      s[i] = ((state >> i) & 1) ? -1 : 1;
+    }
+    const double E = bruteForceEnergy(couplings, s);
+    Z += std::exp(-beta * E);
+    sum_E += E * std::exp(-beta * E);
+  }
+  const double exact = sum_E / Z;
+
+  SharedModelData<SKModel> data(N, couplings.data());
+  for (auto method :
+       {SKModel::UpdateMethod::metropolis, SKModel::UpdateMethod::heat_bath}) {
+    SKModel model(data);
+    RandomStream rng(RngBackend::philox, 9);
+    model.updateSweep(100, beta, rng, method, false);
+    const int num_samples = 100000;
+    double mean = 0.0;
+    for (int k = 0; k < num_samples; ++k) {
+      model.updateSweep(1, beta, rng, method, false);
+      mean += model.measureEnergy();
+    }
+    EXPECT_NEAR(mean / num_samples, exact, 0.02);
+  }
+}
+
+TEST_F(TestSKModel, CopyStateFrom) {
+  SharedModelData<SKModel> data(N, couplings.data(), CouplingPrecision::float32);
+  SKModel a(data), b(data);
+  gsl_rng* r = gsl_rng_alloc(gsl_rng_mt19937);
+  gsl_rng_set(r, 8);
+  a.initializeState(r);
+  a.updateSweep(5, 1.0, r, SKModel::UpdateMethod::metropolis, true);
+  a.setFamily(3);
+  b.copyStateFrom(a);
+  EXPECT_EQ(b.getState(), a.getState());
+  EXPECT_EQ(b.measureEnergy(), a.measureEnergy());
+  EXPECT_EQ(b.getLocalField(N - 1), a.getLocalField(N - 1));
+  EXPECT_EQ(b.getFamily(), 3);
+  EXPECT_EQ(b.measureOverlap(a), N);
+  gsl_rng_free(r);
+}
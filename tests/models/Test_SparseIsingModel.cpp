@@ -0,0 +1,164 @@
+#include <gsl/gsl_rng.h>
+#include <gtest/gtest.h>
+#include <cmath>
+
+#include <vector>
+
+#include "Rng.hpp"
+#include "SharedModelData.hpp"
+#include "models/Ising3DHelpers.hpp"
+#include "models/IsingModel.hpp"
+#include "models/SparseIsingModel.hpp"
+
+// Random graph with degrees from 1 to ~8, Gaussian-like couplings and fields.
+static std::vector<SparseTerm> randomEdges(int N, int num_edges,
+                                           gsl_rng* r) {
+  std::vector<SparseTerm> edges;
+  for (int i = 1; i < N; ++i) {
+    // A spanning chain keeps the graph connected.
+    edges.push_back({i - 1, i, 2 * gsl_rng_uniform(r) - 1});
+  }
+  while (static_cast<int>(edges.size()) < num_edges) {
+    int i = gsl_rng_uniform_int(r, N);
+    int j = gsl_rng_uniform_int(r, N);
+    if (i != j) {
+      edges.push_back({i, j, 2 * gsl_rng_uniform(r) - 1});
+    }
+  }
+  return edges;
+}
+
+static double bruteForceEnergy(const std::vector<SparseTerm>& edges,
+                               const std::vector<double>& fields,
+                               const std::vector<int>& s) {
+  double energy = 0.0;
+  for (const SparseTerm& edge : edges) {
+    energy -= edge.weight * s[edge.i] * s[edge.j];
+  }
+  for (std::size_t i = 0; i < fields.size(); ++i) {
+    energy -= fields[i] * s[i];
+  }
+  return energy;
+}
+
+// The cubic lattice as a CSR graph must give IsingModel's energies, with or
+// without reordering, and getState must come back in the original labels.
+TEST(SparseIsingModelTest, MatchesIsingModelOnCubicLattice) {
+  const int L = 4, N = L * L * L;
+  std::vector<int> neighbors = initializeNeighborTable3D(L);
+  std::vector<double> bonds(N * 6);
+  gsl_rng* r = gsl_rng_alloc(gsl_rng_mt19937);
+  gsl_rng_set(r, 4);
+  for (int i = 0; i < N; ++i) {
+    for (int d = 0; d < 3; ++d) {
+      const double J = 2 * gsl_rng_uniform(r) - 1;
+      bonds[i * 6 + 2 * d + 1] = J;
+      bonds[neighbors[i * 6 + 2 * d + 1] * 6 + 2 * d] = J;
+    }
+  }
+  std::vector<long> offsets(N + 1);
+  for (int i = 0; i <= N; ++i) {
+    offsets[i] = 6L * i;
+  }
+  SharedModelData<IsingModel> ising_data(L, N, 6, neighbors.data(),
+                                         bonds.data());
+  IsingModel reference(ising_data);
+  reference.initializeState(r);
+
+  for (bool reorder : {false, true}) {
+    SharedModelData<SparseIsingModel> data(N, offsets, neighbors, bonds, {},
+                                           reorder);
+    EXPECT_EQ(data.max_degree, 6);
+    SparseIsingModel model(data);
+    const std::vector<int> state = reference.getState();
+    for (int i = 0; i < N; ++i) {
+      model.setSpin(i, state[i]);
+    }
+    EXPECT_EQ(model.getState(), state);
+    EXPECT_NEAR(model.measureEnergy(), reference.measureEnergy(), 1e-10);
+    EXPECT_NEAR(model.computeEnergy(), reference.measureEnergy(), 1e-10);
+  }
+  gsl_rng_free(r);
+}
+
+TEST(SparseIsingModelTest, RejectsInvalidTables) {
+  // 0 - 1 listed in one direction only.
+  EXPECT_THROW(SharedModelData<SparseIsingModel>(2, {0, 1, 1}, {1}, {1.0}),
+               std::invalid_argument);
+  // Mismatched weights.
+  EXPECT_THROW(
+      SharedModelData<SparseIsingModel>(2, {0, 1, 2}, {1, 0}, {1.0, 2.0}),
+      std::invalid_argument);
+  // Self loop.
+  EXPECT_THROW(SharedModelData<SparseIsingModel>::fromEdges(3, {{1, 1, 1.0}}),
+               std::invalid_argument);
+}
+
+// Running energies stay exact through sweeps on an irregular graph with
+// local fields, and both methods sample the Boltzmann distribution.
+TEST(SparseIsingModelTest, MatchesExactEnumeration) {
+  const int N = 10;
+  const double beta = 0.7;
+  gsl_rng* r = gsl_rng_alloc(gsl_rng_mt19937);
+  gsl_rng_set(r, 12);
+  std::vector<SparseTerm> edges = randomEdges(N, 18, r);
+  std::vector<double> fields(N);
+  for (double& h : fields) {
+    h = gsl_rng_uniform(r) - 0.5;
+  }
+  SharedModelData<SparseIsingModel> data =
+      SharedModelData<SparseIsingModel>::fromEdges(N, edges, fields);
+
+  double Z = 0.0, sum_E = 0.0;
+  for (int state = 0; state < (1 << N); ++state) {
+    std::vector<int> s(N);
+    for (int i = 0; i < N; ++i) {
+      s[i] = ((state >> i) & 1) ? -1 : 1;
+    }
+    const double E = bruteForceEnergy(edges, fields, s);
+    Z += std::exp(-beta * E);
+    sum_E += E * std::exp(-beta * E);
+  }
+
+  for (auto method : {SparseIsingModel::UpdateMethod::metropolis,
+                      SparseIsingModel::UpdateMethod::heat_bath}) {
+    SparseIsingModel model(data);
+    model.initializeState(r);
+    RandomStream rng(RngBackend::philox, 2);
+    model.updateSweep(100, beta, rng, method, true);
+    const int num_samples = 200000;
+    double mean = 0.0;
+    for (int k = 0; k < num_samples; ++k) {
+      model.updateSweep(1, beta, rng, method, false);
+      mean += model.measureEnergy();
+    }
+    EXPECT_NEAR(model.measureEnergy(),
+                bruteForceEnergy(edges, fields, model.getState()), 1e-10);
+    EXPECT_NEAR(mean / num_samples, sum_E / Z, 0.05);
+  }
+  gsl_rng_free(r);
+}
+
+// Every energy of the Ising form equals the QUBO objective of the matching x.
+TEST(SparseIsingModelTest, QuboObjective) {
+  const int N = 6;
+  std::vector<SparseTerm> terms = {{0, 0, -1.0}, {1, 1, 2.0}, {0, 1, 3.0},
+                                   {1, 0, -0.5}, {2, 4, 1.5}, {3, 5, -2.0},
+                                   {5, 5, 0.5},  {4, 1, 1.0}, {2, 2, -1.5}};
+  SharedModelData<SparseIsingModel> data =
+      SharedModelData<SparseIsingModel>::fromQubo(N, terms);
+  SparseIsingModel model(data);
+  for (int state = 0; state < (1 << N); ++state) {
+    std::vector<int> x(N);
+    for (int i = 0; i < N; ++i) {
+      x[i] = (state >> i) & 1;
+      model.setSpin(i, 2 * x[i] - 1);
+    }
+    double objective = 0.0;
+    for (const SparseTerm& term : terms) {
+      objective += term.weight * x[term.i] * x[term.j];
+    }
+    EXPECT_NEAR(model.measureEnergy(), objective, 1e-12);
+    EXPECT_NEAR(model.computeEnergy(), objective, 1e-12);
+  }
+}
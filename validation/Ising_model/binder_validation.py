@@ -1,10 +1,14 @@
 #!/usr/bin/env python3
 
 import subprocess
+import sys
 import numpy as np
 import matplotlib.pyplot as plt
 import os
 
+sys.path.append(os.path.join(os.path.dirname(os.path.abspath(__file__)), ".."))
+from pamc_data import load_run
+
 # Parameters
 Ls = [4, 6, 8]#, 10]
 num_runs = 1
@@ -49,6 +53,7 @@ for L in Ls:
 
     for run_idx in range(num_runs):
         seed = np.random.randint(1e5, 1e9)
+        run_dir = os.path.join(data_dir, f"L{L}_run{run_idx}")
         cmd = [
             executable,
             str(L),
@@ -56,26 +61,18 @@ for L in Ls:
             str(culling_frac),
             str(beta_max),
             str(seed),
-            str(num_threads)
+            str(num_threads),
+            run_dir
         ]
 
-        proc = subprocess.run(
-            cmd,
-            check=True,
-            stdout=subprocess.PIPE,
-            universal_newlines=True
-        )
-
-        lines = proc.stdout.strip().split("\n")
-        data = np.array([
-            [float(val) for val in line.split()]
-            for line in lines if line.strip()
-        ])
-
-        steps = data[:, 0].astype(int)
-        beta = data[:, 1]
-        binder = data[:, 4]
-        rho_t = data[:, 5]
+        subprocess.run(cmd, check=True)
+
+        # Binary columns written by DataWriter, no text parsing
+        run = load_run(run_dir)
+        steps = run["step"]
+        beta = run["beta"]
+        binder = run["binder"]
+        rho_t = run["rho_t"]
 
         if beta_ref is None:
             beta_ref = beta
@@ -0,0 +1,37 @@
+#!/usr/bin/env python3
+"""Reader for the columnar run directories written by DataWriter.
+
+The layout is documented in include/DataWriter.hpp: schema.json lists the
+columns, each stored as a raw array in <name>.bin; array columns (one
+variable-length array per step) add <name>.offsets.bin with the int64 start
+of every step and the total at the end.
+"""
+
+import json
+import os
+
+import numpy as np
+
+_DTYPES = {"float64": "f8", "int64": "i8", "int32": "i4", "int8": "i1"}
+
+
+def load_run(directory):
+    """Returns a dict mapping column names to numpy arrays (one entry per
+    step) for scalar columns, and to lists of per-step arrays for array
+    columns."""
+    with open(os.path.join(directory, "schema.json")) as f:
+        schema = json.load(f)
+    if schema.get("format") != "pamc-columnar" or schema.get("version") != 1:
+        raise ValueError(f"{directory} is not a pamc-columnar v1 run")
+    order = "<" if schema["byte_order"] == "little" else ">"
+
+    run = {}
+    for column in schema["columns"]:
+        dtype = np.dtype(order + _DTYPES[column["type"]])
+        values = np.fromfile(os.path.join(directory, column["file"]), dtype=dtype)
+        if column["kind"] == "array":
+            offsets = np.fromfile(os.path.join(directory, column["offsets"]),
+                                  dtype=order + "i8")
+            values = [values[a:b] for a, b in zip(offsets[:-1], offsets[1:])]
+        run[column["name"]] = values
+    return run